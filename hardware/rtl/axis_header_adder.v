@@ -34,12 +34,22 @@ THE SOFTWARE.
 
 /**********************************************************************************
  * axis_header_adder: includes the header at the beginning of the output stream,
- * forwarding then the main (payload) input stream
+ * forwarding then the main (payload) input stream, followed by a trailer word
  * Behavior:
     1) IDLE: wait for hdr_valid
     2) HEADER: add the N header words at m_axis, once per cycle, in the following order:
     {udp_length, source_ip, source_port, dest_ip, dest_port}
-    3) PAYLOAD: forward the payload
+    The upper (unused) bits of words 1-4 carry the rest of the original IP/UDP header:
+        word 1: [47:32] ip identification, [55:48] ip ttl, [63:56] ip tos
+        word 2: [63:16] source mac
+        word 3: [47:32] ip header checksum, [63:48] udp checksum
+        word 4: [18:16] ip flags, [31:19] ip fragment offset, [35:32] ip ihl, [63] extended header flag
+    3) PAYLOAD: forward the payload, computing the UDP checksum on the fly
+    4) TRAILER: add one word with the UDP checksum verification result and the rx timestamp:
+        [15:00] ones' complement sum of pseudo header, udp header and payload
+        [16] udp checksum present (not zero), [17] udp checksum ok
+        [18] timestamp present, [63:24] hdr_timestamp (latched when the header is accepted)
+    The trailer is placed at the first 8-byte boundary after the payload
 **********************************************************************************/
 
 module axis_header_adder #(
@@ -57,6 +67,16 @@ module axis_header_adder #(
     input  wire [31:00] hdr_dest_ip        ,
     input  wire [15:00] hdr_dest_port      ,
     input  wire [15:00] hdr_udp_length     ,
+    input  wire [47:00] hdr_source_mac     ,
+    input  wire [07:00] hdr_ip_tos         ,
+    input  wire [07:00] hdr_ip_ttl         ,
+    input  wire [15:00] hdr_ip_identification ,
+    input  wire [02:00] hdr_ip_flags       ,
+    input  wire [12:00] hdr_ip_fragment_offset,
+    input  wire [03:00] hdr_ip_ihl         ,
+    input  wire [15:00] hdr_ip_header_checksum,
+    input  wire [15:00] hdr_udp_checksum   ,
+    input  wire [39:00] hdr_timestamp      ,
 
     output reg          s_axis_payload_tready,
     input  wire         s_axis_payload_tvalid,
@@ -99,7 +119,8 @@ end
 localparam
     STATE_IDLE     = 2'd0,
     STATE_FORW_HDR = 2'd1,
-    STATE_FORW_PYL = 2'd2;
+    STATE_FORW_PYL = 2'd2,
+    STATE_FORW_TRL = 2'd3;
 reg [1:0] state = STATE_IDLE;
 
 wire payload_last;
@@ -112,12 +133,57 @@ always @ (posedge clk) begin
         case (state)
             STATE_IDLE      : if (hdr_ready & hdr_valid_port                                                          ) state <= STATE_FORW_HDR;
             STATE_FORW_HDR  : if (count_header == HEADER_NUM_WORDS-1 && axis_forwarded_tready && axis_forwarded_tvalid) state <= STATE_FORW_PYL;
-            STATE_FORW_PYL  : if (payload_last                                                                        ) state <= STATE_IDLE;
+            STATE_FORW_PYL  : if (payload_last                                                                        ) state <= STATE_FORW_TRL;
+            STATE_FORW_TRL  : if (axis_forwarded_tready                                                               ) state <= STATE_IDLE;
             default         :                                                                                           state <= STATE_IDLE;
         endcase
     end
 end
 
+// Rx timestamp, held until the trailer
+
+reg [39:00] timestamp_reg;
+always @ (posedge clk) begin
+    if (state == STATE_IDLE && hdr_ready && hdr_valid_port) timestamp_reg <= hdr_timestamp;
+end
+
+// UDP checksum: 32-bit accumulator of 16-bit words (pseudo header + udp header first, then payload)
+
+localparam IP_PROTOCOL_UDP = 16'd17;
+
+wire [31:00] checksum_hdr_sum;
+assign checksum_hdr_sum = hdr_source_ip[31:16] + hdr_source_ip[15:00] + hdr_dest_ip[31:16] + hdr_dest_ip[15:00] 
+                        + IP_PROTOCOL_UDP + hdr_udp_length                                                 // pseudo header
+                        + hdr_source_port + hdr_dest_port + hdr_udp_length + hdr_udp_checksum;             // udp header
+
+// Payload bytes come in network order (byte 0 at tdata[7:0]), bytes not kept count as zero
+reg  [63:00] payload_masked;
+integer      byte_index;
+always @ (*) begin
+    for (byte_index = 0; byte_index < 8; byte_index = byte_index + 1)
+        payload_masked[byte_index*8 +: 8] <= s_axis_payload_tkeep[byte_index] ? s_axis_payload_tdata[byte_index*8 +: 8] : 8'h00;
+end
+
+wire [31:00] checksum_beat_sum;
+assign checksum_beat_sum = {payload_masked[07:00], payload_masked[15:08]} + {payload_masked[23:16], payload_masked[31:24]}
+                         + {payload_masked[39:32], payload_masked[47:40]} + {payload_masked[55:48], payload_masked[63:56]};
+
+reg [31:00] checksum_acc;
+always @ (posedge clk) begin
+    if      (state == STATE_IDLE                                                      ) checksum_acc <= checksum_hdr_sum;
+    else if (state == STATE_FORW_PYL && s_axis_payload_tready && s_axis_payload_tvalid) checksum_acc <= checksum_acc + checksum_beat_sum;
+end
+
+wire [16:00] checksum_fold1;
+wire [15:00] checksum_fold2;
+assign checksum_fold1 = checksum_acc[31:16] + checksum_acc[15:00];
+assign checksum_fold2 = checksum_fold1[15:00] + checksum_fold1[16];
+
+wire checksum_present;
+wire checksum_ok;
+assign checksum_present = hdr_udp_checksum != 16'h0000;
+assign checksum_ok      = checksum_present && checksum_fold2 == 16'hFFFF;
+
 // Data to be forwarded
 
 localparam UDP_OVERHEAD_LENGTH = 8; // hdr_udp_length counts 8 extra bytes (for metadata) that are not part of the payload
@@ -134,10 +200,10 @@ always @ (*) begin
             axis_forwarded_tuser  <= 1'b0;
             case (count_header)
                 0      : axis_forwarded_tdata <= {48'b0, hdr_udp_length-UDP_OVERHEAD_LENGTH};
-                1      : axis_forwarded_tdata <= {32'b0, hdr_source_ip};
-                2      : axis_forwarded_tdata <= {48'b0, hdr_source_port};
-                3      : axis_forwarded_tdata <= {32'b0, hdr_dest_ip};
-                4      : axis_forwarded_tdata <= {48'b0, hdr_dest_port};
+                1      : axis_forwarded_tdata <= {hdr_ip_tos, hdr_ip_ttl, hdr_ip_identification, hdr_source_ip};
+                2      : axis_forwarded_tdata <= {hdr_source_mac, hdr_source_port};
+                3      : axis_forwarded_tdata <= {hdr_udp_checksum, hdr_ip_header_checksum, hdr_dest_ip};
+                4      : axis_forwarded_tdata <= {1'b1, 27'b0, hdr_ip_ihl, hdr_ip_fragment_offset, hdr_ip_flags, hdr_dest_port};
                 default: axis_forwarded_tdata <= {64'b0};
             endcase
         end
@@ -148,10 +214,20 @@ always @ (*) begin
             axis_forwarded_tdata  <= s_axis_payload_tdata ;
             axis_forwarded_tkeep  <= s_axis_payload_tkeep ;
             axis_forwarded_tvalid <= s_axis_payload_tvalid;
-            axis_forwarded_tlast  <= s_axis_payload_tlast ;
+            axis_forwarded_tlast  <= 1'b0                 ; // the trailer closes the stream
             axis_forwarded_tuser  <= s_axis_payload_tuser ;
         end
 
+        STATE_FORW_TRL: begin
+            hdr_ready             <= 1'b0;
+            s_axis_payload_tready <= 1'b0;
+            axis_forwarded_tdata  <= {timestamp_reg, 5'b0, 1'b1, checksum_ok, checksum_present, checksum_fold2};
+            axis_forwarded_tkeep  <= {8{1'b1}};
+            axis_forwarded_tvalid <= 1'b1;
+            axis_forwarded_tlast  <= 1'b1;
+            axis_forwarded_tuser  <= 1'b0;
+        end
+
         default: begin
             hdr_ready             <= axis_forwarded_tready;
             s_axis_payload_tready <= 1'b0;
@@ -34,12 +34,21 @@ THE SOFTWARE.
 
 /**********************************************************************************
  * axis_udp_port_filter: for an incoming packet, it checks if the destination port
- * matches any open socket (within the udp port range), forwards the packet if so
- * or discards the packet otherwise
+ * matches any open socket (within the udp port range, or listed in the port map),
+ * forwards the packet if so or discards the packet otherwise. The rx buffer of
+ * the port (hdr_buffer_idx) is given by the port map for the ports it lists
+ * (hdr_port_mapped), by the offset within the udp port range otherwise
  * Behavior:
     1) IDLE: waits for hdr_valid and dma_done
-    2) CHECK_PORT: checks if destination port is in udp port range and if its socket
-        is open. If so, goes to 3. Otherwise, goes to 4
+    2) CHECK_PORT: checks if destination port is mapped or in udp port range, if its socket
+        is open and if there is a buffer available to store the packet (always true
+        unless a descriptor ring runs out of posted buffers or a packed ring is
+        too full for the packet). If so, goes to 3.
+        Otherwise, goes to 4. IPv4 fragments (MF set or non-zero offset) are
+        always discarded: they are not reassembled, and only the first one
+        carries a UDP header. Each one is flagged on fragment_dropped_o
+        Accepted packets are flagged on accepted_o, the others on port_dropped_o
+        (closed or out-of-range port) or full_dropped_o (no buffer available)
     3) FORWARD: forwards the packet. Goes to 1
     4) DISCARD: discards the packet. Goes to 1
 **********************************************************************************/
@@ -55,12 +64,20 @@ module axis_udp_port_filter #(
 
     input  wire                             hdr_valid           ,
     input  wire [15:00                    ] hdr_dest_port       ,
+    input  wire                             hdr_port_mapped     ,
+    input  wire [log2(MAX_UDP_PORTS)-1 : 0] hdr_buffer_idx      ,
+    input  wire                             hdr_ip_fragment     ,
     input  wire                             dma_done_i          ,
     input  wire [15:00                    ] udp_port_range_lower,
     input  wire [15:00                    ] udp_port_range_upper,
     input  wire [MAX_UDP_PORTS-1 : 0      ] open_sockets_vector ,
+    input  wire                             buffer_available_i  ,
     output reg  [log2(MAX_UDP_PORTS)-1 : 0] buffer_select_idx_o ,
     output reg                              valid_udp_port_o    ,
+    output reg                              fragment_dropped_o  ,
+    output reg                              accepted_o          ,
+    output reg                              port_dropped_o      ,
+    output reg                              full_dropped_o      ,
 
     output reg          s_axis_payload_tready,
     input  wire         s_axis_payload_tvalid,
@@ -101,20 +118,28 @@ reg [1:0] state = STATE_IDLE;
 wire payload_last;
 assign payload_last = s_axis_payload_tready & s_axis_payload_tvalid & s_axis_payload_tlast;
 
-wire [log2(MAX_UDP_PORTS)-1 : 0] buffer_offset_for_current_port;
-assign buffer_offset_for_current_port = hdr_dest_port - udp_port_range_lower;
 wire socket_is_open;
-assign socket_is_open = open_sockets_vector[buffer_offset_for_current_port];
+assign socket_is_open = open_sockets_vector[hdr_buffer_idx];
+wire open_udp_port;
+assign open_udp_port = ((hdr_port_mapped || (hdr_dest_port >= udp_port_range_lower && hdr_dest_port <= udp_port_range_upper)) && socket_is_open);
 wire valid_udp_port;
-assign valid_udp_port = (hdr_dest_port >= udp_port_range_lower && hdr_dest_port <= udp_port_range_upper && socket_is_open);
+assign valid_udp_port = (open_udp_port && buffer_available_i && !hdr_ip_fragment);
 
 always @ (posedge clk) begin
-    if (rst) 
+    if (rst) begin
         state <= STATE_IDLE;
-    else begin
+        fragment_dropped_o <= 1'b0;
+        accepted_o <= 1'b0;
+        port_dropped_o <= 1'b0;
+        full_dropped_o <= 1'b0;
+    end else begin
         valid_udp_port_o <= valid_udp_port && hdr_valid;
+        fragment_dropped_o <= state == STATE_CHECK_PORT && hdr_ip_fragment;
+        accepted_o <= state == STATE_CHECK_PORT && valid_udp_port;
+        port_dropped_o <= state == STATE_CHECK_PORT && !hdr_ip_fragment && !open_udp_port;
+        full_dropped_o <= state == STATE_CHECK_PORT && !hdr_ip_fragment && open_udp_port && !buffer_available_i;
         case (state)
-            STATE_IDLE       : if (hdr_valid                ) state <= STATE_CHECK_PORT;
+            STATE_IDLE       : if (hdr_valid && dma_done_i  ) state <= STATE_CHECK_PORT;
             STATE_CHECK_PORT : if (valid_udp_port           ) state <= STATE_FORWARD;
                                else                           state <= STATE_DISCARD;
             STATE_FORWARD    : if (payload_last             ) state <= STATE_IDLE;
@@ -161,7 +186,7 @@ end
 
 always @ (posedge clk) begin
     if      (rst                      ) buffer_select_idx_o <= 0;
-    else if (state == STATE_CHECK_PORT) buffer_select_idx_o <= buffer_offset_for_current_port;
+    else if (state == STATE_CHECK_PORT) buffer_select_idx_o <= hdr_buffer_idx;
 end
 
 axis_register #(
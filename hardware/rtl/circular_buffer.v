@@ -31,6 +31,10 @@ THE SOFTWARE.
  *   - Handles the control variables for a circular buffer (without allocating the buffer itself)
  *   - Updates head_index and full when data_pushed_i is active (must be a single pulse)
  *   - Updates tail_index and empty when data_popped_i is active (must be a single pulse)    
+ *   - BUFFER_LENGTH is the largest length supported; length_i selects a shorter one at run time
+ *     (0 selects BUFFER_LENGTH). It must only change while rst_i is asserted
+ *   - Discards the slots not popped yet when flush_i is active (single pulse): tail_index jumps to
+ *     head_index. A push in the same cycle is kept, so a write in flight is never lost
  **********************************************************************************/
 
 module circular_buffer #(
@@ -41,8 +45,10 @@ module circular_buffer #(
     input  wire clk_i ,
     input  wire rst_i ,
 
+    input  wire [INDEX_WIDTH   : 00] length_i      ,
     input  wire                      data_pushed_i ,
     input  wire                      data_popped_i ,
+    input  wire                      flush_i       ,
     output reg  [INDEX_WIDTH-1 : 00] head_index_o  ,
     output reg  [INDEX_WIDTH-1 : 00] tail_index_o  ,
     output reg                       full_o        ,
@@ -53,12 +59,20 @@ module circular_buffer #(
  * Main logic
  **********************************************************************************/
 
+// last index (run-time length)
+
+reg [INDEX_WIDTH-1 : 00] last_index;
+always @ * begin
+    if  (length_i == 0 || length_i > BUFFER_LENGTH) last_index = BUFFER_LENGTH-1;
+    else                                            last_index = length_i-1;
+end
+
 // head index update
 
 reg [INDEX_WIDTH-1 : 00] head_index_next;
 always @ * begin
-    if  (head_index_o < BUFFER_LENGTH-1) head_index_next = head_index_o + 1;
-    else                                 head_index_next = 0;
+    if  (head_index_o < last_index) head_index_next = head_index_o + 1;
+    else                            head_index_next = 0;
 end
 
 always @ (posedge clk_i) begin
@@ -70,6 +84,7 @@ end
 
 always @ (posedge clk_i) begin
     if      (rst_i)                                 full_o <= 0;
+    else if (flush_i)                               full_o <= 0;
     else if (!data_pushed_i && data_popped_i)       full_o <= 0;
     else if (data_pushed_i && !data_popped_i) begin
         if (head_index_next == tail_index_o)        full_o <= 1;
@@ -81,12 +96,13 @@ end
 
 reg [INDEX_WIDTH-1 : 00] tail_index_next;
 always @ * begin
-    if  (tail_index_o < BUFFER_LENGTH-1) tail_index_next = tail_index_o + 1;
-    else                                 tail_index_next = 0;
+    if  (tail_index_o < last_index) tail_index_next = tail_index_o + 1;
+    else                            tail_index_next = 0;
 end
 
 always @ (posedge clk_i) begin
     if      (rst_i        ) tail_index_o <= 0;
+    else if (flush_i      ) tail_index_o <= head_index_o;
     else if (data_popped_i) tail_index_o <= tail_index_next;
 end
 
@@ -94,6 +110,7 @@ end
 
 always @ (posedge clk_i) begin
     if      (rst_i)                                 empty_o <= 1;
+    else if (flush_i)                               empty_o <= !data_pushed_i;
     else if (data_pushed_i && !data_popped_i)       empty_o <= 0;
     else if (data_popped_i && !data_pushed_i) begin
         if (tail_index_next == head_index_o)        empty_o <= 1;
@@ -30,11 +30,14 @@
 **********************************************************************************/
 
 module config_regs_AXI_Manager #(
-    parameter C_S_AXI_ADDR_WIDTH   = 14,
+    parameter C_S_AXI_ADDR_WIDTH   = 15,
     parameter C_S_AXI_DATA_WIDTH   = 32,
     parameter C_BUFFRX_INDEX_WIDTH = 5,
     parameter C_BUFFTX_INDEX_WIDTH = 5,        
     parameter C_MAX_UDP_PORTS      = 1024,
+    parameter C_TX_QUEUES          = 4,
+    parameter C_PORT_MAP_ENTRIES   = 32,
+    parameter C_DMA_ADDR_WIDTH     = 32,
     parameter BUFFER_POPPED_OFFSET = 0,
     parameter BUFFER_PUSHED_OFFSET = 1,
     parameter BUFFER_FULL_OFFSET   = 2,
@@ -45,7 +48,10 @@ module config_regs_AXI_Manager #(
     parameter BUFFER_HEAD_UPPER      = BUFFER_HEAD_OFFSET + C_BUFFRX_INDEX_WIDTH - 1,
     parameter BUFFER_OPENSOCK_OFFSET = BUFFER_HEAD_UPPER + 1,
     parameter BUFFER_DUMMY_OFFSET    = BUFFER_OPENSOCK_OFFSET + 1,
-    parameter BUFFER_DUMMY_UPPER     = C_S_AXI_DATA_WIDTH - 1
+    parameter BUFFER_DUMMY_UPPER     = 15,
+    parameter BUFFER_PACK_OFFSET     = BUFFER_DUMMY_UPPER + 1,
+    parameter BUFFER_PACK_UPPER      = C_S_AXI_DATA_WIDTH - 1,
+    parameter BUFFER_PACK_WIDTH      = BUFFER_PACK_UPPER - BUFFER_PACK_OFFSET + 1
 ) (
     input    wire                                               clk               ,
     input    wire                                               res_n             ,
@@ -85,6 +91,8 @@ module config_regs_AXI_Manager #(
 
     inout    wire  [C_S_AXI_DATA_WIDTH*C_MAX_UDP_PORTS  -1 : 0] buffer_rx_vector_io, // MAX_UDP_PORTS sections (one per buffer), each containing 32 bits 
                                                                                     // {head[C_BUFFRX_INDEX_WIDTH], tail[C_BUFFRX_INDEX_WIDTH], empty, full, pushed, popped}
+    input    wire  [BUFFER_PACK_WIDTH*C_MAX_UDP_PORTS-1 : 0]   bufrx_pack_head_i  , // packed ring pointers, read from (head) and written to (tail) 
+    output   wire  [BUFFER_PACK_WIDTH*C_MAX_UDP_PORTS-1 : 0]   bufrx_pack_tail_o  , // the upper bits of each bufrx control reg
     input    wire                               bufrx_push_irq_i ,
 
     input    wire  [C_BUFFTX_INDEX_WIDTH-1 : 0] buftx_head_i    ,
@@ -92,7 +100,53 @@ module config_regs_AXI_Manager #(
     input    wire  [                    -1 : 0] buftx_empty_i   ,
     input    wire  [                    -1 : 0] buftx_full_i    ,
     output   wire  [                    -1 : 0] buftx_pushed_o  ,
-    input    wire  [                    -1 : 0] buftx_popped_i   
+    input    wire  [                    -1 : 0] buftx_popped_i  ,
+
+    output   wire                               rxdesc_mode_o      ,
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   rxdesc_post_addr_o ,
+    output   wire                               rxdesc_post_o      ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   rxdesc_free_count_i,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   rxdesc_compl_i     ,
+    output   wire                               rxdesc_compl_pop_o ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   rx_frag_drops_i    ,
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   slot_size_o        ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   slot_size_max_i    ,
+    output   wire                               rxpack_mode_o      ,
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   rx_buffers_o       ,
+    output   wire  [C_S_AXI_DATA_WIDTH*C_MAX_UDP_PORTS-1 : 0] bufrx_cfg_o, // MAX_UDP_PORTS sections (one per buffer): {base in slots, log2 of length}
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   rx_depth_max_i     ,
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   tx_buffer_base_o   ,
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   txq_ctrl_o         ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   txq_num_i          ,
+    input    wire  [C_S_AXI_DATA_WIDTH*C_TX_QUEUES-1 : 0] txq_status_i, // C_TX_QUEUES sections (one per tx queue): {full, empty, tail, head}
+    output   wire  [C_TX_QUEUES-1 : 0]          txq_pushed_o       , // one pulse per write to the push reg of each tx queue
+    output   wire  [C_S_AXI_DATA_WIDTH*C_TX_QUEUES-1 : 0] txq_weight_o, // C_TX_QUEUES sections (one per tx queue): DWRR quantum in bytes
+    output   wire  [C_S_AXI_DATA_WIDTH*C_TX_QUEUES-1 : 0] txq_rate_o, // C_TX_QUEUES sections (one per tx queue): {burst in bytes, rate in Mbit/s}
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   irq_coal_frames_o  ,
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   irq_coal_usecs_o   ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_rx_frames_i   ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_rx_drop_closed_i,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_rx_drop_full_i,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_tx_frames_i   ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_dma_wr_busy_i ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_dma_wr_stall_i,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_dma_rd_busy_i ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_dma_rd_stall_i,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_rx_hdr_stall_i,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_rx_ring_max_i ,
+    output   wire  [C_MAX_UDP_PORTS-1 : 0]      bufrx_opensock_map_o, // open socket bitmap regs, one bit per buffer
+    output   wire                               rx_rings_rst_o     , // one pulse per write of 1 to the rx rings reset reg
+    output   wire  [C_S_AXI_DATA_WIDTH*C_PORT_MAP_ENTRIES-1 : 0] port_map_o, // C_PORT_MAP_ENTRIES sections (one per port map entry): {valid, rx buffer index, port}
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   shared_mem_hi_o    , // upper 32 bits of the shared memory base address
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   rxdesc_post_addr_hi_o, // upper 32 bits of the posted rx descriptor addresses
+    input    wire  [2*C_S_AXI_DATA_WIDTH-1 : 0] timestamp_i        , // current time (ns)
+    input    wire  [2*C_S_AXI_DATA_WIDTH-1 : 0] tx_ts_i            , // oldest tx timestamp {valid, ns}
+    output   wire                               tx_ts_pop_o        , // one pulse per read of the lower half of the tx timestamp
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   timestamp_incr_i   , // time increment in use (ns per clock cycle, 28 fractional bits)
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   timestamp_incr_o   , // time increment override (0: nominal increment)
+    output   wire  [2*C_S_AXI_DATA_WIDTH-1 : 0] timestamp_load_o   , // time to set, or signed offset to add (ns)
+    output   wire                               timestamp_set_o    , // one pulse per write of the set reg, aligned with timestamp_load_o
+    output   wire                               timestamp_adj_o      // one pulse per write of the adjust reg, aligned with timestamp_load_o
 );
 
 localparam ADDR_AP_CTRL_0_N_P        = 32'h00000000;  // ctrl_0 N_P Control Register Reserved
@@ -116,6 +170,53 @@ localparam ADDR_BUFTX_PUSHED_0_Y_O   = 32'h00000088;  // buftx_pushed_o_0 Y_O Bu
 localparam ADDR_BUFTX_POPPED_0_N_I   = 32'h00000090;  // buftx_popped_i_0 N_I Buffer Tx Popped
 localparam ADDR_BUFRX_PUSH_IRQ_0_IRQ = 32'h00000098;  // bufrx_push_irq_i_0 IRQ Buffer Rx Irq
 localparam ADDR_BUFRX_OFFSET_0_N_I   = 32'h000000a0;  // bufrx control regs take from this address to this address + (C_MAX_UDP_PORTS-1)+*8
+localparam ADDR_RXDESC_CTRL_0_N_O    = 32'h000020a0;  // rxdesc_mode_o_0 N_O Rx Descriptor Mode Enable
+localparam ADDR_RXDESC_POST_0_Y_O    = 32'h000020a8;  // rxdesc_post_o_0 Y_O Rx Descriptor Post (free buffer address; each write posts one buffer)
+localparam ADDR_RXDESC_FREE_0_N_I    = 32'h000020b0;  // rxdesc_free_count_i_0 N_I Rx Descriptors Posted and not used yet
+localparam ADDR_RXDESC_COMPL_0_N_I   = 32'h000020b8;  // rxdesc_compl_i_0 N_I Rx Descriptor Completion {valid, port index} (each read pops one entry)
+localparam ADDR_RX_FRAG_DROPS_0_N_I  = 32'h000020c0;  // rx_frag_drops_i_0 N_I Rx IPv4 fragments discarded (not reassembled)
+localparam ADDR_SLOT_SIZE_0_N_O      = 32'h000020c8;  // slot_size_o_0 N_O Buffer Slot Size (log2 bytes)
+localparam ADDR_SLOT_SIZE_MAX_0_N_I  = 32'h000020d0;  // slot_size_max_i_0 N_I Buffer Slot Size Max (log2 bytes)
+localparam ADDR_RXPACK_CTRL_0_N_O    = 32'h000020d8;  // rxpack_mode_o_0 N_O Rx Packed Ring Mode Enable
+localparam ADDR_RX_BUFFERS_0_N_O     = 32'h000020e0;  // rx_buffers_o_0 N_O Rx Buffers in Shared Memory
+localparam ADDR_RX_DEPTH_MAX_0_N_I   = 32'h000020e8;  // rx_depth_max_i_0 N_I Rx Buffer Length Max (log2 slots)
+localparam ADDR_TXBUF_BASE_0_N_O     = 32'h000020f0;  // tx_buffer_base_o_0 N_O Tx Buffer Position in Shared Memory (slots)
+localparam ADDR_BUFRX_CFG_OFFSET_0_N_O = 32'h00004000; // bufrx config regs take from this address to this address + (C_MAX_UDP_PORTS-1)*8
+localparam ADDR_TXQ_CTRL_0_N_O       = 32'h000020f8;  // txq_ctrl_o_0 N_O Tx Queues Arbitration (bit 0: 0 strict priority, 1 DWRR)
+localparam ADDR_TXQ_NUM_0_N_I        = 32'h00002100;  // txq_num_i_0 N_I Tx Queues Implemented
+localparam ADDR_TXQ_OFFSET_0_N_IO    = 32'h00006000;  // tx queue regs take 32 bytes per queue from this address: status (+0x00), push (+0x08), weight (+0x10), rate (+0x18)
+localparam ADDR_IRQ_COAL_FRAMES_0_N_O = 32'h00002108;  // irq_coal_frames_o_0 N_O Rx Interrupt Moderation Packets
+localparam ADDR_IRQ_COAL_USECS_0_N_O = 32'h00002110;  // irq_coal_usecs_o_0 N_O Rx Interrupt Moderation Time (us)
+localparam ADDR_PERF_RX_FRAMES_0_N_I = 32'h00002118;  // perf_rx_frames_i_0 N_I Perf: Rx frames accepted
+localparam ADDR_PERF_RX_DROP_CLOSED_0_N_I = 32'h00002120;  // perf_rx_drop_closed_i_0 N_I Perf: Rx frames dropped (closed or out-of-range port)
+localparam ADDR_PERF_RX_DROP_FULL_0_N_I = 32'h00002128;  // perf_rx_drop_full_i_0 N_I Perf: Rx frames dropped (ring full)
+localparam ADDR_PERF_TX_FRAMES_0_N_I = 32'h00002130;  // perf_tx_frames_i_0 N_I Perf: Tx frames sent
+localparam ADDR_PERF_DMA_WR_BUSY_0_N_I = 32'h00002138;  // perf_dma_wr_busy_i_0 N_I Perf: DMA write busy cycles
+localparam ADDR_PERF_DMA_WR_STALL_0_N_I = 32'h00002140;  // perf_dma_wr_stall_i_0 N_I Perf: DMA write stall cycles
+localparam ADDR_PERF_DMA_RD_BUSY_0_N_I = 32'h00002148;  // perf_dma_rd_busy_i_0 N_I Perf: DMA read busy cycles
+localparam ADDR_PERF_DMA_RD_STALL_0_N_I = 32'h00002150;  // perf_dma_rd_stall_i_0 N_I Perf: DMA read stall cycles
+localparam ADDR_PERF_RX_HDR_STALL_0_N_I = 32'h00002158;  // perf_rx_hdr_stall_i_0 N_I Perf: Rx header backpressure cycles
+localparam ADDR_PERF_RX_RING_MAX_0_N_I = 32'h00002160;  // perf_rx_ring_max_i_0 N_I Perf: Max Rx ring occupancy
+localparam ADDR_RX_RINGS_RST_0_Y_O   = 32'h00002168;  // rx_rings_rst_o_0 Y_O Rx Rings Reset (write 1: empties every rx ring, clears every bufrx control reg and the open socket bitmap)
+localparam ADDR_OPENSOCK_OFFSET_0_N_O = 32'h00002200; // open socket bitmap regs (32 buffers each) take from this address to this address + (OPENSOCK_REGS-1)*8
+localparam OPENSOCK_REGS             = (C_MAX_UDP_PORTS + C_S_AXI_DATA_WIDTH - 1) / C_S_AXI_DATA_WIDTH;
+localparam ADDR_PORT_MAP_NUM_0_N_I   = 32'h00002170;  // port_map_num_0 N_I Port Map Entries Implemented
+localparam ADDR_PORT_MAP_OFFSET_0_N_O = 32'h00002300; // port map regs take from this address to this address + (C_PORT_MAP_ENTRIES-1)*8
+localparam ADDR_SHMEM_HI_0_N_O       = 32'h00002178;  // shared_mem_hi_o_0 N_O Shared Memory Base Address Output (upper 32 bits)
+localparam ADDR_RXDESC_POST_HI_0_N_O = 32'h00002180;  // rxdesc_post_addr_hi_o_0 N_O Rx Descriptor Post Address (upper 32 bits, kept for the following posts)
+localparam ADDR_DMA_ADDR_WIDTH_0_N_I = 32'h00002188;  // dma_addr_width_0 N_I DMA Address Width (bits)
+localparam ADDR_TIMESTAMP_LO_0_N_I   = 32'h00002190;  // timestamp_i_0 N_I Current Time (ns, lower 32 bits; each read latches the upper ones)
+localparam ADDR_TIMESTAMP_HI_0_N_I   = 32'h00002198;  // timestamp_i_0 N_I Current Time (ns, upper 32 bits, as of the last lower read)
+localparam ADDR_TX_TS_LO_0_N_I       = 32'h000021A0;  // tx_ts_i_0 N_I Tx Timestamp (ns, lower 32 bits; each read pops one entry)
+localparam ADDR_TX_TS_HI_0_N_I       = 32'h000021A8;  // tx_ts_i_0 N_I Tx Timestamp {valid, ns upper 31 bits} of the oldest entry
+localparam ADDR_TIMESTAMP_INCR_0_N_IO = 32'h000021B0; // timestamp_incr_0 N_IO Time Increment (reads the one in use, writes the override; 0: nominal)
+localparam ADDR_TIMESTAMP_LOAD_LO_0_N_O = 32'h000021B8; // timestamp_load_o_0 N_O Time Load Value (ns, lower 32 bits)
+localparam ADDR_TIMESTAMP_SET_HI_0_Y_O = 32'h000021C0; // timestamp_load_o_0 Y_O Time Load Value (ns, upper 32 bits; each write sets the time)
+localparam ADDR_TIMESTAMP_ADJ_HI_0_Y_O = 32'h000021C8; // timestamp_load_o_0 Y_O Time Load Value (ns, upper 32 bits; each write adds the signed value to the time)
+localparam TXQ_REG_STATUS            = 2'd0;
+localparam TXQ_REG_PUSH              = 2'd1;
+localparam TXQ_REG_WEIGHT            = 2'd2;
+localparam TXQ_REG_RATE              = 2'd3;
 
 /**********************************************************************************
 * buffer rx vector handling
@@ -136,6 +237,9 @@ generate
         assign buffer_rx_arr[buffer_rx_arr_index][BUFFER_TAIL_UPPER  : BUFFER_TAIL_OFFSET] = buffer_rx_vector_io[C_S_AXI_DATA_WIDTH*buffer_rx_arr_index + BUFFER_TAIL_UPPER : C_S_AXI_DATA_WIDTH*buffer_rx_arr_index + BUFFER_TAIL_OFFSET];
         assign buffer_rx_arr[buffer_rx_arr_index][BUFFER_HEAD_UPPER  : BUFFER_HEAD_OFFSET] = buffer_rx_vector_io[C_S_AXI_DATA_WIDTH*buffer_rx_arr_index + BUFFER_HEAD_UPPER : C_S_AXI_DATA_WIDTH*buffer_rx_arr_index + BUFFER_HEAD_OFFSET];
         assign buffer_rx_arr[buffer_rx_arr_index][BUFFER_DUMMY_UPPER : BUFFER_DUMMY_OFFSET] = 0;
+        // packed ring pointers (head in, tail out)
+        assign buffer_rx_arr[buffer_rx_arr_index][BUFFER_PACK_UPPER  : BUFFER_PACK_OFFSET ] = bufrx_pack_head_i[BUFFER_PACK_WIDTH*(buffer_rx_arr_index+1)-1 : BUFFER_PACK_WIDTH*buffer_rx_arr_index];
+        assign bufrx_pack_tail_o[BUFFER_PACK_WIDTH*(buffer_rx_arr_index+1)-1 : BUFFER_PACK_WIDTH*buffer_rx_arr_index] = bufrx_temp_arr_r[buffer_rx_arr_index][BUFFER_PACK_UPPER : BUFFER_PACK_OFFSET];
     end
 endgenerate
 
@@ -200,6 +304,31 @@ reg [C_S_AXI_DATA_WIDTH-1 : 0] udp_port_range_h_o_r ; // IP Address Listened Ran
 reg [C_S_AXI_DATA_WIDTH-1 : 0] shared_mem_o_r       ; // Shared Memory Base Address Output
 reg [C_S_AXI_DATA_WIDTH-1 : 0] bufrx_temp_arr_r [C_MAX_UDP_PORTS-1 : 0];
 reg                            buftx_pushed_o_r     ; // Buffer Tx Pushed
+reg                            rxdesc_mode_o_r      ; // Rx Descriptor Mode Enable
+reg [C_S_AXI_DATA_WIDTH-1 : 0] rxdesc_post_addr_o_r ; // Rx Descriptor Post Address
+reg                            rxdesc_post_o_r      ; // Rx Descriptor Post (pulse)
+reg [C_S_AXI_DATA_WIDTH-1 : 0] slot_size_o_r        ; // Buffer Slot Size
+reg                            rxpack_mode_o_r      ; // Rx Packed Ring Mode Enable
+reg [C_S_AXI_DATA_WIDTH-1 : 0] rx_buffers_o_r       ; // Rx Buffers in Shared Memory
+reg [C_S_AXI_DATA_WIDTH-1 : 0] bufrx_cfg_arr_r [C_MAX_UDP_PORTS-1 : 0]; // Rx Buffer Length and Position
+reg [C_S_AXI_DATA_WIDTH-1 : 0] tx_buffer_base_o_r   ; // Tx Buffer Position in Shared Memory
+reg [C_S_AXI_DATA_WIDTH-1 : 0] txq_ctrl_o_r         ; // Tx Queues Arbitration
+reg [C_TX_QUEUES-1 : 0]        txq_pushed_o_r       ; // Tx Queue Pushed (pulse)
+reg [C_S_AXI_DATA_WIDTH-1 : 0] irq_coal_frames_o_r  ; // Rx Interrupt Moderation Packets
+reg [C_S_AXI_DATA_WIDTH-1 : 0] irq_coal_usecs_o_r   ; // Rx Interrupt Moderation Time (us)
+reg [C_S_AXI_DATA_WIDTH-1 : 0] txq_weight_arr_r [C_TX_QUEUES-1 : 0]; // Tx Queue DWRR Quantum
+reg [C_S_AXI_DATA_WIDTH-1 : 0] txq_rate_arr_r [C_TX_QUEUES-1 : 0]; // Tx Queue Shaper {burst, rate}
+reg [C_S_AXI_DATA_WIDTH-1 : 0] opensock_arr_r [OPENSOCK_REGS-1 : 0]; // Open Socket Bitmap
+reg                            rx_rings_rst_o_r     ; // Rx Rings Reset (pulse)
+reg [C_S_AXI_DATA_WIDTH-1 : 0] port_map_arr_r [C_PORT_MAP_ENTRIES-1 : 0]; // Port Map Entries
+reg [C_S_AXI_DATA_WIDTH-1 : 0] shared_mem_hi_o_r    ; // Shared Memory Base Address Output (upper 32 bits)
+reg [C_S_AXI_DATA_WIDTH-1 : 0] rxdesc_post_addr_hi_o_r; // Rx Descriptor Post Address (upper 32 bits)
+reg [C_S_AXI_DATA_WIDTH-1 : 0] timestamp_hi_r       ; // Current Time (upper 32 bits, latched by reads of the lower ones)
+reg [C_S_AXI_DATA_WIDTH-1 : 0] timestamp_incr_o_r   ; // Time Increment Override
+reg [C_S_AXI_DATA_WIDTH-1 : 0] timestamp_load_lo_r  ; // Time Load Value (lower 32 bits)
+reg [C_S_AXI_DATA_WIDTH-1 : 0] timestamp_load_hi_r  ; // Time Load Value (upper 32 bits)
+reg                            timestamp_set_o_r    ; // Time Set (pulse)
+reg                            timestamp_adj_o_r    ; // Time Adjust (pulse)
 // End of user's registers
 
 // Internal IRQ registers
@@ -226,6 +355,64 @@ generate
 endgenerate
 
 assign buftx_pushed_o = buftx_pushed_o_r ; // Buffer Tx Pushed   
+
+assign rxdesc_mode_o      = rxdesc_mode_o_r                              ; // Rx Descriptor Mode Enable
+assign rxdesc_post_addr_o = rxdesc_post_addr_o_r                         ; // Rx Descriptor Post Address
+assign rxdesc_post_o      = rxdesc_post_o_r                              ; // Rx Descriptor Post (pulse, aligned with rxdesc_post_addr_o)
+assign rxdesc_compl_pop_o = ar_hs && raddr == ADDR_RXDESC_COMPL_0_N_I    ; // Rx Descriptor Completion pop (read already captured the current entry)
+
+assign slot_size_o        = slot_size_o_r                                ; // Buffer Slot Size
+assign rxpack_mode_o      = rxpack_mode_o_r                              ; // Rx Packed Ring Mode Enable
+assign rx_buffers_o       = rx_buffers_o_r                               ; // Rx Buffers in Shared Memory
+assign tx_buffer_base_o   = tx_buffer_base_o_r                           ; // Tx Buffer Position in Shared Memory
+assign txq_ctrl_o         = txq_ctrl_o_r                                 ; // Tx Queues Arbitration
+assign txq_pushed_o       = txq_pushed_o_r                               ; // Tx Queue Pushed (pulse)
+assign irq_coal_frames_o  = irq_coal_frames_o_r                          ; // Rx Interrupt Moderation Packets
+assign irq_coal_usecs_o   = irq_coal_usecs_o_r                           ; // Rx Interrupt Moderation Time (us)
+assign rx_rings_rst_o     = rx_rings_rst_o_r                             ; // Rx Rings Reset (pulse)
+assign shared_mem_hi_o    = shared_mem_hi_o_r                            ; // Shared Memory Base Address Output (upper 32 bits)
+assign rxdesc_post_addr_hi_o = rxdesc_post_addr_hi_o_r                   ; // Rx Descriptor Post Address (upper 32 bits)
+assign tx_ts_pop_o        = ar_hs && raddr == ADDR_TX_TS_LO_0_N_I        ; // Tx Timestamp pop (read already captured the current entry)
+assign timestamp_incr_o   = timestamp_incr_o_r                           ; // Time Increment Override
+assign timestamp_load_o   = {timestamp_load_hi_r, timestamp_load_lo_r}   ; // Time Load Value
+assign timestamp_set_o    = timestamp_set_o_r                            ; // Time Set (pulse, aligned with timestamp_load_o)
+assign timestamp_adj_o    = timestamp_adj_o_r                            ; // Time Adjust (pulse, aligned with timestamp_load_o)
+
+genvar port_map_r_index;
+generate
+    for (port_map_r_index = 0; port_map_r_index < C_PORT_MAP_ENTRIES; port_map_r_index = port_map_r_index + 1) begin
+        assign port_map_o[C_S_AXI_DATA_WIDTH*(port_map_r_index+1)-1 : C_S_AXI_DATA_WIDTH*port_map_r_index] = port_map_arr_r[port_map_r_index];
+    end
+endgenerate
+
+// bit i of open socket bitmap reg n drives buffer n*32+i
+genvar opensock_r_index;
+generate
+    for (opensock_r_index = 0; opensock_r_index < C_MAX_UDP_PORTS; opensock_r_index = opensock_r_index + 1) begin
+        assign bufrx_opensock_map_o[opensock_r_index] = opensock_arr_r[opensock_r_index / C_S_AXI_DATA_WIDTH][opensock_r_index % C_S_AXI_DATA_WIDTH];
+    end
+endgenerate
+
+genvar txq_weight_r_index;
+generate
+    for (txq_weight_r_index = 0; txq_weight_r_index < C_TX_QUEUES; txq_weight_r_index = txq_weight_r_index + 1) begin
+        assign txq_weight_o[C_S_AXI_DATA_WIDTH*(txq_weight_r_index+1)-1 : C_S_AXI_DATA_WIDTH*txq_weight_r_index] = txq_weight_arr_r[txq_weight_r_index];
+        assign txq_rate_o[C_S_AXI_DATA_WIDTH*(txq_weight_r_index+1)-1 : C_S_AXI_DATA_WIDTH*txq_weight_r_index]   = txq_rate_arr_r[txq_weight_r_index];
+    end
+endgenerate
+
+// tx queue regs: queue index and register within the queue
+wire [C_S_AXI_ADDR_WIDTH-1:0] txq_raddr_index;
+wire [C_S_AXI_ADDR_WIDTH-1:0] txq_waddr_index;
+assign txq_raddr_index = (raddr - ADDR_TXQ_OFFSET_0_N_IO) / 32;
+assign txq_waddr_index = (waddr - ADDR_TXQ_OFFSET_0_N_IO) / 32;
+
+genvar bufrx_cfg_r_index;
+generate
+    for (bufrx_cfg_r_index = 0; bufrx_cfg_r_index < C_MAX_UDP_PORTS; bufrx_cfg_r_index = bufrx_cfg_r_index + 1) begin
+        assign bufrx_cfg_o[C_S_AXI_DATA_WIDTH*(bufrx_cfg_r_index+1)-1 : C_S_AXI_DATA_WIDTH*bufrx_cfg_r_index] = bufrx_cfg_arr_r[bufrx_cfg_r_index];
+    end
+endgenerate
                                                                                                   
 /**********************************************************************************
 * AXI write fsm
@@ -338,8 +525,61 @@ always @(posedge clk) begin
 
         end else if (raddr < ADDR_BUFRX_OFFSET_0_N_I + 8 * C_MAX_UDP_PORTS ) begin
             rdata <= buffer_rx_arr[(raddr-ADDR_BUFRX_OFFSET_0_N_I)/8];
+        end else if (raddr >= ADDR_BUFRX_CFG_OFFSET_0_N_O && raddr < ADDR_BUFRX_CFG_OFFSET_0_N_O + 8 * C_MAX_UDP_PORTS) begin
+            rdata <= bufrx_cfg_arr_r[(raddr-ADDR_BUFRX_CFG_OFFSET_0_N_O)/8];
+        end else if (raddr >= ADDR_TXQ_OFFSET_0_N_IO && raddr < ADDR_TXQ_OFFSET_0_N_IO + 32 * C_TX_QUEUES) begin
+            case (raddr[4:3])
+            TXQ_REG_STATUS              : rdata <= txq_status_i[C_S_AXI_DATA_WIDTH*txq_raddr_index +: C_S_AXI_DATA_WIDTH];
+            TXQ_REG_WEIGHT              : rdata <= txq_weight_arr_r[txq_raddr_index];
+            TXQ_REG_RATE                : rdata <= txq_rate_arr_r[txq_raddr_index];
+            default                     : rdata <= 0;
+            endcase
+        end else if (raddr >= ADDR_OPENSOCK_OFFSET_0_N_O && raddr < ADDR_OPENSOCK_OFFSET_0_N_O + 8 * OPENSOCK_REGS) begin
+            rdata <= opensock_arr_r[(raddr-ADDR_OPENSOCK_OFFSET_0_N_O)/8];
+        end else if (raddr >= ADDR_PORT_MAP_OFFSET_0_N_O && raddr < ADDR_PORT_MAP_OFFSET_0_N_O + 8 * C_PORT_MAP_ENTRIES) begin
+            rdata <= port_map_arr_r[(raddr-ADDR_PORT_MAP_OFFSET_0_N_O)/8];
         end else begin
-            rdata <= 32'hDEADBEEF;
+            case (raddr)
+            ADDR_RXDESC_CTRL_0_N_O      : rdata <=  rxdesc_mode_o_r;
+            ADDR_RXDESC_POST_0_Y_O      : rdata <=  rxdesc_post_addr_o_r;
+            ADDR_RXDESC_FREE_0_N_I      : rdata <=  rxdesc_free_count_i;
+            ADDR_RXDESC_COMPL_0_N_I     : rdata <=  rxdesc_compl_i;
+            ADDR_RX_FRAG_DROPS_0_N_I    : rdata <=  rx_frag_drops_i;
+            ADDR_SLOT_SIZE_0_N_O        : rdata <=  slot_size_o_r;
+            ADDR_SLOT_SIZE_MAX_0_N_I    : rdata <=  slot_size_max_i;
+            ADDR_RXPACK_CTRL_0_N_O      : rdata <=  rxpack_mode_o_r;
+            ADDR_RX_BUFFERS_0_N_O       : rdata <=  rx_buffers_o_r;
+            ADDR_RX_DEPTH_MAX_0_N_I     : rdata <=  rx_depth_max_i;
+            ADDR_TXBUF_BASE_0_N_O       : rdata <=  tx_buffer_base_o_r;
+            ADDR_TXQ_CTRL_0_N_O         : rdata <=  txq_ctrl_o_r;
+            ADDR_TXQ_NUM_0_N_I          : rdata <=  txq_num_i;
+            ADDR_PERF_RX_FRAMES_0_N_I   : rdata <=  perf_rx_frames_i;
+            ADDR_PERF_RX_DROP_CLOSED_0_N_I : rdata <=  perf_rx_drop_closed_i;
+            ADDR_PERF_RX_DROP_FULL_0_N_I : rdata <=  perf_rx_drop_full_i;
+            ADDR_PERF_TX_FRAMES_0_N_I   : rdata <=  perf_tx_frames_i;
+            ADDR_PERF_DMA_WR_BUSY_0_N_I : rdata <=  perf_dma_wr_busy_i;
+            ADDR_PERF_DMA_WR_STALL_0_N_I : rdata <=  perf_dma_wr_stall_i;
+            ADDR_PERF_DMA_RD_BUSY_0_N_I : rdata <=  perf_dma_rd_busy_i;
+            ADDR_PERF_DMA_RD_STALL_0_N_I : rdata <=  perf_dma_rd_stall_i;
+            ADDR_PERF_RX_HDR_STALL_0_N_I : rdata <=  perf_rx_hdr_stall_i;
+            ADDR_PERF_RX_RING_MAX_0_N_I : rdata <=  perf_rx_ring_max_i;
+            ADDR_IRQ_COAL_FRAMES_0_N_O  : rdata <=  irq_coal_frames_o_r;
+            ADDR_IRQ_COAL_USECS_0_N_O   : rdata <=  irq_coal_usecs_o_r;
+            ADDR_RX_RINGS_RST_0_Y_O     : rdata <=  0;
+            ADDR_PORT_MAP_NUM_0_N_I     : rdata <=  C_PORT_MAP_ENTRIES;
+            ADDR_SHMEM_HI_0_N_O         : rdata <=  shared_mem_hi_o_r;
+            ADDR_RXDESC_POST_HI_0_N_O   : rdata <=  rxdesc_post_addr_hi_o_r;
+            ADDR_DMA_ADDR_WIDTH_0_N_I   : rdata <=  C_DMA_ADDR_WIDTH;
+            ADDR_TIMESTAMP_LO_0_N_I     : begin rdata <= timestamp_i[C_S_AXI_DATA_WIDTH-1 : 0]; timestamp_hi_r <= timestamp_i[2*C_S_AXI_DATA_WIDTH-1 : C_S_AXI_DATA_WIDTH]; end
+            ADDR_TIMESTAMP_HI_0_N_I     : rdata <=  timestamp_hi_r;
+            ADDR_TX_TS_LO_0_N_I         : rdata <=  tx_ts_i[C_S_AXI_DATA_WIDTH-1 : 0];
+            ADDR_TX_TS_HI_0_N_I         : rdata <=  tx_ts_i[2*C_S_AXI_DATA_WIDTH-1 : C_S_AXI_DATA_WIDTH];
+            ADDR_TIMESTAMP_INCR_0_N_IO  : rdata <=  timestamp_incr_i;
+            ADDR_TIMESTAMP_LOAD_LO_0_N_O : rdata <=  timestamp_load_lo_r;
+            ADDR_TIMESTAMP_SET_HI_0_Y_O : rdata <=  timestamp_load_hi_r;
+            ADDR_TIMESTAMP_ADJ_HI_0_Y_O : rdata <=  timestamp_load_hi_r;
+            default                     : rdata <= 32'hDEADBEEF;
+            endcase
         end
 
    end
@@ -365,6 +605,25 @@ always @(posedge clk) begin
         ext_ier0              <= 0;
         for (bufrx_temp_index = 0; bufrx_temp_index < C_MAX_UDP_PORTS; bufrx_temp_index = bufrx_temp_index + 1) bufrx_temp_arr_r[bufrx_temp_index] <= 0;
         buftx_pushed_o_r      <= 0;
+        rxdesc_mode_o_r       <= 0;
+        rxdesc_post_addr_o_r  <= 0;
+        slot_size_o_r         <= 0;
+        rxpack_mode_o_r       <= 0;
+        rx_buffers_o_r        <= 0;
+        for (bufrx_temp_index = 0; bufrx_temp_index < C_MAX_UDP_PORTS; bufrx_temp_index = bufrx_temp_index + 1) bufrx_cfg_arr_r[bufrx_temp_index] <= 0;
+        tx_buffer_base_o_r    <= 0;
+        txq_ctrl_o_r          <= 0;
+        irq_coal_frames_o_r   <= 0;
+        irq_coal_usecs_o_r    <= 0;
+        for (bufrx_temp_index = 0; bufrx_temp_index < C_TX_QUEUES; bufrx_temp_index = bufrx_temp_index + 1) txq_weight_arr_r[bufrx_temp_index] <= 0;
+        for (bufrx_temp_index = 0; bufrx_temp_index < C_TX_QUEUES; bufrx_temp_index = bufrx_temp_index + 1) txq_rate_arr_r[bufrx_temp_index] <= 0;
+        for (bufrx_temp_index = 0; bufrx_temp_index < OPENSOCK_REGS; bufrx_temp_index = bufrx_temp_index + 1) opensock_arr_r[bufrx_temp_index] <= 0;
+        for (bufrx_temp_index = 0; bufrx_temp_index < C_PORT_MAP_ENTRIES; bufrx_temp_index = bufrx_temp_index + 1) port_map_arr_r[bufrx_temp_index] <= 0;
+        shared_mem_hi_o_r     <= 0;
+        rxdesc_post_addr_hi_o_r <= 0;
+        timestamp_incr_o_r    <= 0;
+        timestamp_load_lo_r   <= 0;
+        timestamp_load_hi_r   <= 0;
 
     end
     if (w_hs) begin
@@ -385,6 +644,44 @@ always @(posedge clk) begin
 
         end else if (waddr < ADDR_BUFRX_OFFSET_0_N_I + 8 * C_MAX_UDP_PORTS) begin
             bufrx_temp_arr_r[(waddr-ADDR_BUFRX_OFFSET_0_N_I)/8] <= ( WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask ) | ( bufrx_temp_arr_r[(waddr-ADDR_BUFRX_OFFSET_0_N_I)/8] & ~wmask );
+
+        end else if (waddr >= ADDR_BUFRX_CFG_OFFSET_0_N_O && waddr < ADDR_BUFRX_CFG_OFFSET_0_N_O + 8 * C_MAX_UDP_PORTS) begin
+            bufrx_cfg_arr_r[(waddr-ADDR_BUFRX_CFG_OFFSET_0_N_O)/8] <= ( WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask ) | ( bufrx_cfg_arr_r[(waddr-ADDR_BUFRX_CFG_OFFSET_0_N_O)/8] & ~wmask );
+
+        end else if (waddr >= ADDR_TXQ_OFFSET_0_N_IO && waddr < ADDR_TXQ_OFFSET_0_N_IO + 32 * C_TX_QUEUES) begin
+            if (waddr[4:3] == TXQ_REG_WEIGHT)
+                txq_weight_arr_r[txq_waddr_index] <= ( WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask ) | ( txq_weight_arr_r[txq_waddr_index] & ~wmask );
+            if (waddr[4:3] == TXQ_REG_RATE)
+                txq_rate_arr_r[txq_waddr_index] <= ( WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask ) | ( txq_rate_arr_r[txq_waddr_index] & ~wmask );
+
+        end else if (waddr >= ADDR_OPENSOCK_OFFSET_0_N_O && waddr < ADDR_OPENSOCK_OFFSET_0_N_O + 8 * OPENSOCK_REGS) begin
+            opensock_arr_r[(waddr-ADDR_OPENSOCK_OFFSET_0_N_O)/8] <= ( WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask ) | ( opensock_arr_r[(waddr-ADDR_OPENSOCK_OFFSET_0_N_O)/8] & ~wmask );
+
+        end else if (waddr >= ADDR_PORT_MAP_OFFSET_0_N_O && waddr < ADDR_PORT_MAP_OFFSET_0_N_O + 8 * C_PORT_MAP_ENTRIES) begin
+            port_map_arr_r[(waddr-ADDR_PORT_MAP_OFFSET_0_N_O)/8] <= ( WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask ) | ( port_map_arr_r[(waddr-ADDR_PORT_MAP_OFFSET_0_N_O)/8] & ~wmask );
+
+        end else begin
+            case (waddr)
+            ADDR_RXDESC_CTRL_0_N_O  : rxdesc_mode_o_r                                                   <= (WDATA[0] & wmask[0]) | (rxdesc_mode_o_r & ~wmask[0]);
+            ADDR_RXDESC_POST_0_Y_O  : rxdesc_post_addr_o_r[C_S_AXI_DATA_WIDTH - 1 : 0]                  <= (WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask) | (rxdesc_post_addr_o_r[C_S_AXI_DATA_WIDTH - 1 : 0] & ~wmask);
+            ADDR_SLOT_SIZE_0_N_O    : slot_size_o_r[C_S_AXI_DATA_WIDTH - 1 : 0]                         <= (WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask) | (slot_size_o_r[C_S_AXI_DATA_WIDTH - 1 : 0] & ~wmask);
+            ADDR_RXPACK_CTRL_0_N_O  : rxpack_mode_o_r                                                   <= (WDATA[0] & wmask[0]) | (rxpack_mode_o_r & ~wmask[0]);
+            ADDR_RX_BUFFERS_0_N_O   : rx_buffers_o_r[C_S_AXI_DATA_WIDTH - 1 : 0]                        <= (WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask) | (rx_buffers_o_r[C_S_AXI_DATA_WIDTH - 1 : 0] & ~wmask);
+            ADDR_TXBUF_BASE_0_N_O   : tx_buffer_base_o_r[C_S_AXI_DATA_WIDTH - 1 : 0]                    <= (WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask) | (tx_buffer_base_o_r[C_S_AXI_DATA_WIDTH - 1 : 0] & ~wmask);
+            ADDR_TXQ_CTRL_0_N_O     : txq_ctrl_o_r[C_S_AXI_DATA_WIDTH - 1 : 0]                          <= (WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask) | (txq_ctrl_o_r[C_S_AXI_DATA_WIDTH - 1 : 0] & ~wmask);
+            ADDR_IRQ_COAL_FRAMES_0_N_O : irq_coal_frames_o_r[C_S_AXI_DATA_WIDTH - 1 : 0]                   <= (WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask) | (irq_coal_frames_o_r[C_S_AXI_DATA_WIDTH - 1 : 0] & ~wmask);
+            ADDR_IRQ_COAL_USECS_0_N_O  : irq_coal_usecs_o_r[C_S_AXI_DATA_WIDTH - 1 : 0]                    <= (WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask) | (irq_coal_usecs_o_r[C_S_AXI_DATA_WIDTH - 1 : 0] & ~wmask);
+            ADDR_SHMEM_HI_0_N_O     : shared_mem_hi_o_r[C_S_AXI_DATA_WIDTH - 1 : 0]                     <= (WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask) | (shared_mem_hi_o_r[C_S_AXI_DATA_WIDTH - 1 : 0] & ~wmask);
+            ADDR_RXDESC_POST_HI_0_N_O : rxdesc_post_addr_hi_o_r[C_S_AXI_DATA_WIDTH - 1 : 0]             <= (WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask) | (rxdesc_post_addr_hi_o_r[C_S_AXI_DATA_WIDTH - 1 : 0] & ~wmask);
+            ADDR_TIMESTAMP_INCR_0_N_IO : timestamp_incr_o_r[C_S_AXI_DATA_WIDTH - 1 : 0]                 <= (WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask) | (timestamp_incr_o_r[C_S_AXI_DATA_WIDTH - 1 : 0] & ~wmask);
+            ADDR_TIMESTAMP_LOAD_LO_0_N_O : timestamp_load_lo_r[C_S_AXI_DATA_WIDTH - 1 : 0]              <= (WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask) | (timestamp_load_lo_r[C_S_AXI_DATA_WIDTH - 1 : 0] & ~wmask);
+            ADDR_TIMESTAMP_SET_HI_0_Y_O,
+            ADDR_TIMESTAMP_ADJ_HI_0_Y_O : timestamp_load_hi_r[C_S_AXI_DATA_WIDTH - 1 : 0]               <= (WDATA[C_S_AXI_DATA_WIDTH-1:0] & wmask) | (timestamp_load_hi_r[C_S_AXI_DATA_WIDTH - 1 : 0] & ~wmask);
+            ADDR_RX_RINGS_RST_0_Y_O : if (WDATA[0] && wmask[0]) begin
+                for (bufrx_temp_index = 0; bufrx_temp_index < C_MAX_UDP_PORTS; bufrx_temp_index = bufrx_temp_index + 1) bufrx_temp_arr_r[bufrx_temp_index] <= 0;
+                for (bufrx_temp_index = 0; bufrx_temp_index < OPENSOCK_REGS; bufrx_temp_index = bufrx_temp_index + 1) opensock_arr_r[bufrx_temp_index] <= 0;
+            end
+            endcase
         end
 
     end
@@ -453,6 +750,36 @@ end
 
 // Handle bitfield pulse output
 
+// rxdesc_post_o: one pulse per write, aligned with the updated rxdesc_post_addr_o
+always @(posedge clk) begin
+    if (!res_n) rxdesc_post_o_r <= 1'b0;
+    else        rxdesc_post_o_r <= w_hs && waddr == ADDR_RXDESC_POST_0_Y_O;
+end
+
+// rx_rings_rst_o: one pulse per write of 1, issued along with the clear of the bufrx control regs
+always @(posedge clk) begin
+    if (!res_n) rx_rings_rst_o_r <= 1'b0;
+    else        rx_rings_rst_o_r <= w_hs && waddr == ADDR_RX_RINGS_RST_0_Y_O && WDATA[0] && WSTRB[0];
+end
+
+// timestamp_set_o / timestamp_adj_o: one pulse per write of the upper half, aligned with the updated timestamp_load_o
+always @(posedge clk) begin
+    if (!res_n) begin
+        timestamp_set_o_r <= 1'b0;
+        timestamp_adj_o_r <= 1'b0;
+    end else begin
+        timestamp_set_o_r <= w_hs && waddr == ADDR_TIMESTAMP_SET_HI_0_Y_O;
+        timestamp_adj_o_r <= w_hs && waddr == ADDR_TIMESTAMP_ADJ_HI_0_Y_O;
+    end
+end
+
+// txq_pushed_o: one pulse per write to the push reg of a tx queue (the value written is ignored)
+always @(posedge clk) begin
+    if (!res_n)                                                                                                         txq_pushed_o_r <= 0;
+    else if (w_hs && waddr >= ADDR_TXQ_OFFSET_0_N_IO && waddr < ADDR_TXQ_OFFSET_0_N_IO + 32 * C_TX_QUEUES && waddr[4:3] == TXQ_REG_PUSH) txq_pushed_o_r <= 1 << txq_waddr_index;
+    else                                                                                                                txq_pushed_o_r <= 0;
+end
+
 
 endmodule
 
@@ -42,18 +42,93 @@ THE SOFTWARE.
  *
  * Order of buffers in DDR:
  *   - First rx buffer is placed in DDR at shared_mem_base_address
- *   - Next rx buffers are placed contiguously, being buffer_rx[i] located at shared_mem_base_address + (MAX_UDP_PORTS-1)*BUFFER_RX_LENGTH*BUFFER_ELEM_MAX_SIZE
- *   - Tx buffer is placed in DDR at shared_mem_base_address + MAX_UDP_PORTS*BUFFER_RX_LENGTH*BUFFER_ELEM_MAX_SIZE
+ *   - Next rx buffers are placed contiguously, being buffer_rx[i] located at shared_mem_base_address + i*BUFFER_RX_LENGTH*SLOT_SIZE
+ *   - Tx buffer is placed in DDR at shared_mem_base_address + RX_BUFFERS*BUFFER_RX_LENGTH*SLOT_SIZE
+ *   - RX_BUFFERS is MAX_UDP_PORTS unless the PS selects fewer rx buffers while the core is in reset
+ *     (e.g. one per port of the configured range), so that the shared memory only takes the buffers
+ *     in use. Packets for ports without an rx buffer are discarded
+ *   - Addresses are DMA_ADDR_WIDTH bits wide (up to 64), so that the shared memory may be placed
+ *     anywhere. The PS writes their upper 32 bits to separate registers (shared memory base, posted
+ *     rx descriptors), zero by default
+ *   - Each rx buffer takes BUFFER_RX_LENGTH slots by default. The PS may instead set its length (a
+ *     power of two, up to BUFFER_RX_LENGTH_MAX slots) and its position (in slots from the shared
+ *     memory base) through a per-port config register, and the position of the tx buffer, while the
+ *     core is in reset. Full head/tail indices are then read back in the upper bits of bufrx regs
+ *   - SLOT_SIZE is 2KB unless the PS selects a larger power of two (up to BUFFER_ELEM_MAX_SIZE) while
+ *     the core is in reset, e.g. to receive and send jumbo frames
+ *
+ * Rx slots:
+ *   - Each slot holds the header (HEADER_NUM_WORDS words, extended with the original IP/UDP header
+ *     fields, see axis_header_adder), the payload and, at the next 8-byte boundary, a trailer word
+ *     with the UDP checksum verification result
+ *   - Packets are discarded while the rx buffer of their port is full (instead of overwriting
+ *     the oldest slot)
+ *   - Sockets may be opened and closed at any time, without reset. Opening a socket empties its
+ *     rx buffer, so that packets left from the last time it was open are not delivered
+ *   - Ports listed in the port map table (PORT_MAP_ENTRIES entries) are received in the rx buffer
+ *     of their entry, on top of the ports of the udp port range, so that sparse ports (e.g. several
+ *     DDS domains) do not need a range covering all the ports between them
+ *   - Sockets are opened either through their bufrx control reg or through the open socket bitmap
+ *     (32 sockets per register). A single write to the rx rings reset register empties every rx
+ *     buffer and closes every socket, instead of one register access per port
+ *
+ * Tx slots:
+ *   - Each slot starts with the header (HEADER_NUM_WORDS words). By default, the payload follows
+ *     the header within the slot
+ *   - When bit 63 of the first header word is set, the payload is fetched from the address held in
+ *     the upper 32 bits of the second header word instead (external payload, e.g. mapped by the PS).
+ *     The upper 32 bits of the third header word extend the address beyond 4GB
+ *   - The tx buffer is popped once the payload has been read, so the PS can release the memory
+ *   - When bit 62 of the first header word is set, the time the last payload byte is handed to
+ *     udp_complete is pushed to the tx timestamp fifo, read by the PS in the same order
+ *   - When bit 61 of the first header word is set, the header is held back from udp_complete until
+ *     the time reaches the launch time held in the upper 48 bits of the fifth header word (lower
+ *     48 bits of the time, ns). The payload is fetched in the meantime, so that the frame leaves
+ *     right after the launch time. The hold happens after arbitration, so packets of every tx
+ *     queue wait behind it (head-of-line blocking): launch times are meant for a single tx queue
+ *     in use (TX_QUEUES = 1, or the PS pushing to queue 0 only)
+ *   - Each tx queue may be shaped by a token bucket (rate in Mbit/s of UDP payload and burst in
+ *     bytes, set by the PS at any time): the arbiter skips the queue while it is over its rate, so
+ *     that pacing happens at microsecond granularity without the PS sleeping between packets
+ *
+ * Timestamps:
+ *   - A counter holds the time in nanoseconds, from power on unless set by the PS. It advances by
+ *     the increment register each clock cycle (28 fractional bits, nominal from CLK_FREQ_MHZ), so
+ *     that the PS can steer its frequency (e.g. as a PTP hardware clock)
+ *   - The PS sets the time, or adds a signed offset to it, with a single write (applied at once,
+ *     without read-modify-write races)
+ *   - Each rx packet is stamped as its header shows up from udp_complete; the lower 40 bits of the
+ *     stamp are written to the trailer word
+ *
+ * Rx descriptor mode (enabled from PS, latched on reset like the rest of the configuration):
+ *   - The rx buffers above are not used. Instead, the PS posts the addresses of free buffers
+ *     (one register write per buffer) and each received packet is written to the oldest one
+ *   - For each packet written, the index of its port is pushed to a completion fifo that the
+ *     PS reads in order (one register read per packet)
+ *   - Packets are discarded while no posted buffer is available
+ *
+ * Rx packed ring mode (enabled from PS, latched on reset; ignored in rx descriptor mode):
+ *   - The area of each rx buffer is used as a ring of 64-byte lines instead of slots. Packets
+ *     (same layout as in a slot) are written back to back, each one starting at a line boundary,
+ *     so that small packets take a line or two instead of a whole slot
+ *   - The write (head) and read (tail) pointers, in lines, are held in the upper 16 bits of the
+ *     bufrx control register of each port; the PS moves the tail as it consumes packets
+ *   - Packets are discarded while the ring of their port has no room for them
  **********************************************************************************/
 
 module controller #(
     parameter DMA_ADDR_WIDTH       = 32,
     parameter DMA_LEN_WIDTH        = 20,
     parameter BUFFER_RX_LENGTH     = 32,
+    parameter BUFFER_RX_LENGTH_MAX = 256,
     parameter BUFFER_TX_LENGTH     = 32,
     parameter BUFFER_ELEM_MAX_SIZE = 2*1024, // 2KB per slot in buffer
     parameter HEADER_NUM_WORDS     = 5,
-    parameter MAX_UDP_PORTS        = 1024
+    parameter MAX_UDP_PORTS        = 1024,
+    parameter RX_DESC_LENGTH       = 256,
+    parameter TX_QUEUES            = 4,
+    parameter PORT_MAP_ENTRIES     = 32,  // entries of the port map table (ports mapped to any rx buffer)
+    parameter CLK_FREQ_MHZ         = 125   // used to time the rx interrupt moderation and the timestamps (> 62.5)
 ) (
 
     // General
@@ -92,6 +167,15 @@ module controller #(
     input  wire [31:00] rx_hdr_dest_ip        ,
     input  wire [15:00] rx_hdr_dest_port      ,
     input  wire [15:00] rx_hdr_udp_length     ,
+    input  wire [47:00] rx_hdr_source_mac     ,
+    input  wire [07:00] rx_hdr_ip_tos         ,
+    input  wire [07:00] rx_hdr_ip_ttl         ,
+    input  wire [15:00] rx_hdr_ip_identification,
+    input  wire [02:00] rx_hdr_ip_flags       ,
+    input  wire [12:00] rx_hdr_ip_fragment_offset,
+    input  wire [03:00] rx_hdr_ip_ihl         ,
+    input  wire [15:00] rx_hdr_ip_header_checksum,
+    input  wire [15:00] rx_hdr_udp_checksum   ,
     output wire         rx_reduced_payload_axis_tready,
     input  wire         rx_reduced_payload_axis_tvalid,
     input  wire [07:00] rx_reduced_payload_axis_tdata ,
@@ -115,7 +199,6 @@ module controller #(
     output wire [DMA_LEN_WIDTH-1  : 00] dma_rd_ctrl_len_bytes_o ,
     output reg                          dma_rd_ctrl_valid_o     ,
     input  wire                         dma_rd_ctrl_ready_i     ,
-    input  wire                         dma_rd_ctrl_popped_i    , // Must go high for one single pulse
     output wire                         dma_rd_data_axis_tready ,
     input  wire                         dma_rd_data_axis_tvalid ,
     input  wire                         dma_rd_data_axis_tlast  ,
@@ -146,6 +229,13 @@ module controller #(
 
 wire rst_user;
 wire rst_global;
+wire rx_rings_rst;
+
+wire [32*PORT_MAP_ENTRIES-1:0] port_map_vec;
+reg                              rx_hdr_port_mapped;
+reg  [log2(MAX_UDP_PORTS)-1 : 0] rx_hdr_port_map_idx;
+wire [log2(MAX_UDP_PORTS)-1 : 0] rx_hdr_buffer_idx;
+wire                             rx_hdr_buffer_in_shmem;
 
 reg [31:00] udp_port_range_l;
 reg [31:00] udp_port_range_h;
@@ -153,7 +243,40 @@ reg [31:00] udp_port_range_h;
 reg  [DMA_ADDR_WIDTH-1 : 00] shared_mem_base_address;
 
 localparam BUFFRX_INDEX_WIDTH = log2(BUFFER_RX_LENGTH);
+localparam BUFFRX_EXT_INDEX_WIDTH = log2(BUFFER_RX_LENGTH_MAX); // up to 8 bits (256 slots)
 localparam BUFFTX_INDEX_WIDTH = log2(BUFFER_TX_LENGTH);
+localparam TXQ_INDEX_WIDTH = (TX_QUEUES > 1) ? log2(TX_QUEUES) : 1;
+localparam RXDESC_INDEX_WIDTH = log2(RX_DESC_LENGTH);
+
+reg rx_desc_mode;
+reg rx_pack_mode;
+
+reg [31:00] rx_frag_drops;
+
+reg [31:00] perf_rx_frames;
+reg [31:00] perf_rx_drop_closed;
+reg [31:00] perf_rx_drop_full;
+reg [31:00] perf_tx_frames;
+reg [31:00] perf_dma_wr_busy;
+reg [31:00] perf_dma_wr_stall;
+reg [31:00] perf_dma_rd_busy;
+reg [31:00] perf_dma_rd_stall;
+reg [31:00] perf_rx_hdr_stall;
+reg [31:00] perf_rx_ring_max;
+
+// Slot size (log2), selected by the PS among the ones allowed by BUFFER_ELEM_MAX_SIZE
+localparam SLOT_SIZE_LOG2_MIN = 11; // 2KB
+localparam SLOT_SIZE_LOG2_MAX = log2(BUFFER_ELEM_MAX_SIZE);
+reg [04:00] slot_size_log2;
+
+// Rx buffers in shared memory (0 or out of range: MAX_UDP_PORTS)
+reg [log2(MAX_UDP_PORTS) : 00] rx_buffers;
+
+// Tx buffer position in shared memory, in slots (0: right after the default-sized rx buffers)
+reg [27:00] tx_buffer_base;
+
+// Tx queues arbitration (0: strict priority, 1: deficit weighted round robin)
+reg tx_queues_dwrr;
 
 /**********************************************************************************
 * Registers for PL-PS communication
@@ -161,7 +284,10 @@ localparam BUFFTX_INDEX_WIDTH = log2(BUFFER_TX_LENGTH);
 
 wire rst_user_req;
 
-wire [DMA_ADDR_WIDTH-1 : 00] shmem_from_ps;
+wire [31:00] shmem_from_ps;
+wire [31:00] shmem_hi_from_ps;
+wire [63:00] shmem_from_ps_64;
+assign shmem_from_ps_64 = {shmem_hi_from_ps, shmem_from_ps};
 
 wire [47:00] local_mac_from_ps  ;
 wire [31:00] gateway_ip_from_ps ;
@@ -169,6 +295,14 @@ wire [31:00] subnet_mask_from_ps;
 wire [31:00] local_ip_from_ps   ;
 wire [31:00] udp_port_range_l_from_ps;
 wire [31:00] udp_port_range_h_from_ps;
+wire         rx_desc_mode_from_ps    ;
+wire         rx_pack_mode_from_ps    ;
+wire [31:00] slot_size_from_ps       ;
+wire [31:00] rx_buffers_from_ps      ;
+wire [31:00] tx_buffer_base_from_ps  ;
+wire [31:00] txq_ctrl_from_ps        ;
+wire [31:00] irq_coal_frames_from_ps ;
+wire [31:00] irq_coal_usecs_from_ps  ;
 
 always @ (posedge clk_i) begin
     if (rst_global) begin
@@ -178,7 +312,16 @@ always @ (posedge clk_i) begin
         local_ip                <= local_ip_from_ps   ;
         udp_port_range_l        <= udp_port_range_l_from_ps;
         udp_port_range_h        <= udp_port_range_h_from_ps;
-        shared_mem_base_address <= shmem_from_ps;
+        shared_mem_base_address <= shmem_from_ps_64[DMA_ADDR_WIDTH-1 : 00];
+        rx_desc_mode            <= rx_desc_mode_from_ps;
+        rx_pack_mode            <= rx_pack_mode_from_ps && !rx_desc_mode_from_ps;
+        if      (slot_size_from_ps < SLOT_SIZE_LOG2_MIN) slot_size_log2 <= SLOT_SIZE_LOG2_MIN;
+        else if (slot_size_from_ps > SLOT_SIZE_LOG2_MAX) slot_size_log2 <= SLOT_SIZE_LOG2_MAX;
+        else                                             slot_size_log2 <= slot_size_from_ps[04:00];
+        if (rx_buffers_from_ps == 0 || rx_buffers_from_ps > MAX_UDP_PORTS) rx_buffers <= MAX_UDP_PORTS;
+        else                                                               rx_buffers <= rx_buffers_from_ps[log2(MAX_UDP_PORTS) : 00];
+        tx_buffer_base          <= tx_buffer_base_from_ps[27:00];
+        tx_queues_dwrr          <= txq_ctrl_from_ps[0];
     end
 end
 
@@ -186,7 +329,10 @@ ctrl_axi_regs #(
     .C_S_AXI_DATA_WIDTH   (32 ),
     .C_BUFFRX_INDEX_WIDTH (BUFFRX_INDEX_WIDTH),
     .C_BUFFTX_INDEX_WIDTH (BUFFTX_INDEX_WIDTH),
-    .C_MAX_UDP_PORTS      (MAX_UDP_PORTS)
+    .C_MAX_UDP_PORTS      (MAX_UDP_PORTS),
+    .C_TX_QUEUES          (TX_QUEUES),
+    .C_PORT_MAP_ENTRIES   (PORT_MAP_ENTRIES),
+    .C_DMA_ADDR_WIDTH     (DMA_ADDR_WIDTH)
 ) ctrl_axi_regs_inst (
     .clk_i          (clk_i ),
     .rst_i          (rst_i ),
@@ -230,13 +376,59 @@ ctrl_axi_regs #(
     .bufrx_pushed_i    (circbuff_rx_data_pushed_vec),
     .bufrx_popped_o    (circbuff_rx_data_popped_vec),
     .bufrx_opensock_o  (circbuff_rx_data_opensock_vec),
-    .bufrx_push_irq_i  (circbuff_rx_data_pushed_vec_interr),
+    .bufrx_pack_head_i (bufrx_upper_vec            ),
+    .bufrx_pack_tail_o (rx_pack_tail_vec           ),
+    .bufrx_push_irq_i  (rx_irq_event           ),
     .buftx_head_i      (circbuff_tx_head_index ),
     .buftx_tail_i      (circbuff_tx_tail_index ),
     .buftx_empty_i     (circbuff_tx_empty      ),
     .buftx_full_i      (circbuff_tx_full       ),
-    .buftx_pushed_o    (circbuff_tx_data_pushed),
-    .buftx_popped_i    (circbuff_tx_data_popped) 
+    .buftx_pushed_o    (circbuff_tx_legacy_pushed),
+    .buftx_popped_i    (circbuff_tx_data_popped),
+    .rxdesc_mode_o     (rx_desc_mode_from_ps   ),
+    .rxdesc_post_addr_o(rx_desc_post_addr      ),
+    .rxdesc_post_o     (rx_desc_post           ),
+    .rxdesc_free_count_i(rx_desc_free_count_reg),
+    .rxdesc_compl_i    (rx_desc_compl_reg      ),
+    .rxdesc_compl_pop_o(rx_desc_compl_pop      ),
+    .rx_frag_drops_i   (rx_frag_drops          ),
+    .slot_size_o       (slot_size_from_ps      ),
+    .slot_size_max_i   (SLOT_SIZE_LOG2_MAX     ),
+    .rxpack_mode_o     (rx_pack_mode_from_ps   ),
+    .rx_buffers_o      (rx_buffers_from_ps     ),
+    .bufrx_cfg_o       (bufrx_cfg_vec          ),
+    .rx_depth_max_i    (BUFFRX_EXT_INDEX_WIDTH ),
+    .tx_buffer_base_o  (tx_buffer_base_from_ps ),
+    .txq_ctrl_o        (txq_ctrl_from_ps       ),
+    .txq_num_i         (TX_QUEUES              ),
+    .txq_status_i      (txq_status_vec         ),
+    .txq_pushed_o      (txq_pushed_vec         ),
+    .txq_weight_o      (txq_weight_vec         ),
+    .txq_rate_o        (txq_rate_vec           ),
+    .irq_coal_frames_o (irq_coal_frames_from_ps),
+    .irq_coal_usecs_o  (irq_coal_usecs_from_ps ),
+    .perf_rx_frames_i      (perf_rx_frames      ),
+    .perf_rx_drop_closed_i (perf_rx_drop_closed ),
+    .perf_rx_drop_full_i   (perf_rx_drop_full   ),
+    .perf_tx_frames_i      (perf_tx_frames      ),
+    .perf_dma_wr_busy_i    (perf_dma_wr_busy    ),
+    .perf_dma_wr_stall_i   (perf_dma_wr_stall   ),
+    .perf_dma_rd_busy_i    (perf_dma_rd_busy    ),
+    .perf_dma_rd_stall_i   (perf_dma_rd_stall   ),
+    .perf_rx_hdr_stall_i   (perf_rx_hdr_stall   ),
+    .perf_rx_ring_max_i    (perf_rx_ring_max    ),
+    .rx_rings_rst_o        (rx_rings_rst        ),
+    .port_map_o            (port_map_vec        ),
+    .shared_mem_hi_o       (shmem_hi_from_ps    ),
+    .rxdesc_post_addr_hi_o (rx_desc_post_addr_hi),
+    .timestamp_i           (timestamp_ns        ),
+    .timestamp_incr_i      (timestamp_incr      ),
+    .timestamp_incr_o      (timestamp_incr_ps   ),
+    .timestamp_load_o      (timestamp_load      ),
+    .timestamp_set_o       (timestamp_set       ),
+    .timestamp_adj_o       (timestamp_adj       ),
+    .tx_ts_i               (tx_ts_reg           ),
+    .tx_ts_pop_o           (tx_ts_pop           )
 );
 
 /**********************************************************************************
@@ -284,6 +476,10 @@ user_rst_handler user_rst_handler_dut (
 
 wire [log2(MAX_UDP_PORTS)-1 : 0]    buffer_select_idx;
 wire                                valid_udp_port;
+wire                                rx_frag_dropped;
+wire                                rx_accepted;
+wire                                rx_port_dropped;
+wire                                rx_full_dropped;
 
 wire         portfilt_axis_tready;
 wire         portfilt_axis_tvalid;
@@ -299,12 +495,20 @@ axis_udp_port_filter #(
     .rst                    (rst_global                   ),
     .hdr_valid              (rx_hdr_valid                 ),
     .hdr_dest_port          (rx_hdr_dest_port             ),
-    .dma_done_i             (~rx_busy                     ),
+    .hdr_port_mapped        (rx_hdr_port_mapped           ),
+    .hdr_buffer_idx         (rx_hdr_buffer_idx            ),
+    .hdr_ip_fragment        (rx_hdr_ip_flags[0] || rx_hdr_ip_fragment_offset != 0),
+    .dma_done_i             (!rx_pack_busy                ),
     .udp_port_range_lower   (udp_port_range_l             ),
     .udp_port_range_upper   (udp_port_range_h             ),
     .open_sockets_vector    (circbuff_rx_data_opensock_vec),
+    .buffer_available_i     (rx_desc_mode ? !rx_desc_free_empty : rx_hdr_buffer_in_shmem && (rx_pack_mode ? rx_pack_available : !circbuff_rx_full_arr[rx_hdr_buffer_idx])),
     .buffer_select_idx_o    (buffer_select_idx            ),
     .valid_udp_port_o       (valid_udp_port               ),
+    .fragment_dropped_o     (rx_frag_dropped              ),
+    .accepted_o             (rx_accepted                  ),
+    .port_dropped_o         (rx_port_dropped              ),
+    .full_dropped_o         (rx_full_dropped              ),
     .s_axis_payload_tready  (rx_payload_axis_tready       ),
     .s_axis_payload_tvalid  (rx_payload_axis_tvalid       ),
     .s_axis_payload_tdata   (rx_payload_axis_tdata        ),
@@ -319,6 +523,13 @@ axis_udp_port_filter #(
     .m_axis_tuser           (portfilt_axis_tuser          )
 );
 
+// IPv4 fragments are not reassembled, count the ones discarded
+
+always @ (posedge clk_i) begin
+    if      (rst_global     ) rx_frag_drops <= 0;
+    else if (rx_frag_dropped) rx_frag_drops <= rx_frag_drops + 1;
+end
+
 /**********************************************************************************
 * Circular buffer rx
 **********************************************************************************/
@@ -326,22 +537,39 @@ axis_udp_port_filter #(
 reg                           circbuff_rx_data_pushed_arr  [0 : MAX_UDP_PORTS-1];
 wire                          circbuff_rx_data_popped_arr  [0 : MAX_UDP_PORTS-1];
 wire                          circbuff_rx_data_opensock_arr[0 : MAX_UDP_PORTS-1];
-wire [BUFFRX_INDEX_WIDTH-1:0] circbuff_rx_head_index_arr   [0 : MAX_UDP_PORTS-1];
-wire [BUFFRX_INDEX_WIDTH-1:0] circbuff_rx_tail_index_arr   [0 : MAX_UDP_PORTS-1];
+wire                          circbuff_rx_flush_arr        [0 : MAX_UDP_PORTS-1];
+wire [BUFFRX_EXT_INDEX_WIDTH-1:0] circbuff_rx_head_index_arr   [0 : MAX_UDP_PORTS-1];
+wire [BUFFRX_EXT_INDEX_WIDTH-1:0] circbuff_rx_tail_index_arr   [0 : MAX_UDP_PORTS-1];
 wire                          circbuff_rx_full_arr         [0 : MAX_UDP_PORTS-1];
 wire                          circbuff_rx_empty_arr        [0 : MAX_UDP_PORTS-1];
 
+/**
+ * Sockets can be opened and closed while traffic flows: the filter checks the socket state once per frame,
+ * so a frame already accepted for a socket being closed is still written to its ring. Opening a socket
+ * flushes its ring, discarding any packet left over from the last time it was open, and keeps a packet
+ * pushed in the same cycle.
+ */
+
 genvar buffer_rx_index;
 generate
     for (buffer_rx_index = 0; buffer_rx_index < MAX_UDP_PORTS; buffer_rx_index = buffer_rx_index + 1) begin
+        pulse_on_posedge pulse_rx_opensock (
+            .clk_i           (clk_i                                          ),
+            .rst_i           (rst_global                                     ),
+            .signal_rising_i (circbuff_rx_data_opensock_arr[buffer_rx_index] ),
+            .signal_pulse_o  (circbuff_rx_flush_arr        [buffer_rx_index] )
+        );
+
         circular_buffer #(
-            .BUFFER_LENGTH (BUFFER_RX_LENGTH   ),
-            .INDEX_WIDTH   (BUFFRX_INDEX_WIDTH )
+            .BUFFER_LENGTH (BUFFER_RX_LENGTH_MAX  ),
+            .INDEX_WIDTH   (BUFFRX_EXT_INDEX_WIDTH)
         ) circular_buffer_rx (
             .clk_i         (clk_i      ),
-            .rst_i         (rst_global ),
+            .rst_i         (rst_global || rx_rings_rst),
+            .length_i      (rx_ring_length_arr         [buffer_rx_index] ),
             .data_pushed_i (circbuff_rx_data_pushed_arr[buffer_rx_index] ),
             .data_popped_i (circbuff_rx_data_popped_arr[buffer_rx_index] ),
+            .flush_i       (circbuff_rx_flush_arr      [buffer_rx_index] ),
             .head_index_o  (circbuff_rx_head_index_arr [buffer_rx_index] ),
             .tail_index_o  (circbuff_rx_tail_index_arr [buffer_rx_index] ),
             .full_o        (circbuff_rx_full_arr       [buffer_rx_index] ),
@@ -353,7 +581,7 @@ endgenerate
 reg [log2(MAX_UDP_PORTS) : 0] buffer_rx_index2;
 always @(*) begin
     for (buffer_rx_index2 = 0; buffer_rx_index2 < MAX_UDP_PORTS; buffer_rx_index2 = buffer_rx_index2 + 1) begin
-        if (buffer_rx_index2 == buffer_select_idx) circbuff_rx_data_pushed_arr[buffer_rx_index2] <= dma_wr_ctrl_pushed_i;
+        if (buffer_rx_index2 == buffer_select_idx) circbuff_rx_data_pushed_arr[buffer_rx_index2] <= dma_wr_ctrl_pushed_i && !rx_desc_mode && !rx_pack_mode;
         else                                       circbuff_rx_data_pushed_arr[buffer_rx_index2] <= 0;
     end
 end
@@ -369,7 +597,43 @@ wire [MAX_UDP_PORTS-1                    : 0] circbuff_rx_full_vec       ;
 wire [MAX_UDP_PORTS-1                    : 0] circbuff_rx_empty_vec      ;
 
 wire circbuff_rx_data_pushed_vec_interr;
-assign circbuff_rx_data_pushed_vec_interr = |circbuff_rx_data_pushed_vec;
+assign circbuff_rx_data_pushed_vec_interr = |circbuff_rx_data_pushed_vec || rx_desc_pushed || rx_pack_pushed;
+
+/**
+ * Rx interrupt moderation: the interrupt is raised once irq_coal_frames packets have been pushed, or once
+ * irq_coal_usecs microseconds have passed since the first packet not notified yet, whichever comes first.
+ * With irq_coal_usecs set to 0 (default) the interrupt is raised for each packet, as the count alone could
+ * leave the last packets of a burst pending forever.
+ */
+
+reg  [31:00] rx_irq_pending;
+reg  [31:00] rx_irq_usecs;
+reg  [07:00] rx_irq_usec_ticks;
+wire         rx_irq_usec_tick;
+wire         rx_irq_frames_hit;
+wire         rx_irq_usecs_hit;
+wire         rx_irq_event;
+
+assign rx_irq_usec_tick  = rx_irq_usec_ticks == CLK_FREQ_MHZ - 1;
+assign rx_irq_frames_hit = rx_irq_pending + circbuff_rx_data_pushed_vec_interr >= irq_coal_frames_from_ps;
+assign rx_irq_usecs_hit  = rx_irq_pending != 0 && rx_irq_usecs >= irq_coal_usecs_from_ps;
+assign rx_irq_event      = (irq_coal_usecs_from_ps == 0) ? circbuff_rx_data_pushed_vec_interr :
+                           (circbuff_rx_data_pushed_vec_interr && rx_irq_frames_hit) || rx_irq_usecs_hit;
+
+always @ (posedge clk_i) begin
+    if      (rst_global || rx_irq_usec_tick) rx_irq_usec_ticks <= 0;
+    else                                     rx_irq_usec_ticks <= rx_irq_usec_ticks + 1;
+end
+
+always @ (posedge clk_i) begin
+    if (rst_global || rx_irq_event) begin
+        rx_irq_pending <= 0;
+        rx_irq_usecs   <= 0;
+    end else begin
+        if (circbuff_rx_data_pushed_vec_interr) rx_irq_pending <= rx_irq_pending + 1;
+        if (rx_irq_pending != 0 && rx_irq_usec_tick) rx_irq_usecs <= rx_irq_usecs + 1;
+    end
+end
 
 genvar buffer_rx_vec_index;
 generate
@@ -377,39 +641,366 @@ generate
         assign circbuff_rx_data_pushed_vec  [buffer_rx_vec_index] = circbuff_rx_data_pushed_arr[buffer_rx_vec_index];
         assign circbuff_rx_data_popped_arr  [buffer_rx_vec_index] = circbuff_rx_data_popped_vec[buffer_rx_vec_index];
         assign circbuff_rx_data_opensock_arr[buffer_rx_vec_index] = circbuff_rx_data_opensock_vec[buffer_rx_vec_index];
-        assign circbuff_rx_head_index_vec   [(buffer_rx_vec_index+1)*BUFFRX_INDEX_WIDTH-1 : buffer_rx_vec_index*BUFFRX_INDEX_WIDTH] = circbuff_rx_head_index_arr [buffer_rx_vec_index];
-        assign circbuff_rx_tail_index_vec   [(buffer_rx_vec_index+1)*BUFFRX_INDEX_WIDTH-1 : buffer_rx_vec_index*BUFFRX_INDEX_WIDTH] = circbuff_rx_tail_index_arr [buffer_rx_vec_index];
+        assign circbuff_rx_head_index_vec   [(buffer_rx_vec_index+1)*BUFFRX_INDEX_WIDTH-1 : buffer_rx_vec_index*BUFFRX_INDEX_WIDTH] = circbuff_rx_head_index_arr [buffer_rx_vec_index][BUFFRX_INDEX_WIDTH-1 : 0];
+        assign circbuff_rx_tail_index_vec   [(buffer_rx_vec_index+1)*BUFFRX_INDEX_WIDTH-1 : buffer_rx_vec_index*BUFFRX_INDEX_WIDTH] = circbuff_rx_tail_index_arr [buffer_rx_vec_index][BUFFRX_INDEX_WIDTH-1 : 0];
         assign circbuff_rx_full_vec         [buffer_rx_vec_index] = circbuff_rx_full_arr       [buffer_rx_vec_index];
         assign circbuff_rx_empty_vec        [buffer_rx_vec_index] = circbuff_rx_empty_arr      [buffer_rx_vec_index];
     end
 endgenerate
 
+/**********************************************************************************
+* Rx buffer length and position (per port)
+*   - bufrx cfg reg of each port: {base (in slots), log2 of length}. A length of 0 keeps the
+*     default layout (BUFFER_RX_LENGTH slots, buffer i at slot i*BUFFER_RX_LENGTH)
+*   - Written by the PS while the core is in reset
+*   - Upper 16 bits of bufrx regs: packed ring head in packed mode, {head, tail} otherwise
+**********************************************************************************/
+
+wire [MAX_UDP_PORTS*32-1 : 0] bufrx_cfg_vec;
+wire [MAX_UDP_PORTS*16-1 : 0] bufrx_upper_vec;
+
+wire [BUFFRX_EXT_INDEX_WIDTH : 00] rx_ring_length_arr [0 : MAX_UDP_PORTS-1];
+wire [27:00]                       rx_ring_base_arr   [0 : MAX_UDP_PORTS-1];
+
+genvar rx_ring_index;
+generate
+    for (rx_ring_index = 0; rx_ring_index < MAX_UDP_PORTS; rx_ring_index = rx_ring_index + 1) begin
+        wire [03:00] length_log2;
+        wire [07:00] head_ext;
+        wire [07:00] tail_ext;
+        assign length_log2 = bufrx_cfg_vec[rx_ring_index*32+3 : rx_ring_index*32];
+        assign head_ext    = circbuff_rx_head_index_arr[rx_ring_index];
+        assign tail_ext    = circbuff_rx_tail_index_arr[rx_ring_index];
+
+        assign rx_ring_length_arr[rx_ring_index] = (length_log2 == 0                     ) ? BUFFER_RX_LENGTH     :
+                                                   (length_log2 > BUFFRX_EXT_INDEX_WIDTH) ? BUFFER_RX_LENGTH_MAX : 1 << length_log2;
+        assign rx_ring_base_arr  [rx_ring_index] = (length_log2 == 0) ? rx_ring_index * BUFFER_RX_LENGTH : bufrx_cfg_vec[rx_ring_index*32+31 : rx_ring_index*32+4];
+
+        assign bufrx_upper_vec[(rx_ring_index+1)*16-1 : rx_ring_index*16] = rx_pack_mode ? rx_pack_head_arr[rx_ring_index] : {head_ext, tail_ext};
+    end
+endgenerate
+
+/**********************************************************************************
+* Rx descriptor rings (descriptor mode)
+*   - rx_desc_free_fifo: addresses of the buffers posted by the PS, oldest first
+*   - rx_desc_compl_fifo: port index of each packet written, in the same order
+**********************************************************************************/
+
+wire                          rx_desc_post        ;
+wire [31:00]                  rx_desc_post_addr   ;
+wire [31:00]                  rx_desc_post_addr_hi;
+wire [63:00]                  rx_desc_post_addr_64;
+assign rx_desc_post_addr_64 = {rx_desc_post_addr_hi, rx_desc_post_addr};
+wire                          rx_desc_pushed      ;
+wire [DMA_ADDR_WIDTH-1 : 00]  rx_desc_free_addr   ;
+wire                          rx_desc_free_empty  ;
+wire [RXDESC_INDEX_WIDTH : 0] rx_desc_free_count  ;
+wire [31:00]                  rx_desc_free_count_reg;
+wire                          rx_desc_compl_pop   ;
+wire [log2(MAX_UDP_PORTS)-1:0] rx_desc_compl_idx  ;
+wire                          rx_desc_compl_empty ;
+wire [RXDESC_INDEX_WIDTH : 0] rx_desc_compl_count ;
+wire [31:00]                  rx_desc_compl_reg   ;
+
+assign rx_desc_pushed = rx_desc_mode && dma_wr_ctrl_pushed_i;
+
+// Posted buffers and pending completions survive user resets (e.g. when the PS updates the IP
+// configuration); they are only flushed on POR or when the descriptor mode gets disabled
+wire rx_desc_rst;
+assign rx_desc_rst = rst_i || !rx_desc_mode;
+
+sync_fifo #(
+    .DATA_WIDTH  (DMA_ADDR_WIDTH     ),
+    .DEPTH       (RX_DESC_LENGTH     ),
+    .INDEX_WIDTH (RXDESC_INDEX_WIDTH )
+) rx_desc_free_fifo (
+    .clk_i       (clk_i              ),
+    .rst_i       (rx_desc_rst        ),
+    .wr_en_i     (rx_desc_post       ),
+    .wr_data_i   (rx_desc_post_addr_64[DMA_ADDR_WIDTH-1 : 00]),
+    .rd_en_i     (rx_desc_pushed     ),
+    .rd_data_o   (rx_desc_free_addr  ),
+    .full_o      (                   ),
+    .empty_o     (rx_desc_free_empty ),
+    .count_o     (rx_desc_free_count )
+);
+
+sync_fifo #(
+    .DATA_WIDTH  (log2(MAX_UDP_PORTS)),
+    .DEPTH       (RX_DESC_LENGTH     ),
+    .INDEX_WIDTH (RXDESC_INDEX_WIDTH )
+) rx_desc_compl_fifo (
+    .clk_i       (clk_i              ),
+    .rst_i       (rx_desc_rst        ),
+    .wr_en_i     (rx_desc_pushed     ),
+    .wr_data_i   (buffer_select_idx  ),
+    .rd_en_i     (rx_desc_compl_pop  ),
+    .rd_data_o   (rx_desc_compl_idx  ),
+    .full_o      (                   ),
+    .empty_o     (rx_desc_compl_empty),
+    .count_o     (rx_desc_compl_count)
+);
+
+// Both fifos have the same depth, so the completion fifo cannot overflow: a completion
+// is only pushed when a posted buffer is consumed
+
+assign rx_desc_free_count_reg = rx_desc_free_count;
+assign rx_desc_compl_reg      = {!rx_desc_compl_empty, {(31-log2(MAX_UDP_PORTS)){1'b0}}, rx_desc_compl_idx};
+
 /**********************************************************************************
 * Circular buffer tx
 **********************************************************************************/
 
+wire                          circbuff_tx_legacy_pushed;
 wire                          circbuff_tx_data_pushed;
 wire                          circbuff_tx_data_popped;
 wire [BUFFTX_INDEX_WIDTH-1:0] circbuff_tx_head_index ;
 wire [BUFFTX_INDEX_WIDTH-1:0] circbuff_tx_tail_index ;
 wire                          circbuff_tx_full       ;
 wire                          circbuff_tx_empty      ;
-assign circbuff_tx_data_popped = dma_rd_ctrl_popped_i;
-
-circular_buffer #(
-    .BUFFER_LENGTH (BUFFER_TX_LENGTH   ),
-    .INDEX_WIDTH   (BUFFTX_INDEX_WIDTH )
-) circular_buffer_tx (
-    .clk_i         (clk_i      ),
-    .rst_i         (rst_global ),
-    .data_pushed_i (circbuff_tx_data_pushed ),
-    .data_popped_i (circbuff_tx_data_popped ),
-    .head_index_o  (circbuff_tx_head_index  ),
-    .tail_index_o  (circbuff_tx_tail_index  ),
-    .full_o        (circbuff_tx_full        ),
-    .empty_o       (circbuff_tx_empty       ) 
+assign circbuff_tx_data_popped = dma_rd_state == DMA_RD_STATE_PAYLOAD && dma_rd_data_last;
+
+/**
+ * Tx queues: TX_QUEUES rings of BUFFER_TX_LENGTH slots, back to back in shared memory from the tx buffer.
+ * Queue 0 is the tx buffer itself (also driven through the BUFTX registers), the others are only pushed
+ * through their own registers. The next slot to be sent is picked among them by the arbiter (see below).
+ */
+
+wire [TX_QUEUES-1:0]                    txq_pushed_vec;
+wire [32*TX_QUEUES-1:0]                 txq_status_vec;
+wire [32*TX_QUEUES-1:0]                 txq_weight_vec;
+wire [32*TX_QUEUES-1:0]                 txq_rate_vec;
+wire [TX_QUEUES-1:0]                    txq_empty_vec;
+wire [BUFFTX_INDEX_WIDTH-1:0]           txq_tail_index_arr [TX_QUEUES-1:0];
+reg  [TXQ_INDEX_WIDTH-1:0]              txq_sel;
+
+assign circbuff_tx_data_pushed = circbuff_tx_legacy_pushed | txq_pushed_vec[0];
+
+genvar txq_index;
+generate
+    for (txq_index = 0; txq_index < TX_QUEUES; txq_index = txq_index + 1) begin : gen_txq
+
+        wire [BUFFTX_INDEX_WIDTH-1:0] head_index;
+        wire [BUFFTX_INDEX_WIDTH-1:0] tail_index;
+        wire                          full;
+        wire                          empty;
+
+        circular_buffer #(
+            .BUFFER_LENGTH (BUFFER_TX_LENGTH   ),
+            .INDEX_WIDTH   (BUFFTX_INDEX_WIDTH )
+        ) circular_buffer_tx (
+            .clk_i         (clk_i      ),
+            .rst_i         (rst_global ),
+            .length_i      (0                       ),
+            .data_pushed_i ((txq_index == 0) ? circbuff_tx_data_pushed : txq_pushed_vec[txq_index]),
+            .data_popped_i (circbuff_tx_data_popped && txq_sel == txq_index),
+            .flush_i       (0                       ),
+            .head_index_o  (head_index              ),
+            .tail_index_o  (tail_index              ),
+            .full_o        (full                    ),
+            .empty_o       (empty                   ) 
+        );
+
+        assign txq_empty_vec[txq_index]      = empty;
+        assign txq_tail_index_arr[txq_index] = tail_index;
+        assign txq_status_vec[32*txq_index +: 32] = {14'b0, full, empty, {(8-BUFFTX_INDEX_WIDTH){1'b0}}, tail_index, {(8-BUFFTX_INDEX_WIDTH){1'b0}}, head_index};
+    end
+endgenerate
+
+assign circbuff_tx_head_index = gen_txq[0].head_index;
+assign circbuff_tx_tail_index = gen_txq[0].tail_index;
+assign circbuff_tx_full       = gen_txq[0].full;
+assign circbuff_tx_empty      = gen_txq[0].empty;
+
+/**
+ * Tx queues shaping (token bucket), ahead of the arbitration:
+ *   - a queue with a rate (Mbit/s of UDP payload, 0: not shaped) gains as many bits of credit every microsecond,
+ *     up to its burst (in bytes, 0: one slot), and each packet takes its payload length
+ *   - the queue is only eligible for the arbitration while its credit is not negative, so a packet larger than
+ *     the burst is still sent, then the queue waits for the credit to come back
+ *   - the microsecond tick is the one of the rx interrupt moderation
+ */
+
+wire [TX_QUEUES-1:0] txq_active_vec; // non-empty and within its rate
+
+genvar txq_shaper_index;
+generate
+    for (txq_shaper_index = 0; txq_shaper_index < TX_QUEUES; txq_shaper_index = txq_shaper_index + 1) begin : gen_txq_shaper
+        wire        [15:00] rate;
+        wire        [15:00] burst;
+        wire signed [31:00] tokens_max;
+        wire signed [31:00] tokens_next;
+        reg  signed [31:00] tokens;
+
+        assign rate        = txq_rate_vec[32*txq_shaper_index      +: 16];
+        assign burst       = txq_rate_vec[32*txq_shaper_index + 16 +: 16];
+        assign tokens_max  = (burst != 0) ? {burst, 3'b0} : {slot_size_bytes, 3'b0};
+        assign tokens_next = tokens + (rx_irq_usec_tick ? rate : 16'd0)
+                                    - ((circbuff_tx_data_popped && txq_sel == txq_shaper_index) ? {tx_payload_length, 3'b0} : 19'd0);
+
+        always @ (posedge clk_i) begin
+            if      (rst_global || rate == 0    ) tokens <= 0;
+            else if (tokens_next > tokens_max   ) tokens <= tokens_max;
+            else                                  tokens <= tokens_next;
+        end
+
+        assign txq_active_vec[txq_shaper_index] = !txq_empty_vec[txq_shaper_index] && (rate == 0 || !tokens[31]);
+    end
+endgenerate
+
+/**
+ * Tx queues arbitration, done while the DMA read is idle, among the queues not empty and within their rate:
+ *   - strict priority: the queue with the highest index is sent first
+ *   - DWRR: the queues are visited in turn; each visit adds the weight of the queue (in bytes, 0: one slot) to
+ *     its deficit, and the queue is served while the deficit is positive (each packet takes its payload length).
+ *     A queue skipped for its rate keeps its deficit, and gains no more until it is served
+ */
+
+reg  signed [31:00]       txq_deficit_arr [TX_QUEUES-1:0];
+reg  [TXQ_INDEX_WIDTH-1:0] txq_rr;
+reg  [TXQ_INDEX_WIDTH-1:0] txq_pick;
+reg                        txq_pick_valid;
+wire [TXQ_INDEX_WIDTH-1:0] txq_rr_next;
+wire [31:00]               txq_rr_next_weight;
+integer txq_arb_index;
+integer txq_rst_index;
+
+assign txq_rr_next        = (txq_rr == TX_QUEUES-1) ? 0 : txq_rr + 1;
+assign txq_rr_next_weight = (txq_weight_vec[32*txq_rr_next +: 32] != 0) ? txq_weight_vec[32*txq_rr_next +: 32] : slot_size_bytes;
+
+always @ (*) begin
+    txq_pick       = 0;
+    txq_pick_valid = 0;
+    if (tx_queues_dwrr) begin
+        txq_pick       = txq_rr;
+        txq_pick_valid = txq_active_vec[txq_rr] && txq_deficit_arr[txq_rr] > 0;
+    end else begin
+        for (txq_arb_index = 0; txq_arb_index < TX_QUEUES; txq_arb_index = txq_arb_index + 1) begin
+            if (txq_active_vec[txq_arb_index]) begin
+                txq_pick       = txq_arb_index;
+                txq_pick_valid = 1;
+            end
+        end
+    end
+end
+
+// the selection only changes while idle, so the slot address is stable for the whole packet
+always @ (posedge clk_i) begin
+    if      (rst_global                          ) txq_sel <= 0;
+    else if (dma_rd_state == DMA_RD_STATE_IDLE   ) txq_sel <= txq_pick;
+end
+
+always @ (posedge clk_i) begin
+    if (rst_global) begin
+        txq_rr <= 0;
+        for (txq_rst_index = 0; txq_rst_index < TX_QUEUES; txq_rst_index = txq_rst_index + 1) txq_deficit_arr[txq_rst_index] <= 0;
+    end else if (circbuff_tx_data_popped) begin
+        txq_deficit_arr[txq_sel] <= txq_deficit_arr[txq_sel] - tx_payload_length;
+    end else if (tx_queues_dwrr && dma_rd_state == DMA_RD_STATE_IDLE && !txq_pick_valid) begin
+        // an empty queue does not keep its credit
+        if (txq_empty_vec[txq_rr]) txq_deficit_arr[txq_rr] <= 0;
+        txq_rr <= txq_rr_next;
+        if (txq_deficit_arr[txq_rr_next] <= 0) txq_deficit_arr[txq_rr_next] <= txq_deficit_arr[txq_rr_next] + txq_rr_next_weight;
+    end
+end
+
+wire txq_ready;
+assign txq_ready = txq_pick_valid && txq_sel == txq_pick;
+
+/**********************************************************************************
+* Timestamps
+*   - timestamp_ns: nanoseconds since power on (or since the time set by the PS), kept with 28
+*     fractional bits so that clock periods that are not a whole number of nanoseconds do not
+*     drift and the frequency can be steered finely. Not cleared by user resets
+*   - The increment written by the PS replaces the nominal one (0: nominal)
+*   - Rx: taken when the header of a packet shows up from udp_complete (also while the header
+*     adder holds it back), then latched by the header adder into the trailer
+*   - Tx: taken when the last payload byte of a datagram flagged by the PS is handed to
+*     udp_complete, pushed to tx_ts_fifo (stamps of a full fifo are lost)
+**********************************************************************************/
+
+localparam [31:00] TIMESTAMP_INCR = (64'd1000 << 28) / CLK_FREQ_MHZ; // ns per clock cycle, 28 fractional bits
+localparam TX_TS_LENGTH = 16;
+
+wire [31:00] timestamp_incr_ps;
+wire [63:00] timestamp_load;
+wire         timestamp_set;
+wire         timestamp_adj;
+wire [31:00] timestamp_incr;
+assign timestamp_incr = (timestamp_incr_ps != 0) ? timestamp_incr_ps : TIMESTAMP_INCR;
+
+reg  [91:00] timestamp_acc;
+wire [63:00] timestamp_ns;
+assign timestamp_ns = timestamp_acc[91:28];
+
+// the offset wraps around like the time (two's complement)
+always @ (posedge clk_i) begin
+    if      (rst_i        ) timestamp_acc <= 0;
+    else if (timestamp_set) timestamp_acc <= {timestamp_load, 28'b0};
+    else if (timestamp_adj) timestamp_acc <= timestamp_acc + {timestamp_load, 28'b0} + timestamp_incr;
+    else                    timestamp_acc <= timestamp_acc + timestamp_incr;
+end
+
+reg          rx_hdr_stamped;
+reg  [63:00] rx_hdr_timestamp_r;
+wire [63:00] rx_hdr_timestamp;
+assign rx_hdr_timestamp = rx_hdr_stamped ? rx_hdr_timestamp_r : timestamp_ns;
+
+always @ (posedge clk_i) begin
+    if      (rst_global || (rx_hdr_valid && rx_hdr_ready)) rx_hdr_stamped <= 0;
+    else if (rx_hdr_valid                                ) rx_hdr_stamped <= 1;
+    if (rx_hdr_valid && !rx_hdr_stamped) rx_hdr_timestamp_r <= timestamp_ns;
+end
+
+reg          tx_timestamp_req;   // bit 62 of the first header word of the slot being fetched
+reg          tx_timestamp_armed; // the datagram handed to udp_complete asked for a stamp
+wire         tx_ts_push;
+wire         tx_ts_pop;
+wire [62:00] tx_ts_head;
+wire         tx_ts_empty;
+wire [63:00] tx_ts_reg;
+
+always @ (posedge clk_i) begin
+    if      (rst_global                  ) tx_timestamp_armed <= 0;
+    else if (tx_hdr_valid && tx_hdr_ready) tx_timestamp_armed <= tx_timestamp_req;
+    else if (tx_ts_push                  ) tx_timestamp_armed <= 0;
+end
+
+assign tx_ts_push = tx_timestamp_armed && tx_payload_axis_tready && tx_payload_axis_tvalid && tx_payload_axis_tlast;
+
+sync_fifo #(
+    .DATA_WIDTH  (63                 ),
+    .DEPTH       (TX_TS_LENGTH       ),
+    .INDEX_WIDTH (log2(TX_TS_LENGTH) )
+) tx_ts_fifo (
+    .clk_i       (clk_i              ),
+    .rst_i       (rst_global         ),
+    .wr_en_i     (tx_ts_push         ),
+    .wr_data_i   (timestamp_ns[62:00]),
+    .rd_en_i     (tx_ts_pop          ),
+    .rd_data_o   (tx_ts_head         ),
+    .full_o      (                   ),
+    .empty_o     (tx_ts_empty        ),
+    .count_o     (                   )
 );
 
+assign tx_ts_reg = {!tx_ts_empty, tx_ts_head};
+
+// Launch time: the header of a flagged packet is held back while the time (lower 48 bits) is before
+// the launch time, compared within half the 48-bit range (about 39 hours) so that it wraps around.
+// The queue has already been picked by the arbiter, so the other tx queues are stalled meanwhile
+reg          tx_launch_req = 0;  // bit 61 of the first header word of the slot being fetched
+reg  [47:00] tx_launch_time;     // upper 48 bits of the fifth header word
+wire [47:00] tx_launch_diff;
+wire         tx_launch_hold;
+wire         tx_hdr_valid_int;
+wire         tx_hdr_ready_int;
+
+assign tx_launch_diff   = timestamp_ns[47:00] - tx_launch_time;
+assign tx_launch_hold   = tx_launch_req && tx_launch_diff[47];
+assign tx_hdr_valid     = tx_hdr_valid_int && !tx_launch_hold;
+assign tx_hdr_ready_int = tx_hdr_ready     && !tx_launch_hold;
+
 /**********************************************************************************
 * AXIS header adder
 **********************************************************************************/
@@ -453,6 +1044,16 @@ axis_header_adder #(
     .hdr_dest_ip               (rx_hdr_dest_ip    ),
     .hdr_dest_port             (rx_hdr_dest_port  ),
     .hdr_udp_length            (rx_hdr_udp_length ),
+    .hdr_source_mac            (rx_hdr_source_mac ),
+    .hdr_ip_tos                (rx_hdr_ip_tos     ),
+    .hdr_ip_ttl                (rx_hdr_ip_ttl     ),
+    .hdr_ip_identification     (rx_hdr_ip_identification ),
+    .hdr_ip_flags              (rx_hdr_ip_flags   ),
+    .hdr_ip_fragment_offset    (rx_hdr_ip_fragment_offset),
+    .hdr_ip_ihl                (rx_hdr_ip_ihl     ),
+    .hdr_ip_header_checksum    (rx_hdr_ip_header_checksum),
+    .hdr_udp_checksum          (rx_hdr_udp_checksum      ),
+    .hdr_timestamp             (rx_hdr_timestamp[39:00]  ),
     .s_axis_payload_tready     (portfilt_axis_tready ),
     .s_axis_payload_tvalid     (portfilt_axis_tvalid ),
     .s_axis_payload_tdata      (portfilt_axis_tdata  ),
@@ -509,8 +1110,8 @@ axis_header_remover #(
     .s_axis_tkeep      (dma_rd_data_axis_tkeep ),
     .s_axis_tlast      (dma_rd_data_axis_tlast ),
     .s_axis_tuser      (1'b0                   ),
-    .hdr_ready         (tx_hdr_ready      ),
-    .hdr_valid         (tx_hdr_valid      ),
+    .hdr_ready         (tx_hdr_ready_int  ),
+    .hdr_valid         (tx_hdr_valid_int  ),
     .hdr_source_ip     (tx_hdr_source_ip  ),
     .hdr_source_port   (tx_hdr_source_port),
     .hdr_dest_ip       (tx_hdr_dest_ip    ),
@@ -534,48 +1135,294 @@ always @ (posedge clk_i) begin
     else if (dma_wr_data_axis_tvalid           ) dma_wr_ctrl_valid_o = 1;
 end
 
-localparam BUFFER_SIZE_BYTES = BUFFER_RX_LENGTH * BUFFER_ELEM_MAX_SIZE;
+// slots are 2^slot_size_log2 bytes long, each buffer takes BUFFER_RX_LENGTH slots
+wire [DMA_LEN_WIDTH-1  : 00] slot_size_bytes;
 wire [DMA_ADDR_WIDTH-1 : 00] buffer_rx_0_base_addr;
 reg [DMA_ADDR_WIDTH-1 : 00] buffer_rx_selected_base_addr;
 reg [DMA_ADDR_WIDTH-1 : 00] buffer_rx_selected_next_slot_addr; 
+assign slot_size_bytes = 1 << slot_size_log2;
 assign buffer_rx_0_base_addr = shared_mem_base_address; 
 always @(posedge clk_i) begin
-    buffer_rx_selected_base_addr = buffer_rx_0_base_addr + buffer_select_idx * BUFFER_SIZE_BYTES; 
-    buffer_rx_selected_next_slot_addr <= buffer_rx_selected_base_addr + circbuff_rx_head_index_arr[buffer_select_idx] * BUFFER_ELEM_MAX_SIZE;
+    buffer_rx_selected_base_addr = buffer_rx_0_base_addr + (rx_ring_base_arr[buffer_select_idx] << slot_size_log2); 
+    buffer_rx_selected_next_slot_addr <= buffer_rx_selected_base_addr + (circbuff_rx_head_index_arr[buffer_select_idx] << slot_size_log2);
 end 
-assign dma_wr_ctrl_addr_o = buffer_rx_selected_next_slot_addr;
+
+/**
+ * Port map: a CAM of PORT_MAP_ENTRIES entries written by the PS, each one {valid (bit 31), rx buffer
+ * index (bits 16 and up), port (bits 0-15)}. A port listed in a valid entry goes to the rx buffer of
+ * the entry (the first one listing it), wherever it is; other ports go to the buffer of their offset
+ * within the udp port range. Entries can be changed at any time, preferably with the socket closed
+ */
+
+reg  [log2(PORT_MAP_ENTRIES) : 0] port_map_index;
+always @(*) begin
+    rx_hdr_port_mapped  = 0;
+    rx_hdr_port_map_idx = 0;
+    for (port_map_index = PORT_MAP_ENTRIES; port_map_index > 0; port_map_index = port_map_index - 1) begin
+        if (port_map_vec[32*(port_map_index-1)+31] && port_map_vec[32*(port_map_index-1) +: 16] == rx_hdr_dest_port) begin
+            rx_hdr_port_mapped  = 1;
+            rx_hdr_port_map_idx = port_map_vec[32*(port_map_index-1)+16 +: log2(MAX_UDP_PORTS)];
+        end
+    end
+end
+
+// index of the rx buffer of an incoming header (computed as the port filter does)
+assign rx_hdr_buffer_idx      = rx_hdr_port_mapped ? rx_hdr_port_map_idx : rx_hdr_dest_port - udp_port_range_l[15:00];
+assign rx_hdr_buffer_in_shmem = rx_hdr_buffer_idx < rx_buffers;
+
+assign dma_wr_ctrl_addr_o = rx_desc_mode ? rx_desc_free_addr  : 
+                            rx_pack_mode ? rx_pack_wr_addr    : buffer_rx_selected_next_slot_addr;
 
 wire [DMA_LEN_WIDTH-1: 00] packet_length_bytes;
-assign packet_length_bytes = rx_hdr_udp_length + HEADER_NUM_WORDS*8; // the header takes 5 8-byte words
+// the header takes 5 8-byte words; rx_hdr_udp_length counts 8 extra bytes, taken by the trailer word 
+// placed after the payload, which is padded to a multiple of 8 bytes
+assign packet_length_bytes = {rx_hdr_udp_length[15:3] + (rx_hdr_udp_length[2:0] != 0), 3'b000} + HEADER_NUM_WORDS*8;
 always @ (*) begin
-    if (packet_length_bytes <= BUFFER_ELEM_MAX_SIZE) dma_wr_ctrl_len_bytes_o <= packet_length_bytes;
-    else                                             dma_wr_ctrl_len_bytes_o <= BUFFER_ELEM_MAX_SIZE;
+    if (packet_length_bytes <= slot_size_bytes) dma_wr_ctrl_len_bytes_o <= packet_length_bytes;
+    else                                        dma_wr_ctrl_len_bytes_o <= slot_size_bytes;
+end
+
+/**********************************************************************************
+* Rx packed rings (packed mode)
+*   - Head and tail are free-running line counters (rings are a power of two lines long)
+*   - A packet never wraps around the ring: when less than a slot is left before the end of
+*     the ring, the packet is written at its start instead. The PS applies the same rule
+*   - Room for the packet is checked along with its port (port filter) and the pointers are
+*     latched when its header is accepted. The head is only moved once the packet has been
+*     written, so the next packet is held until then (see dma_done_i at the port filter)
+**********************************************************************************/
+
+localparam RXPACK_LINE_LOG2 = 6;       // 64-byte lines
+localparam RXPACK_RING_LINES_MAX = 1 << 15; // rings take up to the first 2MB of their rx buffer
+
+wire [23:00] rx_pack_buffer_lines;
+wire [15:00] rx_pack_ring_lines;
+wire [15:00] rx_pack_slot_lines;
+assign rx_pack_buffer_lines = (rx_ring_length_arr[rx_hdr_buffer_idx] << slot_size_log2) >> RXPACK_LINE_LOG2;
+assign rx_pack_ring_lines   = (rx_pack_buffer_lines > RXPACK_RING_LINES_MAX) ? RXPACK_RING_LINES_MAX : rx_pack_buffer_lines;
+assign rx_pack_slot_lines = slot_size_bytes >> RXPACK_LINE_LOG2;
+
+reg  [15:00] rx_pack_head_arr [0 : MAX_UDP_PORTS-1];
+wire [15:00] rx_pack_tail_arr [0 : MAX_UDP_PORTS-1];
+
+wire [MAX_UDP_PORTS*16-1 : 0] rx_pack_tail_vec;
+
+genvar rx_pack_vec_index;
+generate
+    for (rx_pack_vec_index = 0; rx_pack_vec_index < MAX_UDP_PORTS; rx_pack_vec_index = rx_pack_vec_index + 1) begin
+        assign rx_pack_tail_arr[rx_pack_vec_index] = rx_pack_tail_vec[(rx_pack_vec_index+1)*16-1 : rx_pack_vec_index*16];
+    end
+endgenerate
+
+// Room check for the header at the port filter
+
+wire [15:00] rx_pack_head     ;
+wire [15:00] rx_pack_offset   ;
+wire [15:00] rx_pack_skip     ;
+wire [15:00] rx_pack_rec_lines;
+wire [15:00] rx_pack_used     ;
+wire         rx_pack_available;
+
+assign rx_pack_head      = rx_pack_head_arr[rx_hdr_buffer_idx];
+assign rx_pack_offset    = rx_pack_head & (rx_pack_ring_lines - 1);
+assign rx_pack_skip      = (rx_pack_ring_lines - rx_pack_offset < rx_pack_slot_lines) ? rx_pack_ring_lines - rx_pack_offset : 0;
+assign rx_pack_rec_lines = (dma_wr_ctrl_len_bytes_o + (1 << RXPACK_LINE_LOG2) - 1) >> RXPACK_LINE_LOG2;
+assign rx_pack_used      = rx_pack_head - rx_pack_tail_arr[rx_hdr_buffer_idx];
+assign rx_pack_available = rx_pack_ring_lines - rx_pack_used >= rx_pack_skip + rx_pack_rec_lines;
+
+// Packet in flight: from header acceptance to the end of the DMA write
+
+reg         rx_pack_busy;
+reg [15:00] rx_pack_wr_line;
+reg [15:00] rx_pack_next_head;
+wire        rx_pack_pushed;
+wire        rx_pack_hdr_accepted;
+
+assign rx_pack_pushed       = rx_pack_mode && dma_wr_ctrl_pushed_i;
+assign rx_pack_hdr_accepted = rx_pack_mode && rx_hdr_valid && rx_hdr_ready && valid_udp_port;
+
+always @ (posedge clk_i) begin
+    if      (rst_global          ) rx_pack_busy <= 0;
+    else if (rx_pack_hdr_accepted) rx_pack_busy <= 1;
+    else if (rx_pack_pushed      ) rx_pack_busy <= 0;
+end
+
+always @ (posedge clk_i) begin
+    if (rx_pack_hdr_accepted) begin
+        rx_pack_wr_line   <= (rx_pack_head + rx_pack_skip) & (rx_pack_ring_lines - 1);
+        rx_pack_next_head <= rx_pack_head + rx_pack_skip + rx_pack_rec_lines;
+    end
 end
 
+// On reset, rings start empty wherever the PS left their tail
+
+reg [log2(MAX_UDP_PORTS) : 0] rx_pack_index;
+always @ (posedge clk_i) begin
+    for (rx_pack_index = 0; rx_pack_index < MAX_UDP_PORTS; rx_pack_index = rx_pack_index + 1) begin
+        if      (rst_global || rx_rings_rst                          ) rx_pack_head_arr[rx_pack_index] <= rx_pack_tail_arr[rx_pack_index];
+        else if (rx_pack_pushed && rx_pack_index == buffer_select_idx) rx_pack_head_arr[rx_pack_index] <= rx_pack_next_head;
+    end
+end
+
+wire [DMA_ADDR_WIDTH-1 : 00] rx_pack_wr_addr;
+assign rx_pack_wr_addr = buffer_rx_selected_base_addr + (rx_pack_wr_line << RXPACK_LINE_LOG2);
+
 /**********************************************************************************
 * DMA read (UDP tx) control
+*   - Each tx slot is fetched with two reads: first the header, then only the payload bytes
+*   - The header words are captured while they are streamed to the header remover in order to
+*     locate the payload (in the slot, right after the header, or at an external address)
 **********************************************************************************/
 
-reg dma_rd_locked;
-wire dma_rd_unlock_condition;
-assign dma_rd_unlock_condition = dma_rd_data_axis_tlast && dma_rd_data_axis_tvalid && dma_rd_data_axis_tready;
-wire dma_rd_lock_condition;
-assign dma_rd_lock_condition = dma_rd_ctrl_valid_o && dma_rd_ctrl_ready_i;
+localparam HEADER_SIZE_BYTES = HEADER_NUM_WORDS*8;
+
+wire [DMA_LEN_WIDTH-1 : 00] payload_max_size;
+assign payload_max_size = slot_size_bytes - HEADER_SIZE_BYTES;
+
+localparam
+    DMA_RD_STATE_IDLE        = 3'd0,
+    DMA_RD_STATE_HEADER_REQ  = 3'd1,
+    DMA_RD_STATE_HEADER      = 3'd2,
+    DMA_RD_STATE_PAYLOAD_REQ = 3'd3,
+    DMA_RD_STATE_PAYLOAD     = 3'd4;
+reg [2:0] dma_rd_state;
+
+wire dma_rd_req_accepted;
+wire dma_rd_data_beat;
+wire dma_rd_data_last;
+assign dma_rd_req_accepted = dma_rd_ctrl_valid_o && dma_rd_ctrl_ready_i;
+assign dma_rd_data_beat    = dma_rd_data_axis_tvalid && dma_rd_data_axis_tready;
+assign dma_rd_data_last    = dma_rd_data_beat && dma_rd_data_axis_tlast;
+
 always @ (posedge clk_i) begin
-    if      (rst_global || dma_rd_unlock_condition) dma_rd_locked = 0;
-    else if (dma_rd_lock_condition                ) dma_rd_locked = 1;
+    if (rst_global) 
+        dma_rd_state <= DMA_RD_STATE_IDLE;
+    else begin
+        case (dma_rd_state)
+            DMA_RD_STATE_IDLE        : if (txq_ready           ) dma_rd_state <= DMA_RD_STATE_HEADER_REQ;
+            DMA_RD_STATE_HEADER_REQ  : if (dma_rd_req_accepted ) dma_rd_state <= DMA_RD_STATE_HEADER;
+            DMA_RD_STATE_HEADER      : if (dma_rd_data_last    ) dma_rd_state <= DMA_RD_STATE_PAYLOAD_REQ;
+            DMA_RD_STATE_PAYLOAD_REQ : if (dma_rd_req_accepted ) dma_rd_state <= DMA_RD_STATE_PAYLOAD;
+            DMA_RD_STATE_PAYLOAD     : if (dma_rd_data_last    ) dma_rd_state <= DMA_RD_STATE_IDLE;
+            default                  :                           dma_rd_state <= DMA_RD_STATE_IDLE;
+        endcase
+    end
+end
+
+// One request per state: valid drops as soon as the request is accepted
+always @ (*) begin
+    dma_rd_ctrl_valid_o <= (dma_rd_state == DMA_RD_STATE_HEADER_REQ || dma_rd_state == DMA_RD_STATE_PAYLOAD_REQ);
 end
+
+// Header capture: {ext flag, timestamp flag, launch flag, payload length} from word 0, external payload
+// address from words 1 (lower 32 bits) and 2 (upper 32 bits), launch time from word 4
+
+reg [log2(HEADER_NUM_WORDS):0] dma_rd_header_count;
+reg [15:00]                    tx_payload_length;
+reg                            tx_payload_ext;
+reg [63:00]                    tx_payload_ext_addr;
+
 always @ (posedge clk_i) begin
-    if      (rst_global || dma_rd_locked) dma_rd_ctrl_valid_o = 0;
-    else if (!circbuff_tx_empty         ) dma_rd_ctrl_valid_o = 1;
+    if      (rst_global || dma_rd_state != DMA_RD_STATE_HEADER) dma_rd_header_count <= 0;
+    else if (dma_rd_data_beat                                 ) dma_rd_header_count <= dma_rd_header_count + 1;
+end
+
+always @ (posedge clk_i) begin
+    if (dma_rd_state == DMA_RD_STATE_HEADER && dma_rd_data_beat && dma_rd_header_count == 0) begin
+        tx_payload_length <= dma_rd_data_axis_tdata[15:00];
+        tx_payload_ext    <= dma_rd_data_axis_tdata[63];
+        tx_timestamp_req  <= dma_rd_data_axis_tdata[62];
+        tx_launch_req     <= dma_rd_data_axis_tdata[61];
+    end
+    if (dma_rd_state == DMA_RD_STATE_HEADER && dma_rd_data_beat && dma_rd_header_count == 1) begin
+        tx_payload_ext_addr[31:00] <= dma_rd_data_axis_tdata[63:32];
+    end
+    if (dma_rd_state == DMA_RD_STATE_HEADER && dma_rd_data_beat && dma_rd_header_count == 2) begin
+        tx_payload_ext_addr[63:32] <= dma_rd_data_axis_tdata[63:32];
+    end
+    if (dma_rd_state == DMA_RD_STATE_HEADER && dma_rd_data_beat && dma_rd_header_count == 4) begin
+        tx_launch_time <= dma_rd_data_axis_tdata[63:16];
+    end
 end
 
 wire [DMA_ADDR_WIDTH-1 : 00] circbuff_tx_base_addr;
 reg [DMA_ADDR_WIDTH-1 : 00] buffer_tx_next_slot_addr;
-assign circbuff_tx_base_addr = shared_mem_base_address + BUFFER_SIZE_BYTES * MAX_UDP_PORTS;
-always @(posedge clk_i) buffer_tx_next_slot_addr <= circbuff_tx_base_addr + circbuff_tx_tail_index * BUFFER_ELEM_MAX_SIZE; 
+assign circbuff_tx_base_addr = (tx_buffer_base != 0) ? shared_mem_base_address + (tx_buffer_base << slot_size_log2) :
+                                                       shared_mem_base_address + ((rx_buffers * BUFFER_RX_LENGTH) << slot_size_log2);
+always @(posedge clk_i) buffer_tx_next_slot_addr <= circbuff_tx_base_addr + (((txq_sel * BUFFER_TX_LENGTH) + txq_tail_index_arr[txq_sel]) << slot_size_log2); 
 
-assign dma_rd_ctrl_addr_o = buffer_tx_next_slot_addr;
-assign dma_rd_ctrl_len_bytes_o = BUFFER_ELEM_MAX_SIZE; // Always reads the whole buffer slot regardless the actual packet size
+reg [DMA_ADDR_WIDTH-1 : 00] dma_rd_ctrl_addr;
+reg [DMA_LEN_WIDTH-1  : 00] dma_rd_ctrl_len_bytes;
+always @ (*) begin
+    if (dma_rd_state == DMA_RD_STATE_HEADER_REQ) begin
+        dma_rd_ctrl_addr      <= buffer_tx_next_slot_addr;
+        dma_rd_ctrl_len_bytes <= HEADER_SIZE_BYTES;
+    end else begin
+        if (tx_payload_ext) dma_rd_ctrl_addr <= tx_payload_ext_addr[DMA_ADDR_WIDTH-1 : 00];
+        else                dma_rd_ctrl_addr <= buffer_tx_next_slot_addr + HEADER_SIZE_BYTES;
+        // the payload read cannot be empty (the header remover waits for tlast)
+        if      (tx_payload_length == 0               ) dma_rd_ctrl_len_bytes <= 1;
+        else if (tx_payload_length > payload_max_size ) dma_rd_ctrl_len_bytes <= payload_max_size;
+        else                                            dma_rd_ctrl_len_bytes <= tx_payload_length;
+    end
+end
+
+assign dma_rd_ctrl_addr_o = dma_rd_ctrl_addr;
+assign dma_rd_ctrl_len_bytes_o = dma_rd_ctrl_len_bytes;
+
+/**********************************************************************************
+* Performance counters
+*   - Free-running 32-bit counters (they wrap around), cleared on reset like the rest of the core.
+*     Rates are measured by reading them twice
+*   - Rx frames accepted by the port filter, dropped for a closed or out-of-range port, or dropped
+*     for lack of room (full rx ring, no posted descriptor or no room in a packed ring)
+*   - DMA write busy: from the first data beat to the end of the transfer (see rx_busy). Stalled:
+*     data held back by the DMA write (tvalid without tready)
+*   - DMA read busy: while a tx slot is being fetched. Stalled: waiting for the request to be
+*     accepted or for data from memory
+*   - Rx header stall: headers held back by the core (hdr_valid without hdr_ready)
+*   - Max ring occupancy: highest fill level reached by a ring when a packet is written to it
+*     (in slots, in lines in packed mode, in pending completions in descriptor mode)
+**********************************************************************************/
+
+reg [15:00] perf_rx_ring_level;
+always @ (*) begin
+    if      (rx_desc_pushed      ) perf_rx_ring_level = rx_desc_compl_count + 1;
+    else if (rx_pack_hdr_accepted) perf_rx_ring_level = rx_pack_used + rx_pack_skip + rx_pack_rec_lines;
+    else if (dma_wr_ctrl_pushed_i && !rx_pack_mode) 
+        perf_rx_ring_level = ((circbuff_rx_head_index_arr[buffer_select_idx] - circbuff_rx_tail_index_arr[buffer_select_idx]) & 
+                              (rx_ring_length_arr[buffer_select_idx] - 1)) + 1;
+    else                           perf_rx_ring_level = 0;
+end
+
+wire perf_dma_rd_stalled;
+assign perf_dma_rd_stalled = (dma_rd_ctrl_valid_o && !dma_rd_ctrl_ready_i) || 
+                             ((dma_rd_state == DMA_RD_STATE_HEADER || dma_rd_state == DMA_RD_STATE_PAYLOAD) && !dma_rd_data_axis_tvalid);
+
+always @ (posedge clk_i) begin
+    if (rst_global) begin
+        perf_rx_frames      <= 0;
+        perf_rx_drop_closed <= 0;
+        perf_rx_drop_full   <= 0;
+        perf_tx_frames      <= 0;
+        perf_dma_wr_busy    <= 0;
+        perf_dma_wr_stall   <= 0;
+        perf_dma_rd_busy    <= 0;
+        perf_dma_rd_stall   <= 0;
+        perf_rx_hdr_stall   <= 0;
+        perf_rx_ring_max    <= 0;
+    end else begin
+        if (rx_accepted                                      ) perf_rx_frames      <= perf_rx_frames + 1;
+        if (rx_port_dropped                                  ) perf_rx_drop_closed <= perf_rx_drop_closed + 1;
+        if (rx_full_dropped                                  ) perf_rx_drop_full   <= perf_rx_drop_full + 1;
+        if (circbuff_tx_data_popped                          ) perf_tx_frames      <= perf_tx_frames + 1;
+        if (rx_busy                                          ) perf_dma_wr_busy    <= perf_dma_wr_busy + 1;
+        if (dma_wr_data_axis_tvalid && !dma_wr_data_axis_tready) perf_dma_wr_stall <= perf_dma_wr_stall + 1;
+        if (dma_rd_state != DMA_RD_STATE_IDLE                ) perf_dma_rd_busy    <= perf_dma_rd_busy + 1;
+        if (perf_dma_rd_stalled                              ) perf_dma_rd_stall   <= perf_dma_rd_stall + 1;
+        if (rx_hdr_valid && !rx_hdr_ready                    ) perf_rx_hdr_stall   <= perf_rx_hdr_stall + 1;
+        if (perf_rx_ring_level > perf_rx_ring_max            ) perf_rx_ring_max    <= perf_rx_ring_level;
+    end
+end
 
 endmodule
\ No newline at end of file
@@ -33,11 +33,14 @@ THE SOFTWARE.
 **********************************************************************************/
 
 module ctrl_axi_regs #(
-    parameter C_S_AXI_ADDR_WIDTH   = 14, // 2^14 = 16KB; needed to handle 1024 rx buffers
+    parameter C_S_AXI_ADDR_WIDTH   = 15, // 2^15 = 32KB; needed to handle 1024 rx buffers and their config regs
     parameter C_S_AXI_DATA_WIDTH   = 32,
     parameter C_BUFFRX_INDEX_WIDTH = 5,
     parameter C_BUFFTX_INDEX_WIDTH = 5,
-    parameter C_MAX_UDP_PORTS      = 1024
+    parameter C_MAX_UDP_PORTS      = 1024,
+    parameter C_TX_QUEUES          = 4,
+    parameter C_PORT_MAP_ENTRIES   = 32,
+    parameter C_DMA_ADDR_WIDTH     = 32
 ) (
     input    wire                               clk_i           ,
     input    wire                               rst_i           ,
@@ -82,6 +85,8 @@ module ctrl_axi_regs #(
     input    wire  [C_MAX_UDP_PORTS                     -1 : 0 ] bufrx_pushed_i   ,
     output   wire  [C_MAX_UDP_PORTS                     -1 : 0 ] bufrx_popped_o   ,
     output   wire  [C_MAX_UDP_PORTS                     -1 : 0 ] bufrx_opensock_o ,
+    input    wire  [C_MAX_UDP_PORTS*16                  -1 : 0 ] bufrx_pack_head_i,
+    output   wire  [C_MAX_UDP_PORTS*16                  -1 : 0 ] bufrx_pack_tail_o,
 
     input    wire                               bufrx_push_irq_i  ,
     input    wire  [C_BUFFTX_INDEX_WIDTH : 0]   buftx_head_i      ,
@@ -89,7 +94,52 @@ module ctrl_axi_regs #(
     input    wire                               buftx_empty_i     ,
     input    wire                               buftx_full_i      ,
     output   wire                               buftx_pushed_o    ,
-    input    wire                               buftx_popped_i    
+    input    wire                               buftx_popped_i    ,
+
+    output   wire                               rxdesc_mode_o      ,
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   rxdesc_post_addr_o ,
+    output   wire                               rxdesc_post_o      ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   rxdesc_free_count_i,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   rxdesc_compl_i     ,
+    output   wire                               rxdesc_compl_pop_o ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   rx_frag_drops_i    ,
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   slot_size_o        ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   slot_size_max_i    ,
+    output   wire                               rxpack_mode_o      ,
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   rx_buffers_o       ,
+    output   wire  [C_S_AXI_DATA_WIDTH*C_MAX_UDP_PORTS-1 : 0] bufrx_cfg_o,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   rx_depth_max_i     ,
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   tx_buffer_base_o   ,
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   txq_ctrl_o         ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   txq_num_i          ,
+    input    wire  [C_S_AXI_DATA_WIDTH*C_TX_QUEUES-1 : 0] txq_status_i,
+    output   wire  [C_TX_QUEUES-1 : 0]          txq_pushed_o       ,
+    output   wire  [C_S_AXI_DATA_WIDTH*C_TX_QUEUES-1 : 0] txq_weight_o,
+    output   wire  [C_S_AXI_DATA_WIDTH*C_TX_QUEUES-1 : 0] txq_rate_o,
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   irq_coal_frames_o  ,
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   irq_coal_usecs_o   ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_rx_frames_i   ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_rx_drop_closed_i,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_rx_drop_full_i,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_tx_frames_i   ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_dma_wr_busy_i ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_dma_wr_stall_i,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_dma_rd_busy_i ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_dma_rd_stall_i,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_rx_hdr_stall_i,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   perf_rx_ring_max_i ,
+    output   wire                               rx_rings_rst_o     ,
+    output   wire  [C_S_AXI_DATA_WIDTH*C_PORT_MAP_ENTRIES-1 : 0] port_map_o,
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   shared_mem_hi_o    ,
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   rxdesc_post_addr_hi_o,
+    input    wire  [2*C_S_AXI_DATA_WIDTH-1 : 0] timestamp_i        ,
+    input    wire  [2*C_S_AXI_DATA_WIDTH-1 : 0] tx_ts_i            ,
+    output   wire                               tx_ts_pop_o        ,
+    input    wire  [C_S_AXI_DATA_WIDTH-1 : 0]   timestamp_incr_i   ,
+    output   wire  [C_S_AXI_DATA_WIDTH-1 : 0]   timestamp_incr_o   ,
+    output   wire  [2*C_S_AXI_DATA_WIDTH-1 : 0] timestamp_load_o   ,
+    output   wire                               timestamp_set_o    ,
+    output   wire                               timestamp_adj_o
 );
 
 /**********************************************************************************
@@ -106,9 +156,12 @@ localparam BUFFER_HEAD_OFFSET     = BUFFER_TAIL_UPPER + 1;
 localparam BUFFER_HEAD_UPPER      = BUFFER_HEAD_OFFSET + C_BUFFRX_INDEX_WIDTH - 1;
 localparam BUFFER_OPENSOCK_OFFSET = BUFFER_HEAD_UPPER + 1;
 localparam BUFFER_DUMMY_OFFSET    = BUFFER_OPENSOCK_OFFSET + 1;
-localparam BUFFER_DUMMY_UPPER     = C_S_AXI_DATA_WIDTH - 1;
+localparam BUFFER_DUMMY_UPPER     = 15;
+localparam BUFFER_PACK_OFFSET     = 16; // packed ring pointers (16 bits), see controller
+localparam BUFFER_PACK_UPPER      = C_S_AXI_DATA_WIDTH - 1;
 
 wire [C_S_AXI_DATA_WIDTH*C_MAX_UDP_PORTS-1 : 0] buffer_rx_vector;
+wire [C_MAX_UDP_PORTS-1 : 0]                    bufrx_opensock_map; // a socket is open if set in its bufrx control reg or in the open socket bitmap
 genvar buffer_index;
 generate
     for (buffer_index = 0; buffer_index < C_MAX_UDP_PORTS; buffer_index = buffer_index + 1) begin
@@ -119,6 +172,7 @@ generate
         assign buffer_rx_vector[C_S_AXI_DATA_WIDTH*buffer_index + BUFFER_TAIL_UPPER  : C_S_AXI_DATA_WIDTH*buffer_index + BUFFER_TAIL_OFFSET ] = bufrx_tail_i  [C_BUFFRX_INDEX_WIDTH*(buffer_index+1) - 1 : C_BUFFRX_INDEX_WIDTH*buffer_index];
         assign buffer_rx_vector[C_S_AXI_DATA_WIDTH*buffer_index + BUFFER_HEAD_UPPER  : C_S_AXI_DATA_WIDTH*buffer_index + BUFFER_HEAD_OFFSET ] = bufrx_head_i  [C_BUFFRX_INDEX_WIDTH*(buffer_index+1) - 1 : C_BUFFRX_INDEX_WIDTH*buffer_index];
         assign buffer_rx_vector[C_S_AXI_DATA_WIDTH*buffer_index + BUFFER_DUMMY_UPPER : C_S_AXI_DATA_WIDTH*buffer_index + BUFFER_DUMMY_OFFSET] = 0;
+        assign buffer_rx_vector[C_S_AXI_DATA_WIDTH*buffer_index + BUFFER_PACK_UPPER  : C_S_AXI_DATA_WIDTH*buffer_index + BUFFER_PACK_OFFSET ] = 0; // dedicated ports
         // Outputs
         pulse_on_posedge pulse_bufrx_popped (
             .clk_i (clk_i ),
@@ -126,7 +180,7 @@ generate
             .signal_rising_i (buffer_rx_vector[C_S_AXI_DATA_WIDTH*buffer_index + BUFFER_POPPED_OFFSET ]),
             .signal_pulse_o  (bufrx_popped_o[buffer_index])
         );
-        assign bufrx_opensock_o[buffer_index] = buffer_rx_vector[C_S_AXI_DATA_WIDTH*buffer_index + BUFFER_OPENSOCK_OFFSET ];
+        assign bufrx_opensock_o[buffer_index] = buffer_rx_vector[C_S_AXI_DATA_WIDTH*buffer_index + BUFFER_OPENSOCK_OFFSET ] | bufrx_opensock_map[buffer_index];
     end
 endgenerate
 
@@ -142,6 +196,9 @@ config_regs_AXI_Manager #(
     .C_BUFFRX_INDEX_WIDTH   (C_BUFFRX_INDEX_WIDTH  ),
     .C_BUFFTX_INDEX_WIDTH   (C_BUFFTX_INDEX_WIDTH  ),        
     .C_MAX_UDP_PORTS        (C_MAX_UDP_PORTS       ),
+    .C_TX_QUEUES            (C_TX_QUEUES           ),
+    .C_PORT_MAP_ENTRIES     (C_PORT_MAP_ENTRIES    ),
+    .C_DMA_ADDR_WIDTH       (C_DMA_ADDR_WIDTH      ),
     .BUFFER_POPPED_OFFSET   (BUFFER_POPPED_OFFSET  ),
     .BUFFER_PUSHED_OFFSET   (BUFFER_PUSHED_OFFSET  ),
     .BUFFER_FULL_OFFSET     (BUFFER_FULL_OFFSET    ),
@@ -152,7 +209,9 @@ config_regs_AXI_Manager #(
     .BUFFER_HEAD_UPPER      (BUFFER_HEAD_UPPER     ),
     .BUFFER_OPENSOCK_OFFSET (BUFFER_OPENSOCK_OFFSET),
     .BUFFER_DUMMY_OFFSET    (BUFFER_DUMMY_OFFSET   ),
-    .BUFFER_DUMMY_UPPER     (BUFFER_DUMMY_UPPER    )
+    .BUFFER_DUMMY_UPPER     (BUFFER_DUMMY_UPPER    ),
+    .BUFFER_PACK_OFFSET     (BUFFER_PACK_OFFSET    ),
+    .BUFFER_PACK_UPPER      (BUFFER_PACK_UPPER     )
 ) config_regs_AXI_Manager_inst (
     .clk                (clk_i  ),
     .res_n              (~rst_i ),
@@ -187,13 +246,60 @@ config_regs_AXI_Manager #(
     .udp_port_range_h_o (udp_port_range_h_o ),
     .shared_mem_o       (shared_mem_o       ),
     .buffer_rx_vector_io(buffer_rx_vector   ),
+    .bufrx_pack_head_i  (bufrx_pack_head_i  ),
+    .bufrx_pack_tail_o  (bufrx_pack_tail_o  ),
     .bufrx_push_irq_i   (bufrx_push_irq_i   ),
     .buftx_head_i       (buftx_head_i       ),
     .buftx_tail_i       (buftx_tail_i       ),
     .buftx_empty_i      (buftx_empty_i      ),
     .buftx_full_i       (buftx_full_i       ),
     .buftx_pushed_o     (buftx_pushed_temp  ),
-    .buftx_popped_i     (buftx_popped_i     )
+    .buftx_popped_i     (buftx_popped_i     ),
+    .rxdesc_mode_o      (rxdesc_mode_o      ),
+    .rxdesc_post_addr_o (rxdesc_post_addr_o ),
+    .rxdesc_post_o      (rxdesc_post_o      ),
+    .rxdesc_free_count_i(rxdesc_free_count_i),
+    .rxdesc_compl_i     (rxdesc_compl_i     ),
+    .rxdesc_compl_pop_o (rxdesc_compl_pop_o ),
+    .rx_frag_drops_i    (rx_frag_drops_i    ),
+    .slot_size_o        (slot_size_o        ),
+    .slot_size_max_i    (slot_size_max_i    ),
+    .rxpack_mode_o      (rxpack_mode_o      ),
+    .rx_buffers_o       (rx_buffers_o       ),
+    .bufrx_cfg_o        (bufrx_cfg_o        ),
+    .rx_depth_max_i     (rx_depth_max_i     ),
+    .tx_buffer_base_o   (tx_buffer_base_o   ),
+    .txq_ctrl_o         (txq_ctrl_o         ),
+    .txq_num_i          (txq_num_i          ),
+    .txq_status_i       (txq_status_i       ),
+    .txq_pushed_o       (txq_pushed_o       ),
+    .txq_weight_o       (txq_weight_o       ),
+    .txq_rate_o         (txq_rate_o         ),
+    .irq_coal_frames_o  (irq_coal_frames_o  ),
+    .irq_coal_usecs_o   (irq_coal_usecs_o   ),
+    .perf_rx_frames_i   (perf_rx_frames_i   ),
+    .perf_rx_drop_closed_i(perf_rx_drop_closed_i),
+    .perf_rx_drop_full_i(perf_rx_drop_full_i),
+    .perf_tx_frames_i   (perf_tx_frames_i   ),
+    .perf_dma_wr_busy_i (perf_dma_wr_busy_i ),
+    .perf_dma_wr_stall_i(perf_dma_wr_stall_i),
+    .perf_dma_rd_busy_i (perf_dma_rd_busy_i ),
+    .perf_dma_rd_stall_i(perf_dma_rd_stall_i),
+    .perf_rx_hdr_stall_i(perf_rx_hdr_stall_i),
+    .perf_rx_ring_max_i (perf_rx_ring_max_i ),
+    .bufrx_opensock_map_o(bufrx_opensock_map),
+    .rx_rings_rst_o     (rx_rings_rst_o     ),
+    .port_map_o         (port_map_o         ),
+    .shared_mem_hi_o    (shared_mem_hi_o    ),
+    .rxdesc_post_addr_hi_o (rxdesc_post_addr_hi_o),
+    .timestamp_i        (timestamp_i        ),
+    .tx_ts_i            (tx_ts_i            ),
+    .tx_ts_pop_o        (tx_ts_pop_o        ),
+    .timestamp_incr_i   (timestamp_incr_i   ),
+    .timestamp_incr_o   (timestamp_incr_o   ),
+    .timestamp_load_o   (timestamp_load_o   ),
+    .timestamp_set_o    (timestamp_set_o    ),
+    .timestamp_adj_o    (timestamp_adj_o    )
 );
 
 /**********************************************************************************
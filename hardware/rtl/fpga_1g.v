@@ -36,7 +36,7 @@ module fpga #
 (
     // AXI interface configuration (DMA)
     parameter AXI_DATA_WIDTH = 128,
-    parameter AXI_ADDR_WIDTH = 32,
+    parameter AXI_ADDR_WIDTH = 64,
     parameter AXI_STRB_WIDTH = (AXI_DATA_WIDTH/8),
     parameter AXI_ID_WIDTH = 8,
 
@@ -51,9 +51,11 @@ module fpga #
     parameter AXIL_APP_CTRL_STRB_WIDTH = (AXIL_APP_CTRL_DATA_WIDTH/8),
 
     parameter BUFFER_RX_LENGTH      = 32,
+    parameter BUFFER_RX_LENGTH_MAX  = 256,
     parameter BUFFER_TX_LENGTH      = 32,
     parameter BUFFER_ELEM_MAX_SIZE  = 2*1024,
-    parameter MAX_UDP_PORTS         = 1024
+    parameter MAX_UDP_PORTS         = 1024,
+    parameter TX_QUEUES             = 4
 )
 (
     // Clock: 25 MHz LVCMOS18
@@ -85,7 +87,7 @@ module fpga #
     input  wire         fpga_core_axi_aclk     ,  // just for Vivado integrator to infer clock/reset for axi interface
     input  wire         fpga_core_axi_aresetn  ,  // just for Vivado integrator to infer clock/reset for axi interface
     output wire [00:00] fpga_core_axi_arid     ,
-    output wire [31:00] fpga_core_axi_araddr   ,
+    output wire [AXI_ADDR_WIDTH-1:00] fpga_core_axi_araddr   ,
     output wire [07:00] fpga_core_axi_arlen    ,
     output wire [02:00] fpga_core_axi_arsize   ,
     output wire [01:00] fpga_core_axi_arburst  ,
@@ -101,7 +103,7 @@ module fpga #
     input  wire         fpga_core_axi_rvalid   ,
     output wire         fpga_core_axi_rready   ,
     output wire [00:00] fpga_core_axi_awid     ,
-    output wire [31:00] fpga_core_axi_awaddr   ,
+    output wire [AXI_ADDR_WIDTH-1:00] fpga_core_axi_awaddr   ,
     output wire [07:00] fpga_core_axi_awlen    ,
     output wire [02:00] fpga_core_axi_awsize   ,
     output wire [01:00] fpga_core_axi_awburst  ,
@@ -512,9 +514,12 @@ assign phy_mdio = mdio_t ? 1'bz : mdio_o;
 fpga_core #(
     .TARGET("XILINX"),
     .BUFFER_RX_LENGTH     (BUFFER_RX_LENGTH    ),
+    .BUFFER_RX_LENGTH_MAX (BUFFER_RX_LENGTH_MAX),
     .BUFFER_TX_LENGTH     (BUFFER_TX_LENGTH    ),
     .BUFFER_ELEM_MAX_SIZE (BUFFER_ELEM_MAX_SIZE),
-    .MAX_UDP_PORTS        (MAX_UDP_PORTS       )
+    .MAX_UDP_PORTS        (MAX_UDP_PORTS       ),
+    .TX_QUEUES            (TX_QUEUES           ),
+    .AXI_ADDR_WIDTH       (AXI_ADDR_WIDTH      )
 ) core_inst (
     /*
      * Clock: 125MHz
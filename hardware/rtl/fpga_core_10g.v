@@ -36,9 +36,12 @@ THE SOFTWARE.
 module fpga_core #(
 
     parameter BUFFER_RX_LENGTH      = 32,
+    parameter BUFFER_RX_LENGTH_MAX  = 256,
     parameter BUFFER_TX_LENGTH      = 32,
-    parameter BUFFER_ELEM_MAX_SIZE  = 2*1024,
-    parameter MAX_UDP_PORTS         = 1024
+    parameter BUFFER_ELEM_MAX_SIZE  = 2*1024, // largest slot size selectable by the PS (16*1024 for 9000B MTU)
+    parameter MAX_UDP_PORTS         = 1024,
+    parameter TX_QUEUES             = 4, // tx rings arbitrated by the controller (strict priority or DWRR)
+    parameter AXI_ADDR_WIDTH        = 64 // DMA addresses (the shared memory may be placed anywhere the PS port reaches)
 
 ) (
     /*
@@ -69,7 +72,7 @@ module fpga_core #(
      * Master AXI (for udp rx/tx)
      */
     output wire [07:00] m_axi_arid   ,
-    output wire [31:00] m_axi_araddr ,
+    output wire [AXI_ADDR_WIDTH-1:00] m_axi_araddr ,
     output wire [07:00] m_axi_arlen  ,
     output wire [02:00] m_axi_arsize ,
     output wire [01:00] m_axi_arburst,
@@ -85,7 +88,7 @@ module fpga_core #(
     input  wire         m_axi_rvalid ,
     output wire         m_axi_rready ,     
     output wire [07:00] m_axi_awid   ,
-    output wire [31:00] m_axi_awaddr ,
+    output wire [AXI_ADDR_WIDTH-1:00] m_axi_awaddr ,
     output wire [07:00] m_axi_awlen  ,
     output wire [02:00] m_axi_awsize ,
     output wire [01:00] m_axi_awburst,
@@ -275,11 +278,10 @@ wire [31:00] local_ip           ;
 
 // Controller - axi_dma_rd: signals
 
-wire [31:00] dma_rd_ctrl_addr       ;
+wire [AXI_ADDR_WIDTH-1:00] dma_rd_ctrl_addr ;
 wire [19:00] dma_rd_ctrl_len_bytes  ;  
 wire         dma_rd_ctrl_valid      ;
 wire         dma_rd_ctrl_ready      ;
-wire         dma_rd_ctrl_popped     ;
 wire         dma_rd_data_axis_tready;
 wire         dma_rd_data_axis_tvalid;
 wire         dma_rd_data_axis_tlast ;
@@ -288,11 +290,12 @@ wire [07:00] dma_rd_data_axis_tkeep ;
 
 // Controller - axi_dma_wr: signals
 
-wire [31:00] dma_wr_ctrl_addr       ;
+wire [AXI_ADDR_WIDTH-1:00] dma_wr_ctrl_addr ;
 wire [19:00] dma_wr_ctrl_len_bytes  ;
 wire         dma_wr_ctrl_valid      ;
 wire         dma_wr_ctrl_ready      ;
 wire         dma_wr_ctrl_pushed     ;
+wire         dma_wr_desc_done       ;
 wire         dma_wr_data_axis_tready;
 wire         dma_wr_data_axis_tvalid;
 wire         dma_wr_data_axis_tlast ;
@@ -303,13 +306,16 @@ wire [07:00] dma_wr_data_axis_tkeep ;
  * eth_mac_10g_fifo: instantiation and logic
  **********************************************************************************/
 
+// frame fifos hold a whole frame: big enough for the largest slot (jumbo frames)
+localparam MAC_FIFO_DEPTH = BUFFER_ELEM_MAX_SIZE > 4096 ? BUFFER_ELEM_MAX_SIZE : 4096;
+
 eth_mac_10g_fifo #(
     .ENABLE_PADDING(1),
     .ENABLE_DIC(1),
     .MIN_FRAME_LENGTH(64),
-    .TX_FIFO_DEPTH(4096),
+    .TX_FIFO_DEPTH(MAC_FIFO_DEPTH),
     .TX_FRAME_FIFO(1),
-    .RX_FIFO_DEPTH(4096),
+    .RX_FIFO_DEPTH(MAC_FIFO_DEPTH),
     .RX_FRAME_FIFO(1)
 )
 eth_mac_10g_fifo_inst (
@@ -443,9 +449,15 @@ assign tx_ip_payload_axis_tuser = 0;
 assign tx_udp_ip_dscp = 0;
 assign tx_udp_ip_ecn = 0;
 assign tx_udp_ip_ttl = 64;
-assign tx_udp_checksum = 0;
+assign tx_udp_checksum = 0; // ignored, computed over the payload by the checksum generator
+
+// the UDP checksum generator holds a whole payload before sending the header: big enough for the largest slot
+localparam UDP_CHECKSUM_FIFO_DEPTH = BUFFER_ELEM_MAX_SIZE > 2048 ? BUFFER_ELEM_MAX_SIZE : 2048;
 
-udp_complete_64
+udp_complete_64 #(
+    .UDP_CHECKSUM_GEN_ENABLE(1),
+    .UDP_CHECKSUM_PAYLOAD_FIFO_DEPTH(UDP_CHECKSUM_FIFO_DEPTH)
+)
 udp_complete_inst (
     .clk(clk),
     .rst(rst),
@@ -587,17 +599,21 @@ udp_complete_inst (
  * Controller: instantiation and logic
  **********************************************************************************/
 
-assign dma_rd_ctrl_popped = m_axi_rlast & m_axi_rvalid & m_axi_rready; // data completely popped from buffer_tx
-assign dma_wr_ctrl_pushed = m_axi_wlast & m_axi_wvalid & m_axi_wready; // data completely pushed to buffer_rx
+// data completely pushed to buffer_rx. A slot larger than one burst takes several (one wlast each), 
+// so the end of the whole write descriptor is used instead
+assign dma_wr_ctrl_pushed = dma_wr_desc_done;
 
 controller #(
-    .DMA_ADDR_WIDTH       (32),
+    .DMA_ADDR_WIDTH       (AXI_ADDR_WIDTH),
     .DMA_LEN_WIDTH        (20),
     .BUFFER_RX_LENGTH     (BUFFER_RX_LENGTH),
+    .BUFFER_RX_LENGTH_MAX (BUFFER_RX_LENGTH_MAX),
     .BUFFER_TX_LENGTH     (BUFFER_TX_LENGTH),
     .BUFFER_ELEM_MAX_SIZE (BUFFER_ELEM_MAX_SIZE),
     .HEADER_NUM_WORDS     (5),
-    .MAX_UDP_PORTS        (MAX_UDP_PORTS)
+    .MAX_UDP_PORTS        (MAX_UDP_PORTS),
+    .TX_QUEUES            (TX_QUEUES),
+    .CLK_FREQ_MHZ         (156)
 ) controller_inst (
 
     // General
@@ -636,6 +652,15 @@ controller #(
     .rx_hdr_dest_ip         (rx_udp_ip_dest_ip          ),
     .rx_hdr_dest_port       (rx_udp_dest_port           ),
     .rx_hdr_udp_length      (rx_udp_length              ),
+    .rx_hdr_source_mac      (rx_udp_eth_src_mac         ),
+    .rx_hdr_ip_tos          ({rx_udp_ip_dscp, rx_udp_ip_ecn}),
+    .rx_hdr_ip_ttl          (rx_udp_ip_ttl              ),
+    .rx_hdr_ip_identification (rx_udp_ip_identification ),
+    .rx_hdr_ip_flags        (rx_udp_ip_flags            ),
+    .rx_hdr_ip_fragment_offset (rx_udp_ip_fragment_offset),
+    .rx_hdr_ip_ihl          (rx_udp_ip_ihl              ),
+    .rx_hdr_ip_header_checksum (rx_udp_ip_header_checksum),
+    .rx_hdr_udp_checksum    (rx_udp_checksum            ),
     .rx_payload_axis_tready (axis_udp_rx_payload_tready ),
     .rx_payload_axis_tvalid (axis_udp_rx_payload_tvalid ),
     .rx_payload_axis_tdata  (axis_udp_rx_payload_tdata  ),
@@ -661,7 +686,6 @@ controller #(
     .dma_rd_ctrl_len_bytes_o (dma_rd_ctrl_len_bytes  ),
     .dma_rd_ctrl_valid_o     (dma_rd_ctrl_valid      ),
     .dma_rd_ctrl_ready_i     (dma_rd_ctrl_ready      ),
-    .dma_rd_ctrl_popped_i    (dma_rd_ctrl_popped     ),
     .dma_rd_data_axis_tready (dma_rd_data_axis_tready),
     .dma_rd_data_axis_tvalid (dma_rd_data_axis_tvalid),
     .dma_rd_data_axis_tlast  (dma_rd_data_axis_tlast ),
@@ -680,7 +704,7 @@ controller #(
     .dma_wr_data_axis_tlast  (dma_wr_data_axis_tlast ),
     .dma_wr_data_axis_tdata  (dma_wr_data_axis_tdata ),
     .dma_wr_data_axis_tkeep  (dma_wr_data_axis_tkeep ),
-    .dma_wr_data_axi_last    (m_axi_wlast & m_axi_wready & m_axi_wvalid),
+    .dma_wr_data_axi_last    (dma_wr_desc_done       ),
     
     .buffer_rx_pushed_interr_o (buffer_rx_pushed_interr_o)
 );
@@ -691,7 +715,7 @@ controller #(
 
 axi_dma_wr #(
     .AXI_DATA_WIDTH    (64),
-    .AXI_ADDR_WIDTH    (32),
+    .AXI_ADDR_WIDTH    (AXI_ADDR_WIDTH),
     .AXI_ID_WIDTH      (1),
     .AXI_MAX_BURST_LEN (256),
     .AXIS_DATA_WIDTH   (64),
@@ -737,13 +761,14 @@ axi_dma_wr #(
     .m_axi_bresp                    (m_axi_bresp  ),
     .m_axi_bvalid                   (m_axi_bvalid ),
     .m_axi_bready                   (m_axi_bready ),
+    .m_axis_write_desc_status_valid (dma_wr_desc_done),
     .enable                         (1'b1 ),
     .abort                          (1'b0 )
 );
 
 axi_dma_rd #(
     .AXI_DATA_WIDTH    (64),
-    .AXI_ADDR_WIDTH    (32),
+    .AXI_ADDR_WIDTH    (AXI_ADDR_WIDTH),
     .AXI_ID_WIDTH      (1 ),
     .AXI_MAX_BURST_LEN (256),
     .AXIS_DATA_WIDTH   (64),
@@ -753,7 +778,8 @@ axi_dma_rd #(
     .AXIS_ID_ENABLE    (0 ),
     .AXIS_DEST_ENABLE  (0 ),
     .AXIS_USER_ENABLE  (1 ),
-    .AXIS_USER_WIDTH   (1 )   
+    .AXIS_USER_WIDTH   (1 ),
+    .ENABLE_UNALIGNED  (1 )  // tx payloads may be fetched from arbitrary (external) addresses
 ) axi_dma_rd_inst ( 
     .clk                            (clk ),
     .rst                            (rst ),
@@ -0,0 +1,88 @@
+/*
+
+Copyright (c) 2023 Juan Manuel Reina Muñoz
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+
+*/
+
+`resetall
+`timescale 1ns / 1ps
+`default_nettype none
+
+/**********************************************************************************
+ * sync fifo:
+ *   - Single-clock first-word-fall-through fifo (rd_data_o shows the oldest entry while !empty_o)
+ *   - Writes when full and reads when empty are ignored
+ *   - DEPTH must be a power of 2; count_o reports the number of stored entries
+ **********************************************************************************/
+
+module sync_fifo #(
+    parameter DATA_WIDTH  = 32,
+    parameter DEPTH       = 256,
+    parameter INDEX_WIDTH = 8 // log2(DEPTH)
+) (
+
+    input  wire clk_i ,
+    input  wire rst_i ,
+
+    input  wire                      wr_en_i   ,
+    input  wire [DATA_WIDTH-1  : 00] wr_data_i ,
+    input  wire                      rd_en_i   ,
+    output wire [DATA_WIDTH-1  : 00] rd_data_o ,
+    output wire                      full_o    ,
+    output wire                      empty_o   ,
+    output reg  [INDEX_WIDTH   : 00] count_o   
+ );
+
+/**********************************************************************************
+ * Main logic
+ **********************************************************************************/
+
+reg [DATA_WIDTH-1  : 00] mem [0 : DEPTH-1];
+reg [INDEX_WIDTH-1 : 00] wr_index;
+reg [INDEX_WIDTH-1 : 00] rd_index;
+
+wire do_write;
+wire do_read;
+assign do_write = wr_en_i && !full_o;
+assign do_read  = rd_en_i && !empty_o;
+
+assign full_o    = (count_o == DEPTH);
+assign empty_o   = (count_o == 0);
+assign rd_data_o = mem[rd_index];
+
+always @ (posedge clk_i) begin
+    if (do_write) mem[wr_index] <= wr_data_i;
+end
+
+always @ (posedge clk_i) begin
+    if (rst_i) begin
+        wr_index <= 0;
+        rd_index <= 0;
+        count_o  <= 0;
+    end else begin
+        if (do_write) wr_index <= wr_index + 1;
+        if (do_read ) rd_index <= rd_index + 1;
+        if      (do_write && !do_read) count_o <= count_o + 1;
+        else if (do_read && !do_write) count_o <= count_o - 1;
+    end
+end
+
+endmodule
@@ -63,8 +63,10 @@ class TB:
     def __init__(self, dut):
 
         self.dut = dut
+        self.dut.length_i.value      = 0 # BUFFER_LENGTH
         self.dut.data_pushed_i.value = 0
         self.dut.data_popped_i.value = 0
+        self.dut.flush_i.value       = 0
 
         self.log = SimLog("cocotb.tb")
         self.log.setLevel(logging.DEBUG)
@@ -119,6 +121,20 @@ class TB:
         else:
             self.log.info("Buffer is empty")
 
+    async def flush_buffer(self, data=None):
+        self.log.info("Flushing buffer" + ("" if data is None else " and pushing data: " + data) + " ...")
+        head_index = self.dut.head_index_o.value
+        self.buffer_data = [None for i in range(TB.BUFFER_LENGTH)]
+        if (data is not None and not self.dut.full_o.value):
+            self.buffer_data[head_index] = data
+            self.dut.data_pushed_i.value = 1
+        self.dut.flush_i.value = 1
+        await RisingEdge(self.dut.clk_i)
+        self.dut.flush_i.value = 0
+        self.dut.data_pushed_i.value = 0
+        await RisingEdge(self.dut.clk_i)
+        self.log.info("successfully flushed")
+
 ###################################################################################
 # Test: run_test_circular_buffer 
 # Stimulus: 
@@ -180,6 +196,112 @@ async def run_test_circular_buffer(dut):
 
     for _ in range(4): await RisingEdge(tb.dut.clk_i)
 
+###################################################################################
+# Test: run_test_circular_buffer_length
+# Stimulus: run-time length shorter than BUFFER_LENGTH (set during reset)
+# Expected: indexes wrap around at the run-time length
+###################################################################################
+
+@cocotb.test()
+async def run_test_circular_buffer_length(dut):
+
+    # Initialize TB with a run-time length of 2
+
+    tb = TB(dut)
+    tb.dut.length_i.value = 2
+    await tb.init()
+
+    tb.log.info("-----------------------------------------------------------------------")
+    tb.log.info("Initial state...")
+    tb.log.info("Buffer length: " + str(tb.dut.length_i.value))
+    tb.assert_buffer(buffer_content_expected=[None, None, None], empty_expected=1)
+    tb.log.info("-----------------------------------------------------------------------")
+
+    # 0 elements in buffer. Push 3 elements (only 2 should be actually pushed)
+
+    await tb.push_to_buffer("data0")
+    await tb.push_to_buffer("data1")
+    await tb.push_to_buffer("data2")
+    tb.buffer_print()
+    tb.assert_buffer(buffer_content_expected=["data0", "data1", None], head_expected=0, tail_expected=0, full_expected=1)
+    tb.log.info("-----------------------------------------------------------------------")
+
+    # 2 elements in buffer. Pop 1 element and push 1 element (head wraps around)
+
+    await tb.pop_from_buffer()
+    await tb.push_to_buffer("data3")
+    tb.buffer_print()
+    tb.assert_buffer(buffer_content_expected=["data3", "data1", None], head_expected=1, tail_expected=1, full_expected=1)
+    tb.log.info("-----------------------------------------------------------------------")
+
+    # 2 elements in buffer. Pop 2 elements (tail wraps around)
+
+    await tb.pop_from_buffer()
+    await tb.pop_from_buffer()
+    tb.buffer_print()
+    tb.assert_buffer(buffer_content_expected=[None, None, None], head_expected=1, tail_expected=1, empty_expected=1)
+    tb.log.info("-----------------------------------------------------------------------")
+
+    # Wait for some cycles at the end to improve waveform readability
+
+    for _ in range(4): await RisingEdge(tb.dut.clk_i)
+
+###################################################################################
+# Test: run_test_circular_buffer_flush
+# Stimulus: flush with some elements, with the buffer full and along with a push
+# Expected: tail jumps to head and the buffer is empty, except for the element
+#           pushed in the same cycle as the flush (kept)
+###################################################################################
+
+@cocotb.test()
+async def run_test_circular_buffer_flush(dut):
+
+    # Initialize TB
+
+    tb = TB(dut)
+    await tb.init()
+
+    # 0 elements in buffer. Push 2 elements and flush
+
+    await tb.push_to_buffer("data0")
+    await tb.push_to_buffer("data1")
+    tb.assert_buffer(buffer_content_expected=["data0", "data1", None], head_expected=2, tail_expected=0)
+    await tb.flush_buffer()
+    tb.buffer_print()
+    tb.assert_buffer(buffer_content_expected=[None, None, None], head_expected=2, tail_expected=2, empty_expected=1)
+    tb.log.info("-----------------------------------------------------------------------")
+
+    # 0 elements in buffer. Fill it up and flush
+
+    await tb.push_to_buffer("data2")
+    await tb.push_to_buffer("data3")
+    await tb.push_to_buffer("data4")
+    tb.assert_buffer(buffer_content_expected=["data3", "data4", "data2"], head_expected=2, tail_expected=2, full_expected=1)
+    await tb.flush_buffer()
+    tb.buffer_print()
+    tb.assert_buffer(buffer_content_expected=[None, None, None], head_expected=2, tail_expected=2, empty_expected=1)
+    tb.log.info("-----------------------------------------------------------------------")
+
+    # 0 elements in buffer. Push 1 element, then flush and push 1 element in the same cycle
+
+    await tb.push_to_buffer("data5")
+    tb.assert_buffer(buffer_content_expected=[None, None, "data5"], head_expected=0, tail_expected=2)
+    await tb.flush_buffer("data6")
+    tb.buffer_print()
+    tb.assert_buffer(buffer_content_expected=["data6", None, None], head_expected=1, tail_expected=0)
+    tb.log.info("-----------------------------------------------------------------------")
+
+    # 1 element in buffer. Pop it (the one pushed along with the flush)
+
+    await tb.pop_from_buffer()
+    tb.buffer_print()
+    tb.assert_buffer(buffer_content_expected=[None, None, None], head_expected=1, tail_expected=1, empty_expected=1)
+    tb.log.info("-----------------------------------------------------------------------")
+
+    # Wait for some cycles at the end to improve waveform readability
+
+    for _ in range(4): await RisingEdge(tb.dut.clk_i)
+
 ###################################################################################
 # cocotb-test: paths, cocotb and simulator definitions
 ###################################################################################
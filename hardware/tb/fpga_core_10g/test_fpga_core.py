@@ -73,6 +73,36 @@ class TB:
         "ADDR_BUFTX_POPPED_0_N_I"   : 0x00000090,
         "ADDR_BUFRX_PUSH_IRQ_0_IRQ" : 0x00000098,
         "ADDR_BUFRX_OFFSET_0_N_I"   : 0x000000a0,
+        "ADDR_RXDESC_CTRL_0_N_O"    : 0x000020a0,
+        "ADDR_RXDESC_POST_0_Y_O"    : 0x000020a8,
+        "ADDR_RXDESC_FREE_0_N_I"    : 0x000020b0,
+        "ADDR_RXDESC_COMPL_0_N_I"   : 0x000020b8,
+        "ADDR_RX_FRAG_DROPS_0_N_I"  : 0x000020c0,
+        "ADDR_SLOT_SIZE_0_N_O"      : 0x000020c8,
+        "ADDR_SLOT_SIZE_MAX_0_N_I"  : 0x000020d0,
+        "ADDR_RXPACK_CTRL_0_N_O"    : 0x000020d8,
+        "ADDR_RX_BUFFERS_0_N_O"     : 0x000020e0,
+        "ADDR_TXQ_CTRL_0_N_O"       : 0x000020f8,
+        "ADDR_TXQ_NUM_0_N_I"        : 0x00002100,
+        "ADDR_IRQ_COAL_FRAMES_0_N_O" : 0x00002108,
+        "ADDR_IRQ_COAL_USECS_0_N_O" : 0x00002110,
+        "ADDR_PERF_RX_FRAMES_0_N_I" : 0x00002118,
+        "ADDR_PERF_RX_DROP_CLOSED_0_N_I" : 0x00002120,
+        "ADDR_RX_RINGS_RST_0_Y_O"   : 0x00002168,
+        "ADDR_SHMEM_HI_0_N_O"       : 0x00002178,
+        "ADDR_DMA_ADDR_WIDTH_0_N_I" : 0x00002188,
+        "ADDR_TIMESTAMP_LO_0_N_I"   : 0x00002190,
+        "ADDR_TIMESTAMP_HI_0_N_I"   : 0x00002198,
+        "ADDR_TX_TS_LO_0_N_I"       : 0x000021A0,
+        "ADDR_TX_TS_HI_0_N_I"       : 0x000021A8,
+        "ADDR_TIMESTAMP_INCR_0_N_IO"   : 0x000021B0,
+        "ADDR_TXQ_OFFSET_0_N_IO"    : 0x00006000,
+        "ADDR_TXQ_RATE_0_N_O"          : 0x00006018,
+        "ADDR_TIMESTAMP_LOAD_LO_0_N_O" : 0x000021B8,
+        "ADDR_TIMESTAMP_SET_HI_0_Y_O"  : 0x000021C0,
+        "ADDR_TIMESTAMP_ADJ_HI_0_Y_O"  : 0x000021C8,
+        "ADDR_OPENSOCK_OFFSET_0_N_O" : 0x00002200,
+        "ADDR_PORT_MAP_OFFSET_0_N_O" : 0x00002300,
     }
 
     C_BUFFRX_INDEX_WIDTH   = 5
@@ -87,7 +117,10 @@ class TB:
     BUFFER_HEAD_UPPER      = BUFFER_HEAD_OFFSET + C_BUFFRX_INDEX_WIDTH - 1
     BUFFER_OPENSOCK_OFFSET = BUFFER_HEAD_UPPER + 1
     BUFFER_DUMMY_OFFSET    = BUFFER_OPENSOCK_OFFSET + 1
-    BUFFER_DUMMY_UPPER     = C_S_AXI_DATA_WIDTH - 1
+    BUFFER_DUMMY_UPPER     = 15
+    BUFFER_PACK_OFFSET     = BUFFER_DUMMY_UPPER + 1
+    BUFFER_PACK_UPPER      = C_S_AXI_DATA_WIDTH - 1
+    BUFFER_PACK_WIDTH      = BUFFER_PACK_UPPER - BUFFER_PACK_OFFSET + 1
 
     def __init__(self, dut):
         self.dut = dut
@@ -175,6 +208,10 @@ class TB:
     def get_buffer_tx_addr_control(self):
         return TB.axil_ctrl_addresses_dic["ADDR_BUFTX_OFFSET_0_N_I"] + 8 * self.NUM_BUFFERS_RX
     
+    def get_txq_addr_control(self, queue):
+        # Status (+0x00), push (+0x08), weight (+0x10), rate (+0x18)
+        return TB.axil_ctrl_addresses_dic["ADDR_TXQ_OFFSET_0_N_IO"] + 32 * queue
+
     async def get_buffer_rx_param(self, buffer_id, param_offset):
         buff_addr = self.get_buffer_rx_addr_control(buffer_id)
         buff_ctrl_data = int.from_bytes(await self.s_axil_ctrl.read(buff_addr, 4), 'little')
@@ -182,6 +219,8 @@ class TB:
         start_position = param_offset
         if (param_offset == TB.BUFFER_TAIL_OFFSET or param_offset == TB.BUFFER_HEAD_OFFSET):
             num_bits = 5
+        elif (param_offset == TB.BUFFER_PACK_OFFSET):
+            num_bits = TB.BUFFER_PACK_WIDTH
         else:
             num_bits = 1
         mask = (1 << num_bits) - 1
@@ -210,6 +249,14 @@ class TB:
         new_value = TB.replace_bits(original_value, value, TB.BUFFER_OPENSOCK_OFFSET, 1)
         await self.s_axil_ctrl.write(buff_addr, struct.pack('<I', new_value)) # Little endian
 
+    async def set_buffer_rx_pack_tail(self, buffer_id, value):
+        # Read current content (packed rings: the upper bits read the head, but write the tail)
+        buff_addr = self.get_buffer_rx_addr_control(buffer_id)
+        original_value = int.from_bytes(await self.s_axil_ctrl.read(buff_addr, 4), 'little')
+        # Replace our value in original content
+        new_value = TB.replace_bits(original_value, value, TB.BUFFER_PACK_OFFSET, TB.BUFFER_PACK_WIDTH)
+        await self.s_axil_ctrl.write(buff_addr, struct.pack('<I', new_value)) # Little endian
+
     def replace_bits(number, my_value, pos, n):
         mask = ~(2**n - 1 << pos) # Create a mask to clear the bits at the specified position
         cleared_number = number & mask # Clear the bits at the specified position
@@ -258,11 +305,11 @@ class TB:
         frame = XgmiiFrame.from_payload(pkt.build())
         await self.sfp0_source.send(frame)
 
-    async def send_packet_to_dut(self, packet_cfg):
+    async def send_packet_to_dut(self, packet_cfg, ip_flags=0, ip_frag=0):
 
         self.log.info("Generating UDP packet...")
         eth = Ether(src=packet_cfg.src_eth, dst=packet_cfg.dst_eth)
-        ip = IP(src=packet_cfg.src_ip, dst=packet_cfg.dst_ip)
+        ip = IP(src=packet_cfg.src_ip, dst=packet_cfg.dst_ip, flags=ip_flags, frag=ip_frag)
         udp = UDP(sport=packet_cfg.src_udp, dport=packet_cfg.dst_udp)
         test_pkt = eth / ip / udp / packet_cfg.payload
         test_frame = XgmiiFrame.from_payload(test_pkt.build())
@@ -271,15 +318,30 @@ class TB:
 
     async def check_buffer_rx_slot(self, packet_cfg, buffer_rx_id, buffer_slot):
 
-        # Read buffer
         packet_addr = self.get_buffer_rx_addr_ddr(0) + buffer_rx_id*self.BUFFER_SIZE + buffer_slot*self.BUFFER_ELEM_MAX_SIZE
+        await self.check_buffer_rx_packet(packet_cfg, packet_addr)
+
+    async def check_buffer_rx_packet(self, packet_cfg, packet_addr):
+
+        # Read buffer
         read_bytes = self.axi_ram.read(packet_addr, packet_cfg.payload_size+5*8) # The header takes 5 8-byte words
+        # The upper bits of header words 1-4 carry the extended header (original IP/UDP fields): only the base fields are compared
+        header_masks = [0xFFFFFFFFFFFFFFFF, 0xFFFFFFFF, 0xFFFF, 0xFFFFFFFF, 0xFFFF]
+        header_words = [int.from_bytes(read_bytes[i*8:(i+1)*8], byteorder='little') for i in range(5)]
+        read_bytes = b''.join([(header_words[i] & header_masks[i]).to_bytes(8, byteorder='little') for i in range(5)]) + read_bytes[5*8:]
         # self.log.info("Dumping axi ram content...\n" + self.axi_ram.hexdump_str(packet_addr, MAX_PACKET_SIZE*BUFFER_RX_LENGTH, prefix="RAM"))
 
         # Assert content (if the payload is longer than the limit, we expect the payload to be different to the data read from memory)
         expected_value = packet_cfg.payload_size.to_bytes(8, byteorder='little') + ip_str_to_ip_bytes(packet_cfg.src_ip) + packet_cfg.src_udp.to_bytes(8, byteorder='little') + ip_str_to_ip_bytes(packet_cfg.dst_ip) + packet_cfg.dst_udp.to_bytes(8, byteorder='little') + packet_cfg.payload
         if packet_cfg.payload_size+5*8 < self.BUFFER_ELEM_MAX_SIZE:
             assert(read_bytes == expected_value)
+            # Extended header flag and UDP checksum verified (trailer word placed at the next 8-byte boundary after the payload)
+            assert(header_words[4] >> 63 == 1)
+            trailer_addr = packet_addr + 5*8 + ((packet_cfg.payload_size + 7) // 8) * 8
+            trailer = int.from_bytes(self.axi_ram.read(trailer_addr, 8), byteorder='little')
+            assert((trailer >> 17) & 1 == 1)
+            # Rx timestamp present (lower 40 bits of the device time)
+            assert((trailer >> 18) & 1 == 1)
         else:
             assert(read_bytes != expected_value)
 
@@ -313,32 +375,60 @@ class TB:
         circbuff_rx_empty      = str(await self.get_buffer_rx_param(buffer_rx_id, TB.BUFFER_EMPTY_OFFSET))
         self.log.info("Buffer rx status: head=" + circbuff_rx_head_index + ", tail=" + circbuff_rx_tail_index + ", full=" + circbuff_rx_full + ", empty=" + circbuff_rx_empty)
 
-    async def place_packet_at_mem(self, packet_cfg):
+    async def place_packet_at_mem(self, packet_cfg, header_flags=0, launch_time=0, ext_addr=None, queue=0):
+
+        # External payload: placed at ext_addr, whose halves go to the upper bits of header words 1 and 2
+        ext_flag = 0
+        if ext_addr is not None:
+            ext_flag = 1 << 63
+            self.axi_ram.write(ext_addr, packet_cfg.payload)
 
         # Build packet to be placed at DUT memory (DDR)        
-        ddr_packet = packet_cfg.payload_size.to_bytes(8, byteorder='little')
-        ddr_packet += ip_str_to_ip_bytes(packet_cfg.src_ip)
-        ddr_packet += packet_cfg.src_udp.to_bytes(8, byteorder='little') 
+        ddr_packet = (packet_cfg.payload_size | header_flags | ext_flag).to_bytes(8, byteorder='little')
+        ddr_packet += (int.from_bytes(ip_str_to_ip_bytes(packet_cfg.src_ip), byteorder='little') | ((ext_addr or 0) & 0xFFFFFFFF) << 32).to_bytes(8, byteorder='little')
+        ddr_packet += (packet_cfg.src_udp | ((ext_addr or 0) >> 32) << 32).to_bytes(8, byteorder='little')
         ddr_packet += ip_str_to_ip_bytes(packet_cfg.dst_ip)
-        ddr_packet += packet_cfg.dst_udp.to_bytes(8, byteorder='little')
-        ddr_packet += packet_cfg.payload
+        ddr_packet += (packet_cfg.dst_udp | launch_time << 16).to_bytes(8, byteorder='little')
+        if ext_addr is None:
+            ddr_packet += packet_cfg.payload
 
         # Gather tx buffer info to know where to put the packet
-        circbuff_tx_head_index = int.from_bytes(await self.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_BUFTX_HEAD_0_N_I"], 4), 'little' )
-        circbuff_tx_tail_index = int.from_bytes(await self.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_BUFTX_TAIL_0_N_I"], 4), 'little' )
-        circbuff_tx_full       = int.from_bytes(await self.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_BUFTX_FULL_0_N_I"], 4), 'little' )
-        circbuff_tx_empty      = int.from_bytes(await self.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_BUFTX_EMPTY_0_N_I"], 4), 'little')
+        if queue == 0:
+            circbuff_tx_head_index = int.from_bytes(await self.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_BUFTX_HEAD_0_N_I"], 4), 'little' )
+            circbuff_tx_tail_index = int.from_bytes(await self.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_BUFTX_TAIL_0_N_I"], 4), 'little' )
+            circbuff_tx_full       = int.from_bytes(await self.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_BUFTX_FULL_0_N_I"], 4), 'little' )
+            circbuff_tx_empty      = int.from_bytes(await self.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_BUFTX_EMPTY_0_N_I"], 4), 'little')
+        else:
+            # Other tx queues: {full, empty, tail, head} in their status reg
+            txq_status = int.from_bytes(await self.s_axil_ctrl.read(self.get_txq_addr_control(queue), 4), 'little')
+            circbuff_tx_head_index = txq_status & 0xFF
+            circbuff_tx_full       = (txq_status >> 17) & 1
         circbuff_tx_base_addr  = int(self.dut.controller_inst.circbuff_tx_base_addr  )
         MAX_PACKET_SIZE        = int(self.dut.controller_inst.BUFFER_ELEM_MAX_SIZE)
+        BUFFER_TX_LENGTH       = int(self.dut.controller_inst.BUFFER_TX_LENGTH)
 
-        circbuff_tx_next_pack_addr = circbuff_tx_base_addr + circbuff_tx_head_index*MAX_PACKET_SIZE
+        circbuff_tx_next_pack_addr = circbuff_tx_base_addr + (queue*BUFFER_TX_LENGTH + circbuff_tx_head_index)*MAX_PACKET_SIZE
         print(circbuff_tx_head_index)
         print(circbuff_tx_full)
         if (not circbuff_tx_full):
             self.axi_ram.write(circbuff_tx_next_pack_addr, ddr_packet)
             self.log.info(self.axi_ram.hexdump_str(circbuff_tx_next_pack_addr, 256, prefix="RAM"))
             # Notify tx circular buffer about a new data pushed
-            await self.notify_pl_buffer_tx_push()
+            if queue == 0:
+                await self.notify_pl_buffer_tx_push()
+            else:
+                await self.s_axil_ctrl.write(self.get_txq_addr_control(queue) + 0x08, struct.pack('<I', 1))
+
+    async def read_timestamp(self):
+        # Reading the lower half latches the upper one
+        timestamp_lo = int.from_bytes(await self.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_TIMESTAMP_LO_0_N_I"], 4), 'little')
+        timestamp_hi = int.from_bytes(await self.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_TIMESTAMP_HI_0_N_I"], 4), 'little')
+        return (timestamp_hi << 32) | timestamp_lo
+
+    async def write_timestamp(self, addr_hi, value):
+        # Writing the upper half sets (or adjusts) the time
+        await self.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_TIMESTAMP_LOAD_LO_0_N_O"], (value & 0xFFFFFFFF).to_bytes(4, 'little'))
+        await self.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic[addr_hi], (value >> 32 & 0xFFFFFFFF).to_bytes(4, 'little'))
 
     async def notify_pl_buffer_tx_push(self):
         await self.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_BUFTX_PUSHED_0_Y_O"], (0).to_bytes(1, 'big'))
@@ -368,6 +458,14 @@ class TB:
         assert rx_pkt[UDP].dport == packet_cfg.dst_udp
         assert rx_pkt[UDP].sport == packet_cfg.src_udp
 
+        # UDP checksum filled in by the device
+        udp_checksum = rx_pkt[UDP].chksum
+        del rx_pkt[UDP].chksum
+        assert udp_checksum != 0
+        assert udp_checksum == Ether(rx_pkt.build())[UDP].chksum
+
+        return rx_pkt
+
     async def reply_arp(self, packet_cfg, rx_frame):
 
         # Monitor sfp tx until detecting traffic (ARP request from the DUT)
@@ -546,6 +644,695 @@ async def run_test_udp_rx(dut):
     for _ in range(32):
         await tb.check_buffer_rx(packet_cfg, 1, False)    
 
+    # Every packet has been accepted by the port filter (performance counters)
+    perf_rx_frames = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_PERF_RX_FRAMES_0_N_I"], 4), 'little')
+    assert(perf_rx_frames == 36)
+
+    # Leave some extra time to make visual simulation look better
+    for _ in range(100): await RisingEdge(dut.clk)
+
+###################################################################################
+# Test: rx_descriptors
+# Stimulus: descriptor mode set, two buffers posted, UDP packets sent to two ports
+# Expected: packets written to the posted buffers, one completion per packet (in order)
+###################################################################################
+
+@cocotb.test()
+async def run_test_rx_descriptors(dut):
+
+    # Initialize TB
+    tb = TB(dut)
+    await tb.init()
+
+    # General test parameters
+    dut_eth = '02:00:00:00:00:00'
+    dut_ip = '192.168.2.128'
+    ext_eth = '5a:51:52:53:54:55'
+    ext_ip = '192.168.2.100'
+    ext_udp = 1234
+    await tb.config(dut_eth, dut_ip)
+
+    # The mode is latched while in reset
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RXDESC_CTRL_0_N_O"], struct.pack('<I', 1))
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RES_0_Y_O"], (1).to_bytes(1, 'big'))
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RES_0_Y_O"], (0).to_bytes(1, 'big'))
+    await RisingEdge(dut.clk)
+
+    # Post the first two slots of rx buffer 0 (one write per buffer)
+    for slot in range(2):
+        await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RXDESC_POST_0_Y_O"], struct.pack('<I', int(tb.get_buffer_rx_addr_ddr(0)) + slot*tb.BUFFER_ELEM_MAX_SIZE))
+    rxdesc_free = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_RXDESC_FREE_0_N_I"], 4), 'little')
+    assert rxdesc_free == 2
+
+    packet_cfgs = [Packet_cfg(100, ext_eth, ext_ip, ext_udp, dut_eth, dut_ip, 5678),
+                   Packet_cfg(256, ext_eth, ext_ip, ext_udp, dut_eth, dut_ip, 5679)]
+    for packet_cfg in packet_cfgs:
+        await tb.send_packet_to_dut(packet_cfg)
+
+    # Completions come in the order buffers were posted, with the port index in the lower bits
+    for slot, packet_cfg in enumerate(packet_cfgs):
+        rxdesc_compl = 0
+        while not rxdesc_compl >> 31:
+            rxdesc_compl = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_RXDESC_COMPL_0_N_I"], 4), 'little')
+        assert rxdesc_compl & (tb.NUM_BUFFERS_RX - 1) == packet_cfg.dst_udp - 5677
+        await tb.check_buffer_rx_slot(packet_cfg, 0, slot)
+    await tb.check_int_status(1)
+    await tb.deassert_interrupt()
+
+    # Both buffers consumed, no completion left
+    rxdesc_free = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_RXDESC_FREE_0_N_I"], 4), 'little')
+    assert rxdesc_free == 0
+    rxdesc_compl = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_RXDESC_COMPL_0_N_I"], 4), 'little')
+    assert rxdesc_compl >> 31 == 0
+
+    # Leave some extra time to make visual simulation look better
+    for _ in range(100): await RisingEdge(dut.clk)
+
+###################################################################################
+# Test: tx_ext_payload
+# Stimulus: UDP packets placed at shared memory with their payload elsewhere (bit 63 set)
+# Expected: payload fetched from the external address, tx slot popped
+###################################################################################
+
+@cocotb.test()
+async def run_test_tx_ext_payload(dut):
+
+    # Initialize TB
+    tb = TB(dut)
+    await tb.init()
+
+    # General test parameters
+    dut_eth = '02:00:00:00:00:00'
+    dut_ip = '192.168.2.128'
+    dut_udp = 5678
+    ext_eth = '5a:51:52:53:54:55'
+    ext_ip = '192.168.2.100'
+    ext_udp = 1234
+    await tb.config(dut_eth, dut_ip)
+
+    # Payloads placed in rx buffer 2 (unused), only the header is written to the tx slot
+    ext_addr = int(tb.get_buffer_rx_addr_ddr(2))
+    for slot, payload_size in enumerate([256, 1024]):
+        packet_cfg = Packet_cfg(payload_size, dut_eth, dut_ip, dut_udp, ext_eth, ext_ip, ext_udp)
+        await tb.place_packet_at_mem(packet_cfg, ext_addr=ext_addr + slot*tb.BUFFER_ELEM_MAX_SIZE)
+        rx_pkt = await tb.check_tx_packet_at_sfp(packet_cfg)
+        assert bytes(rx_pkt[UDP].payload) == packet_cfg.payload
+
+    circbuff_tx_tail_index = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_BUFTX_TAIL_0_N_I"], 4), 'little')
+    assert circbuff_tx_tail_index == 2
+
+    # Leave some extra time to make visual simulation look better
+    for _ in range(100): await RisingEdge(dut.clk)
+
+###################################################################################
+# Test: rx_fragments
+# Stimulus: IPv4 fragments (more fragments flag set, then non-zero offset) sent to an open port
+# Expected: both fragments dropped and counted, unfragmented packets still received
+###################################################################################
+
+@cocotb.test()
+async def run_test_rx_fragments(dut):
+
+    # Initialize TB
+    tb = TB(dut)
+    await tb.init()
+
+    # General test parameters
+    dut_eth = '02:00:00:00:00:00'
+    dut_ip = '192.168.2.128'
+    dut_udp = 5678
+    ext_eth = '5a:51:52:53:54:55'
+    ext_ip = '192.168.2.100'
+    ext_udp = 1234
+    await tb.config(dut_eth, dut_ip)
+
+    payload_size = 100
+    packet_cfg = Packet_cfg(payload_size, ext_eth, ext_ip, ext_udp, dut_eth, dut_ip, dut_udp)
+    await tb.send_packet_to_dut(packet_cfg, ip_flags='MF')
+    await tb.send_packet_to_dut(packet_cfg, ip_frag=1)
+    rx_frag_drops = 0
+    while rx_frag_drops < 2:
+        rx_frag_drops = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_RX_FRAG_DROPS_0_N_I"], 4), 'little')
+    assert rx_frag_drops == 2
+    assert await tb.get_buffer_rx_param(1, TB.BUFFER_EMPTY_OFFSET) == 1
+    await tb.check_int_status(0)
+
+    await tb.send_packet_to_dut(packet_cfg)
+    await tb.check_buffer_rx(packet_cfg, 1)
+
+    # Leave some extra time to make visual simulation look better
+    for _ in range(100): await RisingEdge(dut.clk)
+
+###################################################################################
+# Test: slot_size
+# Stimulus: slot sizes out of range written while in reset, then the largest one selected
+# Expected: sizes clamped to the range allowed by the bitstream, rx and tx packets filling a slot
+###################################################################################
+
+@cocotb.test()
+async def run_test_slot_size(dut):
+
+    # Initialize TB
+    tb = TB(dut)
+    await tb.init()
+
+    # General test parameters
+    dut_eth = '02:00:00:00:00:00'
+    dut_ip = '192.168.2.128'
+    dut_udp = 5678
+    ext_eth = '5a:51:52:53:54:55'
+    ext_ip = '192.168.2.100'
+    ext_udp = 1234
+    await tb.config(dut_eth, dut_ip)
+
+    slot_size_max = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_SLOT_SIZE_MAX_0_N_I"], 4), 'little')
+    assert (1 << slot_size_max) == tb.BUFFER_ELEM_MAX_SIZE
+
+    # The slot size (log2) is latched while in reset, 2KB at least
+    for slot_size, slot_size_latched in [(slot_size_max + 1, slot_size_max), (0, 11), (slot_size_max, slot_size_max)]:
+        await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_SLOT_SIZE_0_N_O"], struct.pack('<I', slot_size))
+        await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RES_0_Y_O"], (1).to_bytes(1, 'big'))
+        await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RES_0_Y_O"], (0).to_bytes(1, 'big'))
+        await RisingEdge(dut.clk)
+        assert dut.controller_inst.slot_size_log2.value == slot_size_latched
+
+    # Largest packets fitting a slot: device header and trailer on rx, device header on tx (jumbo frames at most)
+    payload_size = min(tb.BUFFER_ELEM_MAX_SIZE - 6*8, 8972)
+    packet_cfg = Packet_cfg(payload_size, ext_eth, ext_ip, ext_udp, dut_eth, dut_ip, dut_udp)
+    await tb.send_packet_to_dut(packet_cfg)
+    await tb.check_buffer_rx(packet_cfg, 1)
+
+    payload_size = min(tb.BUFFER_ELEM_MAX_SIZE - 5*8, 8972)
+    packet_cfg = Packet_cfg(payload_size, dut_eth, dut_ip, dut_udp, ext_eth, ext_ip, ext_udp)
+    await tb.place_packet_at_mem(packet_cfg)
+    rx_pkt = await tb.check_tx_packet_at_sfp(packet_cfg)
+    assert bytes(rx_pkt[UDP].payload) == packet_cfg.payload
+
+    # Leave some extra time to make visual simulation look better
+    for _ in range(100): await RisingEdge(dut.clk)
+
+###################################################################################
+# Test: rx_packed
+# Stimulus: packed ring mode set, UDP packets of different sizes sent to a port, tail moved and reset
+# Expected: packets written back to back at 64-byte lines, head set to the tail on reset
+###################################################################################
+
+@cocotb.test()
+async def run_test_rx_packed(dut):
+
+    # Initialize TB
+    tb = TB(dut)
+    await tb.init()
+
+    # General test parameters
+    dut_eth = '02:00:00:00:00:00'
+    dut_ip = '192.168.2.128'
+    dut_udp = 5678
+    ext_eth = '5a:51:52:53:54:55'
+    ext_ip = '192.168.2.100'
+    ext_udp = 1234
+    await tb.config(dut_eth, dut_ip)
+
+    # The mode is latched while in reset
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RXPACK_CTRL_0_N_O"], struct.pack('<I', 1))
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RES_0_Y_O"], (1).to_bytes(1, 'big'))
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RES_0_Y_O"], (0).to_bytes(1, 'big'))
+    await RisingEdge(dut.clk)
+    assert await tb.get_buffer_rx_param(1, TB.BUFFER_PACK_OFFSET) == 0
+
+    # Device header, payload and trailer take 1 line (10B payload) and 3 lines (100B payload)
+    rxpack_line = 0
+    for payload_size, rxpack_lines in [(10, 1), (100, 3)]:
+        packet_cfg = Packet_cfg(payload_size, ext_eth, ext_ip, ext_udp, dut_eth, dut_ip, dut_udp)
+        await tb.send_packet_to_dut(packet_cfg)
+        rxpack_head = rxpack_line
+        while rxpack_head == rxpack_line:
+            rxpack_head = await tb.get_buffer_rx_param(1, TB.BUFFER_PACK_OFFSET)
+        assert rxpack_head == rxpack_line + rxpack_lines
+        await tb.check_buffer_rx_packet(packet_cfg, tb.get_buffer_rx_addr_ddr(1) + rxpack_line*64)
+        rxpack_line = rxpack_head
+    await tb.check_int_status(1)
+    await tb.deassert_interrupt()
+
+    # Tail moved past the head, which follows it on reset: the next packet is written there
+    rxpack_line = 8
+    await tb.set_buffer_rx_pack_tail(1, rxpack_line)
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RES_0_Y_O"], (1).to_bytes(1, 'big'))
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RES_0_Y_O"], (0).to_bytes(1, 'big'))
+    await RisingEdge(dut.clk)
+    assert await tb.get_buffer_rx_param(1, TB.BUFFER_PACK_OFFSET) == rxpack_line
+
+    packet_cfg = Packet_cfg(256, ext_eth, ext_ip, ext_udp, dut_eth, dut_ip, dut_udp)
+    await tb.send_packet_to_dut(packet_cfg)
+    while await tb.get_buffer_rx_param(1, TB.BUFFER_PACK_OFFSET) == rxpack_line: pass
+    await tb.check_buffer_rx_packet(packet_cfg, tb.get_buffer_rx_addr_ddr(1) + rxpack_line*64)
+
+    # Leave some extra time to make visual simulation look better
+    for _ in range(100): await RisingEdge(dut.clk)
+
+###################################################################################
+# Test: rx_buffers
+# Stimulus: 3 rx buffers placed (5 ports in range), UDP packets sent to ports inside and past them
+# Expected: tx buffer right after the 3 rx buffers, packets past them dropped, the others received
+###################################################################################
+
+@cocotb.test()
+async def run_test_rx_buffers(dut):
+
+    # Initialize TB
+    tb = TB(dut)
+    await tb.init()
+
+    # General test parameters
+    dut_eth = '02:00:00:00:00:00'
+    dut_ip = '192.168.2.128'
+    dut_udp = 5678
+    ext_eth = '5a:51:52:53:54:55'
+    ext_ip = '192.168.2.100'
+    ext_udp = 1234
+    await tb.config(dut_eth, dut_ip)
+
+    # The number of rx buffers is latched while in reset
+    rx_buffers = 3
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_UDP_RANGE_H_0_N_O"], (5681).to_bytes(2, 'little'))
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RX_BUFFERS_0_N_O"], struct.pack('<I', rx_buffers))
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RES_0_Y_O"], (1).to_bytes(1, 'big'))
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RES_0_Y_O"], (0).to_bytes(1, 'big'))
+    await RisingEdge(dut.clk)
+    assert dut.controller_inst.circbuff_tx_base_addr.value == tb.get_buffer_rx_addr_ddr(rx_buffers)
+
+    # Port 5681 (rx buffer 4) is open, but its rx buffer is not placed: dropped by the time the next packet is received
+    payload_size = 100
+    packet_cfg = Packet_cfg(payload_size, ext_eth, ext_ip, ext_udp, dut_eth, dut_ip, 5681)
+    await tb.send_packet_to_dut(packet_cfg)
+    packet_cfg = Packet_cfg(payload_size, ext_eth, ext_ip, ext_udp, dut_eth, dut_ip, 5679)
+    await tb.send_packet_to_dut(packet_cfg)
+    await tb.check_buffer_rx(packet_cfg, 2)
+    assert await tb.get_buffer_rx_param(4, TB.BUFFER_EMPTY_OFFSET) == 1
+
+    # Tx buffer moved along
+    packet_cfg = Packet_cfg(256, dut_eth, dut_ip, dut_udp, ext_eth, ext_ip, ext_udp)
+    await tb.place_packet_at_mem(packet_cfg)
+    rx_pkt = await tb.check_tx_packet_at_sfp(packet_cfg)
+    assert bytes(rx_pkt[UDP].payload) == packet_cfg.payload
+
+    # Leave some extra time to make visual simulation look better
+    for _ in range(100): await RisingEdge(dut.clk)
+
+###################################################################################
+# Test: tx_queues
+# Stimulus: 256B packets pushed to tx queues 1 and 2 while DMA reads are held back (arbitration stalled
+#           on the first packet), with strict priority, then DWRR (256B and 768B quanta)
+# Expected: packets sent in the order set by the arbitration
+###################################################################################
+
+@cocotb.test()
+async def run_test_tx_queues(dut):
+
+    # Initialize TB
+    tb = TB(dut)
+    await tb.init()
+
+    # General test parameters
+    dut_eth = '02:00:00:00:00:00'
+    dut_ip = '192.168.2.128'
+    dut_udp = 5678
+    ext_eth = '5a:51:52:53:54:55'
+    ext_ip = '192.168.2.100'
+    ext_udp = 1234
+    await tb.config(dut_eth, dut_ip)
+
+    txq_num = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_TXQ_NUM_0_N_I"], 4), 'little')
+    assert txq_num >= 3
+
+    # Tx queues placed after 3 rx buffers, so that they fit in the TB memory
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RX_BUFFERS_0_N_O"], struct.pack('<I', 3))
+    await tb.s_axil_ctrl.write(tb.get_txq_addr_control(1) + 0x10, struct.pack('<I', 256))
+    await tb.s_axil_ctrl.write(tb.get_txq_addr_control(2) + 0x10, struct.pack('<I', 768))
+
+    # Source port tells the queue of each packet
+    packet_cfgs = [Packet_cfg(256, dut_eth, dut_ip, dut_udp + queue, ext_eth, ext_ip, ext_udp) for queue in range(3)]
+
+    # The first packet of queue 1 is picked right away. Then, strict priority: queue 2 first.
+    # DWRR: queue 1 takes 1 packet per visit, queue 2 takes 3
+    for txq_ctrl, txq_order in [(0, [1, 2, 2, 1]), (1, [1, 2, 2, 2, 1, 2, 1, 1])]:
+        # The arbitration is latched while in reset
+        await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_TXQ_CTRL_0_N_O"], struct.pack('<I', txq_ctrl))
+        await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RES_0_Y_O"], (1).to_bytes(1, 'big'))
+        await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RES_0_Y_O"], (0).to_bytes(1, 'big'))
+        await RisingEdge(dut.clk)
+
+        tb.axi_ram.read_if.r_channel.pause = True
+        for queue in sorted(txq_order):
+            await tb.place_packet_at_mem(packet_cfgs[queue], queue=queue)
+        tb.axi_ram.read_if.r_channel.pause = False
+
+        for queue in txq_order:
+            await tb.check_tx_packet_at_sfp(packet_cfgs[queue])
+
+    # Leave some extra time to make visual simulation look better
+    for _ in range(100): await RisingEdge(dut.clk)
+
+###################################################################################
+# Test: rx_irq_moderation
+# Stimulus: interrupt moderated to 4 packets (1ms), then to 5us (100 packets), UDP packets sent to a port
+# Expected: interrupt raised with the 4th packet, then 5us after a single packet
+###################################################################################
+
+@cocotb.test()
+async def run_test_rx_irq_moderation(dut):
+
+    # Initialize TB
+    tb = TB(dut)
+    await tb.init()
+
+    # General test parameters
+    dut_eth = '02:00:00:00:00:00'
+    dut_ip = '192.168.2.128'
+    dut_udp = 5678
+    ext_eth = '5a:51:52:53:54:55'
+    ext_ip = '192.168.2.100'
+    ext_udp = 1234
+    await tb.config(dut_eth, dut_ip)
+
+    clk_freq_mhz = int(dut.controller_inst.CLK_FREQ_MHZ)
+    payload_size = 100
+    packet_cfg = Packet_cfg(payload_size, ext_eth, ext_ip, ext_udp, dut_eth, dut_ip, dut_udp)
+
+    # Packet count: no interrupt until the 4th packet (taken at runtime, no reset needed)
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_IRQ_COAL_FRAMES_0_N_O"], struct.pack('<I', 4))
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_IRQ_COAL_USECS_0_N_O"], struct.pack('<I', 1000))
+    for _ in range(3):
+        await tb.send_packet_to_dut(packet_cfg)
+    while await tb.get_buffer_rx_param(1, TB.BUFFER_HEAD_OFFSET) != 3: pass
+    await tb.check_int_status(0)
+
+    await tb.send_packet_to_dut(packet_cfg)
+    while await tb.get_buffer_rx_param(1, TB.BUFFER_HEAD_OFFSET) != 4: pass
+    await tb.check_int_status(1)
+    await tb.deassert_interrupt()
+
+    # Time: the interrupt follows a single packet between 4us and 5us later (microsecond ticks)
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_IRQ_COAL_FRAMES_0_N_O"], struct.pack('<I', 100))
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_IRQ_COAL_USECS_0_N_O"], struct.pack('<I', 5))
+    await tb.send_packet_to_dut(packet_cfg)
+    while await tb.get_buffer_rx_param(1, TB.BUFFER_HEAD_OFFSET) != 5: pass
+    await tb.check_int_status(0)
+    for _ in range(3*clk_freq_mhz): await RisingEdge(dut.clk)
+    await tb.check_int_status(0)
+    for _ in range(3*clk_freq_mhz): await RisingEdge(dut.clk)
+    await tb.check_int_status(1)
+    await tb.deassert_interrupt()
+
+    # Leave some extra time to make visual simulation look better
+    for _ in range(100): await RisingEdge(dut.clk)
+
+###################################################################################
+# Test: socket_reopen
+# Stimulus: socket closed and opened again (no reset) with a packet left in its rx buffer
+# Expected: packets dropped while closed, rx buffer emptied when opened again
+###################################################################################
+
+@cocotb.test()
+async def run_test_socket_reopen(dut):
+
+    # Initialize TB
+    tb = TB(dut)
+    await tb.init()
+
+    # General test parameters
+    dut_eth = '02:00:00:00:00:00'
+    dut_ip = '192.168.2.128'
+    dut_udp = 5678
+    ext_eth = '5a:51:52:53:54:55'
+    ext_ip = '192.168.2.100'
+    ext_udp = 1234
+    await tb.config(dut_eth, dut_ip)
+
+    # Leave 1 packet in the rx buffer of the port
+    payload_size = 100
+    packet_cfg = Packet_cfg(payload_size, ext_eth, ext_ip, ext_udp, dut_eth, dut_ip, dut_udp)
+    await tb.send_packet_to_dut(packet_cfg)
+    while await tb.get_buffer_rx_param(1, TB.BUFFER_EMPTY_OFFSET): pass
+    await tb.deassert_interrupt()
+
+    # Close the socket without reset: the next packet is dropped by the port filter
+    await tb.set_buffer_rx_opensocket(1, 0)
+    await tb.send_packet_to_dut(packet_cfg)
+    perf_rx_drop_closed = 0
+    while perf_rx_drop_closed == 0:
+        perf_rx_drop_closed = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_PERF_RX_DROP_CLOSED_0_N_I"], 4), 'little')
+
+    # Open it again: the packet left from before is discarded
+    await tb.set_buffer_rx_opensocket(1, 1)
+    assert await tb.get_buffer_rx_param(1, TB.BUFFER_EMPTY_OFFSET) == 1
+
+    # New packets are received
+    payload_size = 256
+    packet_cfg = Packet_cfg(payload_size, ext_eth, ext_ip, ext_udp, dut_eth, dut_ip, dut_udp)
+    await tb.send_packet_to_dut(packet_cfg)
+    await tb.check_buffer_rx(packet_cfg, 1)
+
+    # Leave some extra time to make visual simulation look better
+    for _ in range(100): await RisingEdge(dut.clk)
+
+###################################################################################
+# Test: socket_bitmap
+# Stimulus: rx rings reset with a packet left in an rx buffer, socket opened through the bitmap
+# Expected: rx buffer emptied and socket closed by the reset, packets received once opened
+###################################################################################
+
+@cocotb.test()
+async def run_test_socket_bitmap(dut):
+
+    # Initialize TB
+    tb = TB(dut)
+    await tb.init()
+
+    # General test parameters
+    dut_eth = '02:00:00:00:00:00'
+    dut_ip = '192.168.2.128'
+    dut_udp = 5678
+    ext_eth = '5a:51:52:53:54:55'
+    ext_ip = '192.168.2.100'
+    ext_udp = 1234
+    await tb.config(dut_eth, dut_ip)
+
+    # Leave 1 packet in the rx buffer of the port
+    payload_size = 100
+    packet_cfg = Packet_cfg(payload_size, ext_eth, ext_ip, ext_udp, dut_eth, dut_ip, dut_udp)
+    await tb.send_packet_to_dut(packet_cfg)
+    while await tb.get_buffer_rx_param(1, TB.BUFFER_EMPTY_OFFSET): pass
+    await tb.deassert_interrupt()
+
+    # Reset all rx rings: the rx buffer is emptied and the socket closed
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RX_RINGS_RST_0_Y_O"], struct.pack('<I', 1))
+    assert await tb.get_buffer_rx_param(1, TB.BUFFER_EMPTY_OFFSET) == 1
+    assert await tb.get_buffer_rx_param(1, TB.BUFFER_OPENSOCK_OFFSET) == 0
+
+    # Open the socket through the bitmap (bit 1 of the first word): new packets are received
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_OPENSOCK_OFFSET_0_N_O"], struct.pack('<I', 1 << 1))
+    payload_size = 256
+    packet_cfg = Packet_cfg(payload_size, ext_eth, ext_ip, ext_udp, dut_eth, dut_ip, dut_udp)
+    await tb.send_packet_to_dut(packet_cfg)
+    await tb.check_buffer_rx(packet_cfg, 1)
+
+    # Leave some extra time to make visual simulation look better
+    for _ in range(100): await RisingEdge(dut.clk)
+
+###################################################################################
+# Test: port_map
+# Stimulus: UDP packet sent to a port outside the udp port range, listed in the port map
+# Expected: packet available at the rx buffer of the port map entry
+###################################################################################
+
+@cocotb.test()
+async def run_test_port_map(dut):
+
+    # Initialize TB
+    tb = TB(dut)
+    await tb.init()
+
+    # General test parameters
+    dut_eth = '02:00:00:00:00:00'
+    dut_ip = '192.168.2.128'
+    dut_udp = 7400
+    ext_eth = '5a:51:52:53:54:55'
+    ext_ip = '192.168.2.100'
+    ext_udp = 1234
+    await tb.config(dut_eth, dut_ip)
+
+    # Map the port onto rx buffer 2 (entry 0: valid, buffer index, port)
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_PORT_MAP_OFFSET_0_N_O"], struct.pack('<I', (1 << 31) | (2 << 16) | dut_udp))
+
+    payload_size = 100
+    packet_cfg = Packet_cfg(payload_size, ext_eth, ext_ip, ext_udp, dut_eth, dut_ip, dut_udp)
+    await tb.send_packet_to_dut(packet_cfg)
+    await tb.check_buffer_rx(packet_cfg, 2)
+
+    # Leave some extra time to make visual simulation look better
+    for _ in range(100): await RisingEdge(dut.clk)
+
+###################################################################################
+# Test: shmem_high
+# Stimulus: upper 32 bits of the shared memory base address written, then reset
+# Expected: 64-bit base address latched by the controller
+###################################################################################
+
+@cocotb.test()
+async def run_test_shmem_high(dut):
+
+    # Initialize TB
+    tb = TB(dut)
+    await tb.init()
+
+    dut_eth = '02:00:00:00:00:00'
+    dut_ip = '192.168.2.128'
+    await tb.config(dut_eth, dut_ip)
+
+    dma_addr_width = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_DMA_ADDR_WIDTH_0_N_I"], 4), 'little')
+    assert dma_addr_width == 64
+
+    # The base address is latched while in reset
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_SHMEM_HI_0_N_O"], struct.pack('<I', 0x12))
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RES_0_Y_O"], (1).to_bytes(1, 'big'))
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_RES_0_Y_O"], (0).to_bytes(1, 'big'))
+    await RisingEdge(dut.clk)
+    assert tb.dut.controller_inst.shared_mem_base_address.value == (0x12 << 32)
+
+    # Leave some extra time to make visual simulation look better
+    for _ in range(100): await RisingEdge(dut.clk)
+
+###################################################################################
+# Test: tx_timestamp
+# Stimulus: UDP packet placed at shared memory with the timestamp flag (bit 62) set
+# Expected: one tx timestamp, between the device times read before and after
+###################################################################################
+
+@cocotb.test()
+async def run_test_tx_timestamp(dut):
+
+    # Initialize TB
+    tb = TB(dut)
+    await tb.init()
+
+    dut_eth = '02:00:00:00:00:00'
+    dut_ip = '192.168.2.128'
+    dut_udp = 5678
+    ext_eth = '5a:51:52:53:54:55'
+    ext_ip = '192.168.2.100'
+    ext_udp = 1234
+    await tb.config(dut_eth, dut_ip)
+
+    time_before = await tb.read_timestamp()
+
+    packet_cfg = Packet_cfg(256, dut_eth, dut_ip, dut_udp, ext_eth, ext_ip, ext_udp)
+    await tb.place_packet_at_mem(packet_cfg, header_flags=1 << 62)
+    await tb.check_tx_packet_at_sfp(packet_cfg)
+
+    time_after = await tb.read_timestamp()
+
+    # The upper half holds the valid bit, reading the lower half pops the entry
+    tx_ts_hi = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_TX_TS_HI_0_N_I"], 4), 'little')
+    tx_ts_lo = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_TX_TS_LO_0_N_I"], 4), 'little')
+    assert tx_ts_hi >> 31 == 1
+    assert time_before < ((tx_ts_hi & 0x7FFFFFFF) << 32 | tx_ts_lo) < time_after
+
+    tx_ts_hi = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_TX_TS_HI_0_N_I"], 4), 'little')
+    assert tx_ts_hi >> 31 == 0
+
+    # Leave some extra time to make visual simulation look better
+    for _ in range(100): await RisingEdge(dut.clk)
+
+###################################################################################
+# Test: tx_queue_rate
+# Stimulus: two packets pushed at once to a tx queue shaped at 100 Mbit/s (64 bytes burst)
+# Expected: second packet sent once the queue is back within its rate
+###################################################################################
+
+@cocotb.test()
+async def run_test_tx_queue_rate(dut):
+
+    # Initialize TB
+    tb = TB(dut)
+    await tb.init()
+
+    dut_eth = '02:00:00:00:00:00'
+    dut_ip = '192.168.2.128'
+    dut_udp = 5678
+    ext_eth = '5a:51:52:53:54:55'
+    ext_ip = '192.168.2.100'
+    ext_udp = 1234
+    await tb.config(dut_eth, dut_ip)
+
+    # First packet not shaped, so that the ARP reply does not delay the shaped ones
+    packet_cfg = Packet_cfg(256, dut_eth, dut_ip, dut_udp, ext_eth, ext_ip, ext_udp)
+    await tb.place_packet_at_mem(packet_cfg)
+    await tb.check_tx_packet_at_sfp(packet_cfg)
+
+    # {burst in bytes, rate in Mbit/s}
+    await tb.s_axil_ctrl.write(TB.axil_ctrl_addresses_dic["ADDR_TXQ_RATE_0_N_O"], ((64 << 16) | 100).to_bytes(4, 'little'))
+
+    await tb.place_packet_at_mem(packet_cfg, header_flags=1 << 62)
+    await tb.place_packet_at_mem(packet_cfg, header_flags=1 << 62)
+    await tb.check_tx_packet_at_sfp(packet_cfg)
+    await tb.check_tx_packet_at_sfp(packet_cfg)
+
+    tx_ts = []
+    for _ in range(2):
+        tx_ts_hi = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_TX_TS_HI_0_N_I"], 4), 'little')
+        tx_ts_lo = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_TX_TS_LO_0_N_I"], 4), 'little')
+        assert tx_ts_hi >> 31 == 1
+        tx_ts.append((tx_ts_hi & 0x7FFFFFFF) << 32 | tx_ts_lo)
+
+    # 256 bytes take 2048 bits of credit, refilled at 100 bits per microsecond (512 bits at most in advance)
+    assert 14000 <= tx_ts[1] - tx_ts[0] < 25000
+
+    # Leave some extra time to make visual simulation look better
+    for _ in range(100): await RisingEdge(dut.clk)
+
+###################################################################################
+# Test: tx_launch_time
+# Stimulus: time set and adjusted by the PS, then a packet flagged with a launch time
+# Expected: packet held back until the launch time, tx timestamp right after it
+###################################################################################
+
+@cocotb.test()
+async def run_test_tx_launch_time(dut):
+
+    # Initialize TB
+    tb = TB(dut)
+    await tb.init()
+
+    dut_eth = '02:00:00:00:00:00'
+    dut_ip = '192.168.2.128'
+    dut_udp = 5678
+    ext_eth = '5a:51:52:53:54:55'
+    ext_ip = '192.168.2.100'
+    ext_udp = 1234
+    await tb.config(dut_eth, dut_ip)
+
+    # Time set and adjusted by a negative offset
+    await tb.write_timestamp("ADDR_TIMESTAMP_SET_HI_0_Y_O", 3 << 32)
+    await tb.write_timestamp("ADDR_TIMESTAMP_ADJ_HI_0_Y_O", -(1 << 32) & 0xFFFFFFFFFFFFFFFF)
+    now = await tb.read_timestamp()
+    assert (2 << 32) <= now < (2 << 32) + 100000
+
+    # Nominal increment in use until the PS writes one
+    incr = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_TIMESTAMP_INCR_0_N_IO"], 4), 'little')
+    assert incr == int(dut.controller_inst.TIMESTAMP_INCR)
+
+    launch_time = now + 20000
+
+    packet_cfg = Packet_cfg(256, dut_eth, dut_ip, dut_udp, ext_eth, ext_ip, ext_udp)
+    await tb.place_packet_at_mem(packet_cfg, header_flags=(1 << 62) | (1 << 61), launch_time=launch_time & 0xFFFFFFFFFFFF)
+    await tb.check_tx_packet_at_sfp(packet_cfg)
+
+    tx_ts_hi = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_TX_TS_HI_0_N_I"], 4), 'little')
+    tx_ts_lo = int.from_bytes(await tb.s_axil_ctrl.read(TB.axil_ctrl_addresses_dic["ADDR_TX_TS_LO_0_N_I"], 4), 'little')
+    assert tx_ts_hi >> 31 == 1
+    assert launch_time <= ((tx_ts_hi & 0x7FFFFFFF) << 32 | tx_ts_lo) < launch_time + 5000
+
     # Leave some extra time to make visual simulation look better
     for _ in range(100): await RisingEdge(dut.clk)
 
@@ -702,6 +1489,7 @@ def test_fpga_core(request):
         os.path.join(rtl_dir, f"{dut}_10g.v"),
         os.path.join(rtl_dir, "controller_64.v"),
         os.path.join(rtl_dir, "circular_buffer.v"),
+        os.path.join(rtl_dir, "sync_fifo.v"),
         os.path.join(rtl_dir, "utils.v"),
         os.path.join(rtl_dir, "axis_header_adder.v"),
         os.path.join(rtl_dir, "axis_header_remover.v"),
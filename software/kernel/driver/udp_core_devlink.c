@@ -8,7 +8,9 @@
 
 #include <net/devlink.h>
 #include <linux/platform_device.h>
+#include <linux/rtnetlink.h>
 #include <linux/version.h>
+#include <linux/log2.h>
 
 #include "udp_core.h"
 
@@ -66,6 +68,316 @@ static void udp_core_devlink_output_open_sockets(
     memcpy(str, udp_core_devlink_opened_ports_buffer, __DEVLINK_PARAM_MAX_STRING_VALUE);
 }
 
+/**
+ * NOTE: Rx buffer lengths are given as "index:depth" pairs (index of the rx
+ * buffer, i.e. port - PORT_RANGE_LOWER, and number of slots, a power of two).
+ * Buffers not listed keep the default length. With rx_ring_depth set to NULL,
+ * the string is only validated.
+ */
+static int udp_core_devlink_parse_rx_ring_depths(
+    const char* str,
+    u16* rx_ring_depth
+)
+{
+    char *tok, *cur, *sep;
+    unsigned long index;
+    unsigned long depth;
+    unsigned int slen;
+    char udp_core_devlink_rx_ring_depths_buffer[__DEVLINK_PARAM_MAX_STRING_VALUE] = {0};
+
+    slen = strlen(str);
+    strscpy(udp_core_devlink_rx_ring_depths_buffer, str, slen + 1);
+    cur = udp_core_devlink_rx_ring_depths_buffer;
+
+    if (rx_ring_depth)
+        memset(rx_ring_depth, 0, MAX_UDP_PORTS * sizeof(u16));
+
+    while ((tok = strsep(&cur, ",")) != NULL) 
+    {
+        if (*tok == '\0')
+            continue;
+
+        sep = strchr(tok, ':');
+        if (sep == NULL)
+            return -EINVAL;
+
+        *sep = '\0';
+
+        if (kstrtoul(tok, 10, &index) || index >= MAX_UDP_PORTS)
+            return -EINVAL;
+
+        // a single slot would read as the default length in the CFG register
+        if (kstrtoul(sep + 1, 10, &depth) || depth < 2 || depth > BUFFER_RX_LENGTH_MAX || !is_power_of_2(depth))
+            return -EINVAL;
+
+        if (rx_ring_depth)
+            rx_ring_depth[index] = (u16)depth;
+    }
+
+    return 0;
+}
+
+static void udp_core_devlink_output_rx_ring_depths(
+    u16* rx_ring_depth,
+    char* str
+)
+{
+    int i, len = 0;
+    char udp_core_devlink_rx_ring_depths_buffer[__DEVLINK_PARAM_MAX_STRING_VALUE] = {0};
+
+    for (i = 0; i < MAX_UDP_PORTS; i++) 
+    {
+        if (rx_ring_depth[i] == 0)
+            continue;
+
+        len += scnprintf(
+            udp_core_devlink_rx_ring_depths_buffer + len, 
+            __DEVLINK_PARAM_MAX_STRING_VALUE - len,
+            "%s%u:%u", 
+            len ? "," : "", 
+            i,
+            rx_ring_depth[i]
+        );
+        
+        if (len >= __DEVLINK_PARAM_MAX_STRING_VALUE)
+            break;
+    }
+
+    memcpy(str, udp_core_devlink_rx_ring_depths_buffer, __DEVLINK_PARAM_MAX_STRING_VALUE);
+}
+
+/**
+ * NOTE: TX queue weights are given as a comma-separated list of DWRR quanta
+ * in bytes, one per queue starting from queue 0 (0: one slot). An empty list
+ * selects strict priority among the queues. With tx_queue_weight set to NULL,
+ * the string is only validated.
+ */
+static int udp_core_devlink_parse_tx_queue_weights(
+    const char* str,
+    u32* tx_queue_weight,
+    bool* tx_queue_dwrr
+)
+{
+    char *tok, *cur;
+    unsigned long weight;
+    unsigned int queue;
+    unsigned int slen;
+    char udp_core_devlink_tx_queue_weights_buffer[__DEVLINK_PARAM_MAX_STRING_VALUE] = {0};
+
+    slen = strlen(str);
+    strscpy(udp_core_devlink_tx_queue_weights_buffer, str, slen + 1);
+    cur = udp_core_devlink_tx_queue_weights_buffer;
+    queue = 0;
+
+    if (tx_queue_weight)
+        memset(tx_queue_weight, 0, TX_QUEUES_MAX * sizeof(u32));
+
+    while ((tok = strsep(&cur, ",")) != NULL) 
+    {
+        if (*tok == '\0')
+            continue;
+
+        if (queue >= TX_QUEUES_MAX || kstrtoul(tok, 10, &weight) || weight > U32_MAX)
+            return -EINVAL;
+
+        if (tx_queue_weight)
+            tx_queue_weight[queue] = (u32)weight;
+
+        queue++;
+    }
+
+    if (tx_queue_dwrr)
+        *tx_queue_dwrr = (queue > 0);
+
+    return 0;
+}
+
+static void udp_core_devlink_output_tx_queue_weights(
+    u32* tx_queue_weight,
+    bool tx_queue_dwrr,
+    char* str
+)
+{
+    int i, len = 0;
+    char udp_core_devlink_tx_queue_weights_buffer[__DEVLINK_PARAM_MAX_STRING_VALUE] = {0};
+
+    for (i = 0; i < TX_QUEUES_MAX && tx_queue_dwrr; i++) 
+    {
+        len += scnprintf(
+            udp_core_devlink_tx_queue_weights_buffer + len, 
+            __DEVLINK_PARAM_MAX_STRING_VALUE - len,
+            "%s%u", 
+            len ? "," : "", 
+            tx_queue_weight[i]
+        );
+    }
+
+    memcpy(str, udp_core_devlink_tx_queue_weights_buffer, __DEVLINK_PARAM_MAX_STRING_VALUE);
+}
+
+/**
+ * NOTE: TX queue rates are given as a comma-separated list of "rate:burst"
+ * pairs, one per queue starting from queue 0: rate in Mbit/s of UDP payload
+ * (0: unlimited) and burst in bytes (optional, 0: one slot). An empty list
+ * leaves every queue unlimited. With tx_queue_rate set to NULL, the string is
+ * only validated.
+ */
+static int udp_core_devlink_parse_tx_queue_rates(
+    const char* str,
+    u32* tx_queue_rate
+)
+{
+    char *tok, *cur, *sep;
+    unsigned long rate;
+    unsigned long burst;
+    unsigned int queue;
+    unsigned int slen;
+    char udp_core_devlink_tx_queue_rates_buffer[__DEVLINK_PARAM_MAX_STRING_VALUE] = {0};
+
+    slen = strlen(str);
+    strscpy(udp_core_devlink_tx_queue_rates_buffer, str, slen + 1);
+    cur = udp_core_devlink_tx_queue_rates_buffer;
+    queue = 0;
+
+    if (tx_queue_rate)
+        memset(tx_queue_rate, 0, TX_QUEUES_MAX * sizeof(u32));
+
+    while ((tok = strsep(&cur, ",")) != NULL) 
+    {
+        if (*tok == '\0')
+            continue;
+
+        burst = 0;
+        sep = strchr(tok, ':');
+
+        if (sep != NULL)
+        {
+            *sep = '\0';
+
+            if (kstrtoul(sep + 1, 10, &burst) || burst > TXQ_RATE_BURST_MAX)
+                return -EINVAL;
+        }
+
+        if (queue >= TX_QUEUES_MAX || kstrtoul(tok, 10, &rate) || rate > TXQ_RATE_MBPS_MAX)
+            return -EINVAL;
+
+        if (tx_queue_rate)
+            tx_queue_rate[queue] = TXQ_RATE(rate, burst);
+
+        queue++;
+    }
+
+    return 0;
+}
+
+static void udp_core_devlink_output_tx_queue_rates(
+    u32* tx_queue_rate,
+    char* str
+)
+{
+    int i, len = 0;
+    bool shaped = false;
+    char udp_core_devlink_tx_queue_rates_buffer[__DEVLINK_PARAM_MAX_STRING_VALUE] = {0};
+
+    for (i = 0; i < TX_QUEUES_MAX; i++)
+        shaped |= (tx_queue_rate[i] != 0);
+
+    for (i = 0; i < TX_QUEUES_MAX && shaped; i++) 
+    {
+        len += scnprintf(
+            udp_core_devlink_tx_queue_rates_buffer + len, 
+            __DEVLINK_PARAM_MAX_STRING_VALUE - len,
+            "%s%u:%u", 
+            len ? "," : "", 
+            tx_queue_rate[i] & TXQ_RATE_MBPS_MAX,
+            tx_queue_rate[i] >> 16
+        );
+    }
+
+    memcpy(str, udp_core_devlink_tx_queue_rates_buffer, __DEVLINK_PARAM_MAX_STRING_VALUE);
+}
+
+/**
+ * NOTE: The port map is given as "port:index" pairs (UDP port and index of
+ * the rx buffer it is delivered to), up to PORT_MAP_ENTRIES_MAX of them. An
+ * empty string clears the map. With port_map set to NULL, the string is only
+ * validated.
+ */
+static int udp_core_devlink_parse_port_map(
+    const char* str,
+    struct udp_core_port_map* port_map
+)
+{
+    char *tok, *cur, *sep;
+    unsigned long port;
+    unsigned long index;
+    unsigned int entry;
+    unsigned int slen;
+    char udp_core_devlink_port_map_buffer[__DEVLINK_PARAM_MAX_STRING_VALUE] = {0};
+
+    slen = strlen(str);
+    strscpy(udp_core_devlink_port_map_buffer, str, slen + 1);
+    cur = udp_core_devlink_port_map_buffer;
+    entry = 0;
+
+    while ((tok = strsep(&cur, ",")) != NULL) 
+    {
+        if (*tok == '\0')
+            continue;
+
+        sep = strchr(tok, ':');
+        if (sep == NULL || entry >= PORT_MAP_ENTRIES_MAX)
+            return -EINVAL;
+
+        *sep = '\0';
+
+        if (kstrtoul(tok, 10, &port) || port > 65535)
+            return -EINVAL;
+
+        if (kstrtoul(sep + 1, 10, &index) || index >= MAX_UDP_PORTS)
+            return -EINVAL;
+
+        if (port_map)
+        {
+            port_map->port[entry] = (u16)port;
+            port_map->buffer_id[entry] = (u16)index;
+        }
+
+        entry++;
+    }
+
+    if (port_map)
+        port_map->entries = entry;
+
+    return 0;
+}
+
+static void udp_core_devlink_output_port_map(
+    struct udp_core_port_map* port_map,
+    char* str
+)
+{
+    int i, len = 0;
+    char udp_core_devlink_port_map_buffer[__DEVLINK_PARAM_MAX_STRING_VALUE] = {0};
+
+    for (i = 0; i < port_map->entries; i++) 
+    {
+        len += scnprintf(
+            udp_core_devlink_port_map_buffer + len, 
+            __DEVLINK_PARAM_MAX_STRING_VALUE - len,
+            "%s%u:%u", 
+            i ? "," : "", 
+            port_map->port[i],
+            port_map->buffer_id[i]
+        );
+        
+        if (len >= __DEVLINK_PARAM_MAX_STRING_VALUE)
+            break;
+    }
+
+    memcpy(str, udp_core_devlink_port_map_buffer, __DEVLINK_PARAM_MAX_STRING_VALUE);
+}
+
 /* -------------------------------------------------------------------------- */
 
 enum udp_core_devlink_param_id 
@@ -76,6 +388,11 @@ enum udp_core_devlink_param_id
     UDP_CORE_DEVLINK_PARAM_ID_OPENED_SOCKETS,
     UDP_CORE_DEVLINK_PARAM_ID_GATEWAY_IP,
     UDP_CORE_DEVLINK_PARAM_ID_GATEWAY_MAC,
+    UDP_CORE_DEVLINK_PARAM_ID_RX_RING_DEPTHS,
+    UDP_CORE_DEVLINK_PARAM_ID_TX_QUEUE_WEIGHTS,
+    UDP_CORE_DEVLINK_PARAM_ID_AUTO_OPEN_SOCKETS,
+    UDP_CORE_DEVLINK_PARAM_ID_PORT_MAP,
+    UDP_CORE_DEVLINK_PARAM_ID_TX_QUEUE_RATES,
 };
 
 static int udp_core_devlink_get_u16(
@@ -110,6 +427,9 @@ static int udp_core_devlink_set_u16(
 {
     struct udp_core_drv_data* drv_data_p = devlink_priv(devlink);
 
+    // the range is read by the socket monitor under rtnl
+    rtnl_lock();
+
     switch (id) 
     {
         case UDP_CORE_DEVLINK_PARAM_ID_PORT_LOW:
@@ -121,10 +441,16 @@ static int udp_core_devlink_set_u16(
             pr_info("udp-core: port-filter high set to %d \n", drv_data_p->port_high);
             break;
         default:
+            rtnl_unlock();
             return -EINVAL;
     }
 
+    rtnl_unlock();
+
     udp_core_netdev_notify_change(drv_data_p->pfdev);
+
+    // buffers are bound to different ports now
+    udp_core_sockmon_update(drv_data_p->pfdev);
     
     return 0;
 }
@@ -167,7 +493,19 @@ static int udp_core_devlink_get_string(
             strscpy(ctx->val.vstr, drv_data_p->gw_mac, slen + 1);
             break;
         case UDP_CORE_DEVLINK_PARAM_ID_OPENED_SOCKETS:
-            udp_core_devlink_output_open_sockets(&drv_data_p->open_ports, ctx->val.vstr);
+            udp_core_devlink_output_open_sockets(&drv_data_p->config_ports, ctx->val.vstr);
+            break;
+        case UDP_CORE_DEVLINK_PARAM_ID_RX_RING_DEPTHS:
+            udp_core_devlink_output_rx_ring_depths(drv_data_p->rx_ring_depth, ctx->val.vstr);
+            break;
+        case UDP_CORE_DEVLINK_PARAM_ID_TX_QUEUE_WEIGHTS:
+            udp_core_devlink_output_tx_queue_weights(drv_data_p->tx_queue_weight, drv_data_p->tx_queue_dwrr, ctx->val.vstr);
+            break;
+        case UDP_CORE_DEVLINK_PARAM_ID_PORT_MAP:
+            udp_core_devlink_output_port_map(&drv_data_p->port_map, ctx->val.vstr);
+            break;
+        case UDP_CORE_DEVLINK_PARAM_ID_TX_QUEUE_RATES:
+            udp_core_devlink_output_tx_queue_rates(drv_data_p->tx_queue_rate, ctx->val.vstr);
             break;
         default:
             return -EINVAL;
@@ -193,16 +531,48 @@ static int udp_core_devlink_set_string(
             slen = strlen(ctx->val.vstr);
             strscpy(drv_data_p->gw_ip, ctx->val.vstr, slen + 1);
             pr_info("udp-core: gateway IP set to %s \n", drv_data_p->gw_ip);
-            break;
+            udp_core_netdev_set_gateway(drv_data_p->pfdev);
+            return 0;
         case UDP_CORE_DEVLINK_PARAM_ID_GATEWAY_MAC:
             slen = strlen(ctx->val.vstr);
             strscpy(drv_data_p->gw_mac, ctx->val.vstr, slen + 1);
             pr_info("udp-core: gateway MAC set to %s \n", drv_data_p->gw_mac);
-            break;
+            udp_core_netdev_set_gateway(drv_data_p->pfdev);
+            return 0;
         case UDP_CORE_DEVLINK_PARAM_ID_OPENED_SOCKETS:
-            udp_core_devlink_parse_open_sockets(ctx->val.vstr, &drv_data_p->open_ports);
-            pr_info("udp-core: opened sockets %d - set %s \n", drv_data_p->open_ports.port_opened_num, ctx->val.vstr);
-            break;
+            // only the sockets that changed are opened / closed, without device reset
+            rtnl_lock();
+            udp_core_devlink_parse_open_sockets(ctx->val.vstr, &drv_data_p->config_ports);
+            rtnl_unlock();
+            pr_info("udp-core: opened sockets %d - set %s \n", drv_data_p->config_ports.port_opened_num, ctx->val.vstr);
+            udp_core_sockmon_update(drv_data_p->pfdev);
+            return 0;
+        case UDP_CORE_DEVLINK_PARAM_ID_RX_RING_DEPTHS:
+            // rx buffers are laid out in memory on open, nothing to change in the device now
+            udp_core_devlink_parse_rx_ring_depths(ctx->val.vstr, drv_data_p->rx_ring_depth);
+            pr_info("udp-core: rx ring depths set to %s (applied on next interface open) \n", ctx->val.vstr);
+            return 0;
+        case UDP_CORE_DEVLINK_PARAM_ID_TX_QUEUE_WEIGHTS:
+            // the arbitration is latched by the device while in reset
+            udp_core_devlink_parse_tx_queue_weights(ctx->val.vstr, drv_data_p->tx_queue_weight, &drv_data_p->tx_queue_dwrr);
+            pr_info("udp-core: tx queue weights set to %s (applied on next interface open) \n", ctx->val.vstr);
+            return 0;
+        case UDP_CORE_DEVLINK_PARAM_ID_PORT_MAP:
+            // the map is looked up on every packet, no need to reset the device
+            rtnl_lock();
+            udp_core_devlink_parse_port_map(ctx->val.vstr, &drv_data_p->port_map);
+            pr_info("udp-core: port map set to %s \n", ctx->val.vstr);
+            udp_core_netdev_set_port_map(drv_data_p->pfdev);
+            rtnl_unlock();
+            // bound sockets may be mapped to different rx buffers now
+            udp_core_sockmon_update(drv_data_p->pfdev);
+            return 0;
+        case UDP_CORE_DEVLINK_PARAM_ID_TX_QUEUE_RATES:
+            // the shapers follow the new rates right away, no need to reset the device
+            udp_core_devlink_parse_tx_queue_rates(ctx->val.vstr, drv_data_p->tx_queue_rate);
+            pr_info("udp-core: tx queue rates set to %s \n", ctx->val.vstr);
+            udp_core_netdev_set_tx_rates(drv_data_p->pfdev);
+            return 0;
         default:
             return -EINVAL;
     }
@@ -239,6 +609,34 @@ static int udp_core_devlink_validate_string(
                 return -EINVAL;
             }
             break;
+        case UDP_CORE_DEVLINK_PARAM_ID_RX_RING_DEPTHS:
+            if (udp_core_devlink_parse_rx_ring_depths(val.vstr, NULL))
+            {
+                NL_SET_ERR_MSG_MOD(extack, "udp-core: rx ring depths shall be index:depth pairs, depth a power of two up to 256");
+                return -EINVAL;
+            }
+            break;
+        case UDP_CORE_DEVLINK_PARAM_ID_TX_QUEUE_WEIGHTS:
+            if (udp_core_devlink_parse_tx_queue_weights(val.vstr, NULL, NULL))
+            {
+                NL_SET_ERR_MSG_MOD(extack, "udp-core: tx queue weights shall be up to 4 comma-separated byte counts");
+                return -EINVAL;
+            }
+            break;
+        case UDP_CORE_DEVLINK_PARAM_ID_PORT_MAP:
+            if (udp_core_devlink_parse_port_map(val.vstr, NULL))
+            {
+                NL_SET_ERR_MSG_MOD(extack, "udp-core: port map shall be up to 32 port:index pairs, index below 1024");
+                return -EINVAL;
+            }
+            break;
+        case UDP_CORE_DEVLINK_PARAM_ID_TX_QUEUE_RATES:
+            if (udp_core_devlink_parse_tx_queue_rates(val.vstr, NULL))
+            {
+                NL_SET_ERR_MSG_MOD(extack, "udp-core: tx queue rates shall be up to 4 comma-separated rate:burst pairs (Mbit/s:bytes, up to 65535)");
+                return -EINVAL;
+            }
+            break;
         default:
             return -EINVAL;
     }
@@ -247,6 +645,51 @@ static int udp_core_devlink_validate_string(
 }
 
 
+static int udp_core_devlink_get_bool(
+    struct devlink *devlink, 
+    u32 id,
+    struct devlink_param_gset_ctx *ctx
+)
+{
+    struct udp_core_drv_data* drv_data_p = devlink_priv(devlink);
+
+    switch (id) 
+    {
+        case UDP_CORE_DEVLINK_PARAM_ID_AUTO_OPEN_SOCKETS:
+            ctx->val.vbool = drv_data_p->auto_open_sockets;
+            break;
+        default:
+            return -EOPNOTSUPP;
+    }
+
+    return 0;
+}
+
+static int udp_core_devlink_set_bool(
+    struct devlink *devlink, 
+    u32 id,
+    struct devlink_param_gset_ctx *ctx
+)
+{
+    struct udp_core_drv_data* drv_data_p = devlink_priv(devlink);
+
+    switch (id) 
+    {
+        case UDP_CORE_DEVLINK_PARAM_ID_AUTO_OPEN_SOCKETS:
+            rtnl_lock();
+            drv_data_p->auto_open_sockets = ctx->val.vbool;
+            rtnl_unlock();
+            pr_info("udp-core: automatic opening of bound sockets %s \n", drv_data_p->auto_open_sockets ? "enabled" : "disabled");
+            break;
+        default:
+            return -EINVAL;
+    }
+
+    udp_core_sockmon_update(drv_data_p->pfdev);
+
+    return 0;
+}
+
 static const struct devlink_param udp_core_devlink_params[] = 
 {
     DEVLINK_PARAM_DRIVER(
@@ -294,6 +737,51 @@ static const struct devlink_param udp_core_devlink_params[] =
         udp_core_devlink_set_string, 
         udp_core_devlink_validate_string
     ),
+    DEVLINK_PARAM_DRIVER(
+        UDP_CORE_DEVLINK_PARAM_ID_RX_RING_DEPTHS, 
+        "RX_RING_DEPTHS", 
+        DEVLINK_PARAM_TYPE_STRING,
+        BIT(DEVLINK_PARAM_CMODE_RUNTIME),
+        udp_core_devlink_get_string,
+        udp_core_devlink_set_string, 
+        udp_core_devlink_validate_string
+    ),
+    DEVLINK_PARAM_DRIVER(
+        UDP_CORE_DEVLINK_PARAM_ID_TX_QUEUE_WEIGHTS, 
+        "TX_QUEUE_WEIGHTS", 
+        DEVLINK_PARAM_TYPE_STRING,
+        BIT(DEVLINK_PARAM_CMODE_RUNTIME),
+        udp_core_devlink_get_string,
+        udp_core_devlink_set_string, 
+        udp_core_devlink_validate_string
+    ),
+    DEVLINK_PARAM_DRIVER(
+        UDP_CORE_DEVLINK_PARAM_ID_AUTO_OPEN_SOCKETS, 
+        "AUTO_OPEN_SOCKETS", 
+        DEVLINK_PARAM_TYPE_BOOL,
+        BIT(DEVLINK_PARAM_CMODE_RUNTIME),
+        udp_core_devlink_get_bool,
+        udp_core_devlink_set_bool, 
+        NULL
+    ),
+    DEVLINK_PARAM_DRIVER(
+        UDP_CORE_DEVLINK_PARAM_ID_PORT_MAP, 
+        "PORT_MAP", 
+        DEVLINK_PARAM_TYPE_STRING,
+        BIT(DEVLINK_PARAM_CMODE_RUNTIME),
+        udp_core_devlink_get_string,
+        udp_core_devlink_set_string, 
+        udp_core_devlink_validate_string
+    ),
+    DEVLINK_PARAM_DRIVER(
+        UDP_CORE_DEVLINK_PARAM_ID_TX_QUEUE_RATES, 
+        "TX_QUEUE_RATES", 
+        DEVLINK_PARAM_TYPE_STRING,
+        BIT(DEVLINK_PARAM_CMODE_RUNTIME),
+        udp_core_devlink_get_string,
+        udp_core_devlink_set_string, 
+        udp_core_devlink_validate_string
+    ),
 };
 
 /* -------------------------------------------------------------------------- */
@@ -349,6 +837,40 @@ static int udp_core_devlink_region_snapshot(
     return 0;
 }
 
+static int udp_core_devlink_counters_snapshot(
+        struct devlink *devlink, 
+        const struct devlink_region_ops *ops, 
+        struct netlink_ext_ack *extack, 
+        u8 **data
+    )
+{
+    u32 index;
+    u32* entry;
+    struct udp_core_drv_data* drv_data_p;
+
+    entry = kmalloc(RBTC_CTRL_PERF_COUNTERS * sizeof(u32), GFP_KERNEL);
+    
+    if (entry == NULL)
+    {
+        return -ENOMEM;
+    }
+
+    drv_data_p = devlink_priv(devlink);
+
+    // dump performance counters, packed (registers are REGS_STRIDE apart)
+    for (index = 0; index < RBTC_CTRL_PERF_COUNTERS; index++)
+    {
+        udp_core_devmem_read_register(
+                drv_data_p->pfdev, 
+                RBTC_CTRL_ADDR_PERF_RX_FRAMES_0_N_I + index * REGS_STRIDE, 
+                &entry[index]
+            );
+    }
+
+    *data = (u8*)entry;
+    return 0;
+}
+
 static const struct devlink_ops udp_core_devlink_ops = 
 {
     .info_get = udp_core_devlink_info_get,
@@ -361,6 +883,13 @@ static struct devlink_region_ops udp_core_devlink_region_ops =
     .destructor = kfree,
 };
 
+static struct devlink_region_ops udp_core_devlink_counters_ops =
+{
+    .name = "counters",
+    .snapshot = udp_core_devlink_counters_snapshot,
+    .destructor = kfree,
+};
+
 /* -------------------------------------------------------------------------- */
 
 int udp_core_devlink_init(struct platform_device* pdev, struct udp_core_drv_data** drv_data_p)
@@ -402,6 +931,8 @@ int udp_core_devlink_init(struct platform_device* pdev, struct udp_core_drv_data
     (*drv_data_p)->port_high = DEFAULT_PORT_RANGE_UPPER;
     (*drv_data_p)->open_ports.port_opened_num = (sizeof(default_opened_sockets) / sizeof(u16));
     memcpy((*drv_data_p)->open_ports.port_opened, default_opened_sockets, sizeof(default_opened_sockets));
+    memcpy(&(*drv_data_p)->config_ports, &(*drv_data_p)->open_ports, sizeof(struct udp_core_open_ports));
+    (*drv_data_p)->auto_open_sockets = DEFAULT_AUTO_OPEN_SOCKETS;
     memcpy((*drv_data_p)->gw_ip, GW_IP, sizeof(GW_IP));
     memcpy((*drv_data_p)->gw_mac, GW_MAC, sizeof(GW_MAC));
 
@@ -458,10 +989,33 @@ int udp_core_devlink_init_region(struct platform_device* pdev)
             RBTC_CTRL_LAST_ADDR
         );
 
-    if (drv_data_p->region == NULL) 
+    if (IS_ERR(drv_data_p->region)) 
     {
+        int err = PTR_ERR(drv_data_p->region);
+
         pr_err("udp-core: unable to create devlink region");
-        return -EINVAL;
+        drv_data_p->region = NULL;
+        return err;
+    }
+
+    udp_core_devlink_counters_ops.priv = (void*)drv_data_p;
+
+    drv_data_p->counters_region = devlink_region_create(
+            udp_core_devlink, 
+            &udp_core_devlink_counters_ops,
+            1, 
+            RBTC_CTRL_PERF_COUNTERS * sizeof(u32)
+        );
+
+    if (IS_ERR(drv_data_p->counters_region)) 
+    {
+        int err = PTR_ERR(drv_data_p->counters_region);
+
+        pr_err("udp-core: unable to create devlink counters region");
+        drv_data_p->counters_region = NULL;
+        devlink_region_destroy(drv_data_p->region);
+        drv_data_p->region = NULL;
+        return err;
     }
 
     return 0;
@@ -481,6 +1035,11 @@ void udp_core_devlink_deinit(struct platform_device* pdev)
     
     udp_core_devlink = priv_to_devlink(drv_data_p);
 
+    if (drv_data_p->counters_region != NULL)
+    {
+        devlink_region_destroy(drv_data_p->counters_region);
+    }
+
     if (drv_data_p->region != NULL)
     {
         devlink_region_destroy(drv_data_p->region);
@@ -12,9 +12,28 @@
 #include <linux/irq.h>
 #include <linux/time64.h>
 #include <linux/netdevice.h>
+#include <linux/jiffies.h>
 
 #include "udp_core.h"
 
+/**
+ * NOTE: Adaptive moderation levels, from the lowest packet rate (packets per
+ * second) they apply to. Timer and count grow together, so that bursts are 
+ * notified as soon as enough packets have been received.
+ */
+static const struct 
+{
+    u32 rate;
+    u32 usecs;
+    u32 frames;
+} udp_core_irq_coal_levels[] = 
+{
+    {      0,   0,  1 },
+    {  10000,  16,  8 },
+    { 100000,  64, 32 },
+    { 500000, 128, 64 },
+};
+
 static irqreturn_t udp_core_irq_handler(int irq, void *dev)
 {
     struct udp_core_drv_data* drv_data_p;
@@ -72,6 +91,64 @@ static int udp_core_register_irq(struct platform_device* pdev)
 
 /* -------------------------------------------------------------------------- */
 
+int udp_core_irq_set_coalesce(struct udp_core_netdev_priv* priv, u32 usecs, u32 frames)
+{
+    u32 value;
+
+    // older bitstreams do not map the moderation registers
+    udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_IRQ_COAL_USECS_0_N_O, &value);
+    priv->rx_coal_supported = (value != RBTC_CTRL_UNMAPPED_VALUE);
+
+    if (!priv->rx_coal_supported)
+    {
+        return -EOPNOTSUPP;
+    }
+
+    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_IRQ_COAL_FRAMES_0_N_O, frames);
+    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_IRQ_COAL_USECS_0_N_O, usecs);
+
+    return 0;
+}
+
+void udp_core_irq_adapt_coalesce(struct udp_core_netdev_priv* priv, int processed)
+{
+    u32 level;
+    u32 rate;
+    unsigned int elapsed_ms;
+
+    if (!priv->rx_coal_adaptive || !priv->rx_coal_supported)
+    {
+        return;
+    }
+
+    priv->rx_coal_packets += processed;
+    elapsed_ms = jiffies_to_msecs(jiffies - priv->rx_coal_window_start);
+
+    if (elapsed_ms < RX_COAL_ADAPT_WINDOW_MS)
+    {
+        return;
+    }
+
+    rate = div_u64((u64)priv->rx_coal_packets * MSEC_PER_SEC, elapsed_ms);
+
+    for (level = ARRAY_SIZE(udp_core_irq_coal_levels) - 1; level > 0; level--)
+    {
+        if (rate >= udp_core_irq_coal_levels[level].rate)
+            break;
+    }
+
+    if (level != priv->rx_coal_level)
+    {
+        priv->rx_coal_level = level;
+        priv->rx_coal_usecs = udp_core_irq_coal_levels[level].usecs;
+        priv->rx_coal_frames = udp_core_irq_coal_levels[level].frames;
+        udp_core_irq_set_coalesce(priv, priv->rx_coal_usecs, priv->rx_coal_frames);
+    }
+
+    priv->rx_coal_packets = 0;
+    priv->rx_coal_window_start = jiffies;
+}
+
 int udp_core_irq_init(struct platform_device* pdev)
 {
     int irqn;						        // number of re-mapped irq 
@@ -122,6 +122,15 @@ static int udp_core_probe(struct platform_device *pdev)
         goto init_fail;
     }
 
+    // open the sockets configured and the ones bound on the interface
+    retval = udp_core_sockmon_init(pdev);
+
+    if (retval < 0)
+    {
+        pr_err("udp-core: unable to initialize socket monitor. abort.\n");
+        goto init_fail;
+    }
+
     pr_info("udp-core: probe succeeded.\n");
     return 0;
 
@@ -139,6 +148,7 @@ static int udp_core_remove(struct platform_device* pdev)
 {
     pr_info("udp-core: removing device.\n");
    
+    udp_core_sockmon_deinit(pdev);
     udp_core_netdev_deinit(pdev);
     udp_core_irq_deinit(pdev);
     udp_core_devlink_deinit(pdev);
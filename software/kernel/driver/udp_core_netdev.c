@@ -9,6 +9,7 @@
 
 #include <linux/etherdevice.h>
 #include <linux/netdevice.h>
+#include <linux/rtnetlink.h>
 #include <linux/inetdevice.h>
 #include <linux/platform_device.h>
 #include <linux/types.h>
@@ -20,6 +21,9 @@
 #include <net/route.h>
 #include <net/addrconf.h>
 #include <linux/inet.h>
+#include <linux/filter.h>
+#include <linux/delay.h>
+#include <net/xdp_sock_drv.h>
 
 #include "udp_core.h"
 
@@ -91,6 +95,18 @@ static int udp_core_find_default_gateway(struct net_device* dev, struct in_ifadd
 
 /* -------------------------------------------------------------------------- */
 
+/**
+ * NOTE: The upper bits of a BUFRX register read as the head of the packed ring
+ * but are written as its tail, so read-modify-write sequences shall put back
+ * the tail kept by the driver.
+ */
+static uint32_t udp_core_netdev_bufrx_value(struct udp_core_netdev_priv* priv, uint32_t buffer_id, uint32_t value)
+{
+    value &= (1 << BUFFER_PACK_OFFSET) - 1;
+
+    return value | ((uint32_t)priv->rx_pack_tail[buffer_id] << BUFFER_PACK_OFFSET);
+}
+
 static void udp_core_netdev_clear_socket(struct net_device* netdev, uint32_t buffer_id) 
 {
     struct udp_core_netdev_priv* priv;
@@ -98,6 +114,14 @@ static void udp_core_netdev_clear_socket(struct net_device* netdev, uint32_t buf
     uint32_t mask_clear;
 
     priv = netdev_priv(netdev);
+
+    if (priv->opensock_map_supported)
+    {
+        priv->opensock_map[buffer_id / OPENSOCK_MAP_BITS] &= ~OPENSOCK_MAP_BIT(buffer_id);
+        udp_core_devmem_write_register(priv->pfdev, OPENSOCK_MAP_OFFSET(buffer_id), priv->opensock_map[buffer_id / OPENSOCK_MAP_BITS]);
+        return;
+    }
+
     mask_clear = ~(1 << BUFFER_OPENSOCK_OFFSET);
     
     udp_core_devmem_read_register(
@@ -105,6 +129,7 @@ static void udp_core_netdev_clear_socket(struct net_device* netdev, uint32_t buf
         BUFFER_RX_CTRL_BASE_OFFSET(buffer_id), 
         &value
     );
+    value = udp_core_netdev_bufrx_value(priv, buffer_id, value);
 
     udp_core_devmem_write_register(
         priv->pfdev, 
@@ -120,6 +145,15 @@ static void udp_core_netdev_open_socket(struct net_device* netdev, uint32_t buff
     uint32_t mask_set;
 
     priv = netdev_priv(netdev);
+
+    if (priv->opensock_map_supported)
+    {
+        priv->opensock_map[buffer_id / OPENSOCK_MAP_BITS] |= OPENSOCK_MAP_BIT(buffer_id);
+        udp_core_devmem_write_register(priv->pfdev, OPENSOCK_MAP_OFFSET(buffer_id), priv->opensock_map[buffer_id / OPENSOCK_MAP_BITS]);
+        netdev_dbg(netdev, "opened socket %d \n", buffer_id);
+        return;
+    }
+
     mask_set = 1 << BUFFER_OPENSOCK_OFFSET;
     
     udp_core_devmem_read_register(
@@ -127,6 +161,7 @@ static void udp_core_netdev_open_socket(struct net_device* netdev, uint32_t buff
         BUFFER_RX_CTRL_BASE_OFFSET(buffer_id), 
         &value
     );
+    value = udp_core_netdev_bufrx_value(priv, buffer_id, value);
 
     udp_core_devmem_write_register(
         priv->pfdev, 
@@ -140,7 +175,7 @@ static void udp_core_netdev_open_socket(struct net_device* netdev, uint32_t buff
         &value
     );
 
-    pr_info("udp-core: opened socket %d \n", buffer_id);
+    netdev_dbg(netdev, "opened socket %d \n", buffer_id);
 }
 
 static void udp_core_netdev_notify_pop_rx(struct net_device* netdev, uint32_t buffer_id) 
@@ -159,6 +194,7 @@ static void udp_core_netdev_notify_pop_rx(struct net_device* netdev, uint32_t bu
             BUFFER_RX_CTRL_BASE_OFFSET(buffer_id), 
             &value
         );
+    value = udp_core_netdev_bufrx_value(priv, buffer_id, value);
     
     // clear pop
     udp_core_devmem_write_register(
@@ -182,6 +218,73 @@ static void udp_core_netdev_notify_pop_rx(struct net_device* netdev, uint32_t bu
     );
 }
 
+/**
+ * NOTE: With the open socket bitmap, a single write empties all the rx buffers
+ * and closes all the sockets, and the list of open sockets takes one write per
+ * 32 ports, instead of one read-modify-write sequence per port.
+ */
+static void udp_core_netdev_reset_rx_buffers(struct net_device* netdev)
+{
+    struct udp_core_netdev_priv* priv;
+    unsigned int buffer_rx_index;
+
+    priv = netdev_priv(netdev);
+
+    if (priv->opensock_map_supported)
+    {
+        udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_RX_RINGS_RST_0_Y_O, 1);
+        memset(priv->opensock_map, 0, sizeof(priv->opensock_map));
+        return;
+    }
+
+    for (buffer_rx_index = 0; buffer_rx_index < MAX_UDP_PORTS; buffer_rx_index++)
+    {
+        udp_core_netdev_notify_pop_rx(netdev, buffer_rx_index);
+        udp_core_netdev_clear_socket(netdev, buffer_rx_index);
+    }
+}
+
+static void udp_core_netdev_write_sockets(struct net_device* netdev, const struct udp_core_open_ports* open_ports)
+{
+    struct udp_core_netdev_priv* priv;
+    unsigned int socket_index;
+    unsigned int map_index;
+    u32 buffer_id;
+
+    priv = netdev_priv(netdev);
+
+    if (priv->opensock_map_supported)
+    {
+        memset(priv->opensock_map, 0, sizeof(priv->opensock_map));
+
+        for (socket_index = 0; socket_index < open_ports->port_opened_num; socket_index++)
+        {
+            buffer_id = open_ports->port_opened[socket_index];
+
+            if (buffer_id < MAX_UDP_PORTS)
+                priv->opensock_map[buffer_id / OPENSOCK_MAP_BITS] |= OPENSOCK_MAP_BIT(buffer_id);
+        }
+
+        for (map_index = 0; map_index < OPENSOCK_MAP_REGS; map_index++)
+        {
+            udp_core_devmem_write_register(priv->pfdev, OPENSOCK_MAP_OFFSET(map_index * OPENSOCK_MAP_BITS), priv->opensock_map[map_index]);
+        }
+
+        pr_info("udp-core: opened %d sockets \n", open_ports->port_opened_num);
+        return;
+    }
+
+    for (buffer_id = 0; buffer_id < MAX_UDP_PORTS; buffer_id++)
+    {
+        udp_core_netdev_clear_socket(netdev, buffer_id);
+    }
+
+    for (socket_index = 0; socket_index < open_ports->port_opened_num; socket_index++)
+    {
+        udp_core_netdev_open_socket(netdev, open_ports->port_opened[socket_index]);
+    }
+}
+
 static void get_buffer_rx_param(struct net_device* netdev, u32 buffer_id, struct RBTC_CTRL_BUFRX* reg) 
 {
     struct udp_core_netdev_priv* priv;
@@ -203,18 +306,27 @@ static void udp_core_netdev_free_memory(struct platform_device* pdev)
     drv_data = platform_get_drvdata(pdev);
     priv = netdev_priv(drv_data->ndev);
 
-    dma_free_coherent(&pdev->dev, BUFFERS_TOTAL_SIZE, priv->virt_dma_area, priv->phys_dma_area);
+    if (priv->virt_dma_area == NULL)
+    {
+        return;
+    }
+
+    dma_free_noncoherent(&pdev->dev, priv->dma_area_size, priv->virt_dma_area, priv->phys_dma_area, DMA_BIDIRECTIONAL);
+    priv->virt_dma_area = NULL;
 }
 
 static int udp_core_netdev_alloc_memory(struct platform_device* pdev)
 {
+    size_t size;
     void* cpu_addr;
     dma_addr_t dma_handle;
     struct udp_core_netdev_priv* priv;
     struct udp_core_drv_data* drv_data;
 
     drv_data = platform_get_drvdata(pdev);
-    cpu_addr = dma_alloc_noncoherent(&pdev->dev, BUFFERS_TOTAL_SIZE, &dma_handle, DMA_BIDIRECTIONAL, GFP_KERNEL);
+    priv = netdev_priv(drv_data->ndev);
+    size = BUFFER_SLOTS_BYTES(priv->tx_ring_base + priv->tx_queues * BUFFER_TX_LENGTH, priv->slot_shift);
+    cpu_addr = dma_alloc_noncoherent(&pdev->dev, size, &dma_handle, DMA_BIDIRECTIONAL, GFP_KERNEL);
     
     if (!cpu_addr) 
     {
@@ -222,13 +334,170 @@ static int udp_core_netdev_alloc_memory(struct platform_device* pdev)
         return -ENOMEM;
     }
 
-    priv = netdev_priv(drv_data->ndev);
     priv->phys_dma_area = dma_handle;
     priv->virt_dma_area = cpu_addr;
+    priv->dma_area_size = size;
 
     return 0;
 }
 
+/**
+ * NOTE: Slots are sized for the MTU: they hold the device header, the payload
+ * (padded to 8 bytes) and the trailer. The smallest power of two that fits
+ * is used, so that a 1500 bytes MTU keeps the default 2KB slots.
+ */
+static u32 udp_core_netdev_slot_shift(unsigned int mtu)
+{
+    u32 shift;
+    u32 slot_len;
+
+    slot_len = PACKET_RX_TRAILER_OFFSET(MTU_PAYLOAD_SIZE(mtu)) + PACKET_RX_TRAILER_SIZE_BYTES;
+    shift = BUFFER_ELEM_SIZE_SHIFT_MIN;
+
+    while (BUFFER_ELEM_SIZE_BYTES(shift) < slot_len)
+    {
+        shift++;
+    }
+
+    return shift;
+}
+
+/**
+ * NOTE: Only the rx buffers of the configured port range (and the ones the
+ * port map delivers to) are placed in the shared memory, followed by the tx 
+ * buffer. The number is latched by the device while in reset; older 
+ * bitstreams do not map the register and always place MAX_UDP_PORTS rx buffers.
+ */
+static u32 udp_core_netdev_rx_buffers(struct platform_device* pdev, u16 port_low, u16 port_high)
+{
+    struct udp_core_drv_data* drv_data;
+    unsigned int entry;
+    u32 count;
+    u32 value;
+
+    drv_data = platform_get_drvdata(pdev);
+
+    count = (port_high >= port_low) ? port_high - port_low + 1 : 1;
+
+    for (entry = 0; entry < drv_data->port_map.entries; entry++)
+    {
+        count = max_t(u32, count, drv_data->port_map.buffer_id[entry] + 1);
+    }
+
+    count = min_t(u32, count, MAX_UDP_PORTS);
+
+    udp_core_devmem_write_register(pdev, RBTC_CTRL_ADDR_RX_BUFFERS_0_N_O, count);
+    udp_core_devmem_read_register(pdev, RBTC_CTRL_ADDR_RX_BUFFERS_0_N_O, &value);
+
+    if (value != count)
+    {
+        return MAX_UDP_PORTS;
+    }
+
+    return count;
+}
+
+/**
+ * NOTE: Rx buffers are laid out back to back, each one with the length set
+ * through devlink (BUFFER_RX_LENGTH by default), followed by the tx buffer.
+ * Lengths and positions are latched by the device while in reset; older 
+ * bitstreams do not map RX_DEPTH_MAX and always use the default layout.
+ */
+static void udp_core_netdev_rx_layout(struct udp_core_netdev_priv* priv, struct udp_core_drv_data* drv_data_p)
+{
+    u32 buffer_id;
+    u32 depth_shift;
+    u32 base;
+    u32 value;
+
+    udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_RX_DEPTH_MAX_0_N_I, &value);
+    priv->rx_depth_shift_max = (value == RBTC_CTRL_UNMAPPED_VALUE) ? 0 : min_t(u32, value, ilog2(BUFFER_RX_LENGTH_MAX));
+
+    base = 0;
+
+    for (buffer_id = 0; buffer_id < MAX_UDP_PORTS; buffer_id++)
+    {
+        depth_shift = BUFFER_RX_LENGTH_SHIFT;
+
+        if (priv->rx_depth_shift_max != 0 && drv_data_p->rx_ring_depth[buffer_id] != 0)
+        {
+            depth_shift = min_t(u32, ilog2(drv_data_p->rx_ring_depth[buffer_id]), priv->rx_depth_shift_max);
+        }
+
+        priv->rx_ring_base[buffer_id] = base;
+        priv->rx_ring_shift[buffer_id] = depth_shift;
+
+        if (priv->rx_depth_shift_max != 0)
+        {
+            udp_core_devmem_write_register(
+                    priv->pfdev, 
+                    BUFFER_RX_CFG_OFFSET(buffer_id), 
+                    (buffer_id < priv->rx_buffers) ? BUFFER_RX_CFG(base, depth_shift) : 0
+                );
+        }
+
+        if (buffer_id < priv->rx_buffers)
+        {
+            base += 1 << depth_shift;
+        }
+    }
+
+    priv->tx_ring_base = base;
+
+    if (priv->rx_depth_shift_max != 0)
+    {
+        udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_TXBUF_BASE_0_N_O, base);
+    }
+}
+
+/**
+ * NOTE: The tx queues implemented by the device are read from TXQ_NUM (older
+ * bitstreams do not map it and only have the tx buffer). The arbitration is
+ * latched while in reset, while the DWRR weights and the rates can be changed
+ * at any time. Fewer queues can be used (ethtool channels): the device never
+ * picks the others, as they stay empty.
+ */
+static u32 udp_core_netdev_tx_queues_max(struct udp_core_netdev_priv* priv)
+{
+    u32 value;
+
+    udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_TXQ_NUM_0_N_I, &value);
+
+    if (value == RBTC_CTRL_UNMAPPED_VALUE || value == 0)
+    {
+        return 1;
+    }
+
+    return min_t(u32, value, TX_QUEUES_MAX);
+}
+
+static u32 udp_core_netdev_tx_queues(struct udp_core_netdev_priv* priv, struct udp_core_drv_data* drv_data_p)
+{
+    u32 queue;
+    u32 value;
+
+    value = udp_core_netdev_tx_queues_max(priv);
+
+    if (priv->tx_channels != 0)
+    {
+        value = min_t(u32, value, priv->tx_channels);
+    }
+
+    if (value == 1)
+    {
+        return 1;
+    }
+
+    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_TXQ_CTRL_0_N_O, drv_data_p->tx_queue_dwrr ? TXQ_CTRL_DWRR : 0);
+
+    for (queue = 0; queue < value; queue++)
+    {
+        udp_core_devmem_write_register(priv->pfdev, TXQ_WEIGHT_OFFSET(queue), drv_data_p->tx_queue_weight[queue]);
+    }
+
+    return value;
+}
+
 /* -------------------------------------------------------------------------- */
 
 /**
@@ -239,45 +508,74 @@ static int udp_core_ndo_open(struct net_device* netdev)
 {
     struct udp_core_drv_data* drv_data_p;
     struct udp_core_netdev_priv* priv;
-    unsigned int buffer_rx_index;
-    unsigned int socket_index;
 
     priv = netdev_priv(netdev);
 
     // assert device reset
     udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_RES_0_Y_O, 1);
 
+    // slot size for the current MTU (latched by the device while in reset)
+    priv->slot_shift = udp_core_netdev_slot_shift(netdev->mtu);
+    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_SLOT_SIZE_0_N_O, priv->slot_shift);
+
+    drv_data_p = platform_get_drvdata(priv->pfdev);
+
+    // rx buffers for the port range only (latched by the device while in reset)
+    priv->rx_buffers = udp_core_netdev_rx_buffers(priv->pfdev, drv_data_p->port_low, drv_data_p->port_high);
+
+    // rx buffer lengths and positions (latched by the device while in reset)
+    udp_core_netdev_rx_layout(priv, drv_data_p);
+
+    // tx queues, placed after the tx buffer (arbitration latched by the device while in reset)
+    priv->tx_queues = udp_core_netdev_tx_queues(priv, drv_data_p);
+    netif_set_real_num_tx_queues(netdev, priv->tx_queues);
+    udp_core_netdev_set_tx_rates(priv->pfdev);
+
     // allocate memory for the data
     if (udp_core_netdev_alloc_memory(priv->pfdev) != 0)
     {
         pr_err("udp-core: unable to allocate contiguos memory for data\n");
         return -ENOMEM;
     }
-    
-    drv_data_p = platform_get_drvdata(priv->pfdev);
 
     // write physical mem address to the device reg
-    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_SHMEM_0_N_O, priv->phys_dma_area);
+    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_SHMEM_0_N_O, lower_32_bits(priv->phys_dma_area));
+
+    if (priv->dma_addr_bits > DMA_ADDR_BITS_MIN)
+        udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_SHMEM_HI_0_N_O, upper_32_bits(priv->phys_dma_area));
 
     // open ports
     udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_UDP_RANGE_L_0_N_O, drv_data_p->port_low);
     udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_UDP_RANGE_H_0_N_O, drv_data_p->port_high);
+    udp_core_netdev_set_port_map(priv->pfdev);
 
-    // empty and clear rx buffers
-    for (buffer_rx_index = 0; buffer_rx_index < MAX_UDP_PORTS; buffer_rx_index++)
-    {
-        udp_core_netdev_notify_pop_rx(netdev, buffer_rx_index);
-        udp_core_netdev_clear_socket(netdev, buffer_rx_index);
-    }
+    // empty and clear rx buffers (packed rings restart from line 0)
+    memset(priv->rx_pack_tail, 0, sizeof(priv->rx_pack_tail));
+    udp_core_netdev_reset_rx_buffers(netdev);
 
     // open sockets
-    for (socket_index = 0; socket_index < drv_data_p->open_ports.port_opened_num; socket_index++)
-    {
-        udp_core_netdev_open_socket(netdev, drv_data_p->open_ports.port_opened[socket_index]);
-    }
+    udp_core_netdev_write_sockets(netdev, &drv_data_p->open_ports);
     
     // clear tx push buffer
     udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_BUFTX_PUSHED_0_Y_O, 0);
+    memset(priv->tx_clean, 0, sizeof(priv->tx_clean));
+    memset(priv->tx_pending, 0, sizeof(priv->tx_pending));
+
+    // rx descriptor mode, or packed rings otherwise (latched by the device while in reset)
+    udp_core_rxdesc_init(netdev);
+    udp_core_rxpack_init(netdev);
+
+    // rx interrupt moderation (adaptive moderation starts from an interrupt per packet)
+    if (priv->rx_coal_adaptive)
+    {
+        priv->rx_coal_level = 0;
+        priv->rx_coal_usecs = 0;
+        priv->rx_coal_frames = 1;
+        priv->rx_coal_packets = 0;
+        priv->rx_coal_window_start = jiffies;
+    }
+
+    udp_core_irq_set_coalesce(priv, priv->rx_coal_usecs, priv->rx_coal_frames);
         
     // enable interrupts
     udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_IER0, 1);
@@ -293,6 +591,20 @@ static int udp_core_ndo_open(struct net_device* netdev)
     // enable napi
     napi_enable(&priv->napi);
 
+    // register xdp rx queue (napi id is needed)
+    if (udp_core_xdp_rxq_init(netdev) != 0)
+    {
+        pr_warn("udp-core: xdp not available on rx queue.\n");
+    }
+
+    // let napi post the rx pages (the ring is only refilled from napi context)
+    if (priv->rx_desc_mode)
+    {
+        local_bh_disable();
+        napi_schedule(&priv->napi);
+        local_bh_enable();
+    }
+
     // link is up!
     netif_carrier_on(netdev);
 
@@ -301,11 +613,28 @@ static int udp_core_ndo_open(struct net_device* netdev)
 
 static int udp_core_ndo_stop(struct net_device *netdev)
 {
-    unsigned int buffer_rx_index;
+    u16 queue;
     struct udp_core_netdev_priv* priv;
 
     priv = netdev_priv(netdev);
 
+    /**
+     * NOTE: Nothing shall write into the shared memory once it is released:
+     * the stack (ndo_start_xmit), XDP redirects from other devices (checking
+     * the carrier) and NAPI (XDP_TX, AF_XDP) are all stopped first.
+     */
+    netif_carrier_off(netdev);
+    netif_tx_disable(netdev);
+    synchronize_net();
+
+    // disable napi (and the timer scheduling it)
+    napi_disable(&priv->napi);
+    hrtimer_cancel(&priv->tx_timer);
+
+    // disable interrupts
+    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_IER0, 0);
+    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_GIE, 0);
+
     // assert device reset
     udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_RES_0_Y_O, 1);
 
@@ -315,110 +644,378 @@ static int udp_core_ndo_stop(struct net_device *netdev)
     // reset shmem address
     udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_SHMEM_0_N_O, 0x0);
 
+    if (priv->dma_addr_bits > DMA_ADDR_BITS_MIN)
+        udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_SHMEM_HI_0_N_O, 0x0);
+
     // empty and clear all rx buffers
-    for (buffer_rx_index = 0; buffer_rx_index < MAX_UDP_PORTS; buffer_rx_index++)
-    {
-        udp_core_netdev_notify_pop_rx(netdev, buffer_rx_index);
-        udp_core_netdev_clear_socket(netdev, buffer_rx_index);
-    }
+    udp_core_netdev_reset_rx_buffers(netdev);
     
     // clear tx push buffer
     udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_BUFTX_PUSHED_0_Y_O, 0);
-        
-    // disable interrupts
-    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_IER0, 0);
-    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_GIE, 0);
+
+    // unregister xdp rx queue
+    udp_core_xdp_rxq_deinit(netdev);
+
+    // release rx pages and disable rx descriptor mode (posted buffers are flushed while in reset)
+    udp_core_rxdesc_deinit(netdev);
+    udp_core_rxpack_deinit(netdev);
     
     // deassert device reset
     udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_RES_0_Y_O, 0); 
 
-    // disable napi
-    napi_disable(&priv->napi);
+    // release the skbs still owned by the tx rings
+    for (queue = 0; queue < priv->tx_queues; queue++)
+    {
+        udp_core_netdev_tx_clean(netdev, queue, true);
+    }
 
-    // link is down!
-    netif_carrier_off(netdev);
+    // drop the pending tx timestamp request
+    udp_core_tstamp_stop(priv);
 
     return 0;
 }
 
-static netdev_tx_t udp_core_ndo_start_xmit(struct sk_buff* skb, struct net_device* netdev)
+/**
+ * NOTE: The tx buffer (queue 0) keeps being driven through the BUFTX registers,
+ * so that older bitstreams work as before. The other queues have their own
+ * status and push registers.
+ */
+static void udp_core_netdev_txq_status(struct udp_core_netdev_priv* priv, u16 queue, u32* head, u32* tail, bool* empty, bool* full)
 {
-    u32 tx_slot_full;
-    u32 offset;
-    int pkt_composed;
-    struct udp_core_raw_packet udp_packet;
-    struct udp_core_netdev_priv* priv;
+    u32 value;
 
-    priv = netdev_priv(netdev);
+    if (queue == 0)
+    {
+        // empty first: the tail read afterwards can only be further ahead
+        udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_BUFTX_EMPTY_0_N_I, &value);
+        *empty = value;
+        udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_BUFTX_FULL_0_N_I, &value);
+        *full = value;
+        udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_BUFTX_TAIL_0_N_I, tail);
+        udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_BUFTX_HEAD_0_N_I, head);
+        return;
+    }
 
-    #ifdef NON_RAW_USAGE_ENABLED
-    /**
-     * TODO: When enabling classic sockets, the kernel network stack shall know
-     * the MAC address of the recipient, otherwise it will not forward the
-     * packet to L2 drivers. A hotfix consists of manually update kernel ARP
-     * table for known IP addresses. Find a way to avoid that (or make it 
-     * stable through an external configuration).
-     */
-    update_arp_table(priv->pfdev);
-    #endif
+    udp_core_devmem_read_register(priv->pfdev, TXQ_STATUS_OFFSET(queue), &value);
 
-    // compose the packet (populate udp packet using skb)
-    pkt_composed = udp_core_pkt_compose(skb, &udp_packet);
+    *head = TXQ_STATUS_HEAD(value);
+    *tail = TXQ_STATUS_TAIL(value);
+    *empty = value & TXQ_STATUS_EMPTY;
+    *full = value & TXQ_STATUS_FULL;
+}
 
-    if (pkt_composed < 0)
+static void udp_core_netdev_txq_push(struct udp_core_netdev_priv* priv, u16 queue)
+{
+    if (queue == 0)
     {
-        // pr_err("udp-core: tried to send out a non valid packet - discarded \n");
-        netdev->stats.tx_dropped++;
-        dev_kfree_skb(skb);
-        return NETDEV_TX_OK;
+        udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_BUFTX_PUSHED_0_Y_O, 0);
+        udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_BUFTX_PUSHED_0_Y_O, 1);
+        udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_BUFTX_PUSHED_0_Y_O, 0);
+        return;
     }
 
+    udp_core_devmem_write_register(priv->pfdev, TXQ_PUSH_OFFSET(queue), 1);
+}
 
-    udp_core_devmem_read_register(
-            priv->pfdev, 
-            RBTC_CTRL_ADDR_BUFTX_FULL_0_N_I, 
-            &tx_slot_full
-        );
+/**
+ * NOTE: One slot is kept free, so that a full ring is told apart from an
+ * empty one when comparing the device tail against tx_clean.
+ */
+u32 udp_core_netdev_tx_room(struct udp_core_netdev_priv* priv, u16 queue)
+{
+    return BUFFER_TX_LENGTH - 1 - priv->tx_pending[queue];
+}
+
+void udp_core_netdev_tx_clean(struct net_device* netdev, u16 queue, bool force)
+{
+    u32 tx_head;
+    u32 tx_tail;
+    bool tx_empty;
+    bool tx_full;
+    u32 done;
+    u32 slot;
+    struct udp_core_netdev_priv* priv;
 
-    if (tx_slot_full)
+    priv = netdev_priv(netdev);
+
+    if (priv->tx_pending[queue] == 0)
     {
-        pr_info("udp-core: tried to send out a packet - TX is busy! \n");
-        return NETDEV_TX_OK;
+        return;
     }
 
-    udp_core_devmem_read_register(
-            priv->pfdev, 
-            RBTC_CTRL_ADDR_BUFTX_HEAD_0_N_I, 
-            &offset
-        );
+    if (force)
+    {
+        done = priv->tx_pending[queue];
+    }
+    else
+    {
+        udp_core_netdev_txq_status(priv, queue, &tx_head, &tx_tail, &tx_empty, &tx_full);
 
-    offset = BUFFER_TX_OFFSET_BYTES + (offset * BUFFER_ELEM_MAX_SIZE_BYTES);
+        if (tx_empty)
+            done = priv->tx_pending[queue];
+        else
+            done = (tx_tail + BUFFER_TX_LENGTH - priv->tx_clean[queue]) % BUFFER_TX_LENGTH;
+    }
 
-    // copy header
-    memcpy(
-            ((u8*)priv->virt_dma_area)+offset, 
-            &udp_packet, 
-            PACKET_HEADER_SIZE_BYTES
-        );
+    for (; done > 0; done--)
+    {
+        slot = priv->tx_clean[queue];
+
+        if (priv->tx_skbs[queue][slot] != NULL)
+        {
+            dma_unmap_single(&priv->pfdev->dev, priv->tx_dma[queue][slot], priv->tx_dma_len[queue][slot], DMA_TO_DEVICE);
+            dev_consume_skb_any(priv->tx_skbs[queue][slot]);
+            priv->tx_skbs[queue][slot] = NULL;
+        }
+
+        priv->tx_clean[queue] = (slot + 1) % BUFFER_TX_LENGTH;
+        priv->tx_pending[queue]--;
+    }
+}
+
+int udp_core_netdev_xmit_raw(struct net_device* netdev, u16 queue, struct udp_core_raw_packet* udp_packet, struct sk_buff* skb, u64 flags)
+{
+    u32 tx_head;
+    u32 tx_tail;
+    bool tx_empty;
+    bool tx_full;
+    u32 slot;
+    u32 offset;
+    u32 copy_len;
+    bool payload_mapped;
+    dma_addr_t payload_dma;
+    struct udp_core_raw_packet header;
+    struct udp_core_pcpu_stats* stats;
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+
+    udp_core_netdev_txq_status(priv, queue, &tx_head, &tx_tail, &tx_empty, &tx_full);
+
+    // release the slots already fetched by the device, if the ring looks full
+    if (udp_core_netdev_tx_room(priv, queue) == 0)
+    {
+        udp_core_netdev_tx_clean(netdev, queue, false);
+    }
+
+    slot = tx_head % BUFFER_TX_LENGTH;
+
+    // a slot still holding an skb (and its DMA mapping) shall not be reused
+    if (tx_full || udp_core_netdev_tx_room(priv, queue) == 0 || priv->tx_skbs[queue][slot] != NULL)
+    {
+        return -EBUSY;
+    }
+
+    offset = BUFFER_SLOTS_BYTES(priv->tx_ring_base + queue * BUFFER_TX_LENGTH + slot, priv->slot_shift);
+
+    header = *udp_packet;
+    header.payload_size_bytes |= flags;
+    copy_len = udp_packet->payload_size_bytes;
+    payload_mapped = false;
+
+    if (skb != NULL)
+    {
+        payload_dma = dma_map_single(&priv->pfdev->dev, udp_packet->payload, udp_packet->payload_size_bytes, DMA_TO_DEVICE);
 
-    // copy payload
+        // the DMA mask keeps the address within the device width, fall back to the copy otherwise
+        if (dma_mapping_error(&priv->pfdev->dev, payload_dma))
+        {
+            payload_mapped = false;
+        }
+        else
+        {
+            payload_mapped = true;
+            header.payload_size_bytes |= PACKET_TX_EXT_PAYLOAD_FLAG;
+            header.source_ip |= ((u64)lower_32_bits(payload_dma) << PACKET_TX_EXT_ADDR_OFFSET);
+            header.source_port |= ((u64)upper_32_bits(payload_dma) << PACKET_TX_EXT_ADDR_OFFSET);
+            copy_len = 0;
+
+            priv->tx_skbs[queue][slot] = skb;
+            priv->tx_dma[queue][slot] = payload_dma;
+            priv->tx_dma_len[queue][slot] = udp_packet->payload_size_bytes;
+        }
+    }
+
+    // copy header
+    memcpy(
+            ((u8*)priv->virt_dma_area)+offset, 
+            &header, 
+            PACKET_HEADER_SIZE_BYTES
+        );
+
+    // copy payload (unless fetched from the skb)
     memcpy(
             ((u8*)priv->virt_dma_area)+offset+PACKET_HEADER_SIZE_BYTES, 
-            udp_packet.payload,
-            udp_packet.payload_size_bytes
+            udp_packet->payload,
+            copy_len
         );
 
     // sync 
-    dma_sync_single_for_device(&(priv->pfdev->dev), (dma_addr_t)((u8*)priv->phys_dma_area)+offset, udp_packet.payload_size_bytes+PACKET_HEADER_SIZE_BYTES, DMA_TO_DEVICE);
+    dma_sync_single_for_device(&(priv->pfdev->dev), (dma_addr_t)((u8*)priv->phys_dma_area)+offset, copy_len+PACKET_HEADER_SIZE_BYTES, DMA_TO_DEVICE);
+
+    priv->tx_pending[queue]++;
 
     // transmit!
-    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_BUFTX_PUSHED_0_Y_O, 0);
-    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_BUFTX_PUSHED_0_Y_O, 1);
-    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_BUFTX_PUSHED_0_Y_O, 0);
+    udp_core_netdev_txq_push(priv, queue);
+
+    // keep room for the next skb, NAPI restarts the queue
+    if (udp_core_netdev_tx_room(priv, queue) < TX_STOP_THRESHOLD && !__netif_subqueue_stopped(netdev, queue))
+    {
+        UDP_CORE_STATS_ADD(priv, tx_ring_full, 1);
+        netif_stop_subqueue(netdev, queue);
+        hrtimer_start(&priv->tx_timer, us_to_ktime(TX_CLEAN_TIMER_USECS), HRTIMER_MODE_REL);
+    }
+
+    // the payload has been copied, the skb is not needed anymore
+    if (skb != NULL && !payload_mapped)
+    {
+        dev_consume_skb_any(skb);
+    }
 
     // update netif stats
-    netdev->stats.tx_packets++;
-    netdev->stats.tx_bytes += udp_packet.payload_size_bytes;
+    stats = this_cpu_ptr(priv->stats);
+
+    u64_stats_update_begin(&stats->syncp);
+    stats->tx_packets++;
+    stats->tx_bytes += udp_packet->payload_size_bytes;
+    u64_stats_update_end(&stats->syncp);
+
+    return 0;
+}
+
+static void udp_core_netdev_xmit_gso(struct net_device* netdev, u16 queue, struct sk_buff* skb, struct udp_core_raw_packet* udp_packet, u64 flags)
+{
+    u32 gso_size;
+    u32 remaining;
+    u8* payload;
+    bool ext_payload;
+    u64 segment_flags;
+    struct udp_core_raw_packet segment;
+
+    gso_size = skb_shinfo(skb)->gso_size;
+    payload = (u8*)udp_packet->payload;
+    remaining = udp_packet->payload_size_bytes;
+    ext_payload = false;
+
+    #ifdef TX_EXT_PAYLOAD_ENABLED
+    ext_payload = (gso_size >= TX_EXT_PAYLOAD_MIN_SIZE);
+    #endif
+
+    // the skb is released once the device has fetched every segment (the socket is kept for its tx timestamp)
+    if (!(flags & PACKET_TX_TIMESTAMP_FLAG))
+    {
+        skb_orphan(skb);
+    }
+
+    segment = *udp_packet;
+
+    while (remaining > 0)
+    {
+        segment.payload = (u64*)payload;
+        segment.payload_size_bytes = min(remaining, gso_size);
+
+        // the super-packet is stamped when its last segment is sent (each segment waits for the launch time)
+        segment_flags = (remaining <= gso_size) ? flags : (flags & ~PACKET_TX_TIMESTAMP_FLAG);
+
+        // each slot fetching its payload from the skb holds a reference to it
+        if (ext_payload)
+        {
+            skb_get(skb);
+        }
+
+        // the queue was awake, so there is a slot for every segment
+        udp_core_netdev_xmit_raw(netdev, queue, &segment, ext_payload ? skb : NULL, segment_flags);
+
+        payload += segment.payload_size_bytes;
+        remaining -= segment.payload_size_bytes;
+    }
+
+    dev_consume_skb_any(skb);
+}
+
+static netdev_tx_t udp_core_ndo_start_xmit(struct sk_buff* skb, struct net_device* netdev)
+{
+    int pkt_composed;
+    u16 queue;
+    u64 flags;
+    struct udp_core_raw_packet udp_packet;
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+    queue = skb_get_queue_mapping(skb);
+
+    #ifdef NON_RAW_USAGE_ENABLED
+    /**
+     * TODO: When enabling classic sockets, the kernel network stack shall know
+     * the MAC address of the recipient, otherwise it will not forward the
+     * packet to L2 drivers. A hotfix consists of manually update kernel ARP
+     * table for known IP addresses. Find a way to avoid that (or make it 
+     * stable through an external configuration).
+     */
+    update_arp_table(priv->pfdev);
+    #endif
+
+    // release the skbs whose payload has already been fetched by the device
+    udp_core_netdev_tx_clean(netdev, queue, false);
+
+    // super-packets are segmented here, payloads shall be contiguous
+    if (skb_is_gso(skb) && skb_linearize(skb) != 0)
+    {
+        UDP_CORE_STATS_ADD(priv, tx_dropped, 1);
+        dev_kfree_skb(skb);
+        return NETDEV_TX_OK;
+    }
+
+    // compose the packet (populate udp packet using skb)
+    pkt_composed = udp_core_pkt_compose(skb, &udp_packet);
+
+    if (pkt_composed < 0)
+    {
+        // pr_err("udp-core: tried to send out a non valid packet - discarded \n");
+        UDP_CORE_STATS_ADD(priv, tx_dropped, 1);
+        dev_kfree_skb(skb);
+        return NETDEV_TX_OK;
+    }
+
+    /**
+     * NOTE: The queue is stopped before the ring gets full (TX_STOP_THRESHOLD),
+     * and gso_max_segs keeps super-packets within the slots left. Thus, every
+     * skb reaching this point fits in the ring.
+     */
+
+    // hardware timestamp requested through SO_TIMESTAMPING
+    flags = udp_core_tstamp_tx(priv, skb) ? PACKET_TX_TIMESTAMP_FLAG : 0;
+
+    // launch time requested through SO_TXTIME (queues offloaded by ETF)
+    flags |= udp_core_ptp_launch(priv, queue, skb, &udp_packet);
+
+    skb_tx_timestamp(skb);
+
+    if (skb_is_gso(skb))
+    {
+        udp_core_netdev_xmit_gso(netdev, queue, skb, &udp_packet, flags);
+        return NETDEV_TX_OK;
+    }
+
+    #ifdef TX_EXT_PAYLOAD_ENABLED
+    /**
+     * NOTE: Large payloads are fetched by the device from the skb itself. The
+     * skb is released when the slot is cleaned, so detach it from the socket
+     * to avoid holding its send buffer space until the next transmission.
+     */
+    if (!skb_is_nonlinear(skb) && udp_packet.payload_size_bytes >= TX_EXT_PAYLOAD_MIN_SIZE)
+    {
+        if (!(flags & PACKET_TX_TIMESTAMP_FLAG))
+        {
+            skb_orphan(skb);
+        }
+
+        udp_core_netdev_xmit_raw(netdev, queue, &udp_packet, skb, flags);
+        return NETDEV_TX_OK;
+    }
+    #endif
+
+    udp_core_netdev_xmit_raw(netdev, queue, &udp_packet, NULL, flags);
 
     // free the buffer
     dev_kfree_skb(skb);
@@ -426,67 +1023,295 @@ static netdev_tx_t udp_core_ndo_start_xmit(struct sk_buff* skb, struct net_devic
     return NETDEV_TX_OK;
 }
 
-static int udp_core_rx_poll(struct napi_struct *napi, int budget)
+/**
+ * NOTE: TX queues are picked by priority (SO_PRIORITY, or the one set by the
+ * qdisc): the device serves higher queues first (strict priority), or in 
+ * proportion to their weights (DWRR). Priorities beyond the last queue are 
+ * sent through the last queue.
+ */
+static u16 udp_core_ndo_select_queue(struct net_device* netdev, struct sk_buff* skb, struct net_device* sb_dev)
+{
+    return min_t(u32, skb->priority, netdev->real_num_tx_queues - 1);
+}
+
+void udp_core_netdev_gro_receive(struct udp_core_netdev_priv* priv, struct sk_buff* skb)
+{
+    gro_result_t result;
+
+    result = napi_gro_receive(&priv->napi, skb);
+
+    priv->rx_gro_packets++;
+
+    if (result == GRO_MERGED || result == GRO_MERGED_FREE)
+    {
+        priv->rx_gro_merged++;
+    }
+}
+
+void udp_core_netdev_stats_rx(struct udp_core_netdev_priv* priv, u32 buffer_id, u32 bytes)
+{
+    struct udp_core_pcpu_stats* stats;
+
+    stats = this_cpu_ptr(priv->stats);
+
+    u64_stats_update_begin(&stats->syncp);
+    stats->rx_packets++;
+    stats->rx_bytes += bytes;
+    u64_stats_update_end(&stats->syncp);
+
+    priv->rx_port_packets[buffer_id]++;
+    priv->rx_port_bytes[buffer_id] += bytes;
+}
+
+static int udp_core_rx_poll_buffers(
+    struct udp_core_netdev_priv* priv,
+    int budget,
+    struct bpf_prog* xdp_prog,
+    struct xsk_buff_pool* xsk_pool,
+    int* xdp_status,
+    bool* xsk_starved
+)
 {
-    struct udp_core_netdev_priv* priv;
     struct udp_core_drv_data* drv_data_p;
 
     unsigned int port;
+    unsigned int port_index;
+    unsigned int port_count;
     unsigned int buffer_id;
+    unsigned int burst;
+    unsigned int slot;
+    unsigned int available;
+    unsigned int depth;
+    unsigned int head;
+    unsigned int tail;
     struct RBTC_CTRL_BUFRX reg;
     void* packet_pointer;
     void* payload_pointer;
     struct sk_buff *skb;
     struct udp_core_raw_packet raw_udp_packet;
+    int xsk_result;
     int processed;
     bool packet_found;
+    bool stop;
 
-    priv = container_of(napi, struct udp_core_netdev_priv, napi);
     drv_data_p = platform_get_drvdata(priv->pfdev);
+    port_count = drv_data_p->open_ports.port_opened_num;
 
     processed = 0;
-    port = 0;
+    stop = false;
+
+    if (port_count == 0)
+        return 0;
 
     do {
         packet_found = false;
     
-        for (port = 0; port < drv_data_p->open_ports.port_opened_num; port++) 
+        for (port_index = 0; port_index < port_count && !stop; port_index++) 
         {
             if (processed >= budget)
                 break;
+
+            // start from a different port at each poll, so that no port starves
+            port = (priv->rx_poll_port + port_index) % port_count;
     
             buffer_id = drv_data_p->open_ports.port_opened[port];
             get_buffer_rx_param(priv->ndev, buffer_id, &reg);
     
             if (reg.empty)
                 continue;
+
+            // full indices are only held in the upper bits with configurable lengths
+            depth = 1 << priv->rx_ring_shift[buffer_id];
+            head = priv->rx_depth_shift_max ? BUFFER_EXT_HEAD(reg.pack_pointer) : reg.head;
+            tail = priv->rx_depth_shift_max ? BUFFER_EXT_TAIL(reg.pack_pointer) : reg.tail;
+
+            if (reg.full)
+                available = depth;
+            else
+                available = (head + depth - tail) % depth;
+
+            /**
+             * NOTE: Packets available in a port are drained in a burst, so that 
+             * consecutive datagrams of the same flow reach GRO back to back
+             * and can be merged.
+             */
+            for (burst = 0; burst < available && processed < budget; burst++)
+            {
+                // copy packet from memory
+                packet_found = true;
+                slot = (tail + burst) % depth;
     
-            // copy packet from memory
-            packet_found = true;
-    
-            packet_pointer = 
-                (void*) BUFFER_RX_SLOT_HDR_DATA(buffer_id, reg.tail, priv->virt_dma_area);
-            payload_pointer = 
-                (void*) BUFFER_RX_SLOT_PAYLOAD_DATA(buffer_id, reg.tail, priv->virt_dma_area);            
+                packet_pointer = 
+                    (void*) BUFFER_RX_SLOT_HDR_DATA(priv->rx_ring_base[buffer_id], slot, priv->slot_shift, priv->virt_dma_area);
+                payload_pointer = 
+                    (void*) BUFFER_RX_SLOT_PAYLOAD_DATA(priv->rx_ring_base[buffer_id], slot, priv->slot_shift, priv->virt_dma_area);            
     
-            memcpy(&raw_udp_packet, packet_pointer, PACKET_HEADER_SIZE_BYTES);
-            raw_udp_packet.payload = payload_pointer;
+                memcpy(&raw_udp_packet, packet_pointer, PACKET_HEADER_SIZE_BYTES);
+                raw_udp_packet.payload = payload_pointer;
+                udp_core_pkt_read_trailer(&raw_udp_packet, BUFFER_ELEM_SIZE_BYTES(priv->slot_shift));
+
+                // with an AF_XDP pool bound, packets are delivered into UMEM frames
+                if (xsk_pool)
+                {
+                    xsk_result = udp_core_xsk_run(priv, xsk_pool, xdp_prog, &raw_udp_packet);
+
+                    // no UMEM frame available, leave the packet in the ring
+                    if (xsk_result < 0)
+                    {
+                        *xsk_starved = true;
+                        packet_found = false;
+                        stop = true;
+                        break;
+                    }
+
+                    *xdp_status |= xsk_result;
+
+                    udp_core_netdev_stats_rx(priv, buffer_id, raw_udp_packet.payload_size_bytes + PKT_HLEN);
+
+                    udp_core_netdev_notify_pop_rx(priv->ndev, buffer_id);
+                    processed++;
+                    continue;
+                }
+
+                // let the XDP program (if any) decide before allocating skbs
+                if (xdp_prog)
+                {
+                    *xdp_status |= udp_core_xdp_run(priv, xdp_prog, &raw_udp_packet);
+
+                    udp_core_netdev_stats_rx(priv, buffer_id, raw_udp_packet.payload_size_bytes + PKT_HLEN);
+
+                    udp_core_netdev_notify_pop_rx(priv->ndev, buffer_id);
+                    processed++;
+                    continue;
+                }
     
-            skb = netdev_alloc_skb(priv->ndev, raw_udp_packet.payload_size_bytes + PKT_HLEN);
-            if (!skb)
-                break;
+                skb = napi_alloc_skb(&priv->napi, raw_udp_packet.payload_size_bytes + PKT_HLEN);
+                if (!skb)
+                {
+                    UDP_CORE_STATS_ADD(priv, rx_alloc_failed, 1);
+                    break;
+                }
     
-            udp_core_pkt_decompose(skb, &raw_udp_packet);
-            napi_gro_receive(napi, skb);
+                udp_core_pkt_decompose(skb, &raw_udp_packet);
+                udp_core_netdev_gro_receive(priv, skb);
     
-            priv->ndev->stats.rx_packets++;
-            priv->ndev->stats.rx_bytes += (raw_udp_packet.payload_size_bytes + PKT_HLEN);
+                udp_core_netdev_stats_rx(priv, buffer_id, raw_udp_packet.payload_size_bytes + PKT_HLEN);
     
-            udp_core_netdev_notify_pop_rx(priv->ndev, buffer_id);
-            processed++;
+                udp_core_netdev_notify_pop_rx(priv->ndev, buffer_id);
+                processed++;
+            }
         }
     } 
-    while (packet_found && processed < budget);
+    while (packet_found && processed < budget && !stop);
+
+    priv->rx_poll_port = (priv->rx_poll_port + 1) % port_count;
+
+    return processed;
+}
+
+static enum hrtimer_restart udp_core_netdev_tx_timer(struct hrtimer* timer)
+{
+    struct udp_core_netdev_priv* priv;
+
+    priv = container_of(timer, struct udp_core_netdev_priv, tx_timer);
+
+    // the queues are cleaned (and woken up) by NAPI
+    napi_schedule(&priv->napi);
+
+    return HRTIMER_NORESTART;
+}
+
+static int udp_core_rx_poll(struct napi_struct *napi, int budget)
+{
+    struct udp_core_netdev_priv* priv;
+    struct bpf_prog* xdp_prog;
+    struct xsk_buff_pool* xsk_pool;
+    struct netdev_queue* txq;
+    int xdp_status;
+    bool xsk_starved;
+    bool tx_stopped;
+    int processed;
+    u16 queue;
+
+    priv = container_of(napi, struct udp_core_netdev_priv, napi);
+    xdp_prog = READ_ONCE(priv->xdp_prog);
+    xsk_pool = priv->xsk_pool;
+
+    xdp_status = 0;
+    xsk_starved = false;
+
+    // upper bits of the rx timestamps
+    udp_core_tstamp_refresh(priv);
+
+    if (priv->rx_desc_mode)
+    {
+        processed = udp_core_rxdesc_poll(priv, budget, xdp_prog, xsk_pool, &xdp_status, &xsk_starved);
+    }
+    else if (priv->rx_pack_mode)
+    {
+        processed = udp_core_rxpack_poll(priv, budget, xdp_prog, xsk_pool, &xdp_status, &xsk_starved);
+    }
+    else
+    {
+        processed = udp_core_rx_poll_buffers(priv, budget, xdp_prog, xsk_pool, &xdp_status, &xsk_starved);
+    }
+
+    if (xdp_status & UDP_CORE_XDP_REDIR)
+    {
+        xdp_do_flush();
+    }
+
+    // release transmitted skbs (there is no TX completion interrupt)
+    tx_stopped = false;
+
+    for (queue = 0; queue < priv->tx_queues; queue++)
+    {
+        txq = netdev_get_tx_queue(priv->ndev, queue);
+        __netif_tx_lock(txq, smp_processor_id());
+        udp_core_netdev_tx_clean(priv->ndev, queue, false);
+
+        // restart a queue stopped for lack of slots, check again later otherwise
+        if (netif_tx_queue_stopped(txq) && netif_carrier_ok(priv->ndev))
+        {
+            if (udp_core_netdev_tx_room(priv, queue) >= TX_WAKE_THRESHOLD)
+                netif_tx_wake_queue(txq);
+            else
+                tx_stopped = true;
+        }
+
+        __netif_tx_unlock(txq);
+    }
+
+    if (tx_stopped)
+    {
+        hrtimer_start(&priv->tx_timer, us_to_ktime(TX_CLEAN_TIMER_USECS), HRTIMER_MODE_REL);
+    }
+
+    if (xsk_pool)
+    {
+        // userspace shall kick us when it refills the fill ring
+        if (xsk_uses_need_wakeup(xsk_pool))
+        {
+            if (xsk_starved)
+                xsk_set_rx_need_wakeup(xsk_pool);
+            else
+                xsk_clear_rx_need_wakeup(xsk_pool);
+        }
+
+        // keep polling until the XSK TX ring is drained
+        if (!udp_core_xsk_xmit(priv, xsk_pool, budget))
+        {
+            processed = budget;
+        }
+    }
+
+    // the rings were not drained in a single poll
+    if (processed >= budget)
+    {
+        priv->rx_budget_exhausted++;
+    }
+
+    udp_core_irq_adapt_coalesce(priv, processed);
 
     if (processed < budget) 
     {
@@ -497,79 +1322,512 @@ static int udp_core_rx_poll(struct napi_struct *napi, int budget)
         udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_GIE, 1);
     }
 
-    return processed;
+    return processed;
+}
+
+/**
+ * NOTE: Sums up the per-CPU counters. Length errors are only raised by NAPI,
+ * so they are still kept in the legacy stats of the device.
+ */
+static void udp_core_netdev_fetch_stats(struct net_device* netdev, struct udp_core_pcpu_stats* total)
+{
+    int cpu;
+    unsigned int start;
+    struct udp_core_pcpu_stats* stats;
+    struct udp_core_pcpu_stats snapshot;
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+    memset(total, 0, sizeof(struct udp_core_pcpu_stats));
+
+    for_each_possible_cpu(cpu)
+    {
+        stats = per_cpu_ptr(priv->stats, cpu);
+
+        do {
+            start = u64_stats_fetch_begin(&stats->syncp);
+            snapshot = *stats;
+        }
+        while (u64_stats_fetch_retry(&stats->syncp, start));
+
+        total->rx_packets += snapshot.rx_packets;
+        total->rx_bytes += snapshot.rx_bytes;
+        total->rx_dropped += snapshot.rx_dropped;
+        total->rx_alloc_failed += snapshot.rx_alloc_failed;
+        total->tx_packets += snapshot.tx_packets;
+        total->tx_bytes += snapshot.tx_bytes;
+        total->tx_dropped += snapshot.tx_dropped;
+        total->tx_ring_full += snapshot.tx_ring_full;
+    }
+}
+
+static void udp_core_ndo_get_stats64(struct net_device* netdev, struct rtnl_link_stats64* stats)
+{
+    struct udp_core_pcpu_stats total;
+
+    udp_core_netdev_fetch_stats(netdev, &total);
+
+    stats->rx_packets = total.rx_packets;
+    stats->rx_bytes = total.rx_bytes;
+    stats->rx_dropped = total.rx_dropped;
+    stats->tx_packets = total.tx_packets;
+    stats->tx_bytes = total.tx_bytes;
+    stats->tx_dropped = total.tx_dropped;
+
+    stats->rx_length_errors = netdev->stats.rx_length_errors;
+    stats->rx_errors = netdev->stats.rx_length_errors;
+}
+
+static void udp_core_ndo_set_rx_mode(struct net_device* dev) 
+{
+    return; // nothing to do!
+}
+
+static int udp_core_ndo_set_mac_address(struct net_device* dev, void* addr) 
+{
+    struct sockaddr* sockaddr;
+    struct udp_core_netdev_priv* priv;
+
+    uint64_t mac64;
+    int ret_low, ret_high;
+    uint32_t mac_low, mac_high;
+
+    sockaddr = addr;
+
+    pr_info("udp-core: changing MAC address to %pM \n", sockaddr->sa_data);
+
+    if (!is_valid_ether_addr((u8 *)sockaddr->sa_data))
+    {
+        pr_err("udp-core: MAC address not valid.\n");
+        return -EADDRNOTAVAIL;
+    }
+    
+    priv = netdev_priv(dev);
+    
+    mac64 = ether_addr_to_u64((u8 *)sockaddr->sa_data);
+    mac_low = mac64 & 0xFFFFFFFF;
+    mac_high = (mac64 >> 32) & 0xFFFFFFFF;
+
+    // update mac address
+    ret_low = udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_MAC_0_N_O, mac_low);
+    ret_high = udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_MAC_1_N_O, mac_high);
+
+    if (ret_low || ret_high)
+    {
+        pr_info("udp-core: unable to set device MAC address \n");
+        return -EINVAL;
+    }
+
+    pr_info("udp-core: changed MAC address to %pM \n", sockaddr->sa_data);
+
+    memcpy((void*)dev->dev_addr, sockaddr->sa_data, dev->addr_len);
+    return 0;
+}
+
+static int udp_core_ndo_change_mtu(struct net_device* dev, int new_mtu)
+{
+    int retval;
+    unsigned int old_mtu;
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(dev);
+
+    if (udp_core_xdp_check_mtu(dev, priv->xdp_prog, new_mtu) != 0)
+    {
+        pr_err("udp-core: MTU %d too large for the attached XDP program.\n", new_mtu);
+        return -EINVAL;
+    }
+
+    /**
+     * NOTE: The slot size, and so the layout of the shared memory, is selected
+     * from the MTU while the device is in reset. A running interface is closed
+     * and opened again to apply it.
+     */
+    if (!netif_running(dev))
+    {
+        WRITE_ONCE(dev->mtu, new_mtu);
+        return 0;
+    }
+
+    old_mtu = dev->mtu;
+
+    udp_core_ndo_stop(dev);
+    WRITE_ONCE(dev->mtu, new_mtu);
+    retval = udp_core_ndo_open(dev);
+
+    if (retval == 0)
+    {
+        return 0;
+    }
+
+    // roll back to the previous layout, whose memory has just been released
+    pr_err("udp-core: unable to reopen the device with MTU %d, restoring MTU %u.\n", new_mtu, old_mtu);
+    WRITE_ONCE(dev->mtu, old_mtu);
+
+    if (udp_core_ndo_open(dev) != 0)
+    {
+        /**
+         * NOTE: The device is left in reset, with no carrier and the TX queues
+         * stopped. NAPI is enabled again (with interrupts off), so that the
+         * interface can still be closed through ndo_stop.
+         */
+        pr_err("udp-core: unable to reopen the device, bring the interface down.\n");
+        napi_enable(&priv->napi);
+    }
+
+    return retval;
+}
+
+static const struct net_device_ops udp_core_netdev_ops = 
+{
+    .ndo_open		        = udp_core_ndo_open,
+    .ndo_stop		        = udp_core_ndo_stop,
+    .ndo_start_xmit		    = udp_core_ndo_start_xmit,
+    .ndo_get_stats64        = udp_core_ndo_get_stats64,
+    .ndo_select_queue       = udp_core_ndo_select_queue,
+    .ndo_set_rx_mode        = udp_core_ndo_set_rx_mode,
+    .ndo_set_mac_address	= udp_core_ndo_set_mac_address,
+    .ndo_change_mtu         = udp_core_ndo_change_mtu,
+    .ndo_bpf                = udp_core_xdp_setup,
+    .ndo_xdp_xmit           = udp_core_xdp_xmit,
+    .ndo_xsk_wakeup         = udp_core_xsk_wakeup,
+    .ndo_setup_tc           = udp_core_ptp_setup_tc,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+    .ndo_hwtstamp_get       = udp_core_tstamp_hwtstamp_get,
+    .ndo_hwtstamp_set       = udp_core_tstamp_hwtstamp_set,
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+    .ndo_eth_ioctl          = udp_core_tstamp_ioctl,
+#else
+    .ndo_do_ioctl           = udp_core_tstamp_ioctl,
+#endif
+};
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Register ethtool ops for the device. Ethool is heavily used by Ubuntu, 
+ * especially when dealing with carrier detection. 
+ */
+
+static u32 udp_core_ethtools_get_link(struct net_device* netdev)
+{
+    return netif_carrier_ok(netdev) ? 1 : 0;
+}
+
+static const char udp_core_ethtool_stats_strings[][ETH_GSTRING_LEN] = 
+{
+    "rx_gro_packets",
+    "rx_gro_merged",
+    "rx_ip_frag_dropped",
+    "rx_alloc_failed",
+    "rx_napi_budget_exhausted",
+    "tx_ring_full",
+    "tx_hwtstamp_skipped",
+    "tx_hwtstamp_timeouts",
+};
+
+#define UDP_CORE_ETHTOOL_STATS_LEN ARRAY_SIZE(udp_core_ethtool_stats_strings)
+
+/**
+ * NOTE: Besides the device-wide counters, packets and bytes are reported for
+ * each open port (named after its rx buffer), in the order of open_ports.
+ */
+#define UDP_CORE_ETHTOOL_PORT_STATS_LEN     (2)
+
+static int udp_core_ethtools_get_sset_count(struct net_device* netdev, int sset)
+{
+    struct udp_core_netdev_priv* priv;
+    struct udp_core_drv_data* drv_data_p;
+
+    if (sset != ETH_SS_STATS)
+        return -EOPNOTSUPP;
+
+    priv = netdev_priv(netdev);
+    drv_data_p = platform_get_drvdata(priv->pfdev);
+
+    return UDP_CORE_ETHTOOL_STATS_LEN + 
+        drv_data_p->open_ports.port_opened_num * UDP_CORE_ETHTOOL_PORT_STATS_LEN;
+}
+
+static void udp_core_ethtools_get_strings(struct net_device* netdev, u32 stringset, u8* data)
+{
+    unsigned int port;
+    unsigned int buffer_id;
+    struct udp_core_netdev_priv* priv;
+    struct udp_core_drv_data* drv_data_p;
+
+    if (stringset != ETH_SS_STATS)
+        return;
+
+    priv = netdev_priv(netdev);
+    drv_data_p = platform_get_drvdata(priv->pfdev);
+
+    memcpy(data, udp_core_ethtool_stats_strings, sizeof(udp_core_ethtool_stats_strings));
+    data += sizeof(udp_core_ethtool_stats_strings);
+
+    for (port = 0; port < drv_data_p->open_ports.port_opened_num; port++)
+    {
+        buffer_id = drv_data_p->open_ports.port_opened[port];
+
+        snprintf((char*)data, ETH_GSTRING_LEN, "rx_port%u_packets", buffer_id);
+        data += ETH_GSTRING_LEN;
+        snprintf((char*)data, ETH_GSTRING_LEN, "rx_port%u_bytes", buffer_id);
+        data += ETH_GSTRING_LEN;
+    }
+}
+
+static void udp_core_ethtools_get_stats(struct net_device* netdev, struct ethtool_stats* stats, u64* data)
+{
+    u32 frag_drops;
+    unsigned int port;
+    unsigned int buffer_id;
+    struct udp_core_pcpu_stats total;
+    struct udp_core_netdev_priv* priv;
+    struct udp_core_drv_data* drv_data_p;
+
+    priv = netdev_priv(netdev);
+    drv_data_p = platform_get_drvdata(priv->pfdev);
+
+    udp_core_netdev_fetch_stats(netdev, &total);
+
+    // IPv4 fragments are discarded by the device, which does not reassemble them
+    udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_RX_FRAG_DROPS_0_N_I, &frag_drops);
+
+    if (frag_drops == RBTC_CTRL_UNMAPPED_VALUE)
+    {
+        frag_drops = 0;
+    }
+
+    // same order as udp_core_ethtool_stats_strings
+    data[0] = priv->rx_gro_packets;
+    data[1] = priv->rx_gro_merged;
+    data[2] = frag_drops;
+    data[3] = total.rx_alloc_failed;
+    data[4] = priv->rx_budget_exhausted;
+    data[5] = total.tx_ring_full;
+    data[6] = priv->tstamp_tx_skipped;
+    data[7] = priv->tstamp_tx_timeouts;
+
+    data += UDP_CORE_ETHTOOL_STATS_LEN;
+
+    for (port = 0; port < drv_data_p->open_ports.port_opened_num; port++)
+    {
+        buffer_id = drv_data_p->open_ports.port_opened[port];
+
+        data[0] = priv->rx_port_packets[buffer_id];
+        data[1] = priv->rx_port_bytes[buffer_id];
+        data += UDP_CORE_ETHTOOL_PORT_STATS_LEN;
+    }
+}
+
+/**
+ * NOTE: Ring geometry, in packets. The RX rings are per port: the deepest one
+ * is reported (depths are set per port through devlink). In descriptor mode,
+ * the single ring of posted pages is reported instead. Each TX queue has its
+ * own ring of BUFFER_TX_LENGTH slots. Rings are not resizable via ethtool.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
+static void udp_core_ethtools_get_ringparam(
+    struct net_device* netdev,
+    struct ethtool_ringparam* ring,
+    struct kernel_ethtool_ringparam* kernel_ring,
+    struct netlink_ext_ack* extack
+)
+#else
+static void udp_core_ethtools_get_ringparam(struct net_device* netdev, struct ethtool_ringparam* ring)
+#endif
+{
+    unsigned int port;
+    unsigned int buffer_id;
+    struct udp_core_netdev_priv* priv;
+    struct udp_core_drv_data* drv_data_p;
+
+    priv = netdev_priv(netdev);
+    drv_data_p = platform_get_drvdata(priv->pfdev);
+
+    ring->tx_max_pending = BUFFER_TX_LENGTH;
+    ring->tx_pending = BUFFER_TX_LENGTH;
+
+    if (priv->rx_desc_mode)
+    {
+        ring->rx_max_pending = RX_DESC_LENGTH;
+        ring->rx_pending = RX_DESC_LENGTH;
+        return;
+    }
+
+    ring->rx_max_pending = priv->rx_depth_shift_max ? (1 << priv->rx_depth_shift_max) : BUFFER_RX_LENGTH;
+    ring->rx_pending = BUFFER_RX_LENGTH;
+
+    if (!netif_running(netdev))
+        return;
+
+    for (port = 0; port < drv_data_p->open_ports.port_opened_num; port++)
+    {
+        buffer_id = drv_data_p->open_ports.port_opened[port];
+        ring->rx_pending = max_t(u32, ring->rx_pending, 1 << priv->rx_ring_shift[buffer_id]);
+    }
 }
 
-static void udp_core_ndo_set_rx_mode(struct net_device* dev) 
+/**
+ * NOTE: A single rx channel is reported (one interrupt, one NAPI context), tx
+ * channels are the tx queues. The number of tx queues is latched by the device
+ * while in reset, so a running interface is closed and opened again to change
+ * it. Launch time offload needs a single tx queue.
+ */
+static void udp_core_ethtools_get_channels(struct net_device* netdev, struct ethtool_channels* ch)
 {
-    return; // nothing to do!
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+
+    ch->max_rx = 1;
+    ch->rx_count = 1;
+    ch->max_tx = udp_core_netdev_tx_queues_max(priv);
+
+    if (netif_running(netdev))
+        ch->tx_count = priv->tx_queues;
+    else if (priv->tx_channels != 0)
+        ch->tx_count = min_t(u32, ch->max_tx, priv->tx_channels);
+    else
+        ch->tx_count = ch->max_tx;
 }
 
-static int udp_core_ndo_set_mac_address(struct net_device* dev, void* addr) 
+static int udp_core_ethtools_set_channels(struct net_device* netdev, struct ethtool_channels* ch)
 {
-    struct sockaddr* sockaddr;
+    int retval;
+    u32 queue;
+    u32 old_channels;
     struct udp_core_netdev_priv* priv;
 
-    uint64_t mac64;
-    int ret_low, ret_high;
-    uint32_t mac_low, mac_high;
+    priv = netdev_priv(netdev);
 
-    sockaddr = addr;
+    if (ch->rx_count != 1 || ch->tx_count == 0)
+    {
+        return -EINVAL;
+    }
 
-    pr_info("udp-core: changing MAC address to %pM \n", sockaddr->sa_data);
+    for (queue = 0; queue < TX_QUEUES_MAX; queue++)
+    {
+        if (ch->tx_count > 1 && READ_ONCE(priv->tx_launch[queue]))
+        {
+            pr_err("udp-core: launch time offload needs a single tx queue, remove the etf qdisc first.\n");
+            return -EBUSY;
+        }
+    }
 
-    if (!is_valid_ether_addr((u8 *)sockaddr->sa_data))
+    old_channels = priv->tx_channels;
+    priv->tx_channels = ch->tx_count;
+
+    if (!netif_running(netdev))
     {
-        pr_err("udp-core: MAC address not valid.\n");
-        return -EADDRNOTAVAIL;
+        return 0;
     }
-    
-    priv = netdev_priv(dev);
-    
-    mac64 = ether_addr_to_u64((u8 *)sockaddr->sa_data);
-    mac_low = mac64 & 0xFFFFFFFF;
-    mac_high = (mac64 >> 32) & 0xFFFFFFFF;
 
-    // update mac address
-    ret_low = udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_MAC_0_N_O, mac_low);
-    ret_high = udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_MAC_1_N_O, mac_high);
+    udp_core_ndo_stop(netdev);
+    retval = udp_core_ndo_open(netdev);
 
-    if (ret_low || ret_high)
+    if (retval == 0)
     {
-        pr_info("udp-core: unable to set device MAC address \n");
-        return -EINVAL;
+        return 0;
     }
 
-    pr_info("udp-core: changed MAC address to %pM \n", sockaddr->sa_data);
+    // roll back to the previous tx queues, whose memory has just been released
+    pr_err("udp-core: unable to reopen the device with %u tx queues, restoring the previous ones.\n", ch->tx_count);
+    priv->tx_channels = old_channels;
 
-    memcpy((void*)dev->dev_addr, sockaddr->sa_data, dev->addr_len);
-    return 0;
+    if (udp_core_ndo_open(netdev) != 0)
+    {
+        // left in reset, as in ndo_change_mtu
+        pr_err("udp-core: unable to reopen the device, bring the interface down.\n");
+        napi_enable(&priv->napi);
+    }
+
+    return retval;
 }
 
-static const struct net_device_ops udp_core_netdev_ops = 
+/**
+ * NOTE: RX interrupts are moderated by the device (see udp_core_irq_set_coalesce).
+ * A timer of 0 raises the interrupt for each packet, whatever the count. With
+ * adaptive moderation, the values are picked by NAPI and only read back here.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+static int udp_core_ethtools_get_coalesce(
+    struct net_device* netdev, 
+    struct ethtool_coalesce* ec,
+    struct kernel_ethtool_coalesce* kernel_coal,
+    struct netlink_ext_ack* extack
+)
+#else
+static int udp_core_ethtools_get_coalesce(struct net_device* netdev, struct ethtool_coalesce* ec)
+#endif
 {
-    .ndo_open		        = udp_core_ndo_open,
-    .ndo_stop		        = udp_core_ndo_stop,
-    .ndo_start_xmit		    = udp_core_ndo_start_xmit,
-    .ndo_set_rx_mode        = udp_core_ndo_set_rx_mode,
-    .ndo_set_mac_address	= udp_core_ndo_set_mac_address,
-};
+    struct udp_core_netdev_priv* priv;
 
-/* -------------------------------------------------------------------------- */
+    priv = netdev_priv(netdev);
 
-/**
- * Register ethtool ops for the device. Ethool is heavily used by Ubuntu, 
- * especially when dealing with carrier detection. 
- */
+    ec->rx_coalesce_usecs = priv->rx_coal_usecs;
+    ec->rx_max_coalesced_frames = priv->rx_coal_frames;
+    ec->use_adaptive_rx_coalesce = priv->rx_coal_adaptive;
 
-static u32 udp_core_ethtools_get_link(struct net_device* netdev)
+    return 0;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0)
+static int udp_core_ethtools_set_coalesce(
+    struct net_device* netdev, 
+    struct ethtool_coalesce* ec,
+    struct kernel_ethtool_coalesce* kernel_coal,
+    struct netlink_ext_ack* extack
+)
+#else
+static int udp_core_ethtools_set_coalesce(struct net_device* netdev, struct ethtool_coalesce* ec)
+#endif
 {
-    return netif_carrier_ok(netdev) ? 1 : 0;
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+
+    if (netif_running(netdev) && !priv->rx_coal_supported)
+    {
+        return -EOPNOTSUPP;
+    }
+
+    priv->rx_coal_adaptive = ec->use_adaptive_rx_coalesce;
+
+    if (priv->rx_coal_adaptive)
+    {
+        priv->rx_coal_packets = 0;
+        priv->rx_coal_window_start = jiffies;
+        return 0;
+    }
+
+    priv->rx_coal_usecs = ec->rx_coalesce_usecs;
+    priv->rx_coal_frames = ec->rx_max_coalesced_frames;
+
+    // written again on open (the moderation is only programmed while running)
+    if (netif_running(netdev))
+    {
+        return udp_core_irq_set_coalesce(priv, priv->rx_coal_usecs, priv->rx_coal_frames);
+    }
+
+    return 0;
 }
 
 static const struct ethtool_ops udp_core_ethtool_ops = 
 {
+    .supported_coalesce_params = ETHTOOL_COALESCE_RX_USECS | 
+                                 ETHTOOL_COALESCE_RX_MAX_FRAMES | 
+                                 ETHTOOL_COALESCE_USE_ADAPTIVE_RX,
     .get_link = udp_core_ethtools_get_link,
+    .get_sset_count = udp_core_ethtools_get_sset_count,
+    .get_strings = udp_core_ethtools_get_strings,
+    .get_ethtool_stats = udp_core_ethtools_get_stats,
+    .get_ringparam = udp_core_ethtools_get_ringparam,
+    .get_channels = udp_core_ethtools_get_channels,
+    .set_channels = udp_core_ethtools_set_channels,
+    .get_coalesce = udp_core_ethtools_get_coalesce,
+    .set_coalesce = udp_core_ethtools_set_coalesce,
+    .get_ts_info = udp_core_tstamp_get_ts_info,
 };
 
 /* -------------------------------------------------------------------------- */
@@ -663,6 +1921,9 @@ static int udp_core_notifier_call(struct notifier_block *nb, unsigned long event
             update_arp_table(priv->pfdev);
             #endif
 
+            // sockets bound to the new local IP are opened now
+            udp_core_sockmon_update(priv->pfdev);
+
             pr_info("udp-core: wrote local IP: %pI4 - Mask: %pI4 - GW: %pI4 \n", &if4->ifa_address, &if4->ifa_mask, &gw4);
             break;
         case NETDEV_DOWN:
@@ -688,6 +1949,8 @@ static struct notifier_block udp_core_inetaddr_notifier =
 int udp_core_netdev_init(struct platform_device* pdev)
 {
     int retval;
+    u32 slot_shift_max;
+    u32 value;
     struct net_device* netdev;
     struct udp_core_netdev_priv* priv;
     struct udp_core_drv_data* drv_data;
@@ -696,7 +1959,7 @@ int udp_core_netdev_init(struct platform_device* pdev)
     u8 mac_addr[ETH_ALEN] = IF_DEFAULT_MAC_ADDR;
 
     // allocate and initialize network device
-    netdev = alloc_etherdev(sizeof(struct net_device));
+    netdev = alloc_etherdev_mqs(sizeof(struct udp_core_netdev_priv), TX_QUEUES_MAX, 1);
 
     if (netdev == NULL)
     {
@@ -711,20 +1974,107 @@ int udp_core_netdev_init(struct platform_device* pdev)
     priv = netdev_priv(netdev);
     memset(priv, 0, sizeof(struct udp_core_netdev_priv));
 
+    // an rx interrupt per packet, as with bitstreams not supporting moderation
+    priv->rx_coal_frames = 1;
+
     drv_data->ndev = netdev;
     priv->ndev = netdev;
     priv->pfdev = pdev;
 
+    priv->stats = netdev_alloc_pcpu_stats(struct udp_core_pcpu_stats);
+
+    if (priv->stats == NULL)
+    {
+        pr_err("udp-core: unable to allocate netdevice stats.\n");
+        free_netdev(netdev);
+        return -ENOMEM;
+    }
+
     SET_NETDEV_DEV(netdev, &pdev->dev);
 
     netdev->irq = drv_data->irq_descriptor.irqn;
     netdev->netdev_ops = &udp_core_netdev_ops;
 
+    // the largest slot supported by the device bounds the MTU (2KB on older bitstreams)
+    udp_core_devmem_read_register(pdev, RBTC_CTRL_ADDR_SLOT_SIZE_MAX_0_N_I, &slot_shift_max);
+
+    if (slot_shift_max == RBTC_CTRL_UNMAPPED_VALUE || slot_shift_max < BUFFER_ELEM_SIZE_SHIFT_MIN)
+    {
+        slot_shift_max = BUFFER_ELEM_SIZE_SHIFT_MIN;
+    }
+
+    priv->slot_shift_max = min_t(u32, slot_shift_max, BUFFER_ELEM_SIZE_SHIFT_MAX);
+    priv->slot_shift = BUFFER_ELEM_SIZE_SHIFT_MIN;
+
+    // older bitstreams open sockets one BUFRX register at a time
+    udp_core_devmem_read_register(pdev, RBTC_CTRL_ADDR_RX_RINGS_RST_0_Y_O, &value);
+    priv->opensock_map_supported = (value != RBTC_CTRL_UNMAPPED_VALUE);
+
+    // older bitstreams only receive the port range
+    udp_core_devmem_read_register(pdev, RBTC_CTRL_ADDR_PORT_MAP_NUM_0_N_I, &value);
+    priv->port_map_entries = (value == RBTC_CTRL_UNMAPPED_VALUE) ? 0 : min_t(u32, value, PORT_MAP_ENTRIES_MAX);
+
+    // older bitstreams only take 32-bit DMA addresses
+    udp_core_devmem_read_register(pdev, RBTC_CTRL_ADDR_DMA_ADDR_WIDTH_0_N_I, &value);
+    priv->dma_addr_bits = (value == RBTC_CTRL_UNMAPPED_VALUE || value < DMA_ADDR_BITS_MIN) ? DMA_ADDR_BITS_MIN : min_t(u32, value, DMA_ADDR_BITS_MAX);
+
+    if (dma_set_mask_and_coherent(&pdev->dev, DMA_BIT_MASK(priv->dma_addr_bits)) != 0)
+    {
+        pr_info("udp-core: %u-bit DMA addresses not available, using 32-bit ones.\n", priv->dma_addr_bits);
+        priv->dma_addr_bits = DMA_ADDR_BITS_MIN;
+        dma_set_mask_and_coherent(&pdev->dev, DMA_BIT_MASK(DMA_ADDR_BITS_MIN));
+    }
+
+    // older bitstreams do not stamp packets
+    udp_core_tstamp_init(priv);
+
+    netdev->min_mtu = ETH_MIN_MTU;
+    netdev->max_mtu = min_t(unsigned int, ETH_JUMBO_MTU,
+            BUFFER_ELEM_SIZE_BYTES(priv->slot_shift_max) - PACKET_HEADER_SIZE_BYTES - PACKET_RX_TRAILER_SIZE_BYTES + IPV4_HLEN + UDP_HLEN
+        );
+
+    /**
+     * NOTE: The UDP checksum is computed by the device over each datagram it
+     * sends, so the stack leaves it unfilled (CHECKSUM_PARTIAL) instead of 
+     * running csum_partial over the payload. The device cannot place a 
+     * checksum at an arbitrary offset, hence NETIF_F_IP_CSUM (UDP over IPv4)
+     * rather than NETIF_F_HW_CSUM. This also lets the stack hand over 
+     * UDP_SEGMENT super-packets (up to 64KB) in a single skb. They are 
+     * segmented by the driver into consecutive TX slots, so the stack shall
+     * segment in software the ones that would not fit in a TX ring.
+     */
+    netdev->features |= NETIF_F_IP_CSUM | NETIF_F_GSO_UDP_L4;
+    netdev->hw_features |= NETIF_F_IP_CSUM | NETIF_F_GSO_UDP_L4;
+
+    #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 19, 0)
+    netif_set_gso_max_segs(netdev, TX_GSO_MAX_SEGS);
+    #else
+    netdev->gso_max_segs = TX_GSO_MAX_SEGS;
+    #endif
+
+    /**
+     * NOTE: Received datagrams of the same flow can be chained by UDP GRO even
+     * for sockets without UDP_GRO (fraglist), once enabled via ethtool 
+     * (rx-gro-list). Merged segments are counted in the ethtool stats.
+     */
+    netdev->features |= NETIF_F_GRO;
+    netdev->hw_features |= NETIF_F_GRO | NETIF_F_GRO_FRAGLIST;
+
+    /**
+     * NOTE: AF_XDP TX runs in copy mode (frames are copied into TX slots), and
+     * so does RX unless the RX descriptor ring is filled with UMEM frames. Thus,
+     * zero-copy is not advertised.
+     */
+    #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    netdev->xdp_features = NETDEV_XDP_ACT_BASIC | NETDEV_XDP_ACT_REDIRECT | NETDEV_XDP_ACT_NDO_XMIT;
+    #endif
+
     retval = register_netdev(netdev);
 
     if (retval < 0)
     {
         pr_err("udp-core: unable to register netdevice.\n");
+        free_percpu(priv->stats);
         free_netdev(netdev);
         return retval;
     }
@@ -748,6 +2098,9 @@ int udp_core_netdev_init(struct platform_device* pdev)
     // register ethtool ops
     netdev->ethtool_ops = &udp_core_ethtool_ops;
 
+    // expose the device time as a PTP clock
+    udp_core_ptp_init(priv);
+
     // init napi structure
     #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 1, 0)
     netif_napi_add(netdev, &priv->napi, udp_core_rx_poll);
@@ -755,45 +2108,258 @@ int udp_core_netdev_init(struct platform_device* pdev)
     netif_napi_add(netdev, &priv->napi, udp_core_rx_poll, NAPI_POLL_WEIGHT);
     #endif
 
+    // tx clean timer (see TX_CLEAN_TIMER_USECS)
+    #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+    hrtimer_setup(&priv->tx_timer, udp_core_netdev_tx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    #else
+    hrtimer_init(&priv->tx_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+    priv->tx_timer.function = udp_core_netdev_tx_timer;
+    #endif
+
     // initially, set the link as off
     netif_carrier_off(netdev);
 
     return 0;
 }
 
+/**
+ * NOTE: The device is reset while it runs, so napi is quiesced meanwhile (as
+ * in set_open_ports) and the list of open ports is read under rtnl.
+ */
 void udp_core_netdev_notify_change(struct platform_device* pdev)
 {
-    unsigned int socket_index;
     unsigned int gw4;
+    bool running;
     struct udp_core_drv_data* drv_data;
+    struct udp_core_netdev_priv* priv;
 
     drv_data = platform_get_drvdata(pdev);
+    priv = netdev_priv(drv_data->ndev);
 
-    // assert device reset
-    udp_core_devmem_write_register(pdev, RBTC_CTRL_ADDR_RES_0_Y_O, 1);
+    rtnl_lock();
 
-    // close all sockets
-    for (socket_index = 0; socket_index < MAX_UDP_PORTS; socket_index++)
-    {
-        udp_core_netdev_clear_socket(drv_data->ndev, socket_index);
-    }
+    running = netif_running(drv_data->ndev);
 
-    // open needed ones
-    for (socket_index = 0; socket_index < drv_data->open_ports.port_opened_num; socket_index++)
+    if (running)
     {
-        udp_core_netdev_open_socket(drv_data->ndev, drv_data->open_ports.port_opened[socket_index]);
+        napi_disable(&priv->napi);
     }
 
+    // assert device reset
+    udp_core_devmem_write_register(pdev, RBTC_CTRL_ADDR_RES_0_Y_O, 1);
+
+    // close all sockets, open needed ones
+    udp_core_netdev_write_sockets(drv_data->ndev, &drv_data->open_ports);
+
     // open ports
     udp_core_devmem_write_register(pdev, RBTC_CTRL_ADDR_UDP_RANGE_L_0_N_O, drv_data->port_low);
     udp_core_devmem_write_register(pdev, RBTC_CTRL_ADDR_UDP_RANGE_H_0_N_O, drv_data->port_high);
 
+    // rx buffers are allocated on open: keep them (and the tx buffer) where they are
+    if (running)
+    {
+        if (udp_core_netdev_rx_buffers(pdev, drv_data->port_low, drv_data->port_high) > priv->rx_buffers)
+        {
+            pr_info("udp-core: port range wider than the rx buffers in memory, restart the interface to listen on all ports.\n");
+        }
+
+        udp_core_devmem_write_register(pdev, RBTC_CTRL_ADDR_RX_BUFFERS_0_N_O, priv->rx_buffers);
+    }
+
     // set gw
     in4_pton(drv_data->gw_ip, strlen(drv_data->gw_ip), (u8*)&gw4, '\0', NULL);
     udp_core_devmem_write_register(pdev, RBTC_CTRL_ADDR_GW_0_N_O, ntohl(gw4));
     
     // deassert device reset
     udp_core_devmem_write_register(pdev, RBTC_CTRL_ADDR_RES_0_Y_O, 0);
+
+    if (running)
+    {
+        napi_enable(&priv->napi);
+    }
+
+    rtnl_unlock();
+}
+
+/**
+ * NOTE: Sockets are opened and closed while the device runs: napi is quiesced
+ * meanwhile, since it walks the list of open ports and writes the same BUFRX 
+ * registers (read-modify-write) to pop packets. The device empties the rx slots
+ * of a socket when it is opened, packed rings are emptied by the driver.
+ */
+void udp_core_netdev_set_open_ports(
+    struct platform_device* pdev, 
+    const struct udp_core_open_ports* open_ports
+)
+{
+    unsigned int socket_index;
+    unsigned int buffer_id;
+    bool running;
+    struct udp_core_drv_data* drv_data;
+    struct udp_core_netdev_priv* priv;
+    DECLARE_BITMAP(opened_old, MAX_UDP_PORTS);
+    DECLARE_BITMAP(opened_new, MAX_UDP_PORTS);
+
+    drv_data = platform_get_drvdata(pdev);
+    priv = netdev_priv(drv_data->ndev);
+
+    bitmap_zero(opened_old, MAX_UDP_PORTS);
+    bitmap_zero(opened_new, MAX_UDP_PORTS);
+
+    for (socket_index = 0; socket_index < drv_data->open_ports.port_opened_num; socket_index++)
+    {
+        if (drv_data->open_ports.port_opened[socket_index] < MAX_UDP_PORTS)
+            set_bit(drv_data->open_ports.port_opened[socket_index], opened_old);
+    }
+
+    for (socket_index = 0; socket_index < open_ports->port_opened_num; socket_index++)
+    {
+        if (open_ports->port_opened[socket_index] < MAX_UDP_PORTS)
+            set_bit(open_ports->port_opened[socket_index], opened_new);
+    }
+
+    // most binds and closes are of ports the device does not receive
+    if (bitmap_equal(opened_old, opened_new, MAX_UDP_PORTS))
+    {
+        return;
+    }
+
+    rtnl_lock();
+
+    running = netif_running(drv_data->ndev);
+
+    if (running)
+    {
+        napi_disable(&priv->napi);
+    }
+
+    // close the sockets no longer listed
+    for_each_set_bit(buffer_id, opened_old, MAX_UDP_PORTS)
+    {
+        if (!test_bit(buffer_id, opened_new))
+        {
+            udp_core_netdev_clear_socket(drv_data->ndev, buffer_id);
+            netdev_dbg(drv_data->ndev, "closed socket %d \n", buffer_id);
+        }
+    }
+
+    // open the new ones
+    for_each_set_bit(buffer_id, opened_new, MAX_UDP_PORTS)
+    {
+        if (!test_bit(buffer_id, opened_old))
+        {
+            if (running)
+            {
+                udp_core_rxpack_flush(drv_data->ndev, buffer_id);
+            }
+
+            udp_core_netdev_open_socket(drv_data->ndev, buffer_id);
+        }
+    }
+
+    memcpy(&drv_data->open_ports, open_ports, sizeof(struct udp_core_open_ports));
+
+    if (running)
+    {
+        napi_enable(&priv->napi);
+    }
+
+    rtnl_unlock();
+}
+
+/**
+ * NOTE: The device looks ports up in the map on every packet, entries are 
+ * rewritten while it runs (unused ones are cleared). A port mapped twice is
+ * delivered to the rx buffer of its first entry.
+ */
+void udp_core_netdev_set_port_map(struct platform_device* pdev)
+{
+    unsigned int entry;
+    struct udp_core_drv_data* drv_data;
+    struct udp_core_netdev_priv* priv;
+    struct udp_core_port_map* port_map;
+
+    drv_data = platform_get_drvdata(pdev);
+    priv = netdev_priv(drv_data->ndev);
+    port_map = &drv_data->port_map;
+
+    if (priv->port_map_entries == 0)
+    {
+        if (port_map->entries != 0)
+            pr_info("udp-core: port map not supported by the device, only the port range is received.\n");
+
+        return;
+    }
+
+    if (port_map->entries > priv->port_map_entries)
+    {
+        pr_info("udp-core: the device maps up to %u ports, the others are ignored.\n", priv->port_map_entries);
+    }
+
+    for (entry = 0; entry < priv->port_map_entries; entry++)
+    {
+        if (entry >= port_map->entries)
+        {
+            udp_core_devmem_write_register(pdev, PORT_MAP_OFFSET(entry), 0);
+            continue;
+        }
+
+        if (netif_running(drv_data->ndev) && port_map->buffer_id[entry] >= priv->rx_buffers)
+        {
+            pr_info("udp-core: port %u mapped beyond the rx buffers in memory, restart the interface to receive it.\n", port_map->port[entry]);
+        }
+
+        udp_core_devmem_write_register(
+                pdev, 
+                PORT_MAP_OFFSET(entry), 
+                PORT_MAP_ENTRY(port_map->port[entry], port_map->buffer_id[entry])
+            );
+    }
+}
+
+/**
+ * NOTE: The rates are written and read back, since older bitstreams (and the
+ * ones without tx queues) ignore them. Queues beyond the ones implemented by the
+ * device are not shaped, their packets go through the last queue.
+ */
+void udp_core_netdev_set_tx_rates(struct platform_device* pdev)
+{
+    u32 queue;
+    u32 value;
+    struct udp_core_drv_data* drv_data;
+    struct udp_core_netdev_priv* priv;
+
+    drv_data = platform_get_drvdata(pdev);
+    priv = netdev_priv(drv_data->ndev);
+
+    // tx queues are only known once open
+    if (!netif_running(drv_data->ndev))
+    {
+        return;
+    }
+
+    for (queue = 0; queue < priv->tx_queues; queue++)
+    {
+        udp_core_devmem_write_register(pdev, TXQ_RATE_OFFSET(queue), drv_data->tx_queue_rate[queue]);
+        udp_core_devmem_read_register(pdev, TXQ_RATE_OFFSET(queue), &value);
+
+        if (value != drv_data->tx_queue_rate[queue] && drv_data->tx_queue_rate[queue] != 0)
+        {
+            pr_info("udp-core: tx queue rates not supported by the device.\n");
+            return;
+        }
+    }
+}
+
+void udp_core_netdev_set_gateway(struct platform_device* pdev)
+{
+    unsigned int gw4;
+    struct udp_core_drv_data* drv_data;
+
+    drv_data = platform_get_drvdata(pdev);
+
+    in4_pton(drv_data->gw_ip, strlen(drv_data->gw_ip), (u8*)&gw4, '\0', NULL);
+    udp_core_devmem_write_register(pdev, RBTC_CTRL_ADDR_GW_0_N_O, ntohl(gw4));
 }
 
 void udp_core_netdev_deinit(struct platform_device* pdev)
@@ -814,7 +2380,10 @@ void udp_core_netdev_deinit(struct platform_device* pdev)
     
     netif_napi_del(&priv->napi);
 
+    udp_core_ptp_deinit(priv);
+
     // unregister and free netdev
     unregister_netdev(drv_data->ndev);
+    free_percpu(priv->stats);
     free_netdev(drv_data->ndev);
 }
@@ -69,11 +69,32 @@ static int udp_core_pkt_compose_classic(
 
     udph = udp_hdr(skb);
 
+    /**
+     * NOTE: The device fills in the UDP checksum of every datagram, so the 
+     * checksum field of the skb is never read and CHECKSUM_PARTIAL needs no
+     * software pass. Only a checksum left to the UDP header can be offloaded
+     * though (e.g. not one of a tunnel or of a raw socket with its own layout).
+     */
+    if (skb->ip_summed == CHECKSUM_PARTIAL &&
+        (skb_checksum_start_offset(skb) != skb_transport_offset(skb) || skb->csum_offset != offsetof(struct udphdr, check)))
+    {
+        return -1;
+    }
+
     /**
      * NOTE: The current version of RTL is not supporting fragmentation
-     * at HW level. Therefore, we need to drop this packet.
+     * at HW level. Therefore, we need to drop this packet. GSO super-packets
+     * are segmented by the driver instead, as long as segments fit.
      */
-    if (ntohs(udph->len) - UDP_HLEN > MAX_PAYLOAD_SIZE)
+    if (skb_is_gso(skb))
+    {
+        if (skb_shinfo(skb)->gso_size > MTU_PAYLOAD_SIZE(skb->dev->mtu))
+        {
+            pr_err("udp-core: gso segment too long! (gso_size = %u)\n", skb_shinfo(skb)->gso_size);
+            return -1;
+        }
+    }
+    else if (ntohs(udph->len) - UDP_HLEN > MTU_PAYLOAD_SIZE(skb->dev->mtu))
     {
 	    pr_err("udp-core: packet too long! (src  = %u)\n", ntohs(udph->len));
         return -1; // packet too long
@@ -84,9 +105,14 @@ static int udp_core_pkt_compose_classic(
     udp_packet->source_ip = ntohl(ip_header->saddr);
     udp_packet->dest_port = ntohs(udph->dest);
     udp_packet->source_port = ntohs(udph->source);
-    udp_packet->payload_size_bytes = ntohs(udph->len) - UDP_HLEN;
     udp_packet->payload = (u64*)UDPHDR_PAYLOAD_DATA(udph);
 
+    // the length field of a super-packet is not reliable, use the skb one
+    if (skb_is_gso(skb))
+        udp_packet->payload_size_bytes = skb->len - (skb_transport_offset(skb) + UDP_HLEN);
+    else
+        udp_packet->payload_size_bytes = ntohs(udph->len) - UDP_HLEN;
+
     return 0;
 }
 
@@ -150,7 +176,7 @@ int udp_core_pkt_compose(
     return retval;
 }
 
-struct udp_packet premade_udp_packet = 
+static const struct udp_packet premade_udp_packet = 
 {
     .dest_mac = IF_DEFAULT_MAC_ADDR,
     .src_mac = GW_MAC_OCTETS,
@@ -166,34 +192,115 @@ struct udp_packet premade_udp_packet =
     .checksum = 0
 };
 
-static void udp_core_pkt_decompose_no_strip(
-    struct sk_buff *skb,
-    struct udp_core_raw_packet* raw_udp_packet,
-    struct udp_packet* udp_packet
+void udp_core_pkt_build_header(
+    struct net_device* netdev,
+    void* frame,
+    struct udp_core_raw_packet* raw_udp_packet
 )
 {
-    u64 payload_size_bytes;
-    struct iphdr *iph;
+    struct udp_packet* udp_packet;
+    struct iphdr* iph;
 
-    // save payload size
-    payload_size_bytes = raw_udp_packet->payload_size_bytes;
+    udp_packet = (struct udp_packet*) frame;
+    iph = (struct iphdr*)((u8*)frame + ETH_HLEN);
 
-    // populate missing UDP fields
-    udp_packet->total_len = htons(IPV4_HLEN + UDP_HLEN + payload_size_bytes);
+    // start from the premade header and populate missing UDP fields
+    memcpy(udp_packet, &premade_udp_packet, PKT_HLEN);
+
+    udp_packet->total_len = htons(IPV4_HLEN + UDP_HLEN + raw_udp_packet->payload_size_bytes);
     udp_packet->source_ip = htonl(raw_udp_packet->source_ip);
     udp_packet->dest_ip = htonl(raw_udp_packet->dest_ip);
     udp_packet->source_port = htons(raw_udp_packet->source_port);
     udp_packet->dest_port = htons(raw_udp_packet->dest_port);
     udp_packet->payload_len = htons(raw_udp_packet->payload_size_bytes + UDP_HLEN);
 
+    if (!(raw_udp_packet->dest_port & PACKET_RX_EXT_HEADER_FLAG))
+    {
+        /**
+         * NOTE: Older bitstreams only deliver addresses and ports, so the rest
+         * of the header is made up and the IP checksum computed here.
+         */
+        udp_packet->checksum = 0;
+        udp_packet->checksum = ip_fast_csum((unsigned char*)iph, IPV4_HLEN / 4);
+        return;
+    }
+
+    // the original header fields are delivered by the device
+    u64_to_ether_addr(PACKET_RX_SOURCE_MAC(raw_udp_packet), udp_packet->src_mac);
+    ether_addr_copy(udp_packet->dest_mac, netdev->dev_addr);
+
+    iph->tos = PACKET_RX_IP_TOS(raw_udp_packet);
+    iph->id = htons(PACKET_RX_IP_ID(raw_udp_packet));
+    iph->frag_off = htons((PACKET_RX_IP_FLAGS(raw_udp_packet) << 13) | PACKET_RX_IP_FRAG_OFFSET(raw_udp_packet));
+    iph->ttl = PACKET_RX_IP_TTL(raw_udp_packet);
+    udp_packet->udp_checksum = htons(PACKET_RX_UDP_CSUM(raw_udp_packet));
+
+    /**
+     * NOTE: IP options are not delivered by the device. The rebuilt header is
+     * identical to the original one (and so is its checksum) only without them.
+     */
+    if (PACKET_RX_IP_IHL(raw_udp_packet) == IPV4_HLEN / 4)
+    {
+        iph->check = htons(PACKET_RX_IP_CSUM(raw_udp_packet));
+    }
+    else
+    {
+        iph->check = 0;
+        iph->check = ip_fast_csum((unsigned char*)iph, IPV4_HLEN / 4);
+    }
+}
+
+void udp_core_pkt_read_trailer(struct udp_core_raw_packet* raw_udp_packet, u32 slot_size)
+{
+    raw_udp_packet->trailer = 0;
+
+    if (!(raw_udp_packet->dest_port & PACKET_RX_EXT_HEADER_FLAG))
+    {
+        return;
+    }
+
+    // the trailer is dropped by the device when it does not fit in the slot
+    if (PACKET_RX_TRAILER_OFFSET(raw_udp_packet->payload_size_bytes) + PACKET_RX_TRAILER_SIZE_BYTES > slot_size)
+    {
+        return;
+    }
+
+    memcpy(
+            &raw_udp_packet->trailer,
+            (u8*)raw_udp_packet->payload + ALIGN(raw_udp_packet->payload_size_bytes, PACKET_WORD_SIZE_BYTES),
+            PACKET_RX_TRAILER_SIZE_BYTES
+        );
+}
+
+int udp_core_pkt_ip_summed(struct udp_core_raw_packet* raw_udp_packet)
+{
+    // only trust the UDP checksum when the device actually verified it
+    if (raw_udp_packet->trailer & PACKET_RX_TRAILER_CSUM_OK)
+    {
+        return CHECKSUM_UNNECESSARY;
+    }
+
+    return CHECKSUM_NONE;
+}
+
+static void udp_core_pkt_decompose_no_strip(
+    struct sk_buff *skb,
+    struct udp_core_raw_packet* raw_udp_packet
+)
+{
+    u64 payload_size_bytes;
+
+    // save payload size
+    payload_size_bytes = raw_udp_packet->payload_size_bytes;
+
     /**
      * NOTE: When populating skb with a put data, all bytes are considered part
      * of data. Therefore part of header should be pull out and headers
      * pointers should be correctly set.
      */
 
-    // copy into socket buffer header and (actual) payload received
-    skb_put_data(skb, udp_packet, PKT_HLEN);
+    // build header into socket buffer and copy (actual) payload received
+    udp_core_pkt_build_header(skb->dev, skb_put(skb, PKT_HLEN), raw_udp_packet);
     skb_put_data(skb, raw_udp_packet->payload, payload_size_bytes);
 
     // reset socket buffer pointer and pull frame header from data
@@ -206,22 +313,12 @@ static void udp_core_pkt_decompose_no_strip(
     // set transport header pointer to network + IPV4_HLEN
     skb_set_transport_header(skb, IPV4_HLEN);
 
-    // set protocol to IPv4 and checksum as unnecessary
+    // set protocol to IPv4 and checksum as verified by the device (if so)
     skb->protocol = htons(ETH_P_IP);
-    skb->ip_summed = CHECKSUM_UNNECESSARY;
+    skb->ip_summed = udp_core_pkt_ip_summed(raw_udp_packet);
 
-    /**
-     * TODO: This checksum should come from device, in the packet header!
-     * 
-     * With the current RTL implementation, IP checksum is removed when
-     * unpacking UDP payload. However, in order to have a valid UDP/IP packet
-     * for SKB, kernel stack requires it. So, let software compute it here
-     * and remove it as soon as it is available from hardware with the other
-     * header information.
-     */
-    
-    iph = ip_hdr(skb);
-    iph->check = ip_fast_csum((unsigned char *)iph, iph->ihl);
+    // hardware timestamp (if enabled)
+    udp_core_tstamp_rx(netdev_priv(skb->dev), skb, raw_udp_packet->trailer);
 
     return;
 }
@@ -236,5 +333,5 @@ void udp_core_pkt_decompose(
      * and build up a valid SKB to be sent to upper layer. Currently 
      * decomposition supports only UDP/IPv4 (without data strip).
      */
-    udp_core_pkt_decompose_no_strip(skb, raw_udp_packet, &premade_udp_packet);
+    udp_core_pkt_decompose_no_strip(skb, raw_udp_packet);
 }
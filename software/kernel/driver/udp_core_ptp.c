@@ -0,0 +1,209 @@
+// SPDX-License-Identifier: GPL-2.0+
+
+/* udp-core-ptp.c
+ *
+ * PTP hardware clock and launch time (SO_TXTIME) offload
+ *
+ * Copyright (C) Accelerat S.r.l.
+ */
+
+#include <linux/netdevice.h>
+#include <linux/platform_device.h>
+#include <linux/ptp_clock_kernel.h>
+#include <linux/math64.h>
+#include <linux/skbuff.h>
+#include <linux/version.h>
+#include <net/pkt_sched.h>
+
+#include "udp_core.h"
+
+/**
+ * NOTE: The device time (see TIMESTAMP_LO in udp_core_regs.h) is exposed as a
+ * PTP hardware clock, so that ptp4l and phc2sys can discipline it. The
+ * frequency is steered by scaling the nominal increment, read once at init,
+ * and written back as the TIMESTAMP_INCR override. The same clock holds back
+ * the packets of the TX queue offloaded by an ETF qdisc until their launch
+ * time (skb->tstamp), which is thus expected in the PHC time base: phc2sys
+ * shall keep the PHC in sync with the clock of the qdisc (e.g. CLOCK_TAI).
+ * Bitstreams with more than one TX queue do not offload launch times.
+ */
+
+#define PTP_MAX_ADJ_PPB                     (500000)
+
+/* -------------------------------------------------------------------------- */
+
+static int udp_core_ptp_adjfine(struct ptp_clock_info* info, long scaled_ppm)
+{
+    u64 delta;
+    u32 incr;
+    struct udp_core_netdev_priv* priv;
+
+    priv = container_of(info, struct udp_core_netdev_priv, ptp_info);
+
+    // scaled_ppm is in ppm with 16 fractional bits
+    delta = div64_u64((u64)priv->ptp_incr_base * abs(scaled_ppm), 1000000ULL << 16);
+    incr = (scaled_ppm < 0) ? priv->ptp_incr_base - delta : priv->ptp_incr_base + delta;
+
+    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_TIMESTAMP_INCR_0_N_IO, incr);
+
+    return 0;
+}
+
+static int udp_core_ptp_adjtime(struct ptp_clock_info* info, s64 delta)
+{
+    struct udp_core_netdev_priv* priv;
+
+    priv = container_of(info, struct udp_core_netdev_priv, ptp_info);
+
+    // writing the upper half adds the offset (two's complement)
+    spin_lock_bh(&priv->tstamp_lock);
+    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_TIMESTAMP_LOAD_LO_0_N_O, lower_32_bits(delta));
+    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_TIMESTAMP_ADJ_HI_0_Y_O, upper_32_bits(delta));
+    spin_unlock_bh(&priv->tstamp_lock);
+
+    return 0;
+}
+
+static int udp_core_ptp_gettime64(struct ptp_clock_info* info, struct timespec64* ts)
+{
+    struct udp_core_netdev_priv* priv;
+
+    priv = container_of(info, struct udp_core_netdev_priv, ptp_info);
+
+    *ts = ns_to_timespec64(udp_core_tstamp_read(priv));
+
+    return 0;
+}
+
+static int udp_core_ptp_settime64(struct ptp_clock_info* info, const struct timespec64* ts)
+{
+    u64 ns;
+    struct udp_core_netdev_priv* priv;
+
+    priv = container_of(info, struct udp_core_netdev_priv, ptp_info);
+    ns = timespec64_to_ns(ts);
+
+    // writing the upper half sets the time
+    spin_lock_bh(&priv->tstamp_lock);
+    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_TIMESTAMP_LOAD_LO_0_N_O, lower_32_bits(ns));
+    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_TIMESTAMP_SET_HI_0_Y_O, upper_32_bits(ns));
+    spin_unlock_bh(&priv->tstamp_lock);
+
+    return 0;
+}
+
+static int udp_core_ptp_enable(struct ptp_clock_info* info, struct ptp_clock_request* request, int on)
+{
+    // no alarms, external timestamps or periodic outputs
+    return -EOPNOTSUPP;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void udp_core_ptp_init(struct udp_core_netdev_priv* priv)
+{
+    u32 value;
+
+    // older bitstreams cannot be steered, nor hold packets back
+    udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_TIMESTAMP_INCR_0_N_IO, &value);
+    priv->ptp_supported = (value != RBTC_CTRL_UNMAPPED_VALUE);
+
+    if (!priv->ptp_supported)
+    {
+        return;
+    }
+
+    // drop the override left by a previous instance, then read the nominal increment
+    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_TIMESTAMP_INCR_0_N_IO, 0);
+    udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_TIMESTAMP_INCR_0_N_IO, &priv->ptp_incr_base);
+
+    priv->ptp_info.owner = THIS_MODULE;
+    snprintf(priv->ptp_info.name, sizeof(priv->ptp_info.name), "%s", DRIVER_NAME);
+    priv->ptp_info.max_adj = PTP_MAX_ADJ_PPB;
+    priv->ptp_info.adjfine = udp_core_ptp_adjfine;
+    priv->ptp_info.adjtime = udp_core_ptp_adjtime;
+    priv->ptp_info.gettime64 = udp_core_ptp_gettime64;
+    priv->ptp_info.settime64 = udp_core_ptp_settime64;
+    priv->ptp_info.enable = udp_core_ptp_enable;
+
+    priv->ptp_clock = ptp_clock_register(&priv->ptp_info, &priv->pfdev->dev);
+
+    // the PHC is optional (e.g. PTP_1588_CLOCK disabled), launch times still work
+    if (IS_ERR_OR_NULL(priv->ptp_clock))
+    {
+        pr_info("udp-core: unable to register the PTP clock.\n");
+        priv->ptp_clock = NULL;
+        return;
+    }
+
+    pr_info("udp-core: PTP clock registered (ptp%d).\n", ptp_clock_index(priv->ptp_clock));
+}
+
+void udp_core_ptp_deinit(struct udp_core_netdev_priv* priv)
+{
+    if (priv->ptp_clock != NULL)
+    {
+        ptp_clock_unregister(priv->ptp_clock);
+        priv->ptp_clock = NULL;
+    }
+}
+
+int udp_core_ptp_clock_index(struct udp_core_netdev_priv* priv)
+{
+    return (priv->ptp_clock != NULL) ? ptp_clock_index(priv->ptp_clock) : -1;
+}
+
+/* -------------------------------------------------------------------------- */
+
+int udp_core_ptp_setup_tc(struct net_device* netdev, enum tc_setup_type type, void* type_data)
+{
+    struct tc_etf_qopt_offload* qopt;
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+
+    if (type != TC_SETUP_QDISC_ETF || !priv->ptp_supported)
+    {
+        return -EOPNOTSUPP;
+    }
+
+    qopt = type_data;
+
+    if (qopt->queue < 0 || qopt->queue >= netdev->real_num_tx_queues)
+    {
+        return -EINVAL;
+    }
+
+    /**
+     * NOTE: The device holds a packet back after the tx queues have been
+     * arbitrated, so the packets of every other queue would wait behind it.
+     * Launch times are therefore only offloaded with a single tx queue, which
+     * can be selected through ethtool (e.g. ethtool -L udpip0 tx 1).
+     */
+    if (qopt->enable && netdev->real_num_tx_queues > 1)
+    {
+        pr_info("udp-core: launch time offload needs a single tx queue (%u in use, see ethtool -L).\n", netdev->real_num_tx_queues);
+        return -EOPNOTSUPP;
+    }
+
+    WRITE_ONCE(priv->tx_launch[qopt->queue], qopt->enable);
+
+    pr_info("udp-core: launch time offload %s on tx queue %d.\n", qopt->enable ? "enabled" : "disabled", qopt->queue);
+
+    return 0;
+}
+
+u64 udp_core_ptp_launch(struct udp_core_netdev_priv* priv, u16 queue, struct sk_buff* skb, struct udp_core_raw_packet* udp_packet)
+{
+    u64 launch_time;
+
+    if (!READ_ONCE(priv->tx_launch[queue]) || priv->tx_queues > 1 || skb->tstamp == 0)
+    {
+        return 0;
+    }
+
+    launch_time = ktime_to_ns(skb->tstamp) & ((1ULL << PACKET_TX_LAUNCH_BITS) - 1);
+    udp_packet->dest_port |= (launch_time << PACKET_TX_LAUNCH_OFFSET);
+
+    return PACKET_TX_LAUNCH_FLAG;
+}
@@ -0,0 +1,399 @@
+// SPDX-License-Identifier: GPL-2.0+
+
+/* udp-core-rxdesc.c
+ *
+ * RX descriptor ring: packets written by the device into driver-supplied pages
+ *
+ * Copyright (C) Accelerat S.r.l.
+ */
+
+#include <linux/netdevice.h>
+#include <linux/platform_device.h>
+#include <linux/dma-mapping.h>
+#include <linux/types.h>
+#include <linux/version.h>
+#include <net/xdp.h>
+#include <net/xdp_sock_drv.h>
+
+#include "udp_core.h"
+
+/**
+ * NOTE: Posted pages are kept in a software ring, in the same order they were
+ * posted. The device consumes them in order too, so each completion refers to
+ * the page at rx_desc_head. Head and tail are free-running counters.
+ * With an AF_XDP pool bound when the ring is set up, UMEM frames are posted
+ * instead (rx_desc_xsk), and packets are delivered in place (zero-copy).
+ */
+
+#define RX_DESC_SLOT(index)     ((index) & (RX_DESC_LENGTH - 1))
+#define RX_DESC_MAX_PAYLOAD(shift) \
+    (BUFFER_ELEM_SIZE_BYTES(shift) - PACKET_HEADER_SIZE_BYTES - PACKET_RX_TRAILER_SIZE_BYTES)
+
+/* -------------------------------------------------------------------------- */
+
+int udp_core_rxdesc_init(struct net_device* netdev)
+{
+    struct udp_core_netdev_priv* priv;
+    #ifdef RX_DESC_MODE_ENABLED
+    u32 value;
+    struct page_pool_params pp_params = { 0 };
+    #endif
+
+    priv = netdev_priv(netdev);
+    priv->rx_desc_mode = false;
+
+    #ifdef RX_DESC_MODE_ENABLED
+    priv->rx_desc_zc = false;
+
+    /**
+     * NOTE: The device writes up to a whole slot at the DMA address of each
+     * UMEM frame (8-byte aligned), and the Ethernet/IPv4/UDP header is rebuilt
+     * within the XDP headroom in front of it. Otherwise, packets are copied 
+     * into UMEM frames from page_pool pages.
+     */
+    if (priv->xsk_pool != NULL &&
+        xsk_pool_get_rx_frame_size(priv->xsk_pool) >= BUFFER_ELEM_SIZE_BYTES(priv->slot_shift) &&
+        IS_ALIGNED(xsk_pool_get_headroom(priv->xsk_pool), PACKET_WORD_SIZE_BYTES))
+    {
+        priv->rx_desc_zc = true;
+    }
+    // the device writes up to a whole slot into each page (jumbo slots do not fit)
+    else if (RX_DESC_HEADROOM + BUFFER_ELEM_SIZE_BYTES(priv->slot_shift) + SKB_DATA_ALIGN(sizeof(struct skb_shared_info)) > PAGE_SIZE)
+    {
+        pr_info("udp-core: rx descriptor mode not available with this MTU, using rx buffers.\n");
+        udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_RXDESC_CTRL_0_N_O, 0);
+        return -EOPNOTSUPP;
+    }
+
+    // enable the mode and read it back (older bitstreams return garbage)
+    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_RXDESC_CTRL_0_N_O, RXDESC_CTRL_ENABLE);
+    udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_RXDESC_CTRL_0_N_O, &value);
+
+    if (value != RXDESC_CTRL_ENABLE)
+    {
+        pr_info("udp-core: rx descriptor mode not supported by device, using rx buffers.\n");
+        priv->rx_desc_zc = false;
+        return -EOPNOTSUPP;
+    }
+
+    priv->rx_desc_head = 0;
+    priv->rx_desc_tail = 0;
+    priv->rx_desc_post_hi = 0;
+
+    if (priv->dma_addr_bits > DMA_ADDR_BITS_MIN)
+        udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_RXDESC_POST_HI_0_N_O, 0);
+
+    if (priv->rx_desc_zc)
+    {
+        priv->rx_desc_mode = true;
+        pr_info("udp-core: rx descriptor mode enabled (zero-copy AF_XDP).\n");
+        return 0;
+    }
+
+    pp_params.order = 0;
+    pp_params.flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV;
+    pp_params.pool_size = RX_DESC_LENGTH;
+    pp_params.nid = NUMA_NO_NODE;
+    pp_params.dev = &priv->pfdev->dev;
+    pp_params.dma_dir = DMA_FROM_DEVICE;
+    pp_params.offset = RX_DESC_HEADROOM;
+    pp_params.max_len = BUFFER_ELEM_SIZE_BYTES(priv->slot_shift);
+
+    priv->page_pool = page_pool_create(&pp_params);
+
+    if (IS_ERR(priv->page_pool))
+    {
+        pr_err("udp-core: unable to create page pool, using rx buffers.\n");
+        priv->page_pool = NULL;
+        udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_RXDESC_CTRL_0_N_O, 0);
+        return -ENOMEM;
+    }
+
+    priv->rx_desc_mode = true;
+
+    pr_info("udp-core: rx descriptor mode enabled.\n");
+    return 0;
+    #else
+    return -EOPNOTSUPP;
+    #endif
+}
+
+void udp_core_rxdesc_deinit(struct net_device* netdev)
+{
+    u32 index;
+    struct page* page;
+    struct xdp_buff* xdp;
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+
+    // disabling the mode flushes the posted buffers in the device
+    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_RXDESC_CTRL_0_N_O, 0);
+
+    if (!priv->rx_desc_mode)
+    {
+        return;
+    }
+
+    for (index = priv->rx_desc_head; index != priv->rx_desc_tail; index++)
+    {
+        page = priv->rx_desc_pages[RX_DESC_SLOT(index)];
+        priv->rx_desc_pages[RX_DESC_SLOT(index)] = NULL;
+
+        if (page != NULL)
+        {
+            page_pool_put_full_page(priv->page_pool, page, false);
+        }
+
+        // UMEM frames go back to the pool they were taken from
+        xdp = priv->rx_desc_xsk[RX_DESC_SLOT(index)];
+        priv->rx_desc_xsk[RX_DESC_SLOT(index)] = NULL;
+
+        if (xdp != NULL)
+        {
+            xsk_buff_free(xdp);
+        }
+    }
+
+    if (priv->page_pool != NULL)
+    {
+        page_pool_destroy(priv->page_pool);
+    }
+
+    priv->page_pool = NULL;
+    priv->rx_desc_zc = false;
+    priv->rx_desc_mode = false;
+}
+
+int udp_core_rxdesc_refill(struct udp_core_netdev_priv* priv)
+{
+    int posted;
+    dma_addr_t dma;
+    struct page* page;
+    struct xdp_buff* xdp;
+
+    posted = 0;
+
+    while (priv->rx_desc_tail - priv->rx_desc_head < RX_DESC_LENGTH)
+    {
+        if (priv->rx_desc_zc)
+        {
+            // an empty fill ring is not an error, userspace kicks us once refilled
+            xdp = xsk_buff_alloc(priv->xsk_pool);
+
+            if (xdp == NULL)
+            {
+                break;
+            }
+
+            priv->rx_desc_xsk[RX_DESC_SLOT(priv->rx_desc_tail)] = xdp;
+            priv->rx_desc_tail++;
+
+            dma = xsk_buff_xdp_get_dma(xdp);
+        }
+        else
+        {
+            page = page_pool_dev_alloc_pages(priv->page_pool);
+
+            if (page == NULL)
+            {
+                UDP_CORE_STATS_ADD(priv, rx_alloc_failed, 1);
+                break;
+            }
+
+            priv->rx_desc_pages[RX_DESC_SLOT(priv->rx_desc_tail)] = page;
+            priv->rx_desc_tail++;
+
+            // pages are already synced for the device by the pool
+            dma = page_pool_get_dma_addr(page) + RX_DESC_HEADROOM;
+        }
+
+        // the upper half is sampled by each post, only rewritten when it changes
+        if (priv->dma_addr_bits > DMA_ADDR_BITS_MIN && upper_32_bits(dma) != priv->rx_desc_post_hi)
+        {
+            priv->rx_desc_post_hi = upper_32_bits(dma);
+            udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_RXDESC_POST_HI_0_N_O, priv->rx_desc_post_hi);
+        }
+
+        udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_RXDESC_POST_0_Y_O, lower_32_bits(dma));
+
+        posted++;
+    }
+
+    return posted;
+}
+
+static int udp_core_rxdesc_complete_xsk(struct udp_core_netdev_priv* priv, struct bpf_prog* xdp_prog, u32 compl)
+{
+    u8* packet_pointer;
+    struct xdp_buff* xdp;
+    struct udp_core_raw_packet raw_udp_packet;
+
+    xdp = priv->rx_desc_xsk[RX_DESC_SLOT(priv->rx_desc_head)];
+    priv->rx_desc_xsk[RX_DESC_SLOT(priv->rx_desc_head)] = NULL;
+
+    #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 10, 0)
+    xsk_buff_dma_sync_for_cpu(xdp);
+    #else
+    xsk_buff_dma_sync_for_cpu(xdp, priv->xsk_pool);
+    #endif
+
+    packet_pointer = xdp->data;
+    memcpy(&raw_udp_packet, packet_pointer, PACKET_HEADER_SIZE_BYTES);
+
+    if (raw_udp_packet.payload_size_bytes > RX_DESC_MAX_PAYLOAD(priv->slot_shift))
+    {
+        priv->ndev->stats.rx_length_errors++;
+        xsk_buff_free(xdp);
+        return UDP_CORE_XDP_CONSUMED;
+    }
+
+    raw_udp_packet.payload = (u64*)(packet_pointer + PACKET_HEADER_SIZE_BYTES);
+    udp_core_pkt_read_trailer(&raw_udp_packet, BUFFER_ELEM_SIZE_BYTES(priv->slot_shift));
+
+    udp_core_netdev_stats_rx(priv, compl & RXDESC_COMPL_INDEX_MASK, raw_udp_packet.payload_size_bytes + PKT_HLEN);
+
+    // the frame is rebuilt in place, as for pages (see below)
+    packet_pointer = packet_pointer + PACKET_HEADER_SIZE_BYTES - PKT_HLEN;
+    udp_core_pkt_build_header(priv->ndev, packet_pointer, &raw_udp_packet);
+
+    xdp->data = packet_pointer;
+    xdp->data_meta = packet_pointer;
+    xdp->data_end = packet_pointer + PKT_HLEN + raw_udp_packet.payload_size_bytes;
+
+    return udp_core_xsk_run_frame(priv, xdp_prog, xdp, &raw_udp_packet);
+}
+
+int udp_core_rxdesc_poll(
+    struct udp_core_netdev_priv* priv,
+    int budget,
+    struct bpf_prog* xdp_prog,
+    struct xsk_buff_pool* xsk_pool,
+    int* xdp_status,
+    bool* xsk_starved
+)
+{
+    u32 compl;
+    u32 frame_len;
+    int processed;
+    int xsk_result;
+    u8* packet_pointer;
+    dma_addr_t dma;
+    struct page* page;
+    struct udp_core_raw_packet raw_udp_packet;
+
+    processed = 0;
+
+    while (processed < budget && priv->rx_desc_head != priv->rx_desc_tail)
+    {
+        // completions cannot be given back, make sure the packet can be delivered
+        if (xsk_pool && !priv->rx_desc_zc && !xsk_buff_can_alloc(xsk_pool, 1))
+        {
+            *xsk_starved = true;
+            break;
+        }
+
+        udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_RXDESC_COMPL_0_N_I, &compl);
+
+        if (!(compl & RXDESC_COMPL_VALID))
+        {
+            break;
+        }
+
+        if (priv->rx_desc_zc)
+        {
+            *xdp_status |= udp_core_rxdesc_complete_xsk(priv, xdp_prog, compl);
+            priv->rx_desc_head++;
+            processed++;
+            continue;
+        }
+
+        page = priv->rx_desc_pages[RX_DESC_SLOT(priv->rx_desc_head)];
+        priv->rx_desc_pages[RX_DESC_SLOT(priv->rx_desc_head)] = NULL;
+        priv->rx_desc_head++;
+        processed++;
+
+        dma = page_pool_get_dma_addr(page);
+        packet_pointer = (u8*)page_address(page) + RX_DESC_HEADROOM;
+
+        // read the device header first, then only the bytes actually written
+        dma_sync_single_range_for_cpu(
+                &priv->pfdev->dev, dma, RX_DESC_HEADROOM,
+                PACKET_HEADER_SIZE_BYTES, DMA_FROM_DEVICE
+            );
+
+        memcpy(&raw_udp_packet, packet_pointer, PACKET_HEADER_SIZE_BYTES);
+
+        if (raw_udp_packet.payload_size_bytes > RX_DESC_MAX_PAYLOAD(priv->slot_shift))
+        {
+            priv->ndev->stats.rx_length_errors++;
+            page_pool_recycle_direct(priv->page_pool, page);
+            continue;
+        }
+
+        // payload and trailer (the latter at the next 8-byte boundary)
+        dma_sync_single_range_for_cpu(
+                &priv->pfdev->dev, dma, RX_DESC_HEADROOM + PACKET_HEADER_SIZE_BYTES,
+                ALIGN(raw_udp_packet.payload_size_bytes, PACKET_WORD_SIZE_BYTES) + PACKET_RX_TRAILER_SIZE_BYTES, 
+                DMA_FROM_DEVICE
+            );
+
+        raw_udp_packet.payload = (u64*)(packet_pointer + PACKET_HEADER_SIZE_BYTES);
+        udp_core_pkt_read_trailer(&raw_udp_packet, BUFFER_ELEM_SIZE_BYTES(priv->slot_shift));
+
+        udp_core_netdev_stats_rx(priv, compl & RXDESC_COMPL_INDEX_MASK, raw_udp_packet.payload_size_bytes + PKT_HLEN);
+
+        // with an AF_XDP pool bound, packets are copied into UMEM frames
+        if (xsk_pool)
+        {
+            xsk_result = udp_core_xsk_run(priv, xsk_pool, xdp_prog, &raw_udp_packet);
+            page_pool_recycle_direct(priv->page_pool, page);
+
+            if (xsk_result < 0)
+            {
+                UDP_CORE_STATS_ADD(priv, rx_dropped, 1);
+                continue;
+            }
+
+            *xdp_status |= xsk_result;
+            continue;
+        }
+
+        /**
+         * NOTE: The Ethernet/IPv4/UDP header is rebuilt in place, overwriting the
+         * tail of the device header (already copied out), so that the frame is
+         * contiguous with the payload and no copy is needed.
+         */
+        frame_len = PKT_HLEN + raw_udp_packet.payload_size_bytes;
+        packet_pointer = packet_pointer + PACKET_HEADER_SIZE_BYTES - PKT_HLEN;
+
+        udp_core_pkt_build_header(priv->ndev, packet_pointer, &raw_udp_packet);
+
+        *xdp_status |= udp_core_xdp_run_page(
+                priv, xdp_prog, page,
+                packet_pointer - (u8*)page_address(page), frame_len,
+                &raw_udp_packet
+            );
+    }
+
+    udp_core_rxdesc_refill(priv);
+
+    // UMEM frames are taken from the fill ring, which only userspace refills
+    if (priv->rx_desc_zc && priv->rx_desc_tail - priv->rx_desc_head < RX_DESC_LENGTH)
+    {
+        *xsk_starved = true;
+
+        if (xsk_uses_need_wakeup(xsk_pool))
+        {
+            return processed;
+        }
+    }
+
+    // nothing posted, keep polling until the pool gets pages back
+    if (priv->rx_desc_head == priv->rx_desc_tail)
+    {
+        return budget;
+    }
+
+    return processed;
+}
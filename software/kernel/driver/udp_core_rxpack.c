@@ -0,0 +1,275 @@
+// SPDX-License-Identifier: GPL-2.0+
+
+/* udp-core-rxpack.c
+ *
+ * RX packed rings: packets written back to back in the per-port rx buffers
+ *
+ * Copyright (C) Accelerat S.r.l.
+ */
+
+#include <linux/netdevice.h>
+#include <linux/platform_device.h>
+#include <linux/dma-mapping.h>
+#include <linux/types.h>
+#include <net/xdp.h>
+#include <net/xdp_sock_drv.h>
+
+#include "udp_core.h"
+
+/**
+ * NOTE: The device keeps the head of each ring (in 64-byte lines) in the upper
+ * bits of the BUFRX register of the port, while the tail is owned by the
+ * driver: it is kept in rx_pack_tail and written back once per burst. Both are
+ * free-running counters; a packet never wraps around the end of the ring (see
+ * udp_core_rxpack_align), so it can be handed over as a contiguous buffer.
+ */
+
+#define RXPACK_RING_MASK(lines)     ((lines) - 1)
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * NOTE: When less than a slot is left before the end of the ring, the device
+ * writes the next packet at the start of the ring instead.
+ */
+static u16 udp_core_rxpack_align(u16 pointer, u32 ring_lines, u32 shift)
+{
+    u32 offset;
+
+    offset = pointer & RXPACK_RING_MASK(ring_lines);
+
+    if (ring_lines - offset < RXPACK_SLOT_LINES(shift))
+    {
+        pointer += ring_lines - offset;
+    }
+
+    return pointer;
+}
+
+static void udp_core_rxpack_write_tail(struct udp_core_netdev_priv* priv, u32 buffer_id, u32 value)
+{
+    value &= (1 << BUFFER_OPENSOCK_OFFSET);
+    value |= (u32)priv->rx_pack_tail[buffer_id] << BUFFER_PACK_OFFSET;
+
+    udp_core_devmem_write_register(priv->pfdev, BUFFER_RX_CTRL_BASE_OFFSET(buffer_id), value);
+}
+
+int udp_core_rxpack_init(struct net_device* netdev)
+{
+    struct udp_core_netdev_priv* priv;
+    #ifdef RX_PACKED_MODE_ENABLED
+    u32 value;
+    #endif
+
+    priv = netdev_priv(netdev);
+    priv->rx_pack_mode = false;
+
+    #ifdef RX_PACKED_MODE_ENABLED
+    // the device ignores the packed mode while the descriptor mode is enabled
+    if (priv->rx_desc_mode)
+    {
+        udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_RXPACK_CTRL_0_N_O, 0);
+        return -EBUSY;
+    }
+
+    // enable the mode and read it back (older bitstreams return garbage)
+    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_RXPACK_CTRL_0_N_O, RXPACK_CTRL_ENABLE);
+    udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_RXPACK_CTRL_0_N_O, &value);
+
+    if (value != RXPACK_CTRL_ENABLE)
+    {
+        pr_info("udp-core: rx packed rings not supported by device, using rx slots.\n");
+        return -EOPNOTSUPP;
+    }
+
+    priv->rx_pack_mode = true;
+
+    pr_info("udp-core: rx packed rings enabled.\n");
+    return 0;
+    #else
+    return -EOPNOTSUPP;
+    #endif
+}
+
+void udp_core_rxpack_deinit(struct net_device* netdev)
+{
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+
+    udp_core_devmem_write_register(priv->pfdev, RBTC_CTRL_ADDR_RXPACK_CTRL_0_N_O, 0);
+    priv->rx_pack_mode = false;
+}
+
+void udp_core_rxpack_flush(struct net_device* netdev, u32 buffer_id)
+{
+    u32 value;
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+
+    if (!priv->rx_pack_mode)
+        return;
+
+    udp_core_devmem_read_register(priv->pfdev, BUFFER_RX_CTRL_BASE_OFFSET(buffer_id), &value);
+
+    priv->rx_pack_tail[buffer_id] = value >> BUFFER_PACK_OFFSET;
+    udp_core_rxpack_write_tail(priv, buffer_id, value);
+}
+
+int udp_core_rxpack_poll(
+    struct udp_core_netdev_priv* priv,
+    int budget,
+    struct bpf_prog* xdp_prog,
+    struct xsk_buff_pool* xsk_pool,
+    int* xdp_status,
+    bool* xsk_starved
+)
+{
+    struct udp_core_drv_data* drv_data_p;
+
+    unsigned int port;
+    unsigned int port_index;
+    unsigned int port_count;
+    unsigned int buffer_id;
+    u32 value;
+    u32 offset;
+    u32 record_len;
+    u32 ring_lines;
+    u16 head;
+    u16 tail;
+    u16 pointer;
+    u8* packet_pointer;
+    struct sk_buff *skb;
+    struct udp_core_raw_packet raw_udp_packet;
+    int xsk_result;
+    int processed;
+    bool packet_found;
+    bool stop;
+
+    drv_data_p = platform_get_drvdata(priv->pfdev);
+    port_count = drv_data_p->open_ports.port_opened_num;
+
+    processed = 0;
+    stop = false;
+
+    if (port_count == 0)
+        return 0;
+
+    do {
+        packet_found = false;
+
+        for (port_index = 0; port_index < port_count && !stop; port_index++)
+        {
+            if (processed >= budget)
+                break;
+
+            // start from a different port at each poll, so that no port starves
+            port = (priv->rx_poll_port + port_index) % port_count;
+
+            buffer_id = drv_data_p->open_ports.port_opened[port];
+            udp_core_devmem_read_register(priv->pfdev, BUFFER_RX_CTRL_BASE_OFFSET(buffer_id), &value);
+
+            head = value >> BUFFER_PACK_OFFSET;
+            tail = priv->rx_pack_tail[buffer_id];
+
+            if (head == tail)
+                continue;
+
+            ring_lines = RXPACK_RING_LINES(priv->rx_ring_shift[buffer_id], priv->slot_shift);
+
+            // drain the port in a burst (see udp_core_rx_poll_buffers)
+            while (tail != head && processed < budget)
+            {
+                packet_found = true;
+
+                pointer = udp_core_rxpack_align(tail, ring_lines, priv->slot_shift);
+                offset = BUFFER_SLOTS_BYTES(priv->rx_ring_base[buffer_id], priv->slot_shift) +
+                    (pointer & RXPACK_RING_MASK(ring_lines)) * RXPACK_LINE_SIZE_BYTES;
+                packet_pointer = (u8*)priv->virt_dma_area + offset;
+
+                dma_sync_single_range_for_cpu(
+                        &priv->pfdev->dev, priv->phys_dma_area, offset,
+                        PACKET_HEADER_SIZE_BYTES, DMA_FROM_DEVICE
+                    );
+
+                memcpy(&raw_udp_packet, packet_pointer, PACKET_HEADER_SIZE_BYTES);
+
+                // same length the device wrote (clamped to a slot)
+                record_len = min_t(u32,
+                        PACKET_RX_TRAILER_OFFSET(raw_udp_packet.payload_size_bytes) + PACKET_RX_TRAILER_SIZE_BYTES,
+                        BUFFER_ELEM_SIZE_BYTES(priv->slot_shift)
+                    );
+
+                dma_sync_single_range_for_cpu(
+                        &priv->pfdev->dev, priv->phys_dma_area, offset + PACKET_HEADER_SIZE_BYTES,
+                        record_len - PACKET_HEADER_SIZE_BYTES, DMA_FROM_DEVICE
+                    );
+
+                // release the lines of the packet once it has been delivered
+                pointer += DIV_ROUND_UP(record_len, RXPACK_LINE_SIZE_BYTES);
+
+                if (PACKET_RX_TRAILER_OFFSET(raw_udp_packet.payload_size_bytes) > BUFFER_ELEM_SIZE_BYTES(priv->slot_shift))
+                {
+                    priv->ndev->stats.rx_length_errors++;
+                    tail = pointer;
+                    continue;
+                }
+
+                raw_udp_packet.payload = (u64*)(packet_pointer + PACKET_HEADER_SIZE_BYTES);
+                udp_core_pkt_read_trailer(&raw_udp_packet, BUFFER_ELEM_SIZE_BYTES(priv->slot_shift));
+
+                // with an AF_XDP pool bound, packets are delivered into UMEM frames
+                if (xsk_pool)
+                {
+                    xsk_result = udp_core_xsk_run(priv, xsk_pool, xdp_prog, &raw_udp_packet);
+
+                    // no UMEM frame available, leave the packet in the ring
+                    if (xsk_result < 0)
+                    {
+                        *xsk_starved = true;
+                        stop = true;
+                        break;
+                    }
+
+                    *xdp_status |= xsk_result;
+                }
+                // let the XDP program (if any) decide before allocating skbs
+                else if (xdp_prog)
+                {
+                    *xdp_status |= udp_core_xdp_run(priv, xdp_prog, &raw_udp_packet);
+                }
+                else
+                {
+                    skb = napi_alloc_skb(&priv->napi, raw_udp_packet.payload_size_bytes + PKT_HLEN);
+                    if (!skb)
+                    {
+                        UDP_CORE_STATS_ADD(priv, rx_alloc_failed, 1);
+                        stop = true;
+                        break;
+                    }
+
+                    udp_core_pkt_decompose(skb, &raw_udp_packet);
+                    udp_core_netdev_gro_receive(priv, skb);
+                }
+
+                udp_core_netdev_stats_rx(priv, buffer_id, raw_udp_packet.payload_size_bytes + PKT_HLEN);
+
+                tail = pointer;
+                processed++;
+            }
+
+            // a single register write releases the whole burst
+            if (tail != priv->rx_pack_tail[buffer_id])
+            {
+                priv->rx_pack_tail[buffer_id] = tail;
+                udp_core_rxpack_write_tail(priv, buffer_id, value);
+            }
+        }
+    }
+    while (packet_found && processed < budget && !stop);
+
+    priv->rx_poll_port = (priv->rx_poll_port + 1) % port_count;
+
+    return processed;
+}
@@ -0,0 +1,355 @@
+// SPDX-License-Identifier: GPL-2.0+
+
+/* udp-core-sockmon.c
+ *
+ * Socket monitor: opens the ports of the UDP sockets bound on the interface
+ *
+ * Copyright (C) Accelerat S.r.l.
+ */
+
+#include <linux/netdevice.h>
+#include <linux/rtnetlink.h>
+#include <linux/platform_device.h>
+#include <linux/kprobes.h>
+#include <linux/workqueue.h>
+#include <linux/bitmap.h>
+#include <linux/slab.h>
+#include <linux/types.h>
+#include <linux/version.h>
+#include <net/sock.h>
+#include <net/udp.h>
+
+#include "udp_core.h"
+
+/**
+ * NOTE: The kernel has no notifier for UDP binds, so the return of
+ * udp_lib_get_port (bind and autobind, IPv4 and IPv6 sockets) and of
+ * udp_lib_unhash (close and disconnect) are hooked with kretprobes. The probes
+ * only schedule a scan of the UDP socket table, for sockets of the namespace
+ * of the interface (saved on entry), which runs from a workqueue:
+ * the ports of the range (or of the port map) bound by a socket (on the local
+ * IP of the interface, or on any address) are opened on top of the ones listed
+ * in OPENED_SOCKETS, the others are closed.
+ */
+
+#define SOCKMON_BIND_SYMBOL     "udp_lib_get_port"
+#define SOCKMON_UNHASH_SYMBOL   "udp_lib_unhash"
+
+/* -------------------------------------------------------------------------- */
+
+#ifdef CONFIG_KRETPROBES
+
+static struct kretprobe* udp_core_sockmon_kretprobe(struct kretprobe_instance* ri)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 11, 0)
+    return get_kretprobe(ri);
+#else
+    return ri->rp;
+#endif
+}
+
+static bool udp_core_sockmon_same_net(struct udp_core_sockmon* sockmon, struct kretprobe_instance* ri)
+{
+    struct sock* sk;
+    struct udp_core_drv_data* drv_data;
+
+    sk = *(struct sock**)ri->data;
+    drv_data = container_of(sockmon, struct udp_core_drv_data, sockmon);
+
+    return net_eq(sock_net(sk), dev_net(drv_data->ndev));
+}
+
+static int udp_core_sockmon_entry_handler(struct kretprobe_instance* ri, struct pt_regs* regs)
+{
+    // both probed functions take the socket as first argument
+    *(struct sock**)ri->data = (struct sock*)regs_get_kernel_argument(regs, 0);
+
+    return 0;
+}
+
+static int udp_core_sockmon_bind_handler(struct kretprobe_instance* ri, struct pt_regs* regs)
+{
+    struct udp_core_sockmon* sockmon;
+
+    // the bind failed, nothing changed
+    if (regs_return_value(regs) != 0)
+        return 0;
+
+    sockmon = container_of(udp_core_sockmon_kretprobe(ri), struct udp_core_sockmon, bind_probe);
+
+    if (udp_core_sockmon_same_net(sockmon, ri))
+        schedule_work(&sockmon->work);
+
+    return 0;
+}
+
+static int udp_core_sockmon_unhash_handler(struct kretprobe_instance* ri, struct pt_regs* regs)
+{
+    struct udp_core_sockmon* sockmon;
+
+    sockmon = container_of(udp_core_sockmon_kretprobe(ri), struct udp_core_sockmon, unhash_probe);
+
+    if (udp_core_sockmon_same_net(sockmon, ri))
+        schedule_work(&sockmon->work);
+
+    return 0;
+}
+
+#endif
+
+/**
+ * NOTE: As in the device, a port found in the port map is received by the rx
+ * buffer of its first entry, otherwise by the one of the port range. 
+ * MAX_UDP_PORTS is returned for ports not received at all.
+ */
+static unsigned int udp_core_sockmon_buffer_id(struct udp_core_drv_data* drv_data, u16 port)
+{
+    unsigned int entry;
+
+    for (entry = 0; entry < drv_data->port_map.entries; entry++)
+    {
+        if (drv_data->port_map.port[entry] == port)
+            return drv_data->port_map.buffer_id[entry];
+    }
+
+    if (port < drv_data->port_low || port > drv_data->port_high || port - drv_data->port_low >= MAX_UDP_PORTS)
+        return MAX_UDP_PORTS;
+
+    return port - drv_data->port_low;
+}
+
+/**
+ * NOTE: IPv6 sockets bound to a specific address hold LOOPBACK4_IPV6 as IPv4
+ * address, so they never match the local IP; IPv6-only sockets bound to any
+ * address are skipped as well.
+ */
+static void udp_core_sockmon_scan_port(
+    struct udp_core_drv_data* drv_data, 
+    struct udp_table* table, 
+    u32 local_ip, 
+    u16 port, 
+    unsigned long* bound
+)
+{
+    struct net* net;
+    struct sock* sk;
+    struct udp_hslot* hslot;
+    unsigned int buffer_id;
+
+    net = dev_net(drv_data->ndev);
+    hslot = udp_hashslot(table, net, port);
+
+    if (hlist_empty(&hslot->head))
+        return;
+
+    spin_lock_bh(&hslot->lock);
+
+    sk_for_each(sk, &hslot->head)
+    {
+        // a slot is shared by the ports hashed to it
+        if (inet_sk(sk)->inet_num != port)
+            continue;
+
+        if (!net_eq(sock_net(sk), net))
+            continue;
+
+        if (sk->sk_bound_dev_if && sk->sk_bound_dev_if != drv_data->ndev->ifindex)
+            continue;
+
+        if (sk->sk_family == AF_INET6 && sk->sk_ipv6only)
+            continue;
+
+        if (sk->sk_rcv_saddr && ntohl(sk->sk_rcv_saddr) != local_ip)
+            continue;
+
+        buffer_id = udp_core_sockmon_buffer_id(drv_data, port);
+
+        if (buffer_id >= MAX_UDP_PORTS)
+            continue;
+
+        set_bit(buffer_id, bound);
+    }
+
+    spin_unlock_bh(&hslot->lock);
+}
+
+/**
+ * NOTE: Only the hash slots of the ports received by the device are looked 
+ * up (the ones of the range and of the port map), not the whole table.
+ */
+static void udp_core_sockmon_scan(struct udp_core_drv_data* drv_data, unsigned long* bound)
+{
+    struct udp_table* table;
+    unsigned int port;
+    unsigned int port_last;
+    unsigned int entry;
+    u32 local_ip;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 2, 0)
+    table = dev_net(drv_data->ndev)->ipv4.udp_table;
+#else
+    table = &udp_table;
+#endif
+
+    // the address the device filters on (host order)
+    udp_core_devmem_read_register(drv_data->pfdev, RBTC_CTRL_ADDR_IP_LOC_0_N_O, &local_ip);
+
+    // ports of the range beyond the rx buffers are not received
+    port_last = min_t(unsigned int, drv_data->port_high, drv_data->port_low + MAX_UDP_PORTS - 1);
+
+    for (port = drv_data->port_low; port <= port_last; port++)
+    {
+        udp_core_sockmon_scan_port(drv_data, table, local_ip, port, bound);
+    }
+
+    for (entry = 0; entry < drv_data->port_map.entries; entry++)
+    {
+        port = drv_data->port_map.port[entry];
+
+        // already looked up along with the range
+        if (port >= drv_data->port_low && port <= port_last)
+            continue;
+
+        udp_core_sockmon_scan_port(drv_data, table, local_ip, port, bound);
+    }
+}
+
+static void udp_core_sockmon_work(struct work_struct* work)
+{
+    struct udp_core_drv_data* drv_data;
+    struct udp_core_open_ports* open_ports;
+    unsigned int socket_index;
+    unsigned int buffer_id;
+    DECLARE_BITMAP(opened, MAX_UDP_PORTS);
+
+    drv_data = container_of(work, struct udp_core_drv_data, sockmon.work);
+
+    open_ports = kzalloc(sizeof(struct udp_core_open_ports), GFP_KERNEL);
+
+    if (open_ports == NULL)
+    {
+        pr_err("udp-core: unable to allocate the list of open sockets.\n");
+        return;
+    }
+
+    bitmap_zero(opened, MAX_UDP_PORTS);
+
+    // the configuration is written by devlink under rtnl
+    rtnl_lock();
+
+    // ports listed through devlink are always open
+    for (socket_index = 0; socket_index < drv_data->config_ports.port_opened_num; socket_index++)
+    {
+        if (drv_data->config_ports.port_opened[socket_index] < MAX_UDP_PORTS)
+            set_bit(drv_data->config_ports.port_opened[socket_index], opened);
+    }
+
+    if (drv_data->auto_open_sockets)
+    {
+        udp_core_sockmon_scan(drv_data, opened);
+    }
+
+    rtnl_unlock();
+
+    for_each_set_bit(buffer_id, opened, MAX_UDP_PORTS)
+    {
+        open_ports->port_opened[open_ports->port_opened_num++] = buffer_id;
+    }
+
+    udp_core_netdev_set_open_ports(drv_data->pfdev, open_ports);
+
+    kfree(open_ports);
+}
+
+/* -------------------------------------------------------------------------- */
+
+int udp_core_sockmon_init(struct platform_device* pdev)
+{
+    struct udp_core_drv_data* drv_data;
+    struct udp_core_sockmon* sockmon;
+    int retval;
+
+    drv_data = platform_get_drvdata(pdev);
+    sockmon = &drv_data->sockmon;
+
+    INIT_WORK(&sockmon->work, udp_core_sockmon_work);
+    sockmon->probes = false;
+
+#ifdef CONFIG_KRETPROBES
+    sockmon->bind_probe.kp.symbol_name = SOCKMON_BIND_SYMBOL;
+    sockmon->bind_probe.entry_handler = udp_core_sockmon_entry_handler;
+    sockmon->bind_probe.handler = udp_core_sockmon_bind_handler;
+    sockmon->bind_probe.data_size = sizeof(struct sock*);
+    sockmon->bind_probe.maxactive = 0;
+
+    retval = register_kretprobe(&sockmon->bind_probe);
+
+    if (retval == 0)
+    {
+        sockmon->unhash_probe.kp.symbol_name = SOCKMON_UNHASH_SYMBOL;
+        sockmon->unhash_probe.entry_handler = udp_core_sockmon_entry_handler;
+        sockmon->unhash_probe.handler = udp_core_sockmon_unhash_handler;
+        sockmon->unhash_probe.data_size = sizeof(struct sock*);
+        sockmon->unhash_probe.maxactive = 0;
+
+        retval = register_kretprobe(&sockmon->unhash_probe);
+
+        if (retval < 0)
+            unregister_kretprobe(&sockmon->bind_probe);
+    }
+
+    sockmon->probes = (retval == 0);
+#else
+    retval = -EOPNOTSUPP;
+#endif
+
+    if (sockmon->probes)
+        pr_info("udp-core: ports of the sockets bound on the interface are opened automatically.\n");
+    else
+        pr_info("udp-core: unable to monitor socket binds (%d), only OPENED_SOCKETS are opened.\n", retval);
+
+    sockmon->ready = true;
+
+    // apply the configured sockets, along with the ones already bound
+    schedule_work(&sockmon->work);
+
+    return 0;
+}
+
+void udp_core_sockmon_update(struct platform_device* pdev)
+{
+    struct udp_core_drv_data* drv_data;
+
+    drv_data = platform_get_drvdata(pdev);
+
+    // applied on init
+    if (drv_data == NULL || !drv_data->sockmon.ready)
+        return;
+
+    schedule_work(&drv_data->sockmon.work);
+}
+
+void udp_core_sockmon_deinit(struct platform_device* pdev)
+{
+    struct udp_core_drv_data* drv_data;
+    struct udp_core_sockmon* sockmon;
+
+    drv_data = platform_get_drvdata(pdev);
+
+    if (drv_data == NULL || !drv_data->sockmon.ready)
+        return;
+
+    sockmon = &drv_data->sockmon;
+
+#ifdef CONFIG_KRETPROBES
+    if (sockmon->probes)
+    {
+        unregister_kretprobe(&sockmon->unhash_probe);
+        unregister_kretprobe(&sockmon->bind_probe);
+        sockmon->probes = false;
+    }
+#endif
+
+    sockmon->ready = false;
+    cancel_work_sync(&sockmon->work);
+}
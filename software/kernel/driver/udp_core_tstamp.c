@@ -0,0 +1,339 @@
+// SPDX-License-Identifier: GPL-2.0+
+
+/* udp-core-tstamp.c
+ *
+ * Hardware timestamps of received and transmitted packets (SO_TIMESTAMPING)
+ *
+ * Copyright (C) Accelerat S.r.l.
+ */
+
+#include <linux/netdevice.h>
+#include <linux/platform_device.h>
+#include <linux/ethtool.h>
+#include <linux/net_tstamp.h>
+#include <linux/skbuff.h>
+#include <linux/bitops.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+#include <linux/version.h>
+
+#include "udp_core.h"
+
+/**
+ * NOTE: The device stamps packets with the nanoseconds elapsed since power on
+ * (see TIMESTAMP_LO in udp_core_regs.h). RX stamps only hold the lower
+ * PACKET_RX_TRAILER_TS_BITS bits: the rest is taken from the device time read
+ * once per NAPI poll, since packets are always handled well within 2^39 ns of
+ * being stamped. TX stamps carry no reference to their packet, so a single
+ * skb is stamped at a time: further requests are skipped until its stamp is
+ * read back (polled from a workqueue, as there is no TX completion interrupt)
+ * or TSTAMP_TX_TIMEOUT_MS elapses.
+ */
+
+#define TSTAMP_TX_TIMEOUT_MS                (1000)
+#define TSTAMP_TX_BUSY                      (0)
+
+/* -------------------------------------------------------------------------- */
+
+u64 udp_core_tstamp_read(struct udp_core_netdev_priv* priv)
+{
+    u32 lo;
+    u32 hi;
+
+    // reading the lower half latches the upper one
+    spin_lock_bh(&priv->tstamp_lock);
+    udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_TIMESTAMP_LO_0_N_I, &lo);
+    udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_TIMESTAMP_HI_0_N_I, &hi);
+    spin_unlock_bh(&priv->tstamp_lock);
+
+    return ((u64)hi << 32) | lo;
+}
+
+static void udp_core_tstamp_tx_release(struct udp_core_netdev_priv* priv)
+{
+    struct sk_buff* skb;
+
+    skb = priv->tstamp_tx_skb;
+    priv->tstamp_tx_skb = NULL;
+
+    dev_kfree_skb_any(skb);
+    clear_bit_unlock(TSTAMP_TX_BUSY, &priv->tstamp_state);
+}
+
+/**
+ * NOTE: On timeout, the stamp may still come (e.g. the packet was dropped by
+ * a full ring and never sent, or it was sent late): the fifo is drained, so
+ * that it is not taken for the stamp of the next packet.
+ */
+static void udp_core_tstamp_tx_work(struct work_struct* work)
+{
+    u32 lo;
+    u32 hi;
+    struct udp_core_netdev_priv* priv;
+    struct skb_shared_hwtstamps hwtstamps;
+
+    priv = container_of(to_delayed_work(work), struct udp_core_netdev_priv, tstamp_work);
+
+    if (priv->tstamp_tx_skb == NULL)
+    {
+        return;
+    }
+
+    udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_TX_TS_HI_0_N_I, &hi);
+
+    if (hi & TX_TS_VALID)
+    {
+        // pops the stamp
+        udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_TX_TS_LO_0_N_I, &lo);
+
+        memset(&hwtstamps, 0, sizeof(hwtstamps));
+        hwtstamps.hwtstamp = ns_to_ktime(((u64)(hi & TX_TS_HI_MASK) << 32) | lo);
+
+        skb_tstamp_tx(priv->tstamp_tx_skb, &hwtstamps);
+        udp_core_tstamp_tx_release(priv);
+        return;
+    }
+
+    if (time_after(jiffies, priv->tstamp_tx_start + msecs_to_jiffies(TSTAMP_TX_TIMEOUT_MS)))
+    {
+        priv->tstamp_tx_timeouts++;
+        udp_core_tstamp_tx_release(priv);
+        return;
+    }
+
+    schedule_delayed_work(&priv->tstamp_work, 1);
+}
+
+static void udp_core_tstamp_tx_drain(struct udp_core_netdev_priv* priv)
+{
+    u32 value;
+    unsigned int entry;
+
+    for (entry = 0; entry < TX_TS_LENGTH; entry++)
+    {
+        udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_TX_TS_HI_0_N_I, &value);
+
+        if (!(value & TX_TS_VALID))
+            break;
+
+        udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_TX_TS_LO_0_N_I, &value);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+
+static int udp_core_tstamp_apply(struct udp_core_netdev_priv* priv, int tx_type, int* rx_filter)
+{
+    if (!priv->tstamp_supported)
+    {
+        return -EOPNOTSUPP;
+    }
+
+    if (tx_type != HWTSTAMP_TX_OFF && tx_type != HWTSTAMP_TX_ON)
+    {
+        return -ERANGE;
+    }
+
+    // every received packet is stamped by the device
+    if (*rx_filter != HWTSTAMP_FILTER_NONE)
+    {
+        *rx_filter = HWTSTAMP_FILTER_ALL;
+    }
+
+    priv->tstamp_tx = (tx_type == HWTSTAMP_TX_ON);
+    priv->tstamp_rx = (*rx_filter == HWTSTAMP_FILTER_ALL);
+
+    return 0;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+
+int udp_core_tstamp_hwtstamp_get(struct net_device* netdev, struct kernel_hwtstamp_config* config)
+{
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+
+    if (!priv->tstamp_supported)
+    {
+        return -EOPNOTSUPP;
+    }
+
+    config->flags = 0;
+    config->tx_type = priv->tstamp_tx ? HWTSTAMP_TX_ON : HWTSTAMP_TX_OFF;
+    config->rx_filter = priv->tstamp_rx ? HWTSTAMP_FILTER_ALL : HWTSTAMP_FILTER_NONE;
+
+    return 0;
+}
+
+int udp_core_tstamp_hwtstamp_set(struct net_device* netdev, struct kernel_hwtstamp_config* config, struct netlink_ext_ack* extack)
+{
+    int rx_filter;
+    int retval;
+
+    rx_filter = config->rx_filter;
+    retval = udp_core_tstamp_apply(netdev_priv(netdev), config->tx_type, &rx_filter);
+
+    if (retval == 0)
+    {
+        config->rx_filter = rx_filter;
+    }
+
+    return retval;
+}
+
+#else
+
+int udp_core_tstamp_ioctl(struct net_device* netdev, struct ifreq* ifr, int cmd)
+{
+    int retval;
+    struct hwtstamp_config config;
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+
+    switch (cmd)
+    {
+        case SIOCSHWTSTAMP:
+
+            if (copy_from_user(&config, ifr->ifr_data, sizeof(config)))
+                return -EFAULT;
+
+            retval = udp_core_tstamp_apply(priv, config.tx_type, &config.rx_filter);
+
+            if (retval < 0)
+                return retval;
+
+            break;
+
+        case SIOCGHWTSTAMP:
+
+            if (!priv->tstamp_supported)
+                return -EOPNOTSUPP;
+
+            config.flags = 0;
+            config.tx_type = priv->tstamp_tx ? HWTSTAMP_TX_ON : HWTSTAMP_TX_OFF;
+            config.rx_filter = priv->tstamp_rx ? HWTSTAMP_FILTER_ALL : HWTSTAMP_FILTER_NONE;
+            break;
+
+        default:
+            return -EOPNOTSUPP;
+    }
+
+    return copy_to_user(ifr->ifr_data, &config, sizeof(config)) ? -EFAULT : 0;
+}
+
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 11, 0)
+int udp_core_tstamp_get_ts_info(struct net_device* netdev, struct kernel_ethtool_ts_info* info)
+#else
+int udp_core_tstamp_get_ts_info(struct net_device* netdev, struct ethtool_ts_info* info)
+#endif
+{
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+
+    info->so_timestamping = SOF_TIMESTAMPING_TX_SOFTWARE |
+                            SOF_TIMESTAMPING_RX_SOFTWARE |
+                            SOF_TIMESTAMPING_SOFTWARE;
+    info->phc_index = -1;
+
+    if (!priv->tstamp_supported)
+    {
+        return 0;
+    }
+
+    info->phc_index = udp_core_ptp_clock_index(priv);
+
+    info->so_timestamping |= SOF_TIMESTAMPING_TX_HARDWARE |
+                             SOF_TIMESTAMPING_RX_HARDWARE |
+                             SOF_TIMESTAMPING_RAW_HARDWARE;
+    info->tx_types = BIT(HWTSTAMP_TX_OFF) | BIT(HWTSTAMP_TX_ON);
+    info->rx_filters = BIT(HWTSTAMP_FILTER_NONE) | BIT(HWTSTAMP_FILTER_ALL);
+
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void udp_core_tstamp_init(struct udp_core_netdev_priv* priv)
+{
+    u32 value;
+
+    spin_lock_init(&priv->tstamp_lock);
+    INIT_DELAYED_WORK(&priv->tstamp_work, udp_core_tstamp_tx_work);
+
+    // older bitstreams do not stamp packets
+    udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_TX_TS_HI_0_N_I, &value);
+    priv->tstamp_supported = (value != RBTC_CTRL_UNMAPPED_VALUE);
+
+    if (priv->tstamp_supported)
+    {
+        pr_info("udp-core: hardware timestamps available.\n");
+    }
+}
+
+void udp_core_tstamp_stop(struct udp_core_netdev_priv* priv)
+{
+    if (!priv->tstamp_supported)
+    {
+        return;
+    }
+
+    cancel_delayed_work_sync(&priv->tstamp_work);
+
+    if (priv->tstamp_tx_skb != NULL)
+    {
+        udp_core_tstamp_tx_release(priv);
+    }
+
+    udp_core_tstamp_tx_drain(priv);
+}
+
+void udp_core_tstamp_refresh(struct udp_core_netdev_priv* priv)
+{
+    if (priv->tstamp_rx)
+    {
+        priv->tstamp_now = udp_core_tstamp_read(priv);
+    }
+}
+
+void udp_core_tstamp_rx(struct udp_core_netdev_priv* priv, struct sk_buff* skb, u64 trailer)
+{
+    u64 delta;
+
+    if (!priv->tstamp_rx || !(trailer & PACKET_RX_TRAILER_TS_PRESENT))
+    {
+        return;
+    }
+
+    // distance from the last device time read, within +/- 2^39 ns
+    delta = (PACKET_RX_TRAILER_TS(trailer) - priv->tstamp_now) & ((1ULL << PACKET_RX_TRAILER_TS_BITS) - 1);
+
+    skb_hwtstamps(skb)->hwtstamp = ns_to_ktime(priv->tstamp_now + sign_extend64(delta, PACKET_RX_TRAILER_TS_BITS - 1));
+}
+
+bool udp_core_tstamp_tx(struct udp_core_netdev_priv* priv, struct sk_buff* skb)
+{
+    if (!priv->tstamp_tx || !(skb_shinfo(skb)->tx_flags & SKBTX_HW_TSTAMP))
+    {
+        return false;
+    }
+
+    if (test_and_set_bit_lock(TSTAMP_TX_BUSY, &priv->tstamp_state))
+    {
+        priv->tstamp_tx_skipped++;
+        return false;
+    }
+
+    skb_shinfo(skb)->tx_flags |= SKBTX_IN_PROGRESS;
+
+    priv->tstamp_tx_skb = skb_get(skb);
+    priv->tstamp_tx_start = jiffies;
+
+    schedule_delayed_work(&priv->tstamp_work, 1);
+
+    return true;
+}
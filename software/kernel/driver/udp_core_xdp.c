@@ -0,0 +1,808 @@
+// SPDX-License-Identifier: GPL-2.0+
+
+/* udp-core-xdp.c
+ *
+ * Native XDP and AF_XDP (XSK) support
+ *
+ * Copyright (C) Accelerat S.r.l.
+ */
+
+#include <linux/etherdevice.h>
+#include <linux/netdevice.h>
+#include <linux/platform_device.h>
+#include <linux/types.h>
+#include <linux/version.h>
+#include <linux/ip.h>
+#include <linux/udp.h>
+#include <linux/bpf.h>
+#include <linux/bpf_trace.h>
+#include <linux/filter.h>
+#include <net/xdp.h>
+#include <net/xdp_sock_drv.h>
+
+#include "udp_core.h"
+
+/**
+ * NOTE: The device does not deliver L2/L3 headers, only the device header
+ * (see 'udp_core_raw_packet') followed by the payload. In order to run XDP
+ * programs, a regular Ethernet/IPv4/UDP frame is synthesized into a page,
+ * leaving XDP_PACKET_HEADROOM in front of it and enough tailroom for the
+ * skb_shared_info, so that XDP_PASS can build an skb around it without copies.
+ */
+
+#define XDP_FRAME_SIZE      (PAGE_SIZE)
+#define XDP_FRAME_MAX_LEN   \
+    (XDP_FRAME_SIZE - XDP_PACKET_HEADROOM - SKB_DATA_ALIGN(sizeof(struct skb_shared_info)))
+
+static struct page* udp_core_xdp_get_page(struct udp_core_netdev_priv* priv)
+{
+    struct page* page;
+
+    page = priv->xdp_page;
+
+    if (page != NULL)
+    {
+        priv->xdp_page = NULL;
+        return page;
+    }
+
+    return dev_alloc_page();
+}
+
+static void udp_core_xdp_recycle_page(struct udp_core_netdev_priv* priv, struct page* page)
+{
+    // keep one spare page, so that dropped frames do not hit the allocator
+    if (priv->xdp_page == NULL)
+    {
+        priv->xdp_page = page;
+        return;
+    }
+
+    put_page(page);
+}
+
+static void udp_core_xdp_release_page(struct udp_core_netdev_priv* priv, struct page* page)
+{
+    // in rx descriptor mode, every page comes from the page_pool
+    if (priv->page_pool != NULL)
+    {
+        page_pool_recycle_direct(priv->page_pool, page);
+        return;
+    }
+
+    udp_core_xdp_recycle_page(priv, page);
+}
+
+static int udp_core_xdp_frame_to_raw(
+    struct net_device* netdev,
+    void* data,
+    u32 len,
+    struct udp_core_raw_packet* udp_packet
+)
+{
+    struct ethhdr* eth;
+    struct iphdr* iph;
+    struct udphdr* udph;
+    u32 udp_len;
+
+    /**
+     * NOTE: The device can only send out UDP over IPv4. Frames produced by
+     * XDP programs (or redirected from other devices) are parsed back into the
+     * device format, everything else is refused.
+     */
+
+    if (len < PKT_HLEN)
+    {
+        return -EINVAL;
+    }
+
+    eth = (struct ethhdr*) data;
+
+    if (eth->h_proto != htons(ETH_P_IP))
+    {
+        return -EINVAL;
+    }
+
+    iph = (struct iphdr*) (eth + 1);
+
+    if (iph->version != IPVERSION || iph->ihl < 5 || iph->protocol != IPPROTO_UDP)
+    {
+        return -EINVAL;
+    }
+
+    if (ETH_HLEN + iph->ihl * 4 + UDP_HLEN > len)
+    {
+        return -EINVAL;
+    }
+
+    udph = (struct udphdr*) ((u8*)iph + iph->ihl * 4);
+    udp_len = ntohs(udph->len);
+
+    if (udp_len < UDP_HLEN || (u8*)udph + udp_len > (u8*)data + len)
+    {
+        return -EINVAL;
+    }
+
+    if (udp_len - UDP_HLEN > MTU_PAYLOAD_SIZE(netdev->mtu))
+    {
+        return -EMSGSIZE;
+    }
+
+    udp_packet->dest_ip = ntohl(iph->daddr);
+    udp_packet->source_ip = ntohl(iph->saddr);
+    udp_packet->dest_port = ntohs(udph->dest);
+    udp_packet->source_port = ntohs(udph->source);
+    udp_packet->payload_size_bytes = udp_len - UDP_HLEN;
+    udp_packet->payload = (u64*)((u8*)udph + UDP_HLEN);
+
+    return 0;
+}
+
+static int udp_core_xdp_xmit_frame(struct net_device* netdev, void* data, u32 len)
+{
+    int retval;
+    struct netdev_queue* txq;
+    struct udp_core_raw_packet udp_packet;
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+    retval = udp_core_xdp_frame_to_raw(netdev, data, len, &udp_packet);
+
+    if (retval < 0)
+    {
+        return retval;
+    }
+
+    // XDP frames go through TX queue 0, shared with the stack: serialize against ndo_start_xmit
+    txq = netdev_get_tx_queue(netdev, 0);
+
+    __netif_tx_lock(txq, smp_processor_id());
+    retval = udp_core_netdev_xmit_raw(netdev, 0, &udp_packet, NULL, 0);
+
+    if (retval == -EBUSY)
+    {
+        UDP_CORE_STATS_ADD(priv, tx_ring_full, 1);
+    }
+
+    __netif_tx_unlock(txq);
+
+    return retval;
+}
+
+/**
+ * NOTE: The device exposes a single RX queue (all port rings are polled by the
+ * same NAPI instance), and XDP frames are sent through TX queue 0 only. 
+ * Therefore, an AF_XDP pool can only be bound to queue 0 and, while bound,
+ * every received packet is delivered through UMEM frames.
+ * In RX descriptor mode, UMEM frames are posted to the device in place of
+ * page_pool pages (zero-copy). Posted buffers are only flushed while the
+ * device is in reset, so a running interface is closed and opened again to
+ * switch between them.
+ */
+
+static int udp_core_xsk_pool_reopen(struct net_device* netdev, struct xsk_buff_pool* pool)
+{
+    int retval;
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+
+    netdev->netdev_ops->ndo_stop(netdev);
+    priv->xsk_pool = pool;
+    retval = netdev->netdev_ops->ndo_open(netdev);
+
+    if (retval < 0)
+    {
+        // as on MTU changes, the interface can still be brought down
+        pr_err("udp-core: unable to reopen the device, bring the interface down.\n");
+        napi_enable(&priv->napi);
+    }
+
+    return retval;
+}
+
+static int udp_core_xsk_pool_enable(struct net_device* netdev, struct xsk_buff_pool* pool)
+{
+    int retval;
+    bool running;
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+
+    if (priv->xsk_pool != NULL)
+    {
+        return -EBUSY;
+    }
+
+    retval = xsk_pool_dma_map(pool, &priv->pfdev->dev, 0);
+
+    if (retval < 0)
+    {
+        pr_err("udp-core: unable to map xsk pool.\n");
+        return retval;
+    }
+
+    running = netif_running(netdev);
+
+    if (running && priv->rx_desc_mode)
+    {
+        retval = udp_core_xsk_pool_reopen(netdev, pool);
+
+        if (retval < 0)
+        {
+            priv->xsk_pool = NULL;
+            xsk_pool_dma_unmap(pool, 0);
+            return retval;
+        }
+
+        pr_info("udp-core: xsk pool bound to queue 0.\n");
+        return 0;
+    }
+
+    // the rx queue memory model changes, quiesce napi meanwhile
+    if (running)
+    {
+        napi_disable(&priv->napi);
+        udp_core_xdp_rxq_deinit(netdev);
+    }
+
+    priv->xsk_pool = pool;
+
+    if (running)
+    {
+        retval = udp_core_xdp_rxq_init(netdev);
+        napi_enable(&priv->napi);
+
+        if (retval < 0)
+        {
+            priv->xsk_pool = NULL;
+            xsk_pool_dma_unmap(pool, 0);
+            return retval;
+        }
+    }
+
+    pr_info("udp-core: xsk pool bound to queue 0.\n");
+    return 0;
+}
+
+static int udp_core_xsk_pool_disable(struct net_device* netdev)
+{
+    bool running;
+    struct xsk_buff_pool* pool;
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+    pool = priv->xsk_pool;
+
+    if (pool == NULL)
+    {
+        return -EINVAL;
+    }
+
+    running = netif_running(netdev);
+
+    // UMEM frames posted to the device are given back to the pool first
+    if (running && priv->rx_desc_mode)
+    {
+        udp_core_xsk_pool_reopen(netdev, NULL);
+    }
+    else if (running)
+    {
+        napi_disable(&priv->napi);
+        udp_core_xdp_rxq_deinit(netdev);
+        priv->xsk_pool = NULL;
+        udp_core_xdp_rxq_init(netdev);
+        napi_enable(&priv->napi);
+    }
+    else
+    {
+        priv->xsk_pool = NULL;
+    }
+
+    xsk_pool_dma_unmap(pool, 0);
+
+    pr_info("udp-core: xsk pool unbound from queue 0.\n");
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+
+int udp_core_xdp_rxq_init(struct net_device* netdev)
+{
+    int retval;
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+
+    retval = xdp_rxq_info_reg(&priv->xdp_rxq, netdev, 0, priv->napi.napi_id);
+
+    if (retval < 0)
+    {
+        pr_err("udp-core: unable to register xdp rx queue.\n");
+        return retval;
+    }
+
+    if (priv->xsk_pool != NULL)
+    {
+        retval = xdp_rxq_info_reg_mem_model(&priv->xdp_rxq, MEM_TYPE_XSK_BUFF_POOL, NULL);
+    }
+    else if (priv->page_pool != NULL)
+    {
+        retval = xdp_rxq_info_reg_mem_model(&priv->xdp_rxq, MEM_TYPE_PAGE_POOL, priv->page_pool);
+    }
+    else
+    {
+        retval = xdp_rxq_info_reg_mem_model(&priv->xdp_rxq, MEM_TYPE_PAGE_SHARED, NULL);
+    }
+
+    if (retval < 0)
+    {
+        pr_err("udp-core: unable to register xdp memory model.\n");
+        xdp_rxq_info_unreg(&priv->xdp_rxq);
+        return retval;
+    }
+
+    if (priv->xsk_pool != NULL)
+    {
+        xsk_pool_set_rxq_info(priv->xsk_pool, &priv->xdp_rxq);
+    }
+
+    return 0;
+}
+
+void udp_core_xdp_rxq_deinit(struct net_device* netdev)
+{
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+
+    if (xdp_rxq_info_is_reg(&priv->xdp_rxq))
+    {
+        xdp_rxq_info_unreg(&priv->xdp_rxq);
+    }
+
+    if (priv->xdp_page != NULL)
+    {
+        put_page(priv->xdp_page);
+        priv->xdp_page = NULL;
+    }
+}
+
+int udp_core_xdp_check_mtu(struct net_device* netdev, struct bpf_prog* prog, unsigned int mtu)
+{
+    if (prog && ETH_HLEN + mtu > XDP_FRAME_MAX_LEN)
+    {
+        return -EINVAL;
+    }
+
+    return 0;
+}
+
+int udp_core_xdp_setup(struct net_device* netdev, struct netdev_bpf* bpf)
+{
+    struct udp_core_netdev_priv* priv;
+    struct bpf_prog* old_prog;
+
+    priv = netdev_priv(netdev);
+
+    switch (bpf->command)
+    {
+        case XDP_SETUP_PROG:
+
+            if (udp_core_xdp_check_mtu(netdev, bpf->prog, netdev->mtu) != 0)
+            {
+                NL_SET_ERR_MSG_MOD(bpf->extack, "MTU too large for XDP");
+                return -EOPNOTSUPP;
+            }
+
+            old_prog = xchg(&priv->xdp_prog, bpf->prog);
+
+            if (old_prog)
+            {
+                bpf_prog_put(old_prog);
+            }
+
+            pr_info("udp-core: xdp program %s.\n", bpf->prog ? "attached" : "detached");
+            return 0;
+
+        case XDP_SETUP_XSK_POOL:
+
+            if (bpf->xsk.queue_id != 0)
+            {
+                return -EINVAL;
+            }
+
+            if (bpf->xsk.pool)
+            {
+                return udp_core_xsk_pool_enable(netdev, bpf->xsk.pool);
+            }
+
+            return udp_core_xsk_pool_disable(netdev);
+
+        default:
+            return -EINVAL;
+    }
+}
+
+int udp_core_xdp_xmit(struct net_device* netdev, int n, struct xdp_frame** frames, u32 flags)
+{
+    int i;
+    int nxmit;
+
+    if (unlikely(flags & ~XDP_XMIT_FLAGS_MASK))
+    {
+        return -EINVAL;
+    }
+
+    // the carrier is turned off before the rings are released (see ndo_stop)
+    if (!netif_running(netdev) || !netif_carrier_ok(netdev))
+    {
+        return -ENETDOWN;
+    }
+
+    nxmit = 0;
+
+    /**
+     * NOTE: Frames are copied into the TX ring, so they can be returned as
+     * soon as they have been written. Frames not transmitted are returned by
+     * the caller.
+     */
+    for (i = 0; i < n; i++)
+    {
+        if (udp_core_xdp_xmit_frame(netdev, frames[i]->data, frames[i]->len) < 0)
+        {
+            break;
+        }
+
+        xdp_return_frame(frames[i]);
+        nxmit++;
+    }
+
+    return nxmit;
+}
+
+int udp_core_xdp_run(
+    struct udp_core_netdev_priv* priv,
+    struct bpf_prog* prog,
+    struct udp_core_raw_packet* raw_udp_packet
+)
+{
+    u32 frame_len;
+    u8* hard_start;
+    struct page* page;
+
+    frame_len = PKT_HLEN + raw_udp_packet->payload_size_bytes;
+
+    if (frame_len > XDP_FRAME_MAX_LEN)
+    {
+        priv->ndev->stats.rx_length_errors++;
+        return UDP_CORE_XDP_CONSUMED;
+    }
+
+    page = udp_core_xdp_get_page(priv);
+
+    if (page == NULL)
+    {
+        UDP_CORE_STATS_ADD(priv, rx_dropped, 1);
+        return UDP_CORE_XDP_CONSUMED;
+    }
+
+    // synthesize the frame (headers + payload) after the XDP headroom
+    hard_start = page_address(page);
+
+    udp_core_pkt_build_header(priv->ndev, hard_start + XDP_PACKET_HEADROOM, raw_udp_packet);
+
+    memcpy(
+            hard_start + XDP_PACKET_HEADROOM + PKT_HLEN,
+            raw_udp_packet->payload,
+            raw_udp_packet->payload_size_bytes
+        );
+
+    return udp_core_xdp_run_page(
+            priv, prog, page, XDP_PACKET_HEADROOM, frame_len,
+            raw_udp_packet
+        );
+}
+
+int udp_core_xdp_run_page(
+    struct udp_core_netdev_priv* priv,
+    struct bpf_prog* prog,
+    struct page* page,
+    u32 offset,
+    u32 len,
+    struct udp_core_raw_packet* raw_udp_packet
+)
+{
+    u32 act;
+    u8* hard_start;
+    struct sk_buff* skb;
+    struct xdp_buff xdp;
+
+    hard_start = page_address(page);
+
+    xdp_init_buff(&xdp, XDP_FRAME_SIZE, &priv->xdp_rxq);
+    xdp_prepare_buff(&xdp, hard_start, offset, len, false);
+
+    act = prog ? bpf_prog_run_xdp(prog, &xdp) : XDP_PASS;
+
+    switch (act)
+    {
+        case XDP_PASS:
+
+            skb = napi_build_skb(hard_start, XDP_FRAME_SIZE);
+
+            if (skb == NULL)
+            {
+                UDP_CORE_STATS_ADD(priv, rx_dropped, 1);
+                break;
+            }
+
+            // the program may have moved the frame boundaries
+            skb_reserve(skb, xdp.data - xdp.data_hard_start);
+            skb_put(skb, xdp.data_end - xdp.data);
+
+            // page_pool pages go back to the pool when the skb is freed
+            if (priv->page_pool != NULL)
+            {
+                #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
+                skb_mark_for_recycle(skb);
+                #else
+                skb_mark_for_recycle(skb, page, priv->page_pool);
+                #endif
+            }
+
+            skb->protocol = eth_type_trans(skb, priv->ndev);
+            skb->ip_summed = udp_core_pkt_ip_summed(raw_udp_packet);
+            udp_core_tstamp_rx(priv, skb, raw_udp_packet->trailer);
+
+            udp_core_netdev_gro_receive(priv, skb);
+            return UDP_CORE_XDP_PASS;
+
+        case XDP_TX:
+
+            if (udp_core_xdp_xmit_frame(priv->ndev, xdp.data, xdp.data_end - xdp.data) < 0)
+            {
+                trace_xdp_exception(priv->ndev, prog, act);
+                UDP_CORE_STATS_ADD(priv, tx_dropped, 1);
+            }
+
+            break;
+
+        case XDP_REDIRECT:
+
+            if (xdp_do_redirect(priv->ndev, &xdp, prog) == 0)
+            {
+                // page is now owned by the redirect target
+                return UDP_CORE_XDP_CONSUMED | UDP_CORE_XDP_REDIR;
+            }
+
+            UDP_CORE_STATS_ADD(priv, rx_dropped, 1);
+            break;
+
+        default:
+            #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
+            bpf_warn_invalid_xdp_action(priv->ndev, prog, act);
+            #else
+            bpf_warn_invalid_xdp_action(act);
+            #endif
+            fallthrough;
+        case XDP_ABORTED:
+            trace_xdp_exception(priv->ndev, prog, act);
+            fallthrough;
+        case XDP_DROP:
+            break;
+    }
+
+    udp_core_xdp_release_page(priv, page);
+    return UDP_CORE_XDP_CONSUMED;
+}
+
+/* -------------------------------------------------------------------------- */
+
+int udp_core_xsk_wakeup(struct net_device* netdev, u32 queue_id, u32 flags)
+{
+    struct udp_core_netdev_priv* priv;
+
+    priv = netdev_priv(netdev);
+
+    if (!netif_running(netdev) || !netif_carrier_ok(netdev))
+    {
+        return -ENETDOWN;
+    }
+
+    if (queue_id != 0 || priv->xsk_pool == NULL)
+    {
+        return -ENXIO;
+    }
+
+    // both RX refill and TX are served by NAPI
+    if (!napi_if_scheduled_mark_missed(&priv->napi))
+    {
+        local_bh_disable();
+        napi_schedule(&priv->napi);
+        local_bh_enable();
+    }
+
+    return 0;
+}
+
+int udp_core_xsk_run(
+    struct udp_core_netdev_priv* priv,
+    struct xsk_buff_pool* pool,
+    struct bpf_prog* prog,
+    struct udp_core_raw_packet* raw_udp_packet
+)
+{
+    u32 frame_len;
+    struct xdp_buff* xdp;
+
+    frame_len = PKT_HLEN + raw_udp_packet->payload_size_bytes;
+
+    if (frame_len > xsk_pool_get_rx_frame_size(pool))
+    {
+        priv->ndev->stats.rx_length_errors++;
+        return UDP_CORE_XDP_CONSUMED;
+    }
+
+    xdp = xsk_buff_alloc(pool);
+
+    if (xdp == NULL)
+    {
+        return -ENOMEM;
+    }
+
+    /**
+     * NOTE: The controller writes packets into the per-port slots, so the
+     * synthesized frame is filled into the UMEM frame here. From this point
+     * on, the frame reaches the socket without further copies.
+     */
+    udp_core_pkt_build_header(priv->ndev, xdp->data, raw_udp_packet);
+
+    memcpy(
+            (u8*)xdp->data + PKT_HLEN,
+            raw_udp_packet->payload,
+            raw_udp_packet->payload_size_bytes
+        );
+
+    xdp->data_end = (u8*)xdp->data + frame_len;
+
+    return udp_core_xsk_run_frame(priv, prog, xdp, raw_udp_packet);
+}
+
+int udp_core_xsk_run_frame(
+    struct udp_core_netdev_priv* priv,
+    struct bpf_prog* prog,
+    struct xdp_buff* xdp,
+    struct udp_core_raw_packet* raw_udp_packet
+)
+{
+    u32 act;
+    struct sk_buff* skb;
+
+    act = prog ? bpf_prog_run_xdp(prog, xdp) : XDP_PASS;
+
+    switch (act)
+    {
+        case XDP_REDIRECT:
+
+            if (xdp_do_redirect(priv->ndev, xdp, prog) == 0)
+            {
+                return UDP_CORE_XDP_CONSUMED | UDP_CORE_XDP_REDIR;
+            }
+
+            UDP_CORE_STATS_ADD(priv, rx_dropped, 1);
+            break;
+
+        case XDP_PASS:
+
+            // UMEM frames belong to the socket, hand a copy to the stack
+            skb = napi_alloc_skb(&priv->napi, xdp->data_end - xdp->data);
+
+            if (skb == NULL)
+            {
+                UDP_CORE_STATS_ADD(priv, rx_alloc_failed, 1);
+                UDP_CORE_STATS_ADD(priv, rx_dropped, 1);
+                break;
+            }
+
+            skb_put_data(skb, xdp->data, xdp->data_end - xdp->data);
+            xsk_buff_free(xdp);
+
+            skb->protocol = eth_type_trans(skb, priv->ndev);
+            skb->ip_summed = udp_core_pkt_ip_summed(raw_udp_packet);
+            udp_core_tstamp_rx(priv, skb, raw_udp_packet->trailer);
+
+            udp_core_netdev_gro_receive(priv, skb);
+            return UDP_CORE_XDP_PASS;
+
+        case XDP_TX:
+
+            if (udp_core_xdp_xmit_frame(priv->ndev, xdp->data, xdp->data_end - xdp->data) < 0)
+            {
+                trace_xdp_exception(priv->ndev, prog, act);
+                UDP_CORE_STATS_ADD(priv, tx_dropped, 1);
+            }
+
+            break;
+
+        default:
+            #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 17, 0)
+            bpf_warn_invalid_xdp_action(priv->ndev, prog, act);
+            #else
+            bpf_warn_invalid_xdp_action(act);
+            #endif
+            fallthrough;
+        case XDP_ABORTED:
+            trace_xdp_exception(priv->ndev, prog, act);
+            fallthrough;
+        case XDP_DROP:
+            break;
+    }
+
+    xsk_buff_free(xdp);
+    return UDP_CORE_XDP_CONSUMED;
+}
+
+bool udp_core_xsk_xmit(struct udp_core_netdev_priv* priv, struct xsk_buff_pool* pool, int budget)
+{
+    u32 tx_slot_full;
+    u32 completed;
+    bool drained;
+    void* data;
+    struct xdp_desc desc;
+    struct netdev_queue* txq;
+    struct udp_core_raw_packet udp_packet;
+
+    completed = 0;
+    drained = false;
+
+    txq = netdev_get_tx_queue(priv->ndev, 0);
+    __netif_tx_lock(txq, smp_processor_id());
+
+    while (completed < budget)
+    {
+        /**
+         * NOTE: A descriptor peeked from the XSK ring cannot be given back, so
+         * make sure a TX slot is available before taking it.
+         */
+        udp_core_devmem_read_register(priv->pfdev, RBTC_CTRL_ADDR_BUFTX_FULL_0_N_I, &tx_slot_full);
+
+        if (tx_slot_full || udp_core_netdev_tx_room(priv, 0) == 0)
+        {
+            break;
+        }
+
+        if (!xsk_tx_peek_desc(pool, &desc))
+        {
+            drained = true;
+            break;
+        }
+
+        data = xsk_buff_raw_get_data(pool, desc.addr);
+
+        if (udp_core_xdp_frame_to_raw(priv->ndev, data, desc.len, &udp_packet) < 0 ||
+            udp_core_netdev_xmit_raw(priv->ndev, 0, &udp_packet, NULL, 0) < 0)
+        {
+            UDP_CORE_STATS_ADD(priv, tx_dropped, 1);
+        }
+
+        completed++;
+    }
+
+    __netif_tx_unlock(txq);
+
+    // frames have been copied into TX slots, they can be completed right away
+    if (completed > 0)
+    {
+        xsk_tx_release(pool);
+        xsk_tx_completed(pool, completed);
+    }
+
+    // there is no TX completion interrupt, userspace has to kick us
+    if (xsk_uses_need_wakeup(pool))
+    {
+        xsk_set_tx_need_wakeup(pool);
+    }
+
+    return drained;
+}
@@ -14,6 +14,22 @@
 #include <linux/ip.h>
 #include <linux/udp.h>
 #include <linux/inet.h>
+#include <linux/version.h>
+#include <linux/u64_stats_sync.h>
+#include <linux/kprobes.h>
+#include <linux/workqueue.h>
+#include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/ethtool.h>
+#include <linux/net_tstamp.h>
+#include <linux/ptp_clock_kernel.h>
+#include <net/pkt_sched.h>
+#include <net/xdp.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+#include <net/page_pool/helpers.h>
+#else
+#include <net/page_pool.h>
+#endif
 
 #include "udp_core_regs.h"
 
@@ -30,23 +46,79 @@
  */
 #define NON_RAW_USAGE_ENABLED 1
 
+/**
+ * NOTE: Lets the device write received packets straight into pages posted by
+ * the driver (RX descriptor mode), so that skbs are built around them without
+ * copies and pages are recycled through a page_pool. The mode is only used
+ * when the bitstream supports it; otherwise the per-port rx buffers are used.
+ */
+#define RX_DESC_MODE_ENABLED 1
+
+/**
+ * NOTE: When the RX descriptor mode is not used, lets the device pack received
+ * packets back to back (64-byte aligned) in the per-port rx buffers instead of
+ * taking a whole slot for each one, so that small packets use far less memory
+ * and cache. The mode is only used when the bitstream supports it.
+ */
+#define RX_PACKED_MODE_ENABLED 1
+
+/**
+ * NOTE: Lets the device fetch the payload of transmitted skbs straight from
+ * the skb data (mapped for DMA), instead of copying it into the TX slot. Only
+ * payloads of at least TX_EXT_PAYLOAD_MIN_SIZE bytes are sent this way, since
+ * mapping and completion tracking cost more than copying small payloads.
+ */
+#define TX_EXT_PAYLOAD_ENABLED 1
+#define TX_EXT_PAYLOAD_MIN_SIZE             (256)
+
+/**
+ * NOTE: A TX queue is stopped as soon as fewer than TX_STOP_THRESHOLD slots are
+ * left (see udp_core_netdev_xmit_raw), so that the next skb always fits: a
+ * super-packet takes up to TX_GSO_MAX_SEGS slots. There is no TX completion
+ * interrupt, so NAPI is scheduled every TX_CLEAN_TIMER_USECS while a queue is
+ * stopped, and wakes it up once at least TX_WAKE_THRESHOLD slots are free.
+ */
+#define TX_GSO_MAX_SEGS                     (BUFFER_TX_LENGTH / 2 - 1)
+#define TX_STOP_THRESHOLD                   (TX_GSO_MAX_SEGS + 1)
+#define TX_WAKE_THRESHOLD                   (BUFFER_TX_LENGTH / 2)
+#define TX_CLEAN_TIMER_USECS                (20)
+
+/**
+ * NOTE: With adaptive RX interrupt moderation, the packet rate is measured by
+ * NAPI over windows of RX_COAL_ADAPT_WINDOW_MS, and the moderation is moved
+ * to the level matching it (see udp_core_irq.c): an interrupt per packet at 
+ * low rates, for latency, and fewer interrupts as the rate grows.
+ */
+#define RX_COAL_ADAPT_WINDOW_MS             (100)
+
 /* Macros ------------------------------------------------------------------- */
 
 #define ETH_ALEN	        6		        /* Octets in one ethernet addr */
 #define ETH_ADDR_STR_LEN    18              /* "xx:xx:xx:xx:xx:xx" + '\0' */
 #define ETH_MTU             1500            /* MTU supported on physical IF */
+#define ETH_JUMBO_MTU       9000            /* Max MTU, with large enough slots */
 
 #define IPV4_HLEN (sizeof(struct iphdr))
 #define UDP_HLEN (sizeof(struct udphdr))
 #define PKT_HLEN (ETH_HLEN + IPV4_HLEN + UDP_HLEN)
 
 #define MAX_PAYLOAD_SIZE    (1500 - IPV4_HLEN - UDP_HLEN)
+#define MTU_PAYLOAD_SIZE(mtu) ((mtu) - IPV4_HLEN - UDP_HLEN)
+
+/**
+ * NOTE: In RX descriptor mode, the device header is written at RX_DESC_HEADROOM
+ * (8-byte aligned, as required by the DMA engine) and the Ethernet/IPv4/UDP 
+ * header is rebuilt in place right before the payload. The resulting frame
+ * keeps at least XDP_PACKET_HEADROOM in front of it.
+ */
+#define RX_DESC_HEADROOM    (XDP_PACKET_HEADROOM + 8)
 
 /* Devlink params default values - Changeable via devlink ------------------- */
 
 #define DEFAULT_PORT_RANGE_LOWER 7400
 #define DEFAULT_PORT_RANGE_UPPER 7500
 #define DEFAULT_OPENED_SOCKETS {0, 1, 10, 11}
+#define DEFAULT_AUTO_OPEN_SOCKETS true
 
 #define GW_IP "192.168.1.2"
 #define GW_MAC "02:00:00:00:00:01"
@@ -65,6 +137,31 @@ struct udp_core_open_ports
     u16 port_opened[MAX_UDP_PORTS];
 };
 
+/**
+ * NOTE: UDP ports delivered to a given rx buffer, on top of the port range 
+ * (see PORT_MAP in udp_core_regs.h)
+ */
+struct udp_core_port_map
+{
+    u16 entries;
+    u16 port[PORT_MAP_ENTRIES_MAX];
+    u16 buffer_id[PORT_MAP_ENTRIES_MAX];
+};
+
+/**
+ * NOTE: Tracks the UDP sockets bound on the interface, see udp_core_sockmon.c
+ */
+struct udp_core_sockmon
+{
+    struct work_struct          work;
+#ifdef CONFIG_KRETPROBES
+    struct kretprobe            bind_probe;
+    struct kretprobe            unhash_probe;
+#endif
+    bool                        probes;
+    bool                        ready;
+};
+
 struct udp_core_drv_data 
 {
     struct device*              dev;
@@ -76,15 +173,42 @@ struct udp_core_drv_data
 
     struct regmap*              map;
     struct devlink_region*      region;
+    struct devlink_region*      counters_region;
 
     u16                         port_low;
     u16                         port_high;
     struct udp_core_open_ports  open_ports;
+    struct udp_core_open_ports  config_ports;
+    struct udp_core_port_map    port_map;
+    bool                        auto_open_sockets;
+    struct udp_core_sockmon     sockmon;
+    u16                         rx_ring_depth[MAX_UDP_PORTS];
+    u32                         tx_queue_weight[TX_QUEUES_MAX];
+    bool                        tx_queue_dwrr;
+    u32                         tx_queue_rate[TX_QUEUES_MAX];
     char                        gw_ip[INET_ADDRSTRLEN];
     char                        local_ip[INET_ADDRSTRLEN];
     char                        gw_mac[ETH_ADDR_STR_LEN];
 };
 
+/**
+ * NOTE: Traffic counters are kept per CPU, since the TX path runs on any CPU
+ * (under the lock of the TX queue only). They are summed up on read, by
+ * ndo_get_stats64 and the ethtool stats.
+ */
+struct udp_core_pcpu_stats
+{
+    u64                         rx_packets;
+    u64                         rx_bytes;
+    u64                         rx_dropped;
+    u64                         rx_alloc_failed;
+    u64                         tx_packets;
+    u64                         tx_bytes;
+    u64                         tx_dropped;
+    u64                         tx_ring_full;
+    struct u64_stats_sync       syncp;
+};
+
 struct udp_core_netdev_priv 
 {
     struct device*              dev;
@@ -93,9 +217,98 @@ struct udp_core_netdev_priv
 
     dma_addr_t                  phys_dma_area;
     void*                       virt_dma_area;
+    size_t                      dma_area_size;
+    u32                         slot_shift;
+    u32                         slot_shift_max;
+    u32                         rx_buffers;
+    u32                         rx_depth_shift_max;
+    u32                         rx_ring_base[MAX_UDP_PORTS];
+    u8                          rx_ring_shift[MAX_UDP_PORTS];
+    u32                         tx_ring_base;
+    u32                         tx_queues;
+    u32                         tx_channels;    // tx queues asked through ethtool (0: all)
     struct napi_struct          napi;
+
+    struct bpf_prog*            xdp_prog;
+    struct xdp_rxq_info         xdp_rxq;
+    struct page*                xdp_page;
+    struct xsk_buff_pool*       xsk_pool;
+
+    bool                        rx_desc_mode;
+    bool                        rx_desc_zc;
+    struct page_pool*           page_pool;
+    struct page*                rx_desc_pages[RX_DESC_LENGTH];
+    struct xdp_buff*            rx_desc_xsk[RX_DESC_LENGTH];
+    u32                         rx_desc_head;
+    u32                         rx_desc_tail;
+    u32                         rx_desc_post_hi;
+
+    bool                        rx_pack_mode;
+    u16                         rx_pack_tail[MAX_UDP_PORTS];
+
+    bool                        opensock_map_supported;
+    u32                         opensock_map[OPENSOCK_MAP_REGS];
+
+    u32                         port_map_entries;
+
+    u32                         dma_addr_bits;
+
+    bool                        tstamp_supported;
+    bool                        tstamp_rx;
+    bool                        tstamp_tx;
+    u64                         tstamp_now;
+    spinlock_t                  tstamp_lock;
+    unsigned long               tstamp_state;
+    struct sk_buff*             tstamp_tx_skb;
+    unsigned long               tstamp_tx_start;
+    struct delayed_work         tstamp_work;
+    u64                         tstamp_tx_skipped;
+    u64                         tstamp_tx_timeouts;
+
+    bool                        ptp_supported;
+    u32                         ptp_incr_base;
+    struct ptp_clock*           ptp_clock;
+    struct ptp_clock_info       ptp_info;
+    bool                        tx_launch[TX_QUEUES_MAX];
+
+    struct sk_buff*             tx_skbs[TX_QUEUES_MAX][BUFFER_TX_LENGTH];
+    dma_addr_t                  tx_dma[TX_QUEUES_MAX][BUFFER_TX_LENGTH];
+    u32                         tx_dma_len[TX_QUEUES_MAX][BUFFER_TX_LENGTH];
+    u32                         tx_clean[TX_QUEUES_MAX];
+    u32                         tx_pending[TX_QUEUES_MAX];
+    struct hrtimer              tx_timer;
+
+    bool                        rx_coal_supported;
+    bool                        rx_coal_adaptive;
+    u32                         rx_coal_usecs;
+    u32                         rx_coal_frames;
+    u32                         rx_coal_level;
+    u32                         rx_coal_packets;
+    unsigned long               rx_coal_window_start;
+
+    unsigned int                rx_poll_port;
+    u64                         rx_gro_packets;
+    u64                         rx_gro_merged;
+    u64                         rx_budget_exhausted;
+    u64                         rx_port_packets[MAX_UDP_PORTS];
+    u64                         rx_port_bytes[MAX_UDP_PORTS];
+
+    struct udp_core_pcpu_stats __percpu* stats;
 };
 
+/**
+ * NOTE: Updates a per-CPU counter. It shall be used with preemption disabled
+ * (from NAPI or with the TX queue lock held).
+ */
+#define UDP_CORE_STATS_ADD(priv, field, value)                  \
+    do {                                                        \
+        struct udp_core_pcpu_stats* __stats;                    \
+        __stats = this_cpu_ptr((priv)->stats);                  \
+        u64_stats_update_begin(&__stats->syncp);                \
+        __stats->field += (value);                              \
+        u64_stats_update_end(&__stats->syncp);                  \
+    } while (0)
+
 /* Standard packets --------------------------------------------------------- */
 
 struct __attribute__((packed)) udp_packet
@@ -133,6 +346,8 @@ struct __attribute__((packed)) eth_packet
 /* Forward decls ------------------------------------------------------------ */
 
 struct sk_buff;
+struct xsk_buff_pool;
+struct page_pool;
 
 /* Devlink ------------------------------------------------------------------ */
 
@@ -179,6 +394,27 @@ int udp_core_irq_init(struct platform_device* pdev);
 
 void udp_core_irq_deinit(struct platform_device* pdev);
 
+/**
+ * @brief Program the RX interrupt moderation of the device
+ * 
+ * The device raises the interrupt once frames packets have been received, or
+ * usecs microseconds after the first packet not notified yet (with usecs set
+ * to 0, for each packet). Returns -EOPNOTSUPP when the bitstream does not 
+ * support the moderation, zero otherwise.
+ */
+
+int udp_core_irq_set_coalesce(struct udp_core_netdev_priv* priv, u32 usecs, u32 frames);
+
+/**
+ * @brief Feed the adaptive RX interrupt moderation
+ * 
+ * Called by NAPI with the packets processed in each poll. Once per window, 
+ * the measured packet rate selects the moderation level programmed in the
+ * device. Does nothing unless adaptive moderation is enabled.
+ */
+
+void udp_core_irq_adapt_coalesce(struct udp_core_netdev_priv* priv, int processed);
+
 /* Registers ---------------------------------------------------------------- */
 
 /**
@@ -237,6 +473,46 @@ int udp_core_netdev_init(struct platform_device* pdev);
  */
 void udp_core_netdev_notify_change(struct platform_device* pdev);
 
+/**
+ * @brief Opens and closes sockets to match a new list of open ports
+ * 
+ * This function compares the new list with the one in use and only opens or
+ * closes the sockets that changed, without resetting the device, so that the
+ * traffic of the other ports is not disturbed. The new list is then kept in
+ * the driver data.
+ */
+void udp_core_netdev_set_open_ports(
+    struct platform_device* pdev, 
+    const struct udp_core_open_ports* open_ports
+);
+
+/**
+ * @brief Applies the port map configured in the driver data
+ * 
+ * This function writes the port map to the device, which can be done without
+ * resetting it. Rx buffers are laid out on open: a port mapped to an rx 
+ * buffer beyond the ones in memory is only received after the interface is 
+ * restarted.
+ */
+void udp_core_netdev_set_port_map(struct platform_device* pdev);
+
+/**
+ * @brief Applies the gateway configured in the driver data
+ * 
+ * This function writes the gateway IP to the device, which can be done 
+ * without resetting it.
+ */
+void udp_core_netdev_set_gateway(struct platform_device* pdev);
+
+/**
+ * @brief Applies the tx queue rates configured in the driver data
+ * 
+ * This function writes the rate of each tx queue to the device, which can be
+ * done without resetting it. While the interface is down, the rates are 
+ * written when it is opened.
+ */
+void udp_core_netdev_set_tx_rates(struct platform_device* pdev);
+
 /**
  * @brief Deregister the netdev and free the memory
  * 
@@ -244,6 +520,52 @@ void udp_core_netdev_notify_change(struct platform_device* pdev);
  */
 void udp_core_netdev_deinit(struct platform_device* pdev);
 
+/**
+ * @brief Write an already composed packet into a TX ring and transmit it
+ * 
+ * This function writes the header of the given packet into the next free slot
+ * of the given TX queue and notifies the device. The payload is copied into the slot too, 
+ * unless skb is given (and holds the payload): then the device fetches it 
+ * from the skb. On success, the TX ring takes over the skb (released when the
+ * slot is cleaned, or right away if the payload had to be copied anyway).
+ * Returns zero on success, -EBUSY when the TX ring is full. Callers shall 
+ * serialize against the TX queue.
+ */
+int udp_core_netdev_xmit_raw(struct net_device* netdev, u16 queue, struct udp_core_raw_packet* udp_packet, struct sk_buff* skb, u64 flags);
+
+/**
+ * @brief Release the skbs of the TX slots already read by the device
+ * 
+ * This function unmaps and frees the skbs whose payload has been fetched by
+ * the device from the given TX queue (all of them when force is set, i.e.
+ * with the device in reset). Callers shall serialize against the TX queue.
+ */
+void udp_core_netdev_tx_clean(struct net_device* netdev, u16 queue, bool force);
+
+/**
+ * @brief Number of free slots of the given TX queue
+ * 
+ * This function returns how many slots can be filled before the ones already
+ * fetched by the device are released with udp_core_netdev_tx_clean().
+ */
+u32 udp_core_netdev_tx_room(struct udp_core_netdev_priv* priv, u16 queue);
+
+/**
+ * @brief Account a packet received on the given port
+ * 
+ * This function updates the per-CPU traffic counters and the ones of the port
+ * (exposed through ethtool stats). It shall only be called from NAPI.
+ */
+void udp_core_netdev_stats_rx(struct udp_core_netdev_priv* priv, u32 buffer_id, u32 bytes);
+
+/**
+ * @brief Hand a received skb to GRO
+ * 
+ * This function passes the given skb to napi_gro_receive() and keeps track of
+ * the packets merged by GRO (exposed through ethtool stats).
+ */
+void udp_core_netdev_gro_receive(struct udp_core_netdev_priv* priv, struct sk_buff* skb);
+
 /**
  * @brief Start data read from device
  * 
@@ -272,4 +594,352 @@ int udp_core_pkt_compose(struct sk_buff* skb, struct udp_core_raw_packet* udp_pa
  */
 void udp_core_pkt_decompose(struct sk_buff* skb, struct udp_core_raw_packet* raw_udp_packet);
 
+/**
+ * @brief Build the Ethernet/IPv4/UDP header of a packet received from FPGA
+ * 
+ * This function writes PKT_HLEN bytes into the given frame, populating the
+ * L2/L3/L4 headers from the device packet header. When the device delivers
+ * the extended header, the original fields (checksums included) are used;
+ * otherwise the IP checksum is computed here.
+ */
+void udp_core_pkt_build_header(struct net_device* netdev, void* frame, struct udp_core_raw_packet* raw_udp_packet);
+
+/**
+ * @brief Read the trailer word of a packet received from FPGA
+ * 
+ * This function reads the trailer placed by the device after the payload 
+ * (UDP checksum verification result) into the raw packet. The trailer is
+ * zero when the device does not deliver it (or it did not fit in a slot of
+ * 'slot_size' bytes). The payload pointer shall be set.
+ */
+void udp_core_pkt_read_trailer(struct udp_core_raw_packet* raw_udp_packet, u32 slot_size);
+
+/**
+ * @brief Get the skb checksum status of a packet received from FPGA
+ * 
+ * This function returns CHECKSUM_UNNECESSARY when the device verified the
+ * UDP checksum of the packet, CHECKSUM_NONE otherwise.
+ */
+int udp_core_pkt_ip_summed(struct udp_core_raw_packet* raw_udp_packet);
+
+/* RX descriptor ring ------------------------------------------------------- */
+
+/**
+ * @brief Enable the RX descriptor mode and create the page_pool
+ * 
+ * This function should be called while the device is in reset. It enables
+ * the descriptor mode and checks that the device supports it. With an AF_XDP
+ * pool bound, UMEM frames are posted instead of pages (no page_pool is
+ * created). Returns zero on success, a negative errno when the per-port rx
+ * buffers shall be used.
+ */
+int udp_core_rxdesc_init(struct net_device* netdev);
+
+/**
+ * @brief Disable the RX descriptor mode and release all pages
+ * 
+ * This function should be called while the device is in reset, after NAPI 
+ * has been disabled and the XDP RX queue unregistered.
+ */
+void udp_core_rxdesc_deinit(struct net_device* netdev);
+
+/**
+ * @brief Post free pages to the device
+ * 
+ * This function posts pages from the page_pool (UMEM frames from the AF_XDP
+ * pool in zero-copy mode) until the ring is full, or no buffer is available.
+ * Returns the number of buffers posted.
+ */
+int udp_core_rxdesc_refill(struct udp_core_netdev_priv* priv);
+
+/**
+ * @brief Process the packets completed by the device
+ * 
+ * This function processes up to budget completions, building skbs around the
+ * posted pages (or running the XDP program on them), then refills the ring.
+ * Returns the number of packets processed (budget when no page could be 
+ * posted, so that NAPI keeps polling) and ORs UDP_CORE_XDP_* flags into
+ * xdp_status. xsk_starved is set when no UMEM frame is available.
+ */
+int udp_core_rxdesc_poll(
+    struct udp_core_netdev_priv* priv, 
+    int budget, 
+    struct bpf_prog* xdp_prog, 
+    struct xsk_buff_pool* xsk_pool,
+    int* xdp_status,
+    bool* xsk_starved
+);
+
+/* RX packed rings --------------------------------------------------------- */
+
+/**
+ * @brief Enable the RX packed ring mode
+ * 
+ * This function should be called while the device is in reset, after the RX
+ * descriptor mode has been set up (which takes precedence). Returns zero on 
+ * success, a negative errno when the rx slots shall be used.
+ */
+int udp_core_rxpack_init(struct net_device* netdev);
+
+/**
+ * @brief Disable the RX packed ring mode
+ * 
+ * This function should be called while the device is in reset.
+ */
+void udp_core_rxpack_deinit(struct net_device* netdev);
+
+/**
+ * @brief Discard the packets left in the packed ring of a port
+ * 
+ * This function moves the tail of the ring to its head. It should be called
+ * right before a socket is opened while the device is running, as the device
+ * only empties the rx slots of the port by itself.
+ */
+void udp_core_rxpack_flush(struct net_device* netdev, u32 buffer_id);
+
+/**
+ * @brief Process the packets written to the packed rings of the open ports
+ * 
+ * This function processes up to budget packets, as udp_core_rxdesc_poll does,
+ * and releases the ring space of each port with a single register write.
+ */
+int udp_core_rxpack_poll(
+    struct udp_core_netdev_priv* priv, 
+    int budget, 
+    struct bpf_prog* xdp_prog, 
+    struct xsk_buff_pool* xsk_pool,
+    int* xdp_status,
+    bool* xsk_starved
+);
+
+/* XDP ---------------------------------------------------------------------- */
+
+#define UDP_CORE_XDP_PASS       (0)
+#define UDP_CORE_XDP_CONSUMED   (1 << 0)
+#define UDP_CORE_XDP_REDIR      (1 << 1)
+
+/**
+ * @brief Register the XDP RX queue information of the device
+ * 
+ * This function should be called when the interface is brought up, after
+ * NAPI has been enabled.
+ */
+int udp_core_xdp_rxq_init(struct net_device* netdev);
+
+/**
+ * @brief Unregister the XDP RX queue information of the device
+ * 
+ * This function should be called when the interface is brought down. It also
+ * releases the spare page kept for XDP frames.
+ */
+void udp_core_xdp_rxq_deinit(struct net_device* netdev);
+
+/**
+ * @brief Handle XDP commands (ndo_bpf)
+ * 
+ * This function attaches/detaches the XDP program run by the RX path.
+ */
+int udp_core_xdp_setup(struct net_device* netdev, struct netdev_bpf* bpf);
+
+/**
+ * @brief Check that frames of the given MTU fit in an XDP frame
+ * 
+ * This function returns -EINVAL if an XDP program is attached (or about to
+ * be, 'prog') and frames of 'mtu' bytes would not fit in a single page.
+ */
+int udp_core_xdp_check_mtu(struct net_device* netdev, struct bpf_prog* prog, unsigned int mtu);
+
+/**
+ * @brief Transmit XDP frames redirected to the device (ndo_xdp_xmit)
+ * 
+ * This function writes the given frames into the TX ring. Returns the number
+ * of frames transmitted.
+ */
+int udp_core_xdp_xmit(struct net_device* netdev, int n, struct xdp_frame** frames, u32 flags);
+
+/**
+ * @brief Run the XDP program on a packet received from FPGA
+ * 
+ * This function synthesizes an Ethernet/IPv4/UDP frame for the packet and runs
+ * the given XDP program on it. On XDP_PASS an skb is built around the frame
+ * and handed to GRO. Returns a mask of UDP_CORE_XDP_* flags.
+ */
+int udp_core_xdp_run(struct udp_core_netdev_priv* priv, struct bpf_prog* prog, struct udp_core_raw_packet* raw_udp_packet);
+
+/**
+ * @brief Run the XDP program on a frame already placed in a page
+ * 
+ * This function runs the given XDP program (no program means XDP_PASS) on the
+ * frame found at offset within the page and takes ownership of the page: on
+ * XDP_PASS an skb is built around it (checksum status and timestamp taken
+ * from the given packet trailer), otherwise it is recycled (page_pool pages
+ * go back to the pool). Returns a mask of UDP_CORE_XDP_* flags.
+ */
+int udp_core_xdp_run_page(struct udp_core_netdev_priv* priv, struct bpf_prog* prog, struct page* page, u32 offset, u32 len, struct udp_core_raw_packet* raw_udp_packet);
+
+/**
+ * @brief Wake up the device for AF_XDP RX/TX processing (ndo_xsk_wakeup)
+ * 
+ * This function schedules NAPI, which fills UMEM frames from the RX rings and
+ * drains the XSK TX ring.
+ */
+int udp_core_xsk_wakeup(struct net_device* netdev, u32 queue_id, u32 flags);
+
+/**
+ * @brief Deliver a packet received from FPGA to the bound AF_XDP pool
+ * 
+ * This function fills a UMEM frame with the synthesized frame and runs the
+ * given XDP program on it (no program means XDP_PASS). Returns a mask of 
+ * UDP_CORE_XDP_* flags, or -ENOMEM when no UMEM frame is available (the 
+ * packet is left in the device ring).
+ */
+int udp_core_xsk_run(struct udp_core_netdev_priv* priv, struct xsk_buff_pool* pool, struct bpf_prog* prog, struct udp_core_raw_packet* raw_udp_packet);
+
+/**
+ * @brief Run the XDP program on a frame already placed in a UMEM frame
+ * 
+ * This function runs the given XDP program (no program means XDP_PASS) on
+ * the frame delimited by xdp and takes ownership of it: redirected frames go
+ * to the socket, passed frames are copied into an skb, the others are freed.
+ * Returns a mask of UDP_CORE_XDP_* flags.
+ */
+int udp_core_xsk_run_frame(struct udp_core_netdev_priv* priv, struct bpf_prog* prog, struct xdp_buff* xdp, struct udp_core_raw_packet* raw_udp_packet);
+
+/**
+ * @brief Transmit descriptors pending in the XSK TX ring
+ * 
+ * This function moves up to budget descriptors from the XSK TX ring into the
+ * device TX ring. Returns true when the XSK TX ring has been drained.
+ */
+bool udp_core_xsk_xmit(struct udp_core_netdev_priv* priv, struct xsk_buff_pool* pool, int budget);
+
+/* Socket monitor ----------------------------------------------------------- */
+
+/**
+ * @brief Start tracking the UDP sockets bound on the interface
+ * 
+ * This function should be called once the network device is initialized. It
+ * hooks UDP binds and closes, so that the ports bound are opened in the 
+ * device, and applies the sockets listed in OPENED_SOCKETS. Failing to hook
+ * binds is not fatal: only the listed sockets are opened then.
+ */
+int udp_core_sockmon_init(struct platform_device* pdev);
+
+/**
+ * @brief Apply again the open sockets
+ * 
+ * This function schedules the update of the sockets open in the device, from
+ * the OPENED_SOCKETS list and the sockets bound on the interface. It should 
+ * be called when any of them may have changed (list, port range, local IP). 
+ * It does not sleep.
+ */
+void udp_core_sockmon_update(struct platform_device* pdev);
+
+/**
+ * @brief Stop tracking the UDP sockets bound on the interface
+ * 
+ * This function should be called before the network device is released.
+ */
+void udp_core_sockmon_deinit(struct platform_device* pdev);
+
+/* Timestamps --------------------------------------------------------------- */
+
+/**
+ * @brief Detect hardware timestamps support
+ * 
+ * This function should be called once, when the network device is allocated.
+ * Timestamps stay disabled until enabled through SIOCSHWTSTAMP.
+ */
+void udp_core_tstamp_init(struct udp_core_netdev_priv* priv);
+
+/**
+ * @brief Drop the pending TX timestamp request
+ * 
+ * This function should be called when the device is stopped. It may sleep.
+ */
+void udp_core_tstamp_stop(struct udp_core_netdev_priv* priv);
+
+/**
+ * @brief Read the current time of the device (ns)
+ */
+u64 udp_core_tstamp_read(struct udp_core_netdev_priv* priv);
+
+/**
+ * @brief Read the device time used to extend the RX timestamps
+ * 
+ * This function should be called by NAPI before processing received packets.
+ */
+void udp_core_tstamp_refresh(struct udp_core_netdev_priv* priv);
+
+/**
+ * @brief Set the hardware timestamp of a received skb from its trailer
+ */
+void udp_core_tstamp_rx(struct udp_core_netdev_priv* priv, struct sk_buff* skb, u64 trailer);
+
+/**
+ * @brief Take a TX timestamp request of the given skb
+ * 
+ * This function returns true when PACKET_TX_TIMESTAMP_FLAG shall be set on the
+ * (last) packet of the skb. The stamp is then reported to the socket once read
+ * back from the device.
+ */
+bool udp_core_tstamp_tx(struct udp_core_netdev_priv* priv, struct sk_buff* skb);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+/**
+ * @brief Get/set the hardware timestamps configuration (ndo_hwtstamp_get/set)
+ */
+int udp_core_tstamp_hwtstamp_get(struct net_device* netdev, struct kernel_hwtstamp_config* config);
+int udp_core_tstamp_hwtstamp_set(struct net_device* netdev, struct kernel_hwtstamp_config* config, struct netlink_ext_ack* extack);
+#else
+/**
+ * @brief Handle SIOCSHWTSTAMP and SIOCGHWTSTAMP
+ */
+int udp_core_tstamp_ioctl(struct net_device* netdev, struct ifreq* ifr, int cmd);
+#endif
+
+/**
+ * @brief Report the timestamping capabilities (ethtool get_ts_info)
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 11, 0)
+int udp_core_tstamp_get_ts_info(struct net_device* netdev, struct kernel_ethtool_ts_info* info);
+#else
+int udp_core_tstamp_get_ts_info(struct net_device* netdev, struct ethtool_ts_info* info);
+#endif
+
+/* PTP clock ---------------------------------------------------------------- */
+
+/**
+ * @brief Register the device time as a PTP hardware clock
+ * 
+ * This function should be called once, after udp_core_tstamp_init. Launch
+ * times stay disabled until an ETF qdisc is offloaded to a TX queue.
+ */
+void udp_core_ptp_init(struct udp_core_netdev_priv* priv);
+
+/**
+ * @brief Unregister the PTP hardware clock
+ * 
+ * This function should be called before the network device is released.
+ */
+void udp_core_ptp_deinit(struct udp_core_netdev_priv* priv);
+
+/**
+ * @brief Get the index of the PTP hardware clock (-1 if not registered)
+ */
+int udp_core_ptp_clock_index(struct udp_core_netdev_priv* priv);
+
+/**
+ * @brief Enable/disable the launch time of a TX queue (ndo_setup_tc, ETF)
+ */
+int udp_core_ptp_setup_tc(struct net_device* netdev, enum tc_setup_type type, void* type_data);
+
+/**
+ * @brief Set the launch time of a TX packet from its skb
+ * 
+ * This function returns PACKET_TX_LAUNCH_FLAG when the packet shall be held
+ * back until skb->tstamp (PHC time), 0 otherwise.
+ */
+u64 udp_core_ptp_launch(struct udp_core_netdev_priv* priv, u16 queue, struct sk_buff* skb, struct udp_core_raw_packet* udp_packet);
+
 #endif /* UDP_CORE_H */
\ No newline at end of file
@@ -54,6 +54,66 @@
 #define RBTC_CTRL_ADDR_BUFRX_OFFSET_0_N_I   (0x000000A0)
 #define RBTC_CTRL_LAST_ADDR                 (0x000000A8)
 
+/**
+ * Registers placed after the BUFRX control registers (one per rx buffer, see
+ * BUFFER_RX_CTRL_BASE_OFFSET). They are not part of the devlink region dump,
+ * since reading RXDESC_COMPL has side effects (it pops a completion).
+ */
+
+#define RBTC_CTRL_ADDR_RXDESC_CTRL_0_N_O    (0x000020A0)
+#define RBTC_CTRL_ADDR_RXDESC_POST_0_Y_O    (0x000020A8)
+#define RBTC_CTRL_ADDR_RXDESC_FREE_0_N_I    (0x000020B0)
+#define RBTC_CTRL_ADDR_RXDESC_COMPL_0_N_I   (0x000020B8)
+#define RBTC_CTRL_ADDR_RX_FRAG_DROPS_0_N_I  (0x000020C0)
+#define RBTC_CTRL_ADDR_SLOT_SIZE_0_N_O      (0x000020C8)
+#define RBTC_CTRL_ADDR_SLOT_SIZE_MAX_0_N_I  (0x000020D0)
+#define RBTC_CTRL_ADDR_RXPACK_CTRL_0_N_O    (0x000020D8)
+#define RBTC_CTRL_ADDR_RX_BUFFERS_0_N_O     (0x000020E0)
+#define RBTC_CTRL_ADDR_RX_DEPTH_MAX_0_N_I   (0x000020E8)
+#define RBTC_CTRL_ADDR_TXBUF_BASE_0_N_O     (0x000020F0)
+#define RBTC_CTRL_ADDR_TXQ_CTRL_0_N_O       (0x000020F8)
+#define RBTC_CTRL_ADDR_TXQ_NUM_0_N_I        (0x00002100)
+#define RBTC_CTRL_ADDR_IRQ_COAL_FRAMES_0_N_O (0x00002108)
+#define RBTC_CTRL_ADDR_IRQ_COAL_USECS_0_N_O (0x00002110)
+#define RBTC_CTRL_ADDR_PERF_RX_FRAMES_0_N_I (0x00002118)
+#define RBTC_CTRL_ADDR_PERF_RX_DROP_CLOSED_0_N_I (0x00002120)
+#define RBTC_CTRL_ADDR_PERF_RX_DROP_FULL_0_N_I (0x00002128)
+#define RBTC_CTRL_ADDR_PERF_TX_FRAMES_0_N_I (0x00002130)
+#define RBTC_CTRL_ADDR_PERF_DMA_WR_BUSY_0_N_I (0x00002138)
+#define RBTC_CTRL_ADDR_PERF_DMA_WR_STALL_0_N_I (0x00002140)
+#define RBTC_CTRL_ADDR_PERF_DMA_RD_BUSY_0_N_I (0x00002148)
+#define RBTC_CTRL_ADDR_PERF_DMA_RD_STALL_0_N_I (0x00002150)
+#define RBTC_CTRL_ADDR_PERF_RX_HDR_STALL_0_N_I (0x00002158)
+#define RBTC_CTRL_ADDR_PERF_RX_RING_MAX_0_N_I (0x00002160)
+#define RBTC_CTRL_ADDR_RX_RINGS_RST_0_Y_O   (0x00002168)
+#define RBTC_CTRL_ADDR_PORT_MAP_NUM_0_N_I   (0x00002170)
+#define RBTC_CTRL_ADDR_SHMEM_HI_0_N_O       (0x00002178)
+#define RBTC_CTRL_ADDR_RXDESC_POST_HI_0_N_O (0x00002180)
+#define RBTC_CTRL_ADDR_DMA_ADDR_WIDTH_0_N_I (0x00002188)
+#define RBTC_CTRL_ADDR_TIMESTAMP_LO_0_N_I   (0x00002190)
+#define RBTC_CTRL_ADDR_TIMESTAMP_HI_0_N_I   (0x00002198)
+#define RBTC_CTRL_ADDR_TX_TS_LO_0_N_I       (0x000021A0)
+#define RBTC_CTRL_ADDR_TX_TS_HI_0_N_I       (0x000021A8)
+#define RBTC_CTRL_ADDR_TIMESTAMP_INCR_0_N_IO (0x000021B0)
+#define RBTC_CTRL_ADDR_TIMESTAMP_LOAD_LO_0_N_O (0x000021B8)
+#define RBTC_CTRL_ADDR_TIMESTAMP_SET_HI_0_Y_O (0x000021C0)
+#define RBTC_CTRL_ADDR_TIMESTAMP_ADJ_HI_0_Y_O (0x000021C8)
+#define RBTC_CTRL_ADDR_OPENSOCK_OFFSET_0_N_O (0x00002200)
+#define RBTC_CTRL_ADDR_PORT_MAP_OFFSET_0_N_O (0x00002300)
+#define RBTC_CTRL_ADDR_BUFRX_CFG_OFFSET_0_N_O (0x00004000)
+#define RBTC_CTRL_ADDR_TXQ_OFFSET_0_N_IO    (0x00006000)
+
+/**
+ * Performance counters (PERF_*): free-running 32-bit counters, 8 bytes apart 
+ * from PERF_RX_FRAMES. They are dumped by the "counters" devlink region as 
+ * consecutive u32 values, in address order.
+ */
+
+#define RBTC_CTRL_PERF_COUNTERS             (10)
+
+// value read back from unmapped addresses (e.g. registers missing in older bitstreams)
+#define RBTC_CTRL_UNMAPPED_VALUE            (0xDEADBEEF)
+
 /*
  * Bit Layout of the BUFRX Register:
  * 
@@ -67,7 +127,14 @@
  *  |  9-13  | head                         |
  *  |   14   | socket state (open/closed)   |
  *  |   15   | dummy                        |
- *  | 16-64  | (reserved/unused)            |
+ *  | 16-31  | packed ring pointer          |
+ *  | 32-64  | (reserved/unused)            |
+ * 
+ * The packed ring pointer reads as the head (written by the device) and is 
+ * written as the tail (released by the driver), see RX packed ring mode.
+ * Outside of that mode, bits 16-23 read as the full tail and bits 24-31 as
+ * the full head of the rx buffer (bits 4-13 only hold their lower 5 bits),
+ * on bitstreams supporting configurable rx buffer lengths.
  */
 
 struct RBTC_CTRL_BUFRX
@@ -80,7 +147,8 @@ struct RBTC_CTRL_BUFRX
     u64 head          : 5;  // Bits 9-13 (5 bits)
     u64 socket_state  : 1;  // Bit 14
     u64 dummy         : 1;  // Bit 15
-    u64 reserved      : 49; // Bits 16-64 (reserved/unused)
+    u64 pack_pointer  : 16; // Bits 16-31 (16 bits)
+    u64 reserved      : 33; // Bits 32-64 (reserved/unused)
 };
 
 #define BUFFER_POPPED_OFFSET    (0)
@@ -92,6 +160,10 @@ struct RBTC_CTRL_BUFRX
 #define BUFFER_HEAD_OFFSET      (9)
 #define BUFFER_HEAD_UPPER       (13)
 #define BUFFER_OPENSOCK_OFFSET  (14)
+#define BUFFER_PACK_OFFSET      (16)
+
+#define BUFFER_EXT_TAIL(pointer)    ((pointer) & 0xFF)
+#define BUFFER_EXT_HEAD(pointer)    (((pointer) >> 8) & 0xFF)
 
 /**
  * Each RX buffer has a CTRL register. Given that each register is 8-bytes, the 
@@ -101,6 +173,136 @@ struct RBTC_CTRL_BUFRX
 #define BUFFER_RX_CTRL_BASE_OFFSET(index)   \
     (RBTC_CTRL_ADDR_BUFRX_OFFSET_0_N_I + (index) * 8) 
 
+/**
+ * Each RX buffer has a CFG register too, written while the device is in reset:
+ * 
+ *  | Bit(s) | Description                              |
+ *  |--------|------------------------------------------|       
+ *  |  0-3   | length (log2 slots, 0: BUFFER_RX_LENGTH) |
+ *  |  4-31  | position (slots from shared memory base) |
+ * 
+ * With a length of 0, the buffer is placed as in older bitstreams (n-th buffer
+ * at n * BUFFER_RX_LENGTH slots). The largest length supported (log2) is read
+ * from RX_DEPTH_MAX, which older bitstreams do not map: the CFG registers shall
+ * not be accessed then. Likewise, the tx buffer is placed at TXBUF_BASE (slots)
+ * when it is not 0.
+ */
+
+#define BUFFER_RX_CFG_OFFSET(index)         \
+    (RBTC_CTRL_ADDR_BUFRX_CFG_OFFSET_0_N_O + (index) * 8)
+
+#define BUFFER_RX_CFG_BASE_OFFSET           (4)
+#define BUFFER_RX_CFG(base, depth_shift)    (((base) << BUFFER_RX_CFG_BASE_OFFSET) | (depth_shift))
+
+/**
+ * The device arbitrates among TXQ_NUM tx queues (older bitstreams do not map
+ * the register and only have the tx buffer). Queue n is a ring of 
+ * BUFFER_TX_LENGTH slots placed right after queue n-1, queue 0 being the tx
+ * buffer itself (also driven through the BUFTX registers). Each queue has 
+ * four registers, 8 bytes apart, from TXQ_OFFSET + n * 32:
+ * 
+ *  | Offset | Description                                              |
+ *  |--------|----------------------------------------------------------|
+ *  |  0x00  | status: head (bits 0-7), tail (8-15), empty 16, full 17  |
+ *  |  0x08  | push: any write pushes a slot                            |
+ *  |  0x10  | weight: DWRR quantum in bytes (0: one slot)              |
+ *  |  0x18  | rate: rate in Mbit/s (bits 0-15, 0: unlimited), burst   |
+ *  |        | in bytes (16-31, 0: one slot)                            |
+ * 
+ * TXQ_CTRL selects the arbitration, latched while in reset: strict priority 
+ * (the non-empty queue with the highest index goes first) or DWRR. A queue
+ * with a rate is shaped by a token bucket: it gains rate bits of UDP payload
+ * every microsecond, up to its burst, and is skipped by the arbitration while
+ * it is over its rate. The rate can be changed at any time. Older bitstreams
+ * do not shape the queues (the rate register reads as 0).
+ */
+
+#define TXQ_CTRL_DWRR                       (1 << 0)
+
+#define TXQ_STATUS_OFFSET(queue)            (RBTC_CTRL_ADDR_TXQ_OFFSET_0_N_IO + (queue) * 32)
+#define TXQ_PUSH_OFFSET(queue)              (TXQ_STATUS_OFFSET(queue) + 0x08)
+#define TXQ_WEIGHT_OFFSET(queue)            (TXQ_STATUS_OFFSET(queue) + 0x10)
+#define TXQ_RATE_OFFSET(queue)              (TXQ_STATUS_OFFSET(queue) + 0x18)
+
+#define TXQ_RATE_MBPS_MAX                   (0xFFFF)
+#define TXQ_RATE_BURST_MAX                  (0xFFFF)
+#define TXQ_RATE(mbps, burst)               (((burst) << 16) | (mbps))
+
+#define TXQ_STATUS_HEAD(status)             ((status) & 0xFF)
+#define TXQ_STATUS_TAIL(status)             (((status) >> 8) & 0xFF)
+#define TXQ_STATUS_EMPTY                    (1 << 16)
+#define TXQ_STATUS_FULL                     (1 << 17)
+
+/**
+ * A socket is open when its BUFRX socket state bit or its bit in the open
+ * socket bitmap is set. The bitmap takes MAX_UDP_PORTS / 32 registers, 8 bytes
+ * apart from OPENSOCK_OFFSET: bit i of the n-th register is the socket of rx
+ * buffer n * 32 + i. Writing 1 to RX_RINGS_RST empties every rx buffer and
+ * clears every BUFRX register (packed ring tails included) and the bitmap.
+ * Older bitstreams map neither (RX_RINGS_RST reads as RBTC_CTRL_UNMAPPED_VALUE
+ * instead of 0), sockets are then opened one BUFRX register at a time.
+ */
+
+#define OPENSOCK_MAP_BITS                   (32)
+#define OPENSOCK_MAP_OFFSET(index)          \
+    (RBTC_CTRL_ADDR_OPENSOCK_OFFSET_0_N_O + ((index) / OPENSOCK_MAP_BITS) * 8)
+#define OPENSOCK_MAP_BIT(index)             (1U << ((index) % OPENSOCK_MAP_BITS))
+
+/**
+ * Ports outside the port range are received through the port map: each of its
+ * PORT_MAP_NUM entries (8 bytes apart from PORT_MAP_OFFSET) holds a valid bit,
+ * an rx buffer index and a UDP port. A port found in the map is delivered to
+ * the rx buffer of its entry (the first valid one if listed twice), instead of
+ * port - port range lower. The socket of that rx buffer must still be open.
+ * Older bitstreams do not map the table (PORT_MAP_NUM reads as 
+ * RBTC_CTRL_UNMAPPED_VALUE).
+ */
+
+#define PORT_MAP_ENTRIES_MAX                (32)
+#define PORT_MAP_OFFSET(entry)              (RBTC_CTRL_ADDR_PORT_MAP_OFFSET_0_N_O + (entry) * 8)
+#define PORT_MAP_VALID                      (1U << 31)
+#define PORT_MAP_BUFFER_SHIFT               (16)
+#define PORT_MAP_ENTRY(port, buffer_id)     \
+    (PORT_MAP_VALID | ((buffer_id) << PORT_MAP_BUFFER_SHIFT) | ((port) & 0xFFFF))
+
+/**
+ * DMA addresses are DMA_ADDR_WIDTH bits wide (up to 64). Their upper 32 bits
+ * are held by SHMEM_HI (shared memory) and RXDESC_POST_HI (sampled by each 
+ * RXDESC_POST write). Older bitstreams only take 32-bit addresses 
+ * (DMA_ADDR_WIDTH reads as RBTC_CTRL_UNMAPPED_VALUE).
+ */
+
+#define DMA_ADDR_BITS_MIN                   (32)
+#define DMA_ADDR_BITS_MAX                   (64)
+
+/**
+ * The device counts nanoseconds since power on (64 bits, split in TIMESTAMP_LO
+ * and TIMESTAMP_HI). Reading TIMESTAMP_LO latches the upper half, so that 
+ * TIMESTAMP_HI read right after it matches. Received packets are stamped when
+ * their header shows up (see the RX trailer); a transmitted packet is stamped,
+ * when PACKET_TX_TIMESTAMP_FLAG is set in its header, once its last byte leaves
+ * the DMA engine. TX stamps are queued in a fifo of TX_TS_LENGTH entries:
+ * TX_TS_HI tells whether one is available (TX_TS_VALID) and holds bits 32-62 
+ * of the head one, reading TX_TS_LO returns bits 0-31 and pops it. Older 
+ * bitstreams do not stamp packets (TX_TS_HI reads as RBTC_CTRL_UNMAPPED_VALUE).
+ */
+
+#define TX_TS_LENGTH                        (16)
+#define TX_TS_VALID                         (1U << 31)
+#define TX_TS_HI_MASK                       (0x7FFFFFFF)
+
+/**
+ * The device time can be steered as a PTP hardware clock. TIMESTAMP_INCR holds
+ * the nanoseconds added at each clock cycle, with TIMESTAMP_INCR_FRAC_BITS
+ * fractional bits: it reads the increment in use, and a written value replaces
+ * the nominal one (0 restores it). Writing TIMESTAMP_SET_HI sets the time to
+ * {TIMESTAMP_SET_HI, TIMESTAMP_LOAD_LO}; writing TIMESTAMP_ADJ_HI adds the
+ * signed {TIMESTAMP_ADJ_HI, TIMESTAMP_LOAD_LO} to it instead. Older bitstreams
+ * cannot be steered (TIMESTAMP_INCR reads as RBTC_CTRL_UNMAPPED_VALUE).
+ */
+
+#define TIMESTAMP_INCR_FRAC_BITS            (28)
+
 /**
  * Configuration of circular buffer dimension
  * 
@@ -111,51 +313,106 @@ struct RBTC_CTRL_BUFRX
  * MAX_UDP_PORTS:
  *  > port range width (-> number of rx buffers, 1 per port)
  * BUFFER_*X_LENGTH: 
- *  > number of circular buffer slots
- * BUFFER_ELEM_MAX_SIZE_BYTES: 
- *  > circular buffer slot width in bytes
- * 
- * BUFFER_SIZE_BYTES: 
- *  > length of memory dedicated to each circular buffer
- * BUFFERS_TOTAL_SIZE: 
- *  > total length of memory dedicated to all circular buffers (1 rx buffer per 
- *  > udp port / socket + 1 tx buffer)
- * 
- * BUFFER_RX_OFFSET_BYTES: 
- *  > offset of first rx buffer (end of reg space)
- * BUFFER_RX_INDEX_OFFSET_BYTES: 
- *  > offset of n-th rx buffer
- * BUFFER_TX_OFFSET_BYTES: 
- *  > offset of tx buffer (after all rx buffers)
+ *  > number of circular buffer slots (default for rx buffers)
+ * BUFFER_RX_LENGTH_MAX: 
+ *  > largest number of slots of a rx buffer (see CFG registers)
+ * TX_QUEUES_MAX:
+ *  > largest number of tx queues (see TXQ registers)
+ * BUFFER_ELEM_SIZE_SHIFT_*: 
+ *  > circular buffer slot width in bytes, as log2 ('shift' in the macros).
+ *  > It is written to SLOT_SIZE while the device is in reset: 2KB by default,
+ *  > larger slots (for jumbo frames) up to the value read from SLOT_SIZE_MAX, 
+ *  > which depends on the bitstream
+ * 
+ * BUFFER_SLOTS_BYTES: 
+ *  > length of memory taken by a number of slots, or offset of a slot from
+ *  > the shared memory base
+ * 
+ * The device places as many rx buffers as written to RX_BUFFERS while in 
+ * reset (1 per port of the configured range), or MAX_UDP_PORTS when the 
+ * register is 0 or not supported by the bitstream. The tx buffer (and the 
+ * other tx queues) follows them, unless placed elsewhere through 
+ * TXBUF_BASE. The driver keeps the position of each buffer (in slots) as 
+ * laid out on open.
  *
  */
 
 #define MAX_UDP_PORTS                       (1024)
 
-#define BUFFER_RX_LENGTH                    (32)
+#define BUFFER_RX_LENGTH_SHIFT              (5)
+#define BUFFER_RX_LENGTH                    (1 << BUFFER_RX_LENGTH_SHIFT)
+#define BUFFER_RX_LENGTH_MAX                (256)
 #define BUFFER_TX_LENGTH                    (32)
-#define BUFFER_ELEM_MAX_SIZE_BYTES          (2048)
-
-#define BUFFER_SIZE_BYTES                   (BUFFER_RX_LENGTH * BUFFER_ELEM_MAX_SIZE_BYTES)
-#define BUFFERS_TOTAL_SIZE                  (BUFFER_SIZE_BYTES * (MAX_UDP_PORTS + 1))
+#define TX_QUEUES_MAX                       (4)
+#define OPENSOCK_MAP_REGS                   (MAX_UDP_PORTS / OPENSOCK_MAP_BITS)
+#define BUFFER_ELEM_SIZE_SHIFT_MIN          (11)
+#define BUFFER_ELEM_SIZE_SHIFT_MAX          (14)
 
-#define BUFFER_RX_OFFSET_BYTES              (0)
-#define BUFFER_RX_INDEX_OFFSET_BYTES(index) (BUFFER_RX_OFFSET_BYTES + (index * BUFFER_SIZE_BYTES)) 
-#define BUFFER_TX_OFFSET_BYTES              (BUFFER_RX_OFFSET_BYTES + MAX_UDP_PORTS * BUFFER_SIZE_BYTES)
+#define BUFFER_ELEM_SIZE_BYTES(shift)       (1UL << (shift))
+#define BUFFER_SLOTS_BYTES(slots, shift)    ((size_t)(slots) << (shift))
 
 /**
  * The following are helper macros. They allows to get a byte pointer to packet
- * header data and payload data for each slot in a given RX buffer.
+ * header data and payload data for each slot in a given RX buffer (placed at
+ * rx_buf_base slots).
  */
 
-#define BUFFER_RX_SLOT_DATA_OFFSET(rx_buf_idx, slot_idx) \
-    BUFFER_RX_INDEX_OFFSET_BYTES(rx_buf_idx) + slot_idx * BUFFER_ELEM_MAX_SIZE_BYTES
+#define BUFFER_RX_SLOT_DATA_OFFSET(rx_buf_base, slot_idx, shift) \
+    BUFFER_SLOTS_BYTES((rx_buf_base) + (slot_idx), shift)
 
-#define BUFFER_RX_SLOT_HDR_DATA(rx_buf_idx, slot_idx, virt_dma_base) \
-        ((u8*)virt_dma_base) + BUFFER_RX_SLOT_DATA_OFFSET(rx_buf_idx, slot_idx)
+#define BUFFER_RX_SLOT_HDR_DATA(rx_buf_base, slot_idx, shift, virt_dma_base) \
+        ((u8*)virt_dma_base) + BUFFER_RX_SLOT_DATA_OFFSET(rx_buf_base, slot_idx, shift)
 
-#define BUFFER_RX_SLOT_PAYLOAD_DATA(rx_buf_idx, slot_idx, virt_dma_base) \
-    BUFFER_RX_SLOT_HDR_DATA(rx_buf_idx, slot_idx, virt_dma_base) + PACKET_HEADER_SIZE_BYTES
+#define BUFFER_RX_SLOT_PAYLOAD_DATA(rx_buf_base, slot_idx, shift, virt_dma_base) \
+    BUFFER_RX_SLOT_HDR_DATA(rx_buf_base, slot_idx, shift, virt_dma_base) + PACKET_HEADER_SIZE_BYTES
+
+/**
+ * RX descriptor mode
+ * 
+ * When RXDESC_CTRL is set (while the device is in reset), the per-port rx 
+ * buffers are not used. The driver posts the DMA address of free buffers to
+ * RXDESC_POST (one write per buffer) and the device writes each packet (device
+ * header + payload, as in a rx buffer slot) to the oldest posted buffer. For
+ * each packet, a completion is queued; reading RXDESC_COMPL pops it:
+ * 
+ *  | Bit(s) | Description                  |
+ *  |--------|------------------------------|       
+ *  |  0-9   | rx buffer (port) index       |
+ *  | 10-30  | (reserved/unused)            |
+ *  |   31   | valid                        |
+ * 
+ * Completions are returned in the same order buffers were posted. Posted 
+ * addresses shall be 8-byte aligned and buffers at least one slot long.
+ */
+
+#define RX_DESC_LENGTH                      (256)
+#define RXDESC_CTRL_ENABLE                  (1 << 0)
+#define RXDESC_COMPL_VALID                  (1 << 31)
+#define RXDESC_COMPL_INDEX_MASK             (MAX_UDP_PORTS - 1)
+
+/**
+ * RX packed ring mode
+ * 
+ * When RXPACK_CTRL is set (while the device is in reset, and with RXDESC_CTRL
+ * cleared), each rx buffer is used as a ring of 64-byte lines rather than as
+ * BUFFER_RX_LENGTH slots. Packets (device header + payload + trailer, as in a 
+ * slot) are written back to back, each one at a line boundary. A packet never 
+ * wraps: when less than a slot is left before the end of the ring, it is 
+ * written at the start of the ring instead.
+ * 
+ * Head and tail are free-running line counters (16 bits), held in the BUFRX
+ * register of the port. Packets that do not fit in the free space are dropped.
+ * On reset, the device sets each head to the tail written by the driver.
+ * Rings take up to the first 2MB of the rx buffer (so that 16 bits pointers
+ * can tell a full ring from an empty one).
+ */
+
+#define RXPACK_CTRL_ENABLE                  (1 << 0)
+#define RXPACK_LINE_SIZE_BYTES              (64)
+#define RXPACK_RING_SIZE_SHIFT_MAX          (21)
+#define RXPACK_RING_LINES(depth_shift, shift) \
+    ((1UL << min_t(u32, (depth_shift) + (shift), RXPACK_RING_SIZE_SHIFT_MAX)) / RXPACK_LINE_SIZE_BYTES)
+#define RXPACK_SLOT_LINES(shift)            (BUFFER_ELEM_SIZE_BYTES(shift) / RXPACK_LINE_SIZE_BYTES)
 
 /* -------------------------------------------------------------------------- */
 
@@ -177,10 +434,96 @@ struct udp_core_raw_packet
     u64 dest_ip;
     u64 dest_port;
     u64* payload;
+    u64 trailer;
 };
 
 #define PACKET_WORD_SIZE_BYTES              (8)
 #define PACKET_HEADER_LENGTH                (5)
 #define PACKET_HEADER_SIZE_BYTES            (40) // header len * word size bytes
 
+/**
+ * TX external payload
+ * 
+ * By default, the payload of a TX packet follows its header in the TX slot. 
+ * When PACKET_TX_EXT_PAYLOAD_FLAG is set in the first header word (payload
+ * size), the device fetches the payload from the DMA address held in the
+ * upper 32 bits of the second header word (source ip) instead, extended by the
+ * upper 32 bits of the third one (source port) on 64-bit devices. The slot is
+ * popped (TX tail advances) once the payload has been read, so the buffer can
+ * be released from then on. PACKET_TX_TIMESTAMP_FLAG, in the same word, asks
+ * for a TX timestamp (see TX_TS_HI).
+ * 
+ * PACKET_TX_LAUNCH_FLAG, in the same word, holds the packet back until the
+ * device time reaches the launch time, whose lower PACKET_TX_LAUNCH_BITS bits
+ * are taken from the upper bits of the fifth header word (dest port). Launch
+ * times more than 2^47 ns in the past or ahead are not told apart. A packet
+ * is held back after the TX queues are arbitrated, so while it waits the
+ * packets of every TX queue wait behind it (head-of-line blocking): the 
+ * driver only offloads launch times with a single TX queue.
+ */
+
+#define PACKET_TX_EXT_PAYLOAD_FLAG          (1ULL << 63)
+#define PACKET_TX_TIMESTAMP_FLAG            (1ULL << 62)
+#define PACKET_TX_LAUNCH_FLAG               (1ULL << 61)
+#define PACKET_TX_LAUNCH_OFFSET             (16)
+#define PACKET_TX_LAUNCH_BITS               (48)
+#define PACKET_TX_EXT_ADDR_OFFSET           (32)
+
+/**
+ * RX extended header
+ * 
+ * On RX, the device fills the upper (unused) bits of the header words with
+ * the rest of the original IP/UDP header, and sets PACKET_RX_EXT_HEADER_FLAG
+ * in the last word (dest port) to tell so:
+ * 
+ *  | Word        | Bit(s) | Description                  |
+ *  |-------------|--------|------------------------------|
+ *  | source ip   | 32-47  | ip identification            |
+ *  | source ip   | 48-55  | ip ttl                       |
+ *  | source ip   | 56-63  | ip tos                       |
+ *  | source port | 16-63  | source mac                   |
+ *  | dest ip     | 32-47  | ip header checksum           |
+ *  | dest ip     | 48-63  | udp checksum                 |
+ *  | dest port   | 16-18  | ip flags                     |
+ *  | dest port   | 19-31  | ip fragment offset           |
+ *  | dest port   | 32-35  | ip ihl                       |
+ *  | dest port   |   63   | extended header flag         |
+ * 
+ * The payload is then followed, at the next 8-byte boundary, by a trailer 
+ * word with the result of the UDP checksum verification:
+ * 
+ *  | Bit(s) | Description                           |
+ *  |--------|---------------------------------------|
+ *  |  0-15  | ones' complement sum (pseudo hdr incl)|
+ *  |   16   | udp checksum present (not zero)       |
+ *  |   17   | udp checksum ok                       |
+ *  |   18   | timestamp present                     |
+ *  | 19-23  | (reserved/unused)                     |
+ *  | 24-63  | rx timestamp (bits 0-39, ns)          |
+ * 
+ * The rx timestamp only holds the lower bits of the device time (about 18 
+ * minutes), the upper ones are taken from a recent TIMESTAMP read.
+ */
+
+#define PACKET_RX_EXT_HEADER_FLAG           (1ULL << 63)
+
+#define PACKET_RX_IP_ID(pkt)                (((pkt)->source_ip >> 32) & 0xFFFF)
+#define PACKET_RX_IP_TTL(pkt)               (((pkt)->source_ip >> 48) & 0xFF)
+#define PACKET_RX_IP_TOS(pkt)               (((pkt)->source_ip >> 56) & 0xFF)
+#define PACKET_RX_SOURCE_MAC(pkt)           (((pkt)->source_port >> 16) & 0xFFFFFFFFFFFFULL)
+#define PACKET_RX_IP_CSUM(pkt)              (((pkt)->dest_ip >> 32) & 0xFFFF)
+#define PACKET_RX_UDP_CSUM(pkt)             (((pkt)->dest_ip >> 48) & 0xFFFF)
+#define PACKET_RX_IP_FLAGS(pkt)             (((pkt)->dest_port >> 16) & 0x7)
+#define PACKET_RX_IP_FRAG_OFFSET(pkt)       (((pkt)->dest_port >> 19) & 0x1FFF)
+#define PACKET_RX_IP_IHL(pkt)               (((pkt)->dest_port >> 32) & 0xF)
+
+#define PACKET_RX_TRAILER_SIZE_BYTES        (8)
+#define PACKET_RX_TRAILER_OFFSET(size)      (PACKET_HEADER_SIZE_BYTES + ALIGN((size), PACKET_WORD_SIZE_BYTES))
+#define PACKET_RX_TRAILER_CSUM_PRESENT      (1 << 16)
+#define PACKET_RX_TRAILER_CSUM_OK           (1 << 17)
+#define PACKET_RX_TRAILER_TS_PRESENT        (1 << 18)
+#define PACKET_RX_TRAILER_TS_OFFSET         (24)
+#define PACKET_RX_TRAILER_TS_BITS           (40)
+#define PACKET_RX_TRAILER_TS(trailer)       (((trailer) >> PACKET_RX_TRAILER_TS_OFFSET) & ((1ULL << PACKET_RX_TRAILER_TS_BITS) - 1))
+
 #endif /* UDP_CORE_REGS_H */
\ No newline at end of file
@@ -52,6 +52,7 @@ struct udriver_socket_t
     uint16_t src_port;
     uint32_t dest_ip;
     uint16_t dest_port;
+    uint32_t priority;
 };
 
 struct udriver_socket_id_t
@@ -408,7 +409,6 @@ int getsockopt(int sockfd, int level, int optname, void *optval, socklen_t *optl
 {
     unsigned* optval_int_ptr;
     
-    UNUSED(sockfd);
     UNUSED(optlen);
 
     __trace(__func__, "%d, %d, %d, %p, %p", sockfd, level, optname, optval, optlen);
@@ -423,17 +423,16 @@ int getsockopt(int sockfd, int level, int optname, void *optval, socklen_t *optl
     {
         *optval_int_ptr = 65536;
     }
+    else if (level == SOL_SOCKET && optname == SO_PRIORITY && socket_fds[sockfd].status != NOT_ASSIGNED) 
+    {
+        *optval_int_ptr = socket_fds[sockfd].socket_ptr->priority;
+    }
   
     return 0;
 }
 
 int setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t optlen)
 {
-    UNUSED(level);
-    UNUSED(optname);
-    UNUSED(optval);
-    UNUSED(optlen);
-
     __trace(__func__, "%d, %d, %d, %p, %d", sockfd, level, optname, optval, optlen);
 
     if (socket_fds[sockfd].status == NOT_ASSIGNED)
@@ -448,6 +447,12 @@ int setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t
         socket_fds[sockfd].socket_ptr->multicast = 1;
     }
 
+    // the priority selects the tx queue of the socket
+    if (level == SOL_SOCKET && optname == SO_PRIORITY && optlen >= sizeof(int))
+    {
+        socket_fds[sockfd].socket_ptr->priority = *(const int*)optval;
+    }
+
     return 0;
 }
 
@@ -587,6 +592,13 @@ ssize_t sendto(int sockfd, const void *buf, size_t len, int flags, const struct
         return -1;
     }
 
+    if (len > UDP_PAYL_MAX_LEN)
+    {
+        __log("sendto failed - message too long. \n");
+        errno = EMSGSIZE;
+        return -1;
+    }
+
     sockaddr = (struct sockaddr_in*) dest_addr;
     socket_ptr = socket_fds[sockfd].socket_ptr;
 
@@ -596,10 +608,12 @@ ssize_t sendto(int sockfd, const void *buf, size_t len, int flags, const struct
     tx_udp_packet.dest_ip = htonl(sockaddr->sin_addr.s_addr);
     tx_udp_packet.dest_port = htons(sockaddr->sin_port);
     tx_udp_packet.payload = (uint64_t*) buf;
+    tx_udp_packet.timestamp = 0;
+    tx_udp_packet.launch_time = 0;
 
     do
     {
-        sentb = udriver_send(&tx_udp_packet);
+        sentb = udriver_send_queue(&tx_udp_packet, socket_ptr->priority);
 
         if (sentb < 0)
             nsleep(1);
@@ -678,7 +692,7 @@ ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags)
     {
         iov_len = msg->msg_iov[i].iov_len;
         
-        if ((total_len + iov_len) > (BUF_ELEM_MAX_SIZE_BYTES - PACKET_HDR_SIZE_BYTES)) 
+        if ((total_len + iov_len) > UDP_PAYL_MAX_LEN) 
         {
             __log("sendmsg failed - message too long. \n");
             errno = EMSGSIZE;
@@ -31,7 +31,8 @@ struct RBTC_CTRL_BUFRX
     uint64_t head          : 5;  // Bits 9-13 (5 bits)
     uint64_t socket_state  : 1;  // Bit 14
     uint64_t dummy         : 1;  // Bit 15
-    uint64_t reserved      : 49; // Bits 16-64 (reserved/unused)
+    uint64_t pack_pointer  : 16; // Bits 16-31 (packed ring head, or full tail/head)
+    uint64_t reserved      : 33; // Bits 32-64 (reserved/unused)
 };
 
 struct udp_ip_device
@@ -46,6 +47,17 @@ struct udp_ip_device
     uint64_t        page_offset;
     uint16_t        port_min;
     uint16_t        port_max;
+    uint32_t        rx_buffers;
+    uint32_t        rx_length_log2_max;
+    uint8_t         rx_length_log2[MAX_UDP_PORTS];
+    uint32_t        rx_ring_base[MAX_UDP_PORTS];
+    uint32_t        tx_ring_base;
+    uint32_t        tx_queues;
+    uint16_t        rx_pack_tail[MAX_UDP_PORTS];
+    uint32_t        opensock_map_supported;
+    uint32_t        opensock_map[OPENSOCK_MAP_REGS];
+    uint32_t        port_map_entries;
+    uint32_t        port_map[PORT_MAP_ENTRIES_MAX];
 };
 
 static struct udp_ip_device dev;
@@ -71,12 +83,34 @@ static void notify_pop_to_rx_buffer(
     uint32_t buffer_id
 );
 
+static int setup_shmem(struct udp_ip_device* dev);
+
+static int relayout_shmem(struct udp_ip_device* dev);
+
+static int port_to_buffer(
+    struct udp_ip_device* dev, 
+    uint32_t port, 
+    uint32_t* buffer_id
+);
+
 static void get_buffer_rx_param(
     struct udp_ip_device* dev, 
     uint32_t buffer_id, 
     struct RBTC_CTRL_BUFRX* reg
 );
 
+static int recv_packed(
+    struct udp_ip_device* dev, 
+    struct udp_packet* udp_packet, 
+    uint32_t buffer_id
+);
+
+static void read_rx_timestamp(
+    struct udp_ip_device* dev, 
+    struct udp_packet* udp_packet, 
+    uint32_t trailer_offset
+);
+
 static void uint32_to_byte_arr(
     const uint32_t uint32_in, 
     uint8_t out_bytes[INET_ALEN]
@@ -106,11 +140,19 @@ int udriver_initialize(
     uint32_t mac32_l;
     uint32_t mac32_h;
     uint32_t buffer_rx_index;
-    xrtBufferFlags flags;
+    uint32_t slot_size_max;
+    uint32_t rx_pack_ctrl;
+    uint32_t value;
 
     // ---------------------------------------------------------
     // Input data consistency check
     // ---------------------------------------------------------
+    if (port_max < port_min)
+    {
+        printf("Port range is empty - The max port is lower than the min one \n");
+        return -1;
+    }
+
     if (port_max - port_min >= MAX_UDP_PORTS)
     {
         printf("Port range is too wide - The max range is %d \n", MAX_UDP_PORTS);
@@ -125,28 +167,6 @@ int udriver_initialize(
     // ---------------------------------------------------------
     dev.handle = xrtDeviceOpen(0);
 
-    // ---------------------------------------------------------
-    // Allocate memory (shared memory in DDR for ring buffers)
-    // ---------------------------------------------------------
-
-    #if CACHEABLE_MEM == 1
-    flags = XRT_BO_FLAGS_CACHEABLE;
-    #else
-    flags = XRT_BO_FLAGS_NONE;
-    #endif
-    
-    // Allocate shared memory buffer - in case of exception program fails
-    dev.shmem_buff = xrtBOAlloc(dev.handle, BUF_TOTAL_SIZE, flags, 0); 
-    dev.shmem_phys_addr = xrtBOAddress(dev.shmem_buff);
-    dev.shmem_size = BUF_TOTAL_SIZE;
-
-    // Note. 64 bit addressable memory is not supported by the IP
-    if (dev.shmem_phys_addr > 0xFFFFFFFF)
-    {
-        printf("XRT allocated 64 bit addressable memory. Abort. \n");
-        return -1;
-    }
-
     // ---------------------------------------------------------
     // Mapping memory for udpip core configuration registers
     // ---------------------------------------------------------
@@ -176,6 +196,24 @@ int udriver_initialize(
     
     // Assert reset
     write_reg(&dev, RBTC_CTRL_ADDR_RES_0_Y_O, 1); 
+
+    // Port map - older bitstreams only receive the port range
+    read_reg(&dev, RBTC_CTRL_ADDR_PORT_MAP_NUM_0_N_I, &value);
+    dev.port_map_entries = (value == RBTC_CTRL_UNMAPPED_VALUE) ? 0 : value;
+
+    if (dev.port_map_entries > PORT_MAP_ENTRIES_MAX)
+        dev.port_map_entries = PORT_MAP_ENTRIES_MAX;
+
+    memset(dev.port_map, 0, sizeof(dev.port_map));
+
+    for (value = 0; value < dev.port_map_entries; value++)
+        write_reg(&dev, PORT_MAP_OFFSET(value), 0);
+
+    // Allocate shared memory for ring buffers (default rx buffer length)
+    memset(dev.rx_length_log2, BUF_RX_LENGTH_LOG2, sizeof(dev.rx_length_log2));
+
+    if (setup_shmem(&dev) != 0)
+        return -1;
         
     // Set local MAC
     eth_mac_to_eth_mac32(local_mac, &mac32_h, &mac32_l);
@@ -193,22 +231,62 @@ int udriver_initialize(
     // Local ip
     write_reg(&dev, RBTC_CTRL_ADDR_IP_LOC_0_N_O, byte_arr_to_uint32(local_ip));
     
-    // Shared memory address
-    write_reg(&dev, RBTC_CTRL_ADDR_SHMEM_0_N_O, (uint32_t)dev.shmem_phys_addr);
+    // Slot size (the default one is supported by every bitstream)
+    #if BUF_ELEM_SIZE_SHIFT > 11
+    read_reg(&dev, RBTC_CTRL_ADDR_SLOT_SIZE_MAX_0_N_I, &slot_size_max);
+
+    if (slot_size_max == RBTC_CTRL_UNMAPPED_VALUE || slot_size_max < BUF_ELEM_SIZE_SHIFT)
+    {
+        printf("Slot size of %d bytes not supported by the device. Abort. \n", BUF_ELEM_MAX_SIZE_BYTES);
+        return -1;
+    }
+    #else
+    (void)slot_size_max;
+    #endif
+
+    write_reg(&dev, RBTC_CTRL_ADDR_SLOT_SIZE_0_N_O, BUF_ELEM_SIZE_SHIFT);
+
+    // Rx buffer layout (packed rings are read back to detect older bitstreams)
+    #if RX_PACKED_RING == 1
+    write_reg(&dev, RBTC_CTRL_ADDR_RXPACK_CTRL_0_N_O, 1);
+    read_reg(&dev, RBTC_CTRL_ADDR_RXPACK_CTRL_0_N_O, &rx_pack_ctrl);
+
+    if (rx_pack_ctrl != 1)
+    {
+        printf("Packed rx rings not supported by the device. Abort. \n");
+        return -1;
+    }
+    #else
+    write_reg(&dev, RBTC_CTRL_ADDR_RXPACK_CTRL_0_N_O, 0);
+    (void)rx_pack_ctrl;
+    #endif
+
+    memset(dev.rx_pack_tail, 0, sizeof(dev.rx_pack_tail));
     
     // Listened ports range
     write_reg(&dev, RBTC_CTRL_ADDR_UDP_RANGE_L_0_N_O, port_min);
     write_reg(&dev, RBTC_CTRL_ADDR_UDP_RANGE_H_0_N_O, port_max);
     
-    // Reset buffers - not pushed / not popped
-    for (buffer_rx_index = 0; buffer_rx_index < MAX_UDP_PORTS; buffer_rx_index++)
-        notify_pop_to_rx_buffer(&dev, buffer_rx_index);
+    // Reset buffers and sockets - not pushed / not popped, initially closed
+    read_reg(&dev, RBTC_CTRL_ADDR_RX_RINGS_RST_0_Y_O, &value);
+    dev.opensock_map_supported = (value != RBTC_CTRL_UNMAPPED_VALUE);
+    memset(dev.opensock_map, 0, sizeof(dev.opensock_map));
+
+    if (dev.opensock_map_supported)
+    {
+        // a single write on bitstreams with the open socket bitmap
+        write_reg(&dev, RBTC_CTRL_ADDR_RX_RINGS_RST_0_Y_O, 1);
+    }
+    else
+    {
+        for (buffer_rx_index = 0; buffer_rx_index < MAX_UDP_PORTS; buffer_rx_index++)
+            notify_pop_to_rx_buffer(&dev, buffer_rx_index);
+
+        for (buffer_rx_index = 0; buffer_rx_index < MAX_UDP_PORTS; buffer_rx_index++)
+            udriver_set_socket_status(buffer_rx_index, UDRIVER_SOCKET_CLOSED);
+    }
     
     write_reg(&dev, RBTC_CTRL_ADDR_BUFTX_PUSHED_0_Y_O, 0);
-    
-    // Reset sockets - they are initially closed
-    for (buffer_rx_index = 0; buffer_rx_index < MAX_UDP_PORTS; buffer_rx_index++)
-        udriver_set_socket_status(buffer_rx_index, UDRIVER_SOCKET_CLOSED);
 
     // ---------------------------------------------------------
     // Open the kernel support for interrupt
@@ -247,14 +325,43 @@ int udriver_set_socket_status(uint32_t port, uint32_t status)
     uint32_t buffer_id;
     uint32_t value;
 
-    if (port > dev.port_max || port < dev.port_min)
+    if (port_to_buffer(&dev, port, &buffer_id) != 0)
     {
         return -1;
     }
 
-    buffer_id = port - dev.port_min;
     read_reg(&dev, BUFFER_RX_CTRL_BASE_OFFSET(buffer_id), &value);
+
+    /**
+     * Sockets are opened without reset: the device empties the rx slots of the
+     * port when it opens, packets left in a packed ring are skipped here.
+     */
+    #if RX_PACKED_RING == 1
+    if (status == UDRIVER_SOCKET_OPEN && !(value & (1 << BUFFER_OPENSOCK_OFFSET)) && 
+        !(dev.opensock_map[buffer_id / OPENSOCK_MAP_BITS] & OPENSOCK_MAP_BIT(buffer_id)))
+        dev.rx_pack_tail[buffer_id] = (uint16_t)(value >> BUFFER_PACK_OFFSET);
+    #endif
+
+    // the upper half holds the packed ring head, write back the tail instead
+    value = (value & 0xFFFF) | ((uint32_t)dev.rx_pack_tail[buffer_id] << BUFFER_PACK_OFFSET);
     
+    // the socket is opened through the bitmap when available (one bit per port)
+    if (dev.opensock_map_supported)
+    {
+        if (status == UDRIVER_SOCKET_OPEN) 
+            dev.opensock_map[buffer_id / OPENSOCK_MAP_BITS] |= OPENSOCK_MAP_BIT(buffer_id);
+        else
+            dev.opensock_map[buffer_id / OPENSOCK_MAP_BITS] &= ~OPENSOCK_MAP_BIT(buffer_id);
+
+        #if RX_PACKED_RING == 1
+        write_reg(&dev, BUFFER_RX_CTRL_BASE_OFFSET(buffer_id), value);
+        #endif
+
+        write_reg(&dev, OPENSOCK_MAP_OFFSET(buffer_id), dev.opensock_map[buffer_id / OPENSOCK_MAP_BITS]);
+
+        return 0;
+    }
+
     if (status == UDRIVER_SOCKET_OPEN) 
         value |= (1 << BUFFER_OPENSOCK_OFFSET);
     else
@@ -265,40 +372,193 @@ int udriver_set_socket_status(uint32_t port, uint32_t status)
     return 0;
 }
 
+int udriver_set_rx_ring_depth(uint32_t port, uint32_t depth)
+{
+    uint32_t buffer_id;
+    uint32_t length_log2;
+
+    if (port_to_buffer(&dev, port, &buffer_id) != 0)
+        return -1;
+
+    // a single slot would read as the default length in the CFG register
+    if (depth < 2 || depth > BUF_RX_LENGTH_MAX || (depth & (depth - 1)) != 0)
+        return -1;
+
+    for (length_log2 = 0; (1U << length_log2) < depth; length_log2++);
+
+    if (length_log2 > dev.rx_length_log2_max)
+    {
+        printf("Rx buffer length of %d slots not supported by the device. \n", depth);
+        return -1;
+    }
+
+    dev.rx_length_log2[buffer_id] = length_log2;
+
+    return relayout_shmem(&dev);
+}
+
+int udriver_map_port(uint32_t port, uint32_t buffer_id)
+{
+    uint32_t entry;
+    uint32_t free_entry;
+
+    if (port > 0xFFFF || buffer_id >= MAX_UDP_PORTS)
+        return -1;
+
+    if (dev.port_map_entries == 0)
+    {
+        printf("Port map not supported by the device. \n");
+        return -1;
+    }
+
+    // the entry of the port is updated, if already mapped
+    free_entry = dev.port_map_entries;
+
+    for (entry = 0; entry < dev.port_map_entries; entry++)
+    {
+        if ((dev.port_map[entry] & PORT_MAP_VALID) && PORT_MAP_PORT(dev.port_map[entry]) == port)
+            break;
+
+        if (!(dev.port_map[entry] & PORT_MAP_VALID) && free_entry == dev.port_map_entries)
+            free_entry = entry;
+    }
+
+    if (entry == dev.port_map_entries)
+        entry = free_entry;
+
+    if (entry == dev.port_map_entries)
+    {
+        printf("Port map full - The device maps up to %d ports \n", dev.port_map_entries);
+        return -1;
+    }
+
+    dev.port_map[entry] = PORT_MAP_ENTRY(port, buffer_id);
+    write_reg(&dev, PORT_MAP_OFFSET(entry), dev.port_map[entry]);
+
+    // Buffers beyond the ones in shared memory are dropped by the device
+    if (buffer_id >= dev.rx_buffers)
+        return relayout_shmem(&dev);
+
+    return 0;
+}
+
+int udriver_unmap_port(uint32_t port)
+{
+    uint32_t entry;
+
+    for (entry = 0; entry < dev.port_map_entries; entry++)
+    {
+        if ((dev.port_map[entry] & PORT_MAP_VALID) && PORT_MAP_PORT(dev.port_map[entry]) == port)
+        {
+            dev.port_map[entry] = 0;
+            write_reg(&dev, PORT_MAP_OFFSET(entry), 0);
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
 int udriver_send(struct udp_packet* udp_packet) 
+{
+    return udriver_send_queue(udp_packet, 0);
+}
+
+int udriver_send_queue(struct udp_packet* udp_packet, uint32_t queue) 
 {
     uint32_t tx_slot_full;
     uint32_t buftx_offset;
     uint32_t total_size;
+    uint32_t status;
+    struct udp_packet header;
 
-    read_reg(&dev, RBTC_CTRL_ADDR_BUFTX_FULL_0_N_I, &tx_slot_full);
+    if (queue >= dev.tx_queues)
+        queue = dev.tx_queues - 1;
 
-    if (tx_slot_full)
-        return -1;
+    // queue 0 is the tx buffer, the others have their own status register
+    if (queue == 0)
+    {
+        read_reg(&dev, RBTC_CTRL_ADDR_BUFTX_FULL_0_N_I, &tx_slot_full);
 
-    read_reg(&dev, RBTC_CTRL_ADDR_BUFTX_HEAD_0_N_I, &buftx_offset);
-    buftx_offset = BUF_TX_OFFSET_BYTES + (buftx_offset * BUF_ELEM_MAX_SIZE_BYTES);
+        if (tx_slot_full)
+            return -1;
+
+        read_reg(&dev, RBTC_CTRL_ADDR_BUFTX_HEAD_0_N_I, &buftx_offset);
+    }
+    else
+    {
+        read_reg(&dev, TXQ_STATUS_OFFSET(queue), &status);
+
+        if (status & TXQ_STATUS_FULL)
+            return -1;
+
+        buftx_offset = TXQ_STATUS_HEAD(status);
+    }
+
+    buftx_offset = BUF_SLOTS_BYTES(dev.tx_ring_base + queue * BUF_TX_LENGTH + buftx_offset);
+
+    // ask for a tx timestamp and a launch time in the header only
+    header = *udp_packet;
+
+    #if HW_TIMESTAMPS == 1
+    if (udp_packet->timestamp != 0)
+        header.payload_size_bytes |= PACKET_TX_TIMESTAMP_FLAG;
+    #endif
+
+    if (udp_packet->launch_time != 0)
+    {
+        header.payload_size_bytes |= PACKET_TX_LAUNCH_FLAG;
+        header.dest_port |= (udp_packet->launch_time & ((1ULL << PACKET_TX_LAUNCH_BITS) - 1)) << PACKET_TX_LAUNCH_OFFSET;
+    }
 
     // place packet in shared memory buffer
     total_size = PACKET_HDR_SIZE_BYTES + udp_packet->payload_size_bytes;
-    xrtBOWrite(dev.shmem_buff, udp_packet, PACKET_HDR_SIZE_BYTES, buftx_offset);
+    xrtBOWrite(dev.shmem_buff, &header, PACKET_HDR_SIZE_BYTES, buftx_offset);
     xrtBOWrite(dev.shmem_buff, udp_packet->payload, udp_packet->payload_size_bytes, buftx_offset+PACKET_HDR_SIZE_BYTES); 
     #if CACHEABLE_MEM == 1
     xrtBOSync (dev.shmem_buff, XCL_BO_SYNC_BO_FROM_DEVICE, total_size, buftx_offset);
     #endif
 
     // push to buffer tx
-    write_reg(&dev, RBTC_CTRL_ADDR_BUFTX_PUSHED_0_Y_O, 0);
-    write_reg(&dev, RBTC_CTRL_ADDR_BUFTX_PUSHED_0_Y_O, 1);
-    write_reg(&dev, RBTC_CTRL_ADDR_BUFTX_PUSHED_0_Y_O, 0);
+    if (queue == 0)
+    {
+        write_reg(&dev, RBTC_CTRL_ADDR_BUFTX_PUSHED_0_Y_O, 0);
+        write_reg(&dev, RBTC_CTRL_ADDR_BUFTX_PUSHED_0_Y_O, 1);
+        write_reg(&dev, RBTC_CTRL_ADDR_BUFTX_PUSHED_0_Y_O, 0);
+    }
+    else
+    {
+        write_reg(&dev, TXQ_PUSH_OFFSET(queue), 1);
+    }
 
     return udp_packet->payload_size_bytes;
 }
 
+int udriver_set_tx_rate(uint32_t queue, uint32_t rate_mbps, uint32_t burst_bytes)
+{
+    uint32_t value;
+
+    if (queue >= dev.tx_queues || rate_mbps > TXQ_RATE_MAX || burst_bytes > TXQ_RATE_MAX)
+        return -1;
+
+    // older bitstreams ignore the register
+    write_reg(&dev, TXQ_RATE_OFFSET(queue), (burst_bytes << 16) | rate_mbps);
+    read_reg(&dev, TXQ_RATE_OFFSET(queue), &value);
+
+    if (value != ((burst_bytes << 16) | rate_mbps))
+    {
+        printf("Tx queue rates not supported by the device. \n");
+        return -1;
+    }
+
+    return 0;
+}
+
 int udriver_recv(struct udp_packet* udp_packet, uint32_t port) 
 {
     uint32_t buffer_id;
     uint32_t buf_base_addr;
+    uint32_t tail;
     struct RBTC_CTRL_BUFRX reg;
 
     #if IRQ_SUPPORT == 1
@@ -315,16 +575,33 @@ int udriver_recv(struct udp_packet* udp_packet, uint32_t port)
     }
     #endif
 
-    buffer_id = port - dev.port_min;
+    if (port_to_buffer(&dev, port, &buffer_id) != 0)
+        return -1;
+
+    #if RX_PACKED_RING == 1
+    (void)reg;
+    (void)buf_base_addr;
+    (void)tail;
+    return recv_packed(&dev, udp_packet, buffer_id);
+    #endif
 
     get_buffer_rx_param(&dev, buffer_id, &reg); 
 
     if (reg.empty)
         return 0;
     
-    buf_base_addr = BUF_RX_IDX_OFFSET_BYTES(buffer_id) + reg.tail * BUF_ELEM_MAX_SIZE_BYTES;
+    // bits 4-8 only hold the lower bits of the tail of longer buffers
+    tail = dev.rx_length_log2_max ? BUFFER_EXT_TAIL(reg.pack_pointer) : reg.tail;
+
+    buf_base_addr = BUF_SLOTS_BYTES(dev.rx_ring_base[buffer_id] + tail);
     xrtBORead(dev.shmem_buff, udp_packet, PACKET_HDR_SIZE_BYTES, buf_base_addr);
     xrtBORead(dev.shmem_buff, udp_packet->payload, udp_packet->payload_size_bytes, buf_base_addr+PACKET_HDR_SIZE_BYTES);
+
+    // the trailer is dropped by the device when it does not fit in the slot
+    udp_packet->timestamp = 0;
+
+    if (RXPACK_RECORD_SIZE_BYTES(udp_packet->payload_size_bytes) <= BUF_ELEM_MAX_SIZE_BYTES)
+        read_rx_timestamp(&dev, udp_packet, buf_base_addr + RXPACK_RECORD_SIZE_BYTES(udp_packet->payload_size_bytes) - PACKET_WORD_SIZE_BYTES);
     
     notify_pop_to_rx_buffer(&dev, buffer_id);
 
@@ -336,10 +613,15 @@ int udriver_probe_port(uint32_t port)
     uint32_t buffer_id;
     struct RBTC_CTRL_BUFRX reg;
 
-    buffer_id = port - dev.port_min;
+    if (port_to_buffer(&dev, port, &buffer_id) != 0)
+        return 0;
 
     get_buffer_rx_param(&dev, buffer_id, &reg); 
 
+    #if RX_PACKED_RING == 1
+    return reg.pack_pointer != dev.rx_pack_tail[buffer_id];
+    #endif
+
     if (reg.empty)
         return 0;
 
@@ -354,7 +636,8 @@ void udriver_print_regs(uint32_t port)
 
     struct RBTC_CTRL_BUFRX reg;
 
-    buffer_id = port - dev.port_min;
+    if (port_to_buffer(&dev, port, &buffer_id) != 0)
+        buffer_id = 0;
 
     for (reg_i = 0; reg_i < RBTC_CTRL_REG_NUM; reg_i++)
         read_reg(&dev, reg_i * RBTC_CTRL_REG_STRIDE, &registers[reg_i]);
@@ -429,6 +712,91 @@ uint16_t udriver_get_port_range_high()
     return (uint16_t)port_high;
 }
 
+int udriver_read_counters(struct udriver_counters* counters)
+{
+    if (counters == NULL)
+        return -1;
+
+    read_reg(&dev, RBTC_CTRL_ADDR_PERF_RX_FRAMES_0_N_I, &counters->rx_frames);
+    if (counters->rx_frames == RBTC_CTRL_UNMAPPED_VALUE)
+    {
+        printf("Performance counters not supported by the device. \n");
+        return -1;
+    }
+
+    read_reg(&dev, RBTC_CTRL_ADDR_PERF_RX_DROP_CLOSED_0_N_I, &counters->rx_drop_closed);
+    read_reg(&dev, RBTC_CTRL_ADDR_PERF_RX_DROP_FULL_0_N_I, &counters->rx_drop_full);
+    read_reg(&dev, RBTC_CTRL_ADDR_PERF_TX_FRAMES_0_N_I, &counters->tx_frames);
+    read_reg(&dev, RBTC_CTRL_ADDR_PERF_DMA_WR_BUSY_0_N_I, &counters->dma_wr_busy);
+    read_reg(&dev, RBTC_CTRL_ADDR_PERF_DMA_WR_STALL_0_N_I, &counters->dma_wr_stall);
+    read_reg(&dev, RBTC_CTRL_ADDR_PERF_DMA_RD_BUSY_0_N_I, &counters->dma_rd_busy);
+    read_reg(&dev, RBTC_CTRL_ADDR_PERF_DMA_RD_STALL_0_N_I, &counters->dma_rd_stall);
+    read_reg(&dev, RBTC_CTRL_ADDR_PERF_RX_HDR_STALL_0_N_I, &counters->rx_hdr_stall);
+    read_reg(&dev, RBTC_CTRL_ADDR_PERF_RX_RING_MAX_0_N_I, &counters->rx_ring_max);
+
+    return 0;
+}
+
+uint64_t udriver_read_time(void)
+{
+    uint32_t lo;
+    uint32_t hi;
+
+    // reading the lower half latches the upper one
+    read_reg(&dev, RBTC_CTRL_ADDR_TIMESTAMP_LO_0_N_I, &lo);
+    read_reg(&dev, RBTC_CTRL_ADDR_TIMESTAMP_HI_0_N_I, &hi);
+
+    if (lo == RBTC_CTRL_UNMAPPED_VALUE && hi == RBTC_CTRL_UNMAPPED_VALUE)
+        return 0;
+
+    return ((uint64_t)hi << 32) | lo;
+}
+
+int udriver_read_tx_timestamp(uint64_t* timestamp)
+{
+    uint32_t lo;
+    uint32_t hi;
+
+    if (timestamp == NULL)
+        return -1;
+
+    read_reg(&dev, RBTC_CTRL_ADDR_TX_TS_HI_0_N_I, &hi);
+
+    if (hi == RBTC_CTRL_UNMAPPED_VALUE)
+    {
+        printf("Timestamps not supported by the device. \n");
+        return -1;
+    }
+
+    if (!(hi & TX_TS_VALID))
+        return 0;
+
+    // pops the timestamp
+    read_reg(&dev, RBTC_CTRL_ADDR_TX_TS_LO_0_N_I, &lo);
+    *timestamp = ((uint64_t)(hi & TX_TS_HI_MASK) << 32) | lo;
+
+    return 1;
+}
+
+int udriver_set_time(uint64_t time)
+{
+    uint32_t value;
+
+    read_reg(&dev, RBTC_CTRL_ADDR_TIMESTAMP_INCR_0_N_IO, &value);
+
+    if (value == RBTC_CTRL_UNMAPPED_VALUE)
+    {
+        printf("Setting the time not supported by the device. \n");
+        return -1;
+    }
+
+    // writing the upper half sets the time
+    write_reg(&dev, RBTC_CTRL_ADDR_TIMESTAMP_LOAD_LO_0_N_O, (uint32_t)time);
+    write_reg(&dev, RBTC_CTRL_ADDR_TIMESTAMP_SET_HI_0_Y_O, (uint32_t)(time >> 32));
+
+    return 0;
+}
+
 /****************************************************************************
 * Private functions: definitions
 ****************************************************************************/
@@ -472,8 +840,9 @@ static void notify_pop_to_rx_buffer(
     mask_clear = ~(1 << BUFFER_POPPED_OFFSET);
     mask_set = 1 << BUFFER_POPPED_OFFSET;
 
-    // get current value
+    // get current value (the upper half holds the packed ring head)
     read_reg(dev, BUFFER_RX_CTRL_BASE_OFFSET(buffer_id), &value);
+    value = (value & 0xFFFF) | ((uint32_t)dev->rx_pack_tail[buffer_id] << BUFFER_PACK_OFFSET);
     
     // clear pop
     write_reg(dev, BUFFER_RX_CTRL_BASE_OFFSET(buffer_id), value & mask_clear);
@@ -494,6 +863,248 @@ static void get_buffer_rx_param(
     read_reg(dev, BUFFER_RX_CTRL_BASE_OFFSET(buffer_id), (uint32_t*) reg);
 }
 
+/**
+ * Reads the packet at the tail of a packed ring, then writes the tail back so
+ * that the device can reuse its lines.
+ */
+static int recv_packed(
+    struct udp_ip_device* dev, 
+    struct udp_packet* udp_packet, 
+    uint32_t buffer_id
+)
+{
+    uint32_t value;
+    uint32_t offset;
+    uint32_t record_size;
+    uint32_t ring_lines;
+    uint16_t tail;
+
+    read_reg(dev, BUFFER_RX_CTRL_BASE_OFFSET(buffer_id), &value);
+    tail = dev->rx_pack_tail[buffer_id];
+
+    if ((uint16_t)(value >> BUFFER_PACK_OFFSET) == tail)
+        return 0;
+
+    // the device skips the end of the ring when a slot does not fit in it
+    ring_lines = RXPACK_RING_LINES(dev->rx_length_log2[buffer_id]);
+    offset = tail % ring_lines;
+
+    if (ring_lines - offset < RXPACK_SLOT_LINES)
+    {
+        tail += ring_lines - offset;
+        offset = 0;
+    }
+
+    offset = BUF_SLOTS_BYTES(dev->rx_ring_base[buffer_id]) + offset * RXPACK_LINE_SIZE_BYTES;
+
+    #if CACHEABLE_MEM == 1
+    xrtBOSync(dev->shmem_buff, XCL_BO_SYNC_BO_FROM_DEVICE, PACKET_HDR_SIZE_BYTES, offset);
+    #endif
+    xrtBORead(dev->shmem_buff, udp_packet, PACKET_HDR_SIZE_BYTES, offset);
+
+    record_size = RXPACK_RECORD_SIZE_BYTES(udp_packet->payload_size_bytes);
+    udp_packet->timestamp = 0;
+
+    if (record_size > BUF_ELEM_MAX_SIZE_BYTES)
+        record_size = BUF_ELEM_MAX_SIZE_BYTES;
+    else
+        read_rx_timestamp(dev, udp_packet, offset + record_size - PACKET_WORD_SIZE_BYTES);
+
+    if (udp_packet->payload_size_bytes > record_size - PACKET_HDR_SIZE_BYTES)
+        udp_packet->payload_size_bytes = record_size - PACKET_HDR_SIZE_BYTES;
+
+    #if CACHEABLE_MEM == 1
+    xrtBOSync(dev->shmem_buff, XCL_BO_SYNC_BO_FROM_DEVICE, record_size - PACKET_HDR_SIZE_BYTES, offset + PACKET_HDR_SIZE_BYTES);
+    #endif
+    xrtBORead(dev->shmem_buff, udp_packet->payload, udp_packet->payload_size_bytes, offset + PACKET_HDR_SIZE_BYTES);
+
+    // release the lines of the packet
+    tail += (record_size + RXPACK_LINE_SIZE_BYTES - 1) / RXPACK_LINE_SIZE_BYTES;
+    dev->rx_pack_tail[buffer_id] = tail;
+
+    value = (value & (1 << BUFFER_OPENSOCK_OFFSET)) | ((uint32_t)tail << BUFFER_PACK_OFFSET);
+    write_reg(dev, BUFFER_RX_CTRL_BASE_OFFSET(buffer_id), value);
+
+    return udp_packet->payload_size_bytes;
+}
+
+/**
+ * Reads the trailer of a received packet and extends its rx timestamp (lower
+ * PACKET_RX_TRAILER_TS_BITS bits of the device time) with the current time.
+ */
+static void read_rx_timestamp(
+    struct udp_ip_device* dev, 
+    struct udp_packet* udp_packet, 
+    uint32_t trailer_offset
+)
+{
+    #if HW_TIMESTAMPS == 1
+    uint64_t trailer;
+    uint64_t now;
+    uint64_t delta;
+    uint64_t mask;
+
+    if (!(udp_packet->dest_port & PACKET_RX_EXT_HEADER_FLAG))
+        return;
+
+    xrtBORead(dev->shmem_buff, &trailer, PACKET_WORD_SIZE_BYTES, trailer_offset);
+
+    if (!(trailer & PACKET_RX_TRAILER_TS_PRESENT))
+        return;
+
+    // the packet was stamped less than 2^39 ns ago
+    mask = (1ULL << PACKET_RX_TRAILER_TS_BITS) - 1;
+    now = udriver_read_time();
+    delta = (now - (trailer >> PACKET_RX_TRAILER_TS_OFFSET)) & mask;
+
+    udp_packet->timestamp = now - delta;
+    #else
+    (void)dev;
+    (void)udp_packet;
+    (void)trailer_offset;
+    #endif
+}
+
+/**
+ * Places the rx buffers of the port range (and of mapped ports) back to back 
+ * in a new shared memory buffer (each one with its own length, when supported
+ * by the device), followed by the tx buffer. Shall be called while the device is in reset.
+ */
+static int setup_shmem(struct udp_ip_device* dev)
+{
+    uint32_t buffer_id;
+    uint32_t base;
+    uint32_t value;
+    xrtBufferFlags flags;
+
+    #if CACHEABLE_MEM == 1
+    flags = XRT_BO_FLAGS_CACHEABLE;
+    #else
+    flags = XRT_BO_FLAGS_NONE;
+    #endif
+
+    // Rx buffers for the port range (and mapped ports) only - older bitstreams always place MAX_UDP_PORTS of them
+    dev->rx_buffers = dev->port_max - dev->port_min + 1;
+
+    for (buffer_id = 0; buffer_id < dev->port_map_entries; buffer_id++)
+    {
+        if ((dev->port_map[buffer_id] & PORT_MAP_VALID) && PORT_MAP_BUFFER(dev->port_map[buffer_id]) >= dev->rx_buffers)
+            dev->rx_buffers = PORT_MAP_BUFFER(dev->port_map[buffer_id]) + 1;
+    }
+
+    write_reg(dev, RBTC_CTRL_ADDR_RX_BUFFERS_0_N_O, dev->rx_buffers);
+    read_reg(dev, RBTC_CTRL_ADDR_RX_BUFFERS_0_N_O, &value);
+
+    if (value != dev->rx_buffers)
+        dev->rx_buffers = MAX_UDP_PORTS;
+
+    // Rx buffer lengths - older bitstreams only support BUF_RX_LENGTH slots
+    read_reg(dev, RBTC_CTRL_ADDR_RX_DEPTH_MAX_0_N_I, &value);
+    dev->rx_length_log2_max = (value == RBTC_CTRL_UNMAPPED_VALUE) ? 0 : value;
+
+    base = 0;
+
+    for (buffer_id = 0; buffer_id < MAX_UDP_PORTS; buffer_id++)
+    {
+        dev->rx_ring_base[buffer_id] = base;
+
+        if (dev->rx_length_log2_max != 0)
+            write_reg(dev, BUFFER_RX_CFG_OFFSET(buffer_id), 
+                (buffer_id < dev->rx_buffers) ? BUFFER_RX_CFG(base, dev->rx_length_log2[buffer_id]) : 0);
+
+        if (buffer_id < dev->rx_buffers)
+            base += 1 << dev->rx_length_log2[buffer_id];
+    }
+
+    dev->tx_ring_base = base;
+
+    if (dev->rx_length_log2_max != 0)
+        write_reg(dev, RBTC_CTRL_ADDR_TXBUF_BASE_0_N_O, base);
+
+    // Tx queues after the tx buffer - older bitstreams only have the tx buffer
+    read_reg(dev, RBTC_CTRL_ADDR_TXQ_NUM_0_N_I, &value);
+    dev->tx_queues = (value == RBTC_CTRL_UNMAPPED_VALUE || value == 0) ? 1 : value;
+
+    if (dev->tx_queues > BUF_TX_QUEUES_MAX)
+        dev->tx_queues = BUF_TX_QUEUES_MAX;
+
+    // Allocate shared memory buffer - in case of exception program fails
+    if (dev->shmem_buff != NULL)
+        xrtBOFree(dev->shmem_buff);
+
+    dev->shmem_size = BUF_SLOTS_BYTES(base + dev->tx_queues * BUF_TX_LENGTH);
+    dev->shmem_buff = xrtBOAlloc(dev->handle, dev->shmem_size, flags, 0); 
+    dev->shmem_phys_addr = xrtBOAddress(dev->shmem_buff);
+
+    // Note. older bitstreams only take 32 bit addresses
+    read_reg(dev, RBTC_CTRL_ADDR_DMA_ADDR_WIDTH_0_N_I, &value);
+
+    if (value == RBTC_CTRL_UNMAPPED_VALUE || value < 32)
+        value = 32;
+
+    if (value < 64 && (dev->shmem_phys_addr >> value) != 0)
+    {
+        printf("XRT allocated memory beyond the %u bit addresses of the IP. Abort. \n", value);
+        return -1;
+    }
+
+    // Shared memory address
+    write_reg(dev, RBTC_CTRL_ADDR_SHMEM_0_N_O, (uint32_t)dev->shmem_phys_addr);
+
+    if (value > 32)
+        write_reg(dev, RBTC_CTRL_ADDR_SHMEM_HI_0_N_O, (uint32_t)(dev->shmem_phys_addr >> 32));
+
+    return 0;
+}
+
+/**
+ * Lays out the shared memory again, while in reset: packets not received yet
+ * are dropped and every rx buffer restarts empty.
+ */
+static int relayout_shmem(struct udp_ip_device* dev)
+{
+    uint32_t buffer_rx_index;
+
+    write_reg(dev, RBTC_CTRL_ADDR_RES_0_Y_O, 1);
+
+    if (setup_shmem(dev) != 0)
+        return -1;
+
+    memset(dev->rx_pack_tail, 0, sizeof(dev->rx_pack_tail));
+
+    for (buffer_rx_index = 0; buffer_rx_index < MAX_UDP_PORTS; buffer_rx_index++)
+        notify_pop_to_rx_buffer(dev, buffer_rx_index);
+
+    write_reg(dev, RBTC_CTRL_ADDR_RES_0_Y_O, 0);
+
+    return 0;
+}
+
+/**
+ * Finds the rx buffer of a port as the device does: the first valid entry of 
+ * the port map, or the port range otherwise. Returns -1 for ports not received.
+ */
+static int port_to_buffer(struct udp_ip_device* dev, uint32_t port, uint32_t* buffer_id)
+{
+    uint32_t entry;
+
+    for (entry = 0; entry < dev->port_map_entries; entry++)
+    {
+        if ((dev->port_map[entry] & PORT_MAP_VALID) && PORT_MAP_PORT(dev->port_map[entry]) == port)
+        {
+            *buffer_id = PORT_MAP_BUFFER(dev->port_map[entry]);
+            return 0;
+        }
+    }
+
+    if (port > dev->port_max || port < dev->port_min)
+        return -1;
+
+    *buffer_id = port - dev->port_min;
+
+    return 0;
+}
+
 /**
  * Combines the byte of a network ordered uint32 into a byte array.
  * Used to represent network ordered IP addresses into 4 byte array.
@@ -21,6 +21,9 @@
 
 #define CACHEABLE_MEM   1  /* Set to 0 to use non-cacheable always coherent memory */
 #define IRQ_SUPPORT     0  /* Set to 0 to disable IRQ support (needs kernel module) */
+#define JUMBO_FRAMES    0  /* Set to 1 to use a 9000 bytes MTU (needs a bitstream with 16KB slots) */
+#define RX_PACKED_RING  0  /* Set to 1 to pack rx packets back to back (needs a supporting bitstream) */
+#define HW_TIMESTAMPS   0  /* Set to 1 to report rx/tx packet timestamps (needs a supporting bitstream) */
 
 /****************************************************************************
 * physical memory settings
@@ -83,6 +86,79 @@
 #define RBTC_CTRL_ADDR_BUFRX_PUSH_IRQ_0_IRQ (0x00000098)
 #define RBTC_CTRL_ADDR_BUFRX_OFFSET_0_N_I   (0x000000A0)
 
+/**
+ * Registers placed after the BUFRX control registers (one per rx buffer). The
+ * slot size is written as log2 while the device is in reset; reading an 
+ * unmapped register (older bitstreams) returns RBTC_CTRL_UNMAPPED_VALUE. 
+ * RX_BUFFERS sets how many rx buffers precede the tx buffer in shared memory
+ * (0: MAX_UDP_PORTS, the only layout known to older bitstreams).
+ * RX_DEPTH_MAX reads the largest rx buffer length supported (log2 slots), when
+ * the length and position of each rx buffer can be set through its CFG
+ * register: {position in slots (bits 4-31), length as log2 (bits 0-3)}. A CFG
+ * register set to 0 keeps the default layout. TXBUF_BASE places the tx buffer
+ * (in slots, 0: after the rx buffers of the default layout).
+ * TXQ_NUM reads the number of tx queues: queue n is a ring of BUF_TX_LENGTH 
+ * slots right after queue n-1, queue 0 being the tx buffer itself. Queues 
+ * other than 0 have their own status (head bits 0-7, tail 8-15, empty 16, 
+ * full 17), push, DWRR weight and rate (Mbit/s bits 0-15, burst in bytes 
+ * 16-31) registers, 8 bytes apart, from TXQ_OFFSET + n * 32. TXQ_CTRL 
+ * selects strict priority (0, highest queue first) or DWRR (1), latched 
+ * while in reset.
+ * PERF_* are free-running 32-bit counters (wrapping, cleared by reset): frames
+ * accepted / dropped (closed port, full rx buffer) / sent, cycles the DMA 
+ * write and read channels are busy or stalled, cycles the rx header FIFO 
+ * backpressures the filter, and the highest rx buffer fill level seen.
+ * OPENSOCK_OFFSET starts the open socket bitmap: bit i of the n-th register
+ * (8 bytes apart) opens the socket of rx buffer n * 32 + i, on top of the 
+ * BUFRX socket state bit. Writing 1 to RX_RINGS_RST empties all rx buffers and
+ * clears all BUFRX registers and the bitmap (0 is read back, unless the
+ * bitstream is older and maps neither).
+ * PORT_MAP_OFFSET starts the port map, PORT_MAP_NUM entries 8 bytes apart
+ * (valid bit 31, rx buffer index bits 16-25, port bits 0-15): a port found in
+ * the map is received by the rx buffer of its first valid entry, on top of the
+ * port range. Older bitstreams do not map PORT_MAP_NUM.
+ * DMA addresses are DMA_ADDR_WIDTH bits wide (up to 64): SHMEM_HI holds the 
+ * upper 32 bits of the shared memory address. Older bitstreams only take 
+ * 32-bit addresses and do not map DMA_ADDR_WIDTH.
+ */
+
+#define RBTC_CTRL_ADDR_SLOT_SIZE_0_N_O      (0x000020C8)
+#define RBTC_CTRL_ADDR_SLOT_SIZE_MAX_0_N_I  (0x000020D0)
+#define RBTC_CTRL_ADDR_RXPACK_CTRL_0_N_O    (0x000020D8)
+#define RBTC_CTRL_ADDR_RX_BUFFERS_0_N_O     (0x000020E0)
+#define RBTC_CTRL_ADDR_RX_DEPTH_MAX_0_N_I   (0x000020E8)
+#define RBTC_CTRL_ADDR_TXBUF_BASE_0_N_O     (0x000020F0)
+#define RBTC_CTRL_ADDR_TXQ_CTRL_0_N_O       (0x000020F8)
+#define RBTC_CTRL_ADDR_TXQ_NUM_0_N_I        (0x00002100)
+#define RBTC_CTRL_ADDR_PERF_RX_FRAMES_0_N_I (0x00002118)
+#define RBTC_CTRL_ADDR_PERF_RX_DROP_CLOSED_0_N_I (0x00002120)
+#define RBTC_CTRL_ADDR_PERF_RX_DROP_FULL_0_N_I (0x00002128)
+#define RBTC_CTRL_ADDR_PERF_TX_FRAMES_0_N_I (0x00002130)
+#define RBTC_CTRL_ADDR_PERF_DMA_WR_BUSY_0_N_I (0x00002138)
+#define RBTC_CTRL_ADDR_PERF_DMA_WR_STALL_0_N_I (0x00002140)
+#define RBTC_CTRL_ADDR_PERF_DMA_RD_BUSY_0_N_I (0x00002148)
+#define RBTC_CTRL_ADDR_PERF_DMA_RD_STALL_0_N_I (0x00002150)
+#define RBTC_CTRL_ADDR_PERF_RX_HDR_STALL_0_N_I (0x00002158)
+#define RBTC_CTRL_ADDR_PERF_RX_RING_MAX_0_N_I (0x00002160)
+#define RBTC_CTRL_ADDR_RX_RINGS_RST_0_Y_O   (0x00002168)
+#define RBTC_CTRL_ADDR_PORT_MAP_NUM_0_N_I   (0x00002170)
+#define RBTC_CTRL_ADDR_SHMEM_HI_0_N_O       (0x00002178)
+#define RBTC_CTRL_ADDR_RXDESC_POST_HI_0_N_O (0x00002180)
+#define RBTC_CTRL_ADDR_DMA_ADDR_WIDTH_0_N_I (0x00002188)
+#define RBTC_CTRL_ADDR_TIMESTAMP_LO_0_N_I   (0x00002190)
+#define RBTC_CTRL_ADDR_TIMESTAMP_HI_0_N_I   (0x00002198)
+#define RBTC_CTRL_ADDR_TX_TS_LO_0_N_I       (0x000021A0)
+#define RBTC_CTRL_ADDR_TX_TS_HI_0_N_I       (0x000021A8)
+#define RBTC_CTRL_ADDR_TIMESTAMP_INCR_0_N_IO (0x000021B0)
+#define RBTC_CTRL_ADDR_TIMESTAMP_LOAD_LO_0_N_O (0x000021B8)
+#define RBTC_CTRL_ADDR_TIMESTAMP_SET_HI_0_Y_O (0x000021C0)
+#define RBTC_CTRL_ADDR_TIMESTAMP_ADJ_HI_0_Y_O (0x000021C8)
+#define RBTC_CTRL_ADDR_OPENSOCK_OFFSET_0_N_O (0x00002200)
+#define RBTC_CTRL_ADDR_PORT_MAP_OFFSET_0_N_O (0x00002300)
+#define RBTC_CTRL_ADDR_BUFRX_CFG_OFFSET_0_N_O (0x00004000)
+#define RBTC_CTRL_ADDR_TXQ_OFFSET_0_N_IO    (0x00006000)
+#define RBTC_CTRL_UNMAPPED_VALUE            (0xDEADBEEF)
+
 /*
  * Bit Layout of the BUFRX (buffer receive) register (one per socket):
  * 
@@ -96,7 +172,11 @@
  *  |  9-13  | head                         |
  *  |   14   | socket state (open/closed)   |
  *  |   15   | dummy                        |
- *  | 16-64  | (reserved/unused)            |
+ *  | 16-31  | packed ring head/tail        |
+ *  | 32-64  | (reserved/unused)            |
+ * 
+ * Without RX_PACKED_RING, bits 16-23 read as the full tail and bits 24-31 as
+ * the full head, on bitstreams supporting RX_DEPTH_MAX.
  */
 
 
@@ -109,6 +189,10 @@
 #define BUFFER_HEAD_OFFSET      (9)
 #define BUFFER_HEAD_UPPER       (13)
 #define BUFFER_OPENSOCK_OFFSET  (14)
+#define BUFFER_PACK_OFFSET      (16)
+
+#define BUFFER_EXT_TAIL(pointer)    ((pointer) & 0xFF)
+#define BUFFER_EXT_HEAD(pointer)    (((pointer) >> 8) & 0xFF)
 
 /**
  * Each RX buffer has a CTRL register. Given that each register is 8-bytes, the 
@@ -118,6 +202,32 @@
 #define BUFFER_RX_CTRL_BASE_OFFSET(index)   \
     (RBTC_CTRL_ADDR_BUFRX_OFFSET_0_N_I + (index) * 8) 
 
+#define BUFFER_RX_CFG_OFFSET(index)         \
+    (RBTC_CTRL_ADDR_BUFRX_CFG_OFFSET_0_N_O + (index) * 8)
+
+#define BUFFER_RX_CFG(base, length_log2)    (((base) << 4) | (length_log2))
+
+#define TXQ_STATUS_OFFSET(queue)            (RBTC_CTRL_ADDR_TXQ_OFFSET_0_N_IO + (queue) * 32)
+#define TXQ_PUSH_OFFSET(queue)              (TXQ_STATUS_OFFSET(queue) + 0x08)
+#define TXQ_WEIGHT_OFFSET(queue)            (TXQ_STATUS_OFFSET(queue) + 0x10)
+#define TXQ_RATE_OFFSET(queue)              (TXQ_STATUS_OFFSET(queue) + 0x18)
+#define TXQ_RATE_MAX                        (0xFFFF)
+#define TXQ_STATUS_HEAD(status)             ((status) & 0xFF)
+#define TXQ_STATUS_FULL                     (1 << 17)
+
+#define OPENSOCK_MAP_BITS                   32
+#define OPENSOCK_MAP_REGS                   (MAX_UDP_PORTS / OPENSOCK_MAP_BITS)
+#define OPENSOCK_MAP_OFFSET(index)          \
+    (RBTC_CTRL_ADDR_OPENSOCK_OFFSET_0_N_O + ((index) / OPENSOCK_MAP_BITS) * 8)
+#define OPENSOCK_MAP_BIT(index)             (1U << ((index) % OPENSOCK_MAP_BITS))
+
+#define PORT_MAP_ENTRIES_MAX                32
+#define PORT_MAP_OFFSET(entry)              (RBTC_CTRL_ADDR_PORT_MAP_OFFSET_0_N_O + (entry) * 8)
+#define PORT_MAP_VALID                      (1U << 31)
+#define PORT_MAP_ENTRY(port, buffer_id)     (PORT_MAP_VALID | ((buffer_id) << 16) | ((port) & 0xFFFF))
+#define PORT_MAP_PORT(entry)                ((entry) & 0xFFFF)
+#define PORT_MAP_BUFFER(entry)              (((entry) >> 16) & (MAX_UDP_PORTS - 1))
+
 /**
  * Configuration of circular buffer dimension
  * 
@@ -128,37 +238,53 @@
  * MAX_UDP_PORTS:
  *  > port range width (-> number of rx buffers, 1 per port)
  * BUF_*X_LENGTH: 
- *  > number of circular buffer slots
+ *  > number of circular buffer slots (default for rx buffers, which can be
+ *  > set per port up to BUF_RX_LENGTH_MAX with udriver_set_rx_ring_depth)
  * BUF_ELEM_MAX_SIZE_BYTES: 
- *  > circular buffer slot width in bytes
+ *  > circular buffer slot width in bytes (1 << BUF_ELEM_SIZE_SHIFT), large 
+ *  > enough for a frame of ETH_MTU bytes
  * 
- * BUF_SIZE_BYTES: 
- *  > length of memory dedicated to each circular buffer
- * BUF_TOTAL_SIZE: 
- *  > total length of memory dedicated to all circular buffers (1 rx buffer per 
- *  > udp port / socket + 1 tx buffer)
- * 
- * BUF_RX_OFFSET_BYTES: 
- *  > offset of first rx buffer (end of reg space)
- * BUF_RX_IDX_OFFSET_BYTES: 
- *  > offset of n-th rx buffer
- * BUF_TX_OFFSET_BYTES: 
- *  > offset of tx buffer (after all rx buffers)
+ * BUF_SLOTS_BYTES: 
+ *  > length of memory taken by a number of slots, or offset of a slot from
+ *  > the shared memory base. Rx buffers (1 per port of the configured range)
+ *  > are placed back to back, followed by the tx buffer
  *
  */
 
 #define MAX_UDP_PORTS                   1024
 
-#define BUF_RX_LENGTH                   32
+#define BUF_RX_LENGTH_LOG2              5
+#define BUF_RX_LENGTH                   (1 << BUF_RX_LENGTH_LOG2)
+#define BUF_RX_LENGTH_MAX               256
 #define BUF_TX_LENGTH                   32
-#define BUF_ELEM_MAX_SIZE_BYTES         2048
+#define BUF_TX_QUEUES_MAX               4
+#if JUMBO_FRAMES == 1
+#define BUF_ELEM_SIZE_SHIFT             14
+#else
+#define BUF_ELEM_SIZE_SHIFT             11
+#endif
+#define BUF_ELEM_MAX_SIZE_BYTES         (1 << BUF_ELEM_SIZE_SHIFT)
+
+#define BUF_SLOTS_BYTES(slots)          ((size_t)(slots) * BUF_ELEM_MAX_SIZE_BYTES)
 
-#define BUF_SIZE_BYTES                  (BUF_RX_LENGTH * BUF_ELEM_MAX_SIZE_BYTES)
-#define BUF_TOTAL_SIZE                  (BUF_SIZE_BYTES * (MAX_UDP_PORTS + 1)) 
+/**
+ * With RX_PACKED_RING, each rx buffer is a ring of 64-byte lines: the device
+ * writes packets back to back and reports the head (in lines) in the BUFRX 
+ * register, while the driver writes back the tail. A packet never wraps: when 
+ * less than a slot is left before the end of the ring, it is written at the 
+ * start. Each record is the packet header, the payload (padded to 8 bytes) and
+ * an 8-byte trailer, clamped to a slot. Rings take up to the first 2MB of the
+ * rx buffer.
+ */
 
-#define BUF_RX_OFFSET_BYTES             0 
-#define BUF_RX_IDX_OFFSET_BYTES(idx)    (BUF_RX_OFFSET_BYTES + idx * BUF_SIZE_BYTES)
-#define BUF_TX_OFFSET_BYTES             (BUF_RX_OFFSET_BYTES + MAX_UDP_PORTS * BUF_SIZE_BYTES)
+#define RXPACK_LINE_SIZE_BYTES          64
+#define RXPACK_RING_SIZE_MAX_BYTES      (2 * 1024 * 1024)
+#define RXPACK_RING_LINES(length_log2)  \
+    ((BUF_SLOTS_BYTES(1 << (length_log2)) < RXPACK_RING_SIZE_MAX_BYTES ? \
+        BUF_SLOTS_BYTES(1 << (length_log2)) : RXPACK_RING_SIZE_MAX_BYTES) / RXPACK_LINE_SIZE_BYTES)
+#define RXPACK_SLOT_LINES               (BUF_ELEM_MAX_SIZE_BYTES / RXPACK_LINE_SIZE_BYTES)
+#define RXPACK_RECORD_SIZE_BYTES(size)  \
+    (PACKET_HDR_SIZE_BYTES + (((size) + 7) & ~7) + PACKET_WORD_SIZE_BYTES)
 
 /****************************************************************************
 * UDP Protocol - Constants and structures
@@ -171,10 +297,14 @@
  * With ethernet frame MTU of 1500 bytes (that represents the maximum size for 
  * the payload of an Ethernet frame) and accounting 20 bytes (assuming no IP 
  * options and IPv4) for IP and 8 bytes for UDP header, it makes 1472 bytes
- * available for the UDP payload.
+ * available for the UDP payload (8972 bytes with jumbo frames).
  */
 
+#if JUMBO_FRAMES == 1
+#define ETH_MTU                 (9000)
+#else
 #define ETH_MTU                 (1500)
+#endif
 #define IP_HDR_LEN              (20)
 #define UDP_HDR_LEN             (8)
 #define UDP_PAYL_MAX_LEN        (ETH_MTU-IP_HDR_LEN-UDP_HDR_LEN)
@@ -192,6 +322,30 @@
 #define PACKET_HDR_SIZE_BYTES       (PACKET_HDR_LENGTH * PACKET_WORD_SIZE_BYTES)
 #define PACKET_PAYL_SIZE_MAX_LEN    (UDP_PAYL_MAX_LEN / PACKET_WORD_SIZE_BYTES)
 
+/**
+ * With HW_TIMESTAMPS, the device time (ns since power on) a packet was 
+ * received at is reported in its timestamp (0 when not available). A packet
+ * sent with a non-zero timestamp asks for a tx timestamp instead, to be read
+ * back with udriver_read_tx_timestamp. The timestamp is not part of the
+ * header understood by the device.
+ * 
+ * A packet sent with a non-zero launch_time is held back by the device until
+ * its time (see udriver_read_time) reaches it. Only the lower 48 bits are
+ * passed, in the upper bits of dest_port. While a packet waits, the packets
+ * of every queue wait behind it.
+ */
+
+#define PACKET_TX_TIMESTAMP_FLAG    (1ULL << 62)
+#define PACKET_TX_LAUNCH_FLAG       (1ULL << 61)
+#define PACKET_TX_LAUNCH_OFFSET     (16)
+#define PACKET_TX_LAUNCH_BITS       (48)
+#define PACKET_RX_EXT_HEADER_FLAG   (1ULL << 63)
+#define PACKET_RX_TRAILER_TS_PRESENT (1 << 18)
+#define PACKET_RX_TRAILER_TS_OFFSET (24)
+#define PACKET_RX_TRAILER_TS_BITS   (40)
+#define TX_TS_VALID                 (1U << 31)
+#define TX_TS_HI_MASK               (0x7FFFFFFF)
+
 struct udp_packet 
 {
     uint64_t payload_size_bytes;
@@ -200,6 +354,26 @@ struct udp_packet
     uint64_t dest_ip;
     uint64_t dest_port;
     uint64_t* payload;
+    uint64_t timestamp;
+    uint64_t launch_time;
+};
+
+/**
+ * Snapshot of the device performance counters (see PERF_* registers).
+ */
+
+struct udriver_counters
+{
+    uint32_t rx_frames;
+    uint32_t rx_drop_closed;
+    uint32_t rx_drop_full;
+    uint32_t tx_frames;
+    uint32_t dma_wr_busy;
+    uint32_t dma_wr_stall;
+    uint32_t dma_rd_busy;
+    uint32_t dma_rd_stall;
+    uint32_t rx_hdr_stall;
+    uint32_t rx_ring_max;
 };
 
 /****************************************************************************
@@ -227,16 +401,62 @@ void udriver_destroy(void);
 
 /**
  * Sets a given port number status (0 for closed socket, 1 for opened socket).
- * Returns -1 in case of error (invalid status / port outside allowed range) or
- * 0 otherwise.
+ * It can be called while traffic flows, other ports are not affected. Packets
+ * left in the rx buffer of a port from the last time it was open are dropped
+ * when the port opens. Returns -1 in case of error (invalid status / port 
+ * outside allowed range) or 0 otherwise.
  */
 int udriver_set_socket_status(uint32_t port, uint32_t status);
 
+/**
+ * Sets the number of slots (a power of two, from 2 to BUF_RX_LENGTH_MAX) of 
+ * the rx buffer of a given port. The shared memory is laid out again, so that
+ * packets not received yet (on any port) are dropped. Returns -1 in case of 
+ * error (invalid depth / port outside allowed range / not supported by the 
+ * device) or 0 otherwise.
+ */
+int udriver_set_rx_ring_depth(uint32_t port, uint32_t depth);
+
+/**
+ * Receives a given port (any UDP port, also outside the port range) in the rx
+ * buffer of index buffer_id, as if it was port range low + buffer_id. The 
+ * socket of that buffer is opened and closed through the port, as usual. 
+ * Mapping a port to a buffer beyond the port range lays out the shared memory
+ * again, so that packets not received yet (on any port) are dropped. Returns
+ * -1 in case of error (invalid buffer / port map full / not supported by the
+ * device) or 0 otherwise.
+ */
+int udriver_map_port(uint32_t port, uint32_t buffer_id);
+
+/**
+ * Removes a port from the port map: it is received again through the port 
+ * range, if it falls within. Returns -1 in case of error (port not mapped) or 
+ * 0 otherwise.
+ */
+int udriver_unmap_port(uint32_t port);
+
 /**
  * Sends a UDP packet. Returns the number of bytes sent or -1 in case of errors.
  */
 int udriver_send(struct udp_packet* udp_packet);
 
+/**
+ * Sends a UDP packet through a given tx queue (queues beyond the last one 
+ * implemented by the device use the last one). With strict priority, higher
+ * queues are served first. Returns the number of bytes sent or -1 in case of 
+ * errors (e.g. the queue is full).
+ */
+int udriver_send_queue(struct udp_packet* udp_packet, uint32_t queue);
+
+/**
+ * Limits the rate of a given tx queue in the device (token bucket): rate in
+ * Mbit/s of UDP payload (0: unlimited), burst in bytes (0: one slot), both up
+ * to TXQ_RATE_MAX. Packets over the rate wait in the queue, so that 
+ * udriver_send_queue fails once it is full. Returns -1 in case of error 
+ * (invalid queue / rate / not supported by the device) or 0 otherwise.
+ */
+int udriver_set_tx_rate(uint32_t queue, uint32_t rate_mbps, uint32_t burst_bytes);
+
 /**
  * Receives a UDP packet from the given port. Returns the number of bytes
  * received or -1 in case of errors.
@@ -278,5 +498,32 @@ uint16_t udriver_get_port_range_low(void);
  */
 uint16_t udriver_get_port_range_high(void);
 
+/**
+ * Reads the device performance counters. Counters are 32 bit and wrap, so
+ * rates should be computed from the difference of two snapshots. Returns -1 
+ * in case of error (not supported by the device) or 0 otherwise.
+ */
+int udriver_read_counters(struct udriver_counters* counters);
+
+/**
+ * Reads the device time (ns since power on), the one used for timestamps.
+ * Returns 0 on older bitstreams.
+ */
+uint64_t udriver_read_time(void);
+
+/**
+ * Pops the oldest tx timestamp, in the order the packets asking for one were
+ * sent. Returns 1 if a timestamp was read, 0 if none is available yet or -1 
+ * in case of error (not supported by the device).
+ */
+int udriver_read_tx_timestamp(uint64_t* timestamp);
+
+/**
+ * Sets the device time (ns), e.g. to align it with the system clock before
+ * scheduling launch times. Returns -1 in case of error (not supported by the
+ * device) or 0 otherwise.
+ */
+int udriver_set_time(uint64_t time);
+
 
 #endif  // UDRIVER_H